@@ -0,0 +1,96 @@
+/**
+ * @file bench_codec.c
+ * @brief Microbenchmark: decode kernels (scalar vs build-selected) and whole-block decode, in rows/s.
+ *
+ * Usage: bench_codec [iterations]
+ *
+ * Cycles come from the TSC on x86; elsewhere they are derived from wall time and
+ * STAMPDB_BENCH_CPU_MHZ (if unset, only rows/s is reported).
+ */
+#include "src/stampdb_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+static uint64_t now_ns(void){ struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec; }
+static uint64_t cycles_now(void){
+#if HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static volatile uint32_t sink;
+static uint8_t  src[STAMPDB_PAYLOAD_BYTES];
+static uint32_t deltas[STAMPDB_BLOCK_MAX_ROWS], times[STAMPDB_BLOCK_MAX_ROWS];
+static float    vals[STAMPDB_BLOCK_MAX_ROWS];
+
+/** @brief Print one result row for `rows` rows processed in `ns` wall time / `cyc` cycles. */
+static void report(const char *what, const char *kern, double rows, double ns, double cyc, double mhz){
+  if (cyc <= 0.0 && mhz > 0.0) cyc = ns * mhz / 1000.0;
+  if (cyc > 0.0) printf("%-18s %-10s %7.2f cycles/row  %8.1f Mrows/s\n", what, kern, cyc/rows, rows/ns*1000.0);
+  else printf("%-18s %-10s %7s cycles/row  %8.1f Mrows/s\n", what, kern, "n/a", rows/ns*1000.0);
+}
+
+/** @brief Time each kernel of set `k` over a full lane of `n` rows. */
+static void run_kernels(const codec_kernels_t *k, unsigned iters, double mhz){
+  const size_t n = 109;
+  uint64_t t0, c0; uint32_t acc = 0;
+  t0 = now_ns(); c0 = cycles_now();
+  for (unsigned i=0;i<iters;i++){ k->widen_u8(deltas, src, n); acc ^= deltas[i % n]; }
+  report("widen_u8", k->name, (double)n*iters, (double)(now_ns()-t0), (double)(cycles_now()-c0), mhz);
+  t0 = now_ns(); c0 = cycles_now();
+  for (unsigned i=0;i<iters;i++){ k->widen_u16le(deltas, src, n); acc ^= deltas[i % n]; }
+  report("widen_u16", k->name, (double)n*iters, (double)(now_ns()-t0), (double)(cycles_now()-c0), mhz);
+  t0 = now_ns(); c0 = cycles_now();
+  for (unsigned i=0;i<iters;i++) acc ^= k->prefix_sum(times, deltas, n, i);
+  report("prefix_sum", k->name, (double)n*iters, (double)(now_ns()-t0), (double)(cycles_now()-c0), mhz);
+  t0 = now_ns(); c0 = cycles_now();
+  for (unsigned i=0;i<iters;i++){ k->dequant_i16le(vals, src, n, 1.0f, (float)i); acc ^= (uint32_t)vals[i % n]; }
+  report("dequant_i16", k->name, (double)n*iters, (double)(now_ns()-t0), (double)(cycles_now()-c0), mhz);
+  t0 = now_ns(); c0 = cycles_now();
+  for (unsigned i=0;i<iters;i++){ k->dequant_i8(vals, src, n, 1.0f, (float)i); acc ^= (uint32_t)vals[i % n]; }
+  report("dequant_i8", k->name, (double)n*iters, (double)(now_ns()-t0), (double)(cycles_now()-c0), mhz);
+  sink = acc;
+}
+
+/** @brief Encode one block with the given lanes, then time decode + prefix sum (the iterator's block load). */
+static void run_block(const char *what, uint8_t dt_bits, uint8_t val_lane, uint16_t count, unsigned iters, double mhz){
+  uint32_t d[STAMPDB_BLOCK_MAX_ROWS]; int16_t q[STAMPDB_BLOCK_MAX_ROWS]; float raw[STAMPDB_BLOCK_MAX_ROWS];
+  int32_t lim = val_lane == STAMPDB_VAL_XOR ? 32767 : codec_qlim(val_lane);
+  for (uint16_t i=0;i<count;i++){ d[i] = i ? 100u + (i*7u)%(dt_bits==8 ? 50u : 900u) : 0u; q[i] = (int16_t)((i*2654435761u) % (uint32_t)(2*lim+1) - (uint32_t)lim); raw[i] = 20.0f + 0.01f*(float)(i%17); }
+  if (dt_bits == STAMPDB_DT_DOD) for (uint16_t i=1;i<count;i++) d[i] = 1000u;
+  block_header_t h = {.count=count,.t0_ms=1,.dt_bits=dt_bits,.val_lane=val_lane,.bias=0.5f,.scale=0.001f};
+  uint8_t payload[STAMPDB_PAYLOAD_BYTES];
+  if (!codec_encode_payload(payload, &h, d, q, raw)){ printf("%-18s does not fit\n", what); return; }
+  uint32_t acc = 0;
+  uint64_t t0 = now_ns(), c0 = cycles_now();
+  for (unsigned i=0;i<iters;i++){
+    codec_decode_payload(payload, &h, deltas, vals);
+    acc ^= codec_prefix_sum(times, deltas, count, h.t0_ms);
+  }
+  report(what, codec_kernels_active.name, (double)count*iters, (double)(now_ns()-t0), (double)(cycles_now()-c0), mhz);
+  sink = acc;
+}
+
+int main(int argc, char **argv){
+  unsigned iters = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 10) : 200000u;
+  const char *m = getenv("STAMPDB_BENCH_CPU_MHZ");
+  double mhz = m ? atof(m) : 0.0;
+  for (size_t i=0;i<sizeof(src);i++) src[i] = (uint8_t)(i*131u + 7u);
+  run_kernels(&codec_kernels_scalar, iters, mhz);
+  if (strcmp(codec_kernels_active.name, codec_kernels_scalar.name) != 0) run_kernels(&codec_kernels_active, iters, mhz);
+  run_block("block u8+q16", 8, STAMPDB_VAL_Q16, 74, iters, mhz);
+  run_block("block u16+q16", 16, STAMPDB_VAL_Q16, 56, iters, mhz);
+  run_block("block dod+q16", STAMPDB_DT_DOD, STAMPDB_VAL_Q16, 109, iters, mhz);
+  run_block("block dod+q8", STAMPDB_DT_DOD, STAMPDB_VAL_Q8, 219, iters, mhz);
+  run_block("block dod+q12", STAMPDB_DT_DOD, STAMPDB_VAL_Q12, 146, iters, mhz);
+  run_block("block dod+xor", STAMPDB_DT_DOD, STAMPDB_VAL_XOR, 60, iters, mhz);
+  return 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file bench_crc32c.c
+ * @brief Microbenchmark: throughput of each CRC-32C kernel (bytes/cycle, MB/s).
+ *
+ * Usage: bench_crc32c [iterations]
+ *
+ * Cycles come from the TSC on x86; elsewhere they are derived from wall time and
+ * STAMPDB_BENCH_CPU_MHZ (if unset, only MB/s is reported).
+ */
+#include "src/stampdb_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+typedef uint32_t (*crc_fn)(const void*, size_t);
+
+static uint64_t now_ns(void){ struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec; }
+
+static volatile uint32_t sink;
+
+/** @brief Time `iters` calls of `fn` over `len` bytes and print one result row. */
+static void run(const char *name, crc_fn fn, const uint8_t *buf, size_t len, unsigned iters, double mhz){
+  uint32_t acc = 0;
+  for (unsigned i=0;i<iters/16+1;i++) acc ^= fn(buf, len); // warm-up
+  uint64_t t0 = now_ns();
+#if HAVE_TSC
+  uint64_t c0 = __rdtsc();
+#endif
+  for (unsigned i=0;i<iters;i++) acc ^= fn(buf, len);
+#if HAVE_TSC
+  double cycles = (double)(__rdtsc() - c0);
+#else
+  double cycles = 0.0;
+#endif
+  double ns = (double)(now_ns() - t0);
+  sink = acc;
+  double bytes = (double)len * iters;
+  if (cycles <= 0.0 && mhz > 0.0) cycles = ns * mhz / 1000.0;
+  if (cycles > 0.0) printf("%-10s %5zu B  %7.3f B/cycle  %9.1f MB/s\n", name, len, bytes/cycles, bytes/ns*1000.0);
+  else printf("%-10s %5zu B  %7s B/cycle  %9.1f MB/s\n", name, len, "n/a", bytes/ns*1000.0);
+}
+
+int main(int argc, char **argv){
+  unsigned iters = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 10) : 200000u;
+  const char *m = getenv("STAMPDB_BENCH_CPU_MHZ");
+  double mhz = m ? atof(m) : 0.0;
+  static uint8_t buf[4096];
+  for (size_t i=0;i<sizeof(buf);i++) buf[i] = (uint8_t)(i*131u + 7u);
+  const size_t lens[] = { 28, STAMPDB_PAYLOAD_BYTES, sizeof(buf) };
+  for (size_t k=0;k<sizeof(lens)/sizeof(lens[0]);k++){
+    unsigned it = iters; if (lens[k] > 1024) it = iters/16 ? iters/16 : 1;
+    run("bytewise", crc32c_bytewise, buf, lens[k], it, mhz);
+    run("slice8", crc32c_sw, buf, lens[k], it, mhz);
+    if (crc32c_hw_available()) run(crc32c_hw_name(), crc32c_hw, buf, lens[k], it, mhz);
+    run("dispatch", crc32c, buf, lens[k], it, mhz);
+  }
+  return 0;
+}
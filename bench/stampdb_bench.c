@@ -0,0 +1,326 @@
+/**
+ * @file stampdb_bench.c
+ * @brief End-to-end benchmark suite: ingest, query, latest and open/recovery, as JSON.
+ *
+ * Usage: stampdb_bench [--quick] [--rows N] [--label TEXT] [--out FILE]
+ *
+ * What it measures (each case on a fresh simulated device):
+ *  - ingest: rows/s and per-call latency for single-series writes, 8-series
+ *    interleaved writes, stampdb_write_batch, stampdb_write_batch_multi, and
+ *    single-series writes with the write-behind queue
+ *  - query: narrow (0.1% of the span) and wide (whole span) ranges, with and without
+ *    the page index: rows/s and per-query latency
+ *  - latest: stampdb_query_latest latency
+ *  - open: reopen time and footers read across flash sizes and fill levels, by full
+ *    footer scan and from the zone-map checkpoint
+ *  - device: the Pico main loop (8 series sampled every 100 ms, idle time spent on
+ *    write-behind, GC and group-commit ticks) under the simulator's RP2350 timing
+ *    model; latencies and flash busy time are modeled, so they are deterministic
+ *
+ * Output: one JSON document (schema "stampdb-bench/1") on stdout or in FILE; each
+ * result carries its unit and whether higher or lower is better, so
+ * tools/bench_compare.py can diff two runs. Progress goes to stderr.
+ *
+ * The image lives in `stampdb_bench.bin` in the working directory (removed at exit);
+ * STAMPDB_SIM_MODE / STAMPDB_SIM_SYNC apply as usual. Keep STAMPDB_SIM_TIMING off for
+ * the wall-clock cases; the device cases set the model themselves.
+ */
+#include "stampdb.h"
+#include "sim/sim_flash.h"
+#include "src/stampdb_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_IMAGE "stampdb_bench.bin"
+#define BENCH_SERIES 8u
+#define LAT_SAMPLES 20000u // per-call latencies kept per case (strided over the run)
+
+static uint64_t now_ns(void){ struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec; }
+
+static FILE *out;
+static bool first_result = true;
+static void *ws;
+static const uint32_t ws_bytes = 4u<<20;
+
+/** @brief Emit one result object. `better` is "higher" or "lower". */
+static void result(const char *bench, const char *name, const char *metric, double value, const char *unit, const char *better){
+  fprintf(out, "%s\n    {\"bench\": \"%s\", \"case\": \"%s\", \"metric\": \"%s\", \"value\": %.6g, \"unit\": \"%s\", \"better\": \"%s\"}",
+          first_result ? "" : ",", bench, name, metric, value, unit, better);
+  first_result = false;
+}
+
+static int cmp_u64(const void *a, const void *b){ uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b; return (x > y) - (x < y); }
+
+/** @brief Latency summary of `n` samples (sorted in place): p50, p99, max. */
+static void latency(const char *bench, const char *name, uint64_t *ns, size_t n){
+  if (!n) return;
+  qsort(ns, n, sizeof(*ns), cmp_u64);
+  result(bench, name, "p50", (double)ns[n/2], "ns", "lower");
+  result(bench, name, "p99", (double)ns[(n*99u)/100u], "ns", "lower");
+  result(bench, name, "max", (double)ns[n-1], "ns", "lower");
+}
+
+/** @brief Blank device of `flash_bytes`, opened with `cfg_extra` options. */
+static stampdb_t *fresh_db(uint32_t flash_bytes, const stampdb_cfg_t *cfg_extra){
+  char b[32]; snprintf(b, sizeof(b), "%u", flash_bytes);
+  setenv("STAMPDB_SIM_FLASH_BYTES", b, 1);
+  remove(BENCH_IMAGE); sim_flash_reload();
+  stampdb_cfg_t cfg = cfg_extra ? *cfg_extra : (stampdb_cfg_t){0};
+  cfg.workspace = ws; cfg.workspace_bytes = ws_bytes;
+  if (!cfg.read_batch_rows) cfg.read_batch_rows = 512;
+  if (!cfg.open_builders) cfg.open_builders = BENCH_SERIES;
+  stampdb_t *db = NULL;
+  if (stampdb_open(&db, &cfg)!=STAMPDB_OK){ fprintf(stderr, "open failed (%u B flash)\n", flash_bytes); exit(1); }
+  return db;
+}
+
+/** @brief Sensor-like value for row `i` of series `s` (slow drift plus small ripple). */
+static float sample(uint32_t i, uint32_t s){ return 20.0f + (float)s + 0.01f*(float)(i % 500u) + 0.001f*(float)((i*7u) % 13u); }
+
+enum { INGEST_SINGLE, INGEST_INTERLEAVED, INGEST_BATCH, INGEST_BATCH_MULTI };
+
+/** @brief Time `rows` rows of one ingest shape (flush included); keeps strided per-call latencies. */
+static void bench_ingest(const char *name, int shape, uint32_t rows, uint32_t wb_pages, uint64_t *lat){
+  stampdb_cfg_t extra = {.write_behind_pages = wb_pages};
+  stampdb_t *db = fresh_db(4u<<20, &extra);
+  enum { CHUNK = 256 };
+  uint16_t ser[CHUNK]; uint32_t ts[CHUNK]; float val[CHUNK];
+  uint32_t stride = rows / LAT_SAMPLES ? rows / LAT_SAMPLES : 1u, nlat = 0;
+  uint64_t t0 = now_ns();
+  for (uint32_t i=0; i<rows; ){
+    if (shape == INGEST_SINGLE || shape == INGEST_INTERLEAVED){
+      uint32_t s = shape == INGEST_SINGLE ? 0u : i % BENCH_SERIES;
+      uint32_t t = shape == INGEST_SINGLE ? i*1000u : (i / BENCH_SERIES)*1000u;
+      uint64_t c0 = (i % stride == 0) ? now_ns() : 0;
+      stampdb_write(db, (uint16_t)s, t, sample(i, s));
+      if (c0 && nlat < LAT_SAMPLES) lat[nlat++] = now_ns() - c0;
+      i++;
+      continue;
+    }
+    uint32_t n = rows - i < CHUNK ? rows - i : CHUNK;
+    for (uint32_t k=0;k<n;k++){
+      uint32_t r = i + k, s = shape == INGEST_BATCH ? 0u : r % BENCH_SERIES;
+      ser[k] = (uint16_t)s; ts[k] = (shape == INGEST_BATCH ? r : r / BENCH_SERIES)*1000u; val[k] = sample(r, s);
+    }
+    uint64_t c0 = now_ns();
+    if (shape == INGEST_BATCH) stampdb_write_batch(db, 0, ts, val, n);
+    else stampdb_write_batch_multi(db, ser, ts, val, n);
+    if (nlat < LAT_SAMPLES) lat[nlat++] = now_ns() - c0;
+    i += n;
+  }
+  stampdb_flush(db);
+  double s = (double)(now_ns() - t0) / 1e9;
+  result("ingest", name, "rows_per_s", rows / s, "rows/s", "higher");
+  latency("ingest", name, lat, nlat);
+  if (wb_pages){
+    stampdb_stats_t st; stampdb_info(db, &st);
+    result("ingest", name, "wb_full_stalls", st.wb_full_stalls, "ops", "lower");
+  }
+  stampdb_close(db);
+}
+
+/** @brief Rows of [t0, t1] for series 0 via stampdb_next_batch with a coalescing buffer. */
+static uint32_t drain_query(stampdb_t *db, uint32_t t0, uint32_t t1){
+  static uint32_t bts[512]; static float bv[512];
+  stampdb_it_t it; uint32_t rows = 0;
+  if (stampdb_query_begin(db, 0, t0, t1, &it)!=STAMPDB_OK) return 0;
+  stampdb_query_set_buffer(&it, bts, bv, 512);
+  const uint32_t *ts; const float *v; size_t n;
+  while (stampdb_next_batch(&it, &ts, &v, &n)) rows += (uint32_t)n;
+  stampdb_query_end(&it);
+  return rows;
+}
+
+/** @brief Query and latest benchmarks over `rows` rows spread over 8 interleaved series. */
+static void bench_query(uint32_t rows, uint32_t queries, uint64_t *lat){
+  for (int pidx=0; pidx<2; pidx++){
+    stampdb_cfg_t extra = {.page_index = (uint32_t)pidx};
+    stampdb_t *db = fresh_db(4u<<20, &extra);
+    for (uint32_t i=0;i<rows;i++) stampdb_write(db, (uint16_t)(i % BENCH_SERIES), (i / BENCH_SERIES)*1000u, sample(i, i % BENCH_SERIES));
+    stampdb_flush(db);
+    uint32_t span = (rows / BENCH_SERIES)*1000u, width = span / 1000u ? span / 1000u : 1000u;
+    const char *narrow = pidx ? "narrow_page_index" : "narrow", *wide = pidx ? "wide_page_index" : "wide";
+    uint64_t total_rows = 0, t0 = now_ns();
+    uint32_t seed = 12345u;
+    for (uint32_t q=0;q<queries;q++){
+      seed = seed*1103515245u + 12345u;
+      uint32_t start = (seed >> 8) % (span - width);
+      uint64_t c = now_ns();
+      total_rows += drain_query(db, start, start + width);
+      lat[q] = now_ns() - c;
+    }
+    double s = (double)(now_ns() - t0) / 1e9;
+    result("query", narrow, "queries_per_s", queries / s, "queries/s", "higher");
+    result("query", narrow, "rows_per_s", (double)total_rows / s, "rows/s", "higher");
+    latency("query", narrow, lat, queries);
+    uint32_t reps = 5; total_rows = 0; t0 = now_ns();
+    for (uint32_t r=0;r<reps;r++){ uint64_t c = now_ns(); total_rows += drain_query(db, 0, span); lat[r] = now_ns() - c; }
+    s = (double)(now_ns() - t0) / 1e9;
+    result("query", wide, "rows_per_s", (double)total_rows / s, "rows/s", "higher");
+    latency("query", wide, lat, reps);
+    if (!pidx){
+      seed = 99u;
+      for (uint32_t q=0;q<LAT_SAMPLES;q++){
+        seed = seed*1103515245u + 12345u;
+        uint32_t ts; float v; uint64_t c = now_ns();
+        stampdb_query_latest(db, (uint16_t)((seed >> 16) % BENCH_SERIES), &ts, &v);
+        lat[q] = now_ns() - c;
+      }
+      latency("latest", "random_series", lat, LAT_SAMPLES);
+    }
+    stampdb_close(db);
+  }
+}
+
+/** @brief Dashboard pattern: the same recent window of every series re-queried, without and with the block cache. */
+static void bench_hot_query(uint32_t rows, uint32_t queries, uint64_t *lat){
+  for (int cached=0; cached<2; cached++){
+    stampdb_cfg_t extra = {.block_cache_blocks = cached ? 64u : 0u};
+    stampdb_t *db = fresh_db(4u<<20, &extra);
+    for (uint32_t i=0;i<rows;i++) stampdb_write(db, (uint16_t)(i % BENCH_SERIES), (i / BENCH_SERIES)*1000u, sample(i, i % BENCH_SERIES));
+    stampdb_flush(db);
+    uint32_t span = (rows / BENCH_SERIES)*1000u, width = span / 100u ? span / 100u : 1000u;
+    const char *name = cached ? "hot_repeat_block_cache" : "hot_repeat";
+    uint64_t total_rows = 0, t0 = now_ns();
+    for (uint32_t q=0;q<queries;q++){
+      uint64_t c = now_ns();
+      total_rows += drain_query(db, span - width, span);
+      lat[q] = now_ns() - c;
+    }
+    double s = (double)(now_ns() - t0) / 1e9;
+    result("query", name, "queries_per_s", queries / s, "queries/s", "higher");
+    result("query", name, "rows_per_s", (double)total_rows / s, "rows/s", "higher");
+    latency("query", name, lat, queries);
+    stampdb_close(db);
+  }
+}
+
+/**
+ * @brief Device-like ingest under the RP2350 model (10% jitter): every 100 ms one sample
+ * per series, then idle work in ~1 ms slices until the next round, as in platform/pico/main.c.
+ * Write latencies are modeled time (ns, like the wall-clock cases).
+ */
+static void bench_device(const char *name, uint32_t rows, uint32_t wb_pages, uint32_t interval_ms, uint64_t *lat){
+  sim_flash_timing_t tm = sim_flash_timing_rp2350(); tm.jitter_pct = 10; tm.seed = 1;
+  sim_flash_set_timing(&tm);
+  stampdb_cfg_t extra = {.write_behind_pages = wb_pages, .commit_interval_ms = interval_ms};
+  stampdb_t *db = fresh_db(1u<<20, &extra);
+  sim_flash_stats_t fs; sim_flash_stats(&fs, true);
+  uint32_t stride = rows / LAT_SAMPLES ? rows / LAT_SAMPLES : 1u, nlat = 0;
+  uint64_t start = sim_clock_us(), next = start;
+  for (uint32_t i=0;i<rows;i++){
+    uint32_t s = i % BENCH_SERIES;
+    uint64_t c0 = sim_clock_us();
+    stampdb_write(db, (uint16_t)s, (uint32_t)(c0 / 1000u), sample(i, s));
+    if (i % stride == 0 && nlat < LAT_SAMPLES) lat[nlat++] = (sim_clock_us() - c0)*1000u;
+    if (s != BENCH_SERIES - 1u) continue;
+    next += 100000u;
+    if (interval_ms) stampdb_tick(db, (uint32_t)(sim_clock_us() / 1000u));
+    while (sim_clock_us() < next){
+      uint64_t left = next - sim_clock_us(); uint32_t budget = left < 1000u ? (uint32_t)left : 1000u;
+      if (wb_pages && stampdb_flash_step(db, budget)==STAMPDB_EBUSY) continue;
+      if (stampdb_gc_step(db, budget)==STAMPDB_EBUSY) continue;
+      sim_clock_advance_us(next - sim_clock_us()); // nothing left: sleep until the next round
+    }
+  }
+  stampdb_flush(db);
+  double elapsed_us = (double)(sim_clock_us() - start);
+  sim_flash_stats(&fs, true);
+  uint64_t busy = fs.op[SIM_OP_READ].busy_us + fs.op[SIM_OP_ERASE].busy_us + fs.op[SIM_OP_PROGRAM].busy_us;
+  latency("device", name, lat, nlat);
+  result("device", name, "flash_busy_pct", elapsed_us > 0 ? 100.0*(double)busy/elapsed_us : 0.0, "%", "lower");
+  result("device", name, "erases", (double)fs.op[SIM_OP_ERASE].ops, "ops", "lower");
+  result("device", name, "programs", (double)fs.op[SIM_OP_PROGRAM].ops, "ops", "lower");
+  stampdb_close(db);
+  sim_flash_set_timing(NULL);
+}
+
+/** @brief Median of three reopen times (ms); footers read by the last one in `*reads`. */
+static double reopen_ms(uint32_t *reads){
+  double t[3];
+  for (int r=0;r<3;r++){
+    stampdb_cfg_t cfg = {.workspace=ws,.workspace_bytes=ws_bytes,.read_batch_rows=512,.open_builders=BENCH_SERIES};
+    stampdb_t *db = NULL; uint64_t c = now_ns();
+    if (stampdb_open(&db, &cfg)!=STAMPDB_OK){ fprintf(stderr, "reopen failed\n"); exit(1); }
+    t[r] = (double)(now_ns() - c) / 1e6;
+    stampdb_stats_t st; stampdb_info(db, &st); *reads = st.recovery_footer_reads;
+    stampdb_close(db);
+  }
+  if (t[0] > t[1]){ double x = t[0]; t[0] = t[1]; t[1] = x; }
+  if (t[1] > t[2]){ double x = t[1]; t[1] = t[2]; t[2] = x; }
+  return t[0] > t[1] ? t[0] : t[1];
+}
+
+/** @brief Open time for a device of `flash_bytes` filled to `fill_pct` of its segments (>100 wraps). */
+static void bench_open(uint32_t flash_bytes, uint32_t fill_pct){
+  stampdb_t *db = fresh_db(flash_bytes, NULL);
+  uint32_t segs = (flash_bytes - STAMPDB_META_RESERVED) / STAMPDB_SEG_BYTES, target = segs*fill_pct/100u;
+  stampdb_stats_t st; stampdb_info(db, &st);
+  enum { CHUNK = 219 };
+  uint32_t ts[CHUNK]; float val[CHUNK]; uint32_t row = 0;
+  while (st.seg_seq_head - 1u < target){
+    for (uint32_t k=0;k<CHUNK;k++, row++){ ts[k] = row*1000u; val[k] = sample(row, 0); }
+    stampdb_write_batch(db, 0, ts, val, CHUNK);
+    stampdb_info(db, &st);
+  }
+  stampdb_flush(db); stampdb_close(db);
+  char name[48]; uint32_t reads;
+  snprintf(name, sizeof(name), "%uKiB_fill%u_scan", flash_bytes >> 10, fill_pct);
+  result("open", name, "open_ms", reopen_ms(&reads), "ms", "lower");
+  result("open", name, "footer_reads", reads, "pages", "lower");
+  stampdb_cfg_t cfg = {.workspace=ws,.workspace_bytes=ws_bytes,.read_batch_rows=512,.open_builders=BENCH_SERIES};
+  if (stampdb_open(&db, &cfg)!=STAMPDB_OK) exit(1);
+  stampdb_snapshot_save(db); stampdb_close(db);
+  snprintf(name, sizeof(name), "%uKiB_fill%u_checkpoint", flash_bytes >> 10, fill_pct);
+  result("open", name, "open_ms", reopen_ms(&reads), "ms", "lower");
+  result("open", name, "footer_reads", reads, "pages", "lower");
+}
+
+int main(int argc, char **argv){
+  bool quick = false; uint32_t rows = 0; const char *label = "", *path = NULL;
+  for (int i=1;i<argc;i++){
+    if (!strcmp(argv[i], "--quick")) quick = true;
+    else if (!strcmp(argv[i], "--rows") && i+1<argc) rows = (uint32_t)strtoul(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "--label") && i+1<argc) label = argv[++i];
+    else if (!strcmp(argv[i], "--out") && i+1<argc) path = argv[++i];
+    else { fprintf(stderr, "usage: %s [--quick] [--rows N] [--label TEXT] [--out FILE]\n", argv[0]); return 2; }
+  }
+  if (!rows) rows = quick ? 50000u : 500000u;
+  out = path ? fopen(path, "w") : stdout;
+  if (!out){ perror(path); return 1; }
+  setenv("STAMPDB_FLASH_PATH", BENCH_IMAGE, 1);
+  ws = malloc(ws_bytes);
+  uint64_t *lat = malloc(sizeof(uint64_t)*LAT_SAMPLES);
+  if (!ws || !lat) return 1;
+
+  fprintf(out, "{\n  \"schema\": \"stampdb-bench/1\",\n  \"label\": \"%s\",\n  \"platform\": \"sim\",\n", label);
+  fprintf(out, "  \"build\": {\"codec_kernels\": \"%s\", \"crc32c\": \"%s\", \"perf\": %d},\n",
+          codec_kernels_active.name, crc32c_hw_available() ? crc32c_hw_name() : "sw", STAMPDB_ENABLE_PERF);
+  fprintf(out, "  \"params\": {\"rows\": %u, \"series\": %u, \"quick\": %s},\n  \"results\": [", rows, BENCH_SERIES, quick ? "true" : "false");
+
+  fprintf(stderr, "ingest...\n");
+  bench_ingest("single_series", INGEST_SINGLE, rows, 0, lat);
+  bench_ingest("interleaved_8", INGEST_INTERLEAVED, rows, 0, lat);
+  bench_ingest("batch", INGEST_BATCH, rows, 0, lat);
+  bench_ingest("batch_multi_8", INGEST_BATCH_MULTI, rows, 0, lat);
+  bench_ingest("single_series_write_behind", INGEST_SINGLE, rows, 8, lat);
+  fprintf(stderr, "query + latest...\n");
+  bench_query(rows, quick ? 200u : 1000u, lat);
+  bench_hot_query(rows, quick ? 200u : 1000u, lat);
+  fprintf(stderr, "device model...\n");
+  bench_device("rp2350_sync", rows, 0, 0, lat);
+  bench_device("rp2350_write_behind", rows, 8, 0, lat);
+  bench_device("rp2350_group_commit", rows, 8, 1000, lat);
+  fprintf(stderr, "open...\n");
+  static const uint32_t sizes[] = { 256u<<10, 1u<<20, 4u<<20 }, fills[] = { 0, 50, 120 };
+  for (size_t i=0;i<sizeof(sizes)/sizeof(sizes[0]) - (quick ? 1u : 0u);i++)
+    for (size_t f=0;f<sizeof(fills)/sizeof(fills[0]);f++) bench_open(sizes[i], fills[f]);
+
+  fprintf(out, "\n  ]\n}\n");
+  if (path) fclose(out);
+  remove(BENCH_IMAGE);
+  free(lat); free(ws);
+  return 0;
+}
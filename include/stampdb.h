@@ -16,6 +16,7 @@
 // StampDB public API (C11)
 #pragma once
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct stampdb stampdb_t;
@@ -35,19 +36,87 @@ typedef enum {
  *
  * - workspace: backing memory (static or heap) owned by caller
  * - workspace_bytes: size of workspace; enforced cap
- * - read_batch_rows: 256/512 typical; affects iterator buffering only
- * - commit_interval_ms: advisory cadence (0 = size-only)
+ * - read_batch_rows: 256/512 typical; max rows per coalesced stampdb_next_batch() call
+ * - commit_interval_ms: publish deadline of an open block, measured on the stampdb_tick()
+ *   clock from the tick before its first row (0 = blocks close by size/flush only)
+ * - open_builders: series with an open block at once (0 = 4, max 64); the
+ *   least-recently-written block is published when a new series needs a slot
+ * - page_index: nonzero keeps an 8 B/page index (series, t0, span) in the
+ *   workspace so queries read only matching pages; rebuilt from headers at open
+ * - perf: nonzero keeps per-operation latency histograms in the workspace (~1.5 KiB);
+ *   ignored when the library is built without STAMPDB_ENABLE_PERF
+ * - write_behind_pages: nonzero queues up to that many flash ops (260 B each in the
+ *   workspace) and issues them in order from stampdb_flash_step() or the next
+ *   flush/snapshot/close; writes then never wait for flash unless the queue is full.
+ *   stampdb_flush() is the durability barrier: ops still queued at a power cut are lost
+ * - concurrent_readers: nonzero lets other threads/cores run queries next to the one
+ *   writer thread (see "Concurrent readers" below); queries then never drain the
+ *   write-behind queue, so rows become visible once their page program is issued
+ * - flash_base / flash_bytes: the flash partition this instance owns, as a device
+ *   offset and length (4 KiB aligned; 0/0 = the whole device). Its meta region (32 KiB)
+ *   sits at the top of the partition and the ring below it, so several instances with
+ *   disjoint partitions (each with its own workspace, GC and retention) can share one
+ *   device and run on different threads/cores without touching each other's state
+ * - latest_slots: entries in the latest-row cache (0 = 256; 16 B each, rounded up to a
+ *   power of two and to twice open_builders). Series beyond it are evicted oldest-first
+ *   and answered from flash by stampdb_query_latest; size it to the active series count
+ * - rollup_bucket_ms / rollup_flash_base / rollup_flash_bytes: nonzero bucket (>= 4 ms)
+ *   enables the rollup tier, a second ring in its own partition (disjoint from the
+ *   main one, same rules) holding one min/max/sum/count point per series and bucket,
+ *   emitted as raw blocks publish. It outlives the raw ring by roughly the rows per
+ *   bucket, and stampdb_query_aggregate serves wide ranges from it (see there)
+ * - block_cache_blocks: decoded blocks kept for iterators (~1.8 KB each, LRU): a query
+ *   re-reading a cached block skips its flash read, CRC and decode. Entries are keyed by
+ *   page and segment lap and dropped when GC or rotation erases the segment. Ignored
+ *   with concurrent_readers (readers never write shared state)
+ * - lazy_recovery: nonzero makes open locate only the head (head hint or snapshot plus
+ *   the footers sealed since) and accept writes at once; the other zone-map entries are
+ *   read by stampdb_recover_step / stampdb_gc_step, or by the first query that reaches
+ *   them. Tail reclaim, the latest-cache seeding and the time-sorted fast path wait for
+ *   the zone map to complete (stampdb_stats_t::recovery_ready). Falls back to the full
+ *   build when the head cannot be verified; ignored with a rollup tier
  */
 typedef struct {
   void*    workspace;        // pre-allocated
   uint32_t workspace_bytes;  // hard cap, checked at open
   uint32_t read_batch_rows;  // 256/512
-  uint32_t commit_interval_ms; // 0=size-only
+  uint32_t commit_interval_ms; // 0=size-only; else block deadline for stampdb_tick()
+  uint32_t open_builders;    // 0=default (4)
+  uint32_t page_index;       // 0=off; 1=per-page index (120 B per 4 KiB segment)
+  uint32_t perf;             // 0=off; 1=latency histograms (needs STAMPDB_ENABLE_PERF build)
+  uint32_t write_behind_pages; // 0=synchronous flash ops; N=queue depth (8 typical)
+  uint32_t concurrent_readers; // 0=single-threaded; 1=queries may run on other threads/cores
+  uint32_t flash_base;       // partition start on the device (4 KiB aligned)
+  uint32_t flash_bytes;      // partition length incl. meta region; 0=to end of device
+  uint32_t latest_slots;     // 0=default (256); latest-row cache entries
+  uint32_t rollup_bucket_ms; // 0=no rollup tier; else its bucket width
+  uint32_t rollup_flash_base; // rollup tier partition (as flash_base/flash_bytes)
+  uint32_t rollup_flash_bytes;
+  uint32_t block_cache_blocks; // 0=off; decoded-block cache entries for repeat queries
+  uint32_t lazy_recovery;    // 0=full zone map at open; 1=head only, rest on demand
 } stampdb_cfg_t;
 
+/*
+ * Concurrent readers (cfg.concurrent_readers). One writer thread owns the handle and
+ * is the only caller of the write calls, flush, flash_step, gc_step, recover_step, snapshot_save,
+ * set_tolerance, info, perf_info and close. Any number of other threads (or the other core) may call
+ * stampdb_query_begin/next/next_batch/set_buffer/export/end, stampdb_scan_range,
+ * stampdb_query_aggregate and stampdb_query_latest at the same time, each with its own iterator, without locks:
+ * the zone map, head, page index and latest table are published through a seqlock,
+ * and an iterator re-checks each segment's seqno after reading it, skipping segments
+ * that GC reclaimed or reused under it (their rows are gone). Readers never block
+ * the writer; they retry while it is mid-update. Close only once readers are done.
+ * Reader-side counters in stampdb_info (crc_errors, index_skipped_pages, agg_*,
+ * reader_retries, latest_misses) are relaxed atomics; perf histograms may miss
+ * increments from racing readers. A latest lookup that fell back to flash is not re-cached by a reader.
+ * After a lazy open a reader reaching a pending segment reads its footer itself
+ * (without the page index); only the writer publishes it into the zone map.
+ */
+
 /**
  * @brief Open a database instance, scanning storage and rebuilding summaries.
- * @return STAMPDB_OK on success, *_E* on validation/recovery failure.
+ * @return STAMPDB_OK on success, *_E* on validation/recovery failure (EINVAL also for a
+ * partition that is unaligned, runs past the device, or leaves fewer than 2 segments).
  */
 stampdb_rc stampdb_open(stampdb_t **db, const stampdb_cfg_t *cfg);
 /** @brief Close and release in-memory state. Storage remains intact. */
@@ -55,44 +124,220 @@ void       stampdb_close(stampdb_t *db);
 
 /**
  * @brief Append a single (series, ts_ms, value) sample.
- * - series: 0..255
+ * - series: 0..0xFFFE (0xFFFF is reserved)
  * - ts_ms: u32 ms (wraps); ordering within block is maintained by caller
  */
 stampdb_rc stampdb_write(stampdb_t *db, uint16_t series, uint32_t ts_ms, float value);
-/** @brief Force current block publish (header-last). May roll segment. */
+/**
+ * @brief Append `n` samples of one series from SoA columns (same semantics as n writes).
+ * - GC is checked once per block-sized chunk; on EBUSY, rows of earlier chunks are kept
+ */
+stampdb_rc stampdb_write_batch(stampdb_t *db, uint16_t series, const uint32_t *ts_ms, const float *values, size_t n);
+/** @brief Multi-series variant: row i goes to series[i]; runs of equal series are batched. */
+stampdb_rc stampdb_write_batch_multi(stampdb_t *db, const uint16_t *series, const uint32_t *ts_ms, const float *values, size_t n);
+/**
+ * @brief Publish all open blocks (header-last). May roll segment.
+ *
+ * Durability barrier: returns once every queued write-behind op has reached flash;
+ * EIO when one of them failed since the last barrier.
+ */
 stampdb_rc stampdb_flush(stampdb_t *db);
+/**
+ * @brief Idle-time write-behind worker: issue queued flash ops in order for up to
+ * `budget_us` (at least one op per call, so one op may overrun the budget).
+ * @return OK when the queue is empty, EBUSY when ops remain, EIO on a flash failure
+ * (ops queued behind it are dropped). No-op OK with write-behind off.
+ */
+stampdb_rc stampdb_flash_step(stampdb_t *db, uint32_t budget_us);
+
+/**
+ * @brief Group commit: publish every open block older than commit_interval_ms on this
+ * clock, and with them the ones due within the next quarter interval, in one pass.
+ *
+ * now_ms is any monotonic millisecond clock (wrapping is fine); blocks started after a
+ * tick take their deadline from it (blocks opened before the first tick from that tick),
+ * so the loss exposure at a power cut is bounded by commit_interval_ms plus the tick
+ * period (plus the queue drain with write-behind: the published pages are queued like
+ * any other). Call it from the writer's context, e.g. whenever it wakes up. No-op (besides the clock) with commit_interval_ms 0.
+ */
+stampdb_rc stampdb_tick(stampdb_t *db, uint32_t now_ms);
+
+/** @brief Tolerance of a series that never had one set: Fixed16 at 2 B per value. */
+#define STAMPDB_TOLERANCE_DEFAULT (-1.0f)
+/** @brief Store values bit-exact (XOR-float lane; header aggregates unavailable). */
+#define STAMPDB_TOLERANCE_LOSSLESS 0.0f
+/**
+ * @brief Set the max absolute error allowed for a series' values.
+ *
+ * Each block then uses the narrowest lane (8, 12 or 16-bit Fixed-point) whose
+ * rounding error stays within `max_abs_err` over the block's value range;
+ * Fixed16 is used when none does. STAMPDB_TOLERANCE_LOSSLESS stores raw floats,
+ * any negative value restores the default. Takes effect from the series' next
+ * block; EINVAL on NaN or bad series. Series 0..255 always have a slot; at most 32
+ * higher ids can hold a non-default tolerance at once (ENOSPACE beyond that).
+ */
+stampdb_rc stampdb_set_tolerance(stampdb_t *db, uint16_t series, float max_abs_err);
+
+/**
+ * @brief Max rows per block. Reached with the delta-of-delta timestamp lane at a
+ * constant cadence (5 B lane) and 8-bit values in a 224 B payload; Fixed16 blocks
+ * hold at most 109 rows (74 with u8 delta lanes, 56 with u16).
+ */
+#define STAMPDB_BLOCK_MAX_ROWS 219u
 
 /**
  * @brief Query iterator storage (opaque to callers). Stack-alloc and pass by pointer.
  */
 typedef struct stampdb_it {
-  // Public iterator state. Content is considered private; users just stack-allocate it.
+  // Public iterator state. Content is considered private; users just stack-allocate it
+  // (FFI bindings allocate stampdb_it_size() bytes instead of mirroring the layout).
   void *s;               // internal state pointer
   uint16_t series;       // query series
   uint32_t t0, t1;       // range
-  uint32_t seg_idx;      // internal
+  uint32_t seg_idx;      // internal: logical position (0 = oldest segment)
   uint32_t page_in_seg;  // internal
+  uint32_t seg_origin;   // internal: head segment index at query begin
+  uint8_t  zm_sorted;    // internal: zone map sorted at begin (enables early stop)
+  uint32_t head_seqno;   // internal: head segment seqno at begin (later laps are skipped)
+  uint32_t cur_seqno;    // internal: seqno of the segment being scanned (GC overtake check)
   uint32_t row_idx_in_block;
   uint16_t count_in_block;
   uint8_t  dt_bits;
   uint32_t t0_block;
   float    bias;
   float    scale;
-  uint32_t deltas[74];
-  int16_t  qvals[74];
-  uint32_t times[74];
-  float    values[74];
+  uint32_t *buf_ts;      // stampdb_query_set_buffer(): coalescing target, or NULL
+  float    *buf_vals;
+  uint32_t buf_cap;
+  uint32_t deltas[STAMPDB_BLOCK_MAX_ROWS];
+  uint32_t times[STAMPDB_BLOCK_MAX_ROWS];
+  float    values[STAMPDB_BLOCK_MAX_ROWS];
 } stampdb_it_t;
-/** @brief Begin a query over [t0_ms..t1_ms] for a series. */
+/**
+ * @brief Begin a query over [t0_ms..t1_ms] for a series.
+ *
+ * Rows are produced in segment sequence order (oldest first), so a series written
+ * in time order reads back time-ordered even after the ring wraps.
+ */
 stampdb_rc stampdb_query_begin(stampdb_t *db, uint16_t series, uint32_t t0_ms, uint32_t t1_ms, stampdb_it_t *it);
 /** @brief Advance iterator; returns true if a row is produced. */
 bool       stampdb_next(stampdb_it_t *it, uint32_t *ts_ms, float *val);
+/**
+ * @brief Next run of rows as SoA slices (`*n` rows at `*ts` / `*vals`); false when exhausted.
+ *
+ * Zero-copy by default: the slices point into the iterator's decoded block and
+ * hold one block's in-range rows. After stampdb_query_set_buffer() rows are
+ * coalesced across blocks into the caller buffer, up to min(cap, read_batch_rows).
+ * Slices are valid until the next call on the iterator; mixing with
+ * stampdb_next() is allowed.
+ */
+bool       stampdb_next_batch(stampdb_it_t *it, const uint32_t **ts, const float **vals, size_t *n);
+/** @brief Give stampdb_next_batch() a buffer of `cap` rows to coalesce into (NULL/0 = zero-copy). */
+void       stampdb_query_set_buffer(stampdb_it_t *it, uint32_t *ts_buf, float *val_buf, size_t cap);
+/**
+ * @brief Bulk export: copy up to `cap` next rows into caller columns; returns rows copied, 0 when exhausted.
+ *
+ * Rows are copied across blocks with no read_batch_rows limit, so bindings fill a whole
+ * preallocated array in one call; a short count means the query is done. The columns are
+ * not retained (unlike stampdb_query_set_buffer()).
+ */
+size_t     stampdb_query_export(stampdb_it_t *it, uint32_t *ts, float *vals, size_t cap);
+/** @brief sizeof(stampdb_it_t), for bindings that allocate iterators as opaque buffers. */
+size_t     stampdb_it_size(void);
 /** @brief End a query and release any iterator-bound resources. */
 void       stampdb_query_end(stampdb_it_t *it);
 
-/** @brief Get latest row for a series. */
+/**
+ * @brief Whole-ring scan cursor: the ring as of stampdb_scan_begin(), `segs` logical
+ * positions oldest first. Copyable; threads scan disjoint position ranges of one cursor.
+ */
+typedef struct {
+  uint32_t origin;     // head segment at begin
+  uint32_t head_seqno; // segments written later are skipped
+  uint32_t segs;       // positions 0..segs-1
+} stampdb_scan_t;
+/** @brief Scan callback: one CRC-verified, decoded block (all its rows, unclipped). */
+typedef void (*stampdb_scan_fn)(void *user, uint16_t series, const uint32_t *ts, const float *vals, size_t n);
+/** @brief Snapshot the ring for stampdb_scan_range(). */
+stampdb_rc stampdb_scan_begin(stampdb_t *db, stampdb_scan_t *sc);
+/**
+ * @brief Offline/bulk export: visit every block of every series in positions [pos0, pos1),
+ * in seqno and page order, verifying CRC and decoding like the iterator (a bad page
+ * ends its segment and counts in crc_errors).
+ *
+ * Concatenating the blocks of consecutive ranges gives each series in iterator order, so
+ * a whole image can be split across threads (open with concurrent_readers) and merged.
+ */
+stampdb_rc stampdb_scan_range(stampdb_t *db, const stampdb_scan_t *sc, uint32_t pos0, uint32_t pos1, stampdb_scan_fn fn, void *user);
+
+/**
+ * @brief One aggregate bucket: rows with ts in [bucket_start_ms, bucket_start_ms + bucket_ms).
+ * min/max/sum are 0 when count is 0; mean = sum / count.
+ */
+typedef struct {
+  uint32_t bucket_start_ms;
+  uint32_t count;
+  float    min, max, sum;
+} stampdb_agg_t;
+
+/**
+ * @brief Per-bucket count/min/max/sum over [t0_ms..t1_ms] for a series.
+ *
+ * - bucket_ms: bucket width (0 = one bucket for the whole range); buckets start at t0_ms
+ * - out/out_cap: caller array; EINVAL if fewer than the required buckets
+ * - out_n: buckets written ((t1-t0)/bucket_ms + 1)
+ *
+ * Segments and blocks lying wholly inside one bucket are answered from footer
+ * rollups / block headers without decoding payload values; the rest is decoded.
+ * Sums are float; expect rounding differences vs summing rows one by one.
+ *
+ * With a rollup tier, when bucket_ms is 0 or a multiple of rollup_bucket_ms with t0_ms
+ * bucket-aligned, the whole tier buckets inside the range are read from the tier where
+ * it is known complete (rows written since open, up to the last flush) or where the raw
+ * ring no longer reaches; at least 4 such buckets, the edges come from raw rows. Rows
+ * older than the raw ring then still count, as far back as the tier retains them.
+ */
+stampdb_rc stampdb_query_aggregate(stampdb_t *db, uint16_t series, uint32_t t0_ms, uint32_t t1_ms, uint32_t bucket_ms,
+                                   stampdb_agg_t *out, uint32_t out_cap, uint32_t *out_n);
+
+/**
+ * @brief Get latest row for a series (RAM cache lookup; includes not-yet-flushed rows).
+ *
+ * Unflushed rows report the written value; once flushed the quantized value is
+ * reported. A series evicted from the cache (cfg.latest_slots) is looked up on flash
+ * newest-segment-first, skipping segments by their series filter. EINVAL when the
+ * series has no retained rows.
+ */
 stampdb_rc stampdb_query_latest(stampdb_t *db, uint16_t series, uint32_t *out_ts_ms, float *out_value);
-/** @brief Persist A/B snapshot with ring head/tail and epoch. */
+/**
+ * @brief Idle-time garbage collection bounded by `budget_us`.
+ *
+ * Reclaims the oldest segments while free space is under the 10% watermark, then
+ * pre-erases the empty segments just ahead of the head so later rotations (and
+ * the writes that trigger them) need no erase. The budget is checked before each
+ * 4 KiB erase, so one call may overrun it by a single erase time. Call from the
+ * writer's context when it is idle. After a lazy open it first completes recovery
+ * (stampdb_recover_step) and reports EBUSY until that is done.
+ *
+ * @return OK when no GC work remains, EBUSY when the budget ran out first, EIO on erase failure.
+ */
+stampdb_rc stampdb_gc_step(stampdb_t *db, uint32_t budget_us);
+/**
+ * @brief Complete a lazy open (cfg.lazy_recovery) for up to `budget_us`: read pending
+ * segment footers newest-first (at least one per call, the budget checked before each
+ * further 256 B read), then the tail walk and latest-cache seeding once none are left.
+ * Snapshot_save runs it to the end itself.
+ *
+ * @return OK when recovery is complete (always without lazy_recovery), EBUSY while
+ * segments remain pending.
+ */
+stampdb_rc stampdb_recover_step(stampdb_t *db, uint32_t budget_us);
+/**
+ * @brief Persist A/B snapshot with ring head/tail and epoch.
+ *
+ * Also checkpoints the zone map (per-segment time range, block count, series set) in
+ * the meta region, so the next open reads only footers sealed or reclaimed since.
+ */
 stampdb_rc stampdb_snapshot_save(stampdb_t *db);
 
 /**
@@ -105,10 +350,88 @@ stampdb_rc stampdb_snapshot_save(stampdb_t *db);
  *  - gc_warn_events: Entries into <10% free watermark (may count multiple times)
  *  - gc_busy_events: Entries into <5% free or GC quota busy condition
  *  - recovery_truncations: Times recovery truncated after first invalid page
+ *  - workspace_used_bytes: Workspace consumed by open (control, builders, zone map, index)
+ *  - page_index_bytes: Share of the above used by the page index (0 when disabled)
+ *  - index_skipped_pages: Pages the iterator skipped via the index without a flash read
+ *  - agg_segments_pushdown / agg_blocks_pushdown: Aggregate query work answered from
+ *    footer rollups / block headers; agg_blocks_decoded: blocks it had to decode
+ *  - gc_deferred_events: Foreground reclaims skipped because the 2 seg/s quota was spent
+ *  - gc_preerase_hits: Segment rotations that needed no erase (already reclaimed/pre-erased)
+ *  - recovery_footer_reads: Segment footers read by open (every segment without a
+ *    zone-map checkpoint; only those sealed/reclaimed since it otherwise; with
+ *    lazy_recovery the head walk at open plus every footer settled later)
+ *  - recovery_pending_segs: Zone-map entries a lazy open has not read yet
+ *  - recovery_ready: 1 once recovery is complete (always without lazy_recovery)
+ *  - wb_depth / wb_hwm: Write-behind ops queued now / most ever queued
+ *  - wb_full_stalls: Enqueues that found the queue full and issued the oldest op inline
+ *  - wb_read_drains: Reads that touched a queued page/sector and drained the queue first
+ *  - reader_retries: Seqlock re-reads plus segments a reader dropped because GC
+ *    reclaimed or reused them mid-query (only nonzero with concurrent readers)
+ *  - latest_evictions: Flushed series dropped from the latest cache for another one
+ *  - latest_misses: stampdb_query_latest calls answered from flash (series not cached)
  */
 typedef struct {
   uint32_t seg_seq_head, seg_seq_tail, blocks_written, crc_errors;
   uint32_t gc_warn_events, gc_busy_events, recovery_truncations;
+  uint32_t workspace_used_bytes, page_index_bytes, index_skipped_pages;
+  uint32_t agg_segments_pushdown, agg_blocks_pushdown, agg_blocks_decoded;
+  uint32_t gc_deferred_events, gc_preerase_hits, recovery_footer_reads;
+  uint32_t wb_depth, wb_hwm, wb_full_stalls, wb_read_drains;
+  uint32_t reader_retries;
+  uint32_t latest_evictions, latest_misses;
+  uint32_t rollup_points, agg_rollup_points; // tier points emitted / read by aggregates
+  uint32_t tick_commits;     // blocks published by stampdb_tick deadlines
+  uint32_t block_cache_hits, block_cache_misses; // iterator blocks served from / decoded into the block cache
+  uint32_t recovery_pending_segs, recovery_ready; // lazy open: footers still unread / zone map complete
 } stampdb_stats_t;
 /** @brief Populate current stats into user struct. */
 void       stampdb_info(stampdb_t *db, stampdb_stats_t* out);
+
+/**
+ * @brief Operations timed by the optional perf module (index into stampdb_perf_t::ops).
+ *
+ * FLASH_* wrap every platform flash call (meta region included); the API entries
+ * time public calls; ROTATE / HEAD_HINT / GC_RECLAIM time write-path phases so a
+ * slow write can be attributed to a segment seal, a head-hint sector rewrite or GC.
+ */
+typedef enum {
+  STAMPDB_PERF_FLASH_READ=0,
+  STAMPDB_PERF_FLASH_PROGRAM,
+  STAMPDB_PERF_FLASH_ERASE,
+  STAMPDB_PERF_WRITE,        // stampdb_write / write_batch (per call)
+  STAMPDB_PERF_FLUSH,
+  STAMPDB_PERF_QUERY_BEGIN,
+  STAMPDB_PERF_QUERY_BLOCK,  // iterator loading + decoding its next block
+  STAMPDB_PERF_LATEST,
+  STAMPDB_PERF_AGGREGATE,
+  STAMPDB_PERF_SNAPSHOT,
+  STAMPDB_PERF_GC_STEP,
+  STAMPDB_PERF_ROTATE,       // footer seal + next-segment erase
+  STAMPDB_PERF_HEAD_HINT,    // meta_save_head_hint (sector erase + program)
+  STAMPDB_PERF_GC_RECLAIM,   // write-path tail reclaim
+  STAMPDB_PERF_OP_COUNT
+} stampdb_perf_op_t;
+
+/** @brief Log2 latency buckets: [0] < 1 µs, [i] in [2^(i-1), 2^i) µs, last bucket open-ended. */
+#define STAMPDB_PERF_BUCKETS 20u
+
+/** @brief Counters and latency histogram for one operation. `bytes` is set for flash ops only. */
+typedef struct {
+  uint32_t count, max_us;
+  uint64_t total_us, bytes;
+  uint32_t hist[STAMPDB_PERF_BUCKETS];
+} stampdb_perf_hist_t;
+
+/** @brief Perf snapshot; `enabled` is 0 when the DB was opened without `cfg.perf`. */
+typedef struct {
+  uint32_t enabled, reserved;
+  stampdb_perf_hist_t ops[STAMPDB_PERF_OP_COUNT];
+} stampdb_perf_t;
+
+/**
+ * @brief Copy perf counters (reset=1 also zeroes them afterwards).
+ * @return OK, or EINVAL when the library was built without STAMPDB_ENABLE_PERF.
+ */
+stampdb_rc stampdb_perf_info(stampdb_t *db, stampdb_perf_t *out, int reset);
+/** @brief Short stable name for a perf op (e.g. "flash_erase"); "?" when out of range. */
+const char *stampdb_perf_op_name(uint32_t op);
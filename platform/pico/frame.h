@@ -0,0 +1,95 @@
+/**
+ * @file frame.h
+ * @brief Binary USB-serial framing: length-prefixed, CRC32C-protected frames.
+ *
+ * What it owns:
+ *  - Wire format `A5 5A | u8 type | u16 len | payload[len] | u32 crc` (little-endian;
+ *    CRC32C over type, len and payload)
+ *  - Byte-fed receive state machine with resync on bad length/CRC
+ *  - Frame builder over a caller buffer
+ *
+ * Role in system:
+ *  - Fast path next to the text protocol in main.c: many samples per frame with one
+ *    ack, binary SoA export. A text line never starts with 0xA5, so both share the port.
+ *
+ * Constraints:
+ *  - Header-only and SDK-free (host tests); CRC comes from libstampdb's crc32c()
+ */
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+uint32_t crc32c(const void *data, size_t len); // libstampdb
+
+#define FRAME_SYNC0 0xA5u
+#define FRAME_SYNC1 0x5Au
+#define FRAME_MAX_PAYLOAD 4096u
+#define FRAME_OVERHEAD 9u // sync(2) + type + len(2) + crc(4)
+
+/* Host → device */
+#define FRAME_WRITE    0x01u // u16 n | n * {u16 series, u32 ts_ms, f32 value}
+#define FRAME_FLUSH    0x02u // empty
+#define FRAME_SNAPSHOT 0x03u // empty
+#define FRAME_EXPORT   0x04u // u16 series | u32 t0 | u32 t1
+#define FRAME_LATEST   0x05u // u16 series
+/* Device → host */
+#define FRAME_ACK      0x81u // u8 type acked | u8 status (stampdb_rc or FRAME_ST_*) | u16 samples accepted
+#define FRAME_ROWS     0x84u // u16 n | u32 ts[n] | f32 value[n]
+#define FRAME_END      0x85u // u32 rows exported
+#define FRAME_LATEST_R 0x86u // u8 found | u32 ts_ms | f32 value
+
+#define FRAME_SAMPLE_BYTES 10u
+#define FRAME_MAX_SAMPLES ((FRAME_MAX_PAYLOAD - 2u) / FRAME_SAMPLE_BYTES)
+#define FRAME_MAX_ROWS ((FRAME_MAX_PAYLOAD - 2u) / 8u)
+#define FRAME_ST_BAD  0xF0u // malformed payload
+#define FRAME_ST_BUSY 0xF1u // some samples dropped (ring stayed full)
+
+static inline void frame_put16(uint8_t *p, uint16_t v){ p[0]=(uint8_t)v; p[1]=(uint8_t)(v>>8); }
+static inline void frame_put32(uint8_t *p, uint32_t v){ p[0]=(uint8_t)v; p[1]=(uint8_t)(v>>8); p[2]=(uint8_t)(v>>16); p[3]=(uint8_t)(v>>24); }
+static inline uint16_t frame_get16(const uint8_t *p){ return (uint16_t)(p[0] | (p[1]<<8)); }
+static inline uint32_t frame_get32(const uint8_t *p){ return (uint32_t)p[0] | ((uint32_t)p[1]<<8) | ((uint32_t)p[2]<<16) | ((uint32_t)p[3]<<24); }
+
+/**
+ * @brief Finish a frame whose payload the caller wrote at `buf + 5`.
+ * @return Total frame bytes (sync + header + payload + crc) in `buf`.
+ */
+static inline size_t frame_seal(uint8_t *buf, uint8_t type, uint16_t len){
+  buf[0] = FRAME_SYNC0; buf[1] = FRAME_SYNC1; buf[2] = type; frame_put16(buf + 3, len);
+  frame_put32(buf + 5u + len, crc32c(buf + 2, 3u + len));
+  return FRAME_OVERHEAD + len;
+}
+
+/** @brief Receive state: `buf` holds type | len | payload | crc of the frame in progress. */
+typedef struct {
+  uint32_t have;   // bytes of the current frame after the sync word
+  uint32_t need;   // total bytes expected after the sync word (0 until len is known)
+  uint8_t  sync;   // sync bytes matched
+  uint32_t crc_errors, len_errors;
+  uint8_t  buf[3u + FRAME_MAX_PAYLOAD + 4u];
+} frame_rx_t;
+
+/**
+ * @brief Feed one byte. @return true when a CRC-clean frame is complete; its type is
+ * `buf[0]`, payload `buf + 3`, length frame_get16(buf + 1). Bad frames are counted and
+ * dropped; the parser then rescans for the next sync word.
+ */
+static inline bool frame_rx_byte(frame_rx_t *rx, uint8_t b){
+  if (rx->sync < 2u){
+    if (rx->sync == 1u && b == FRAME_SYNC1){ rx->sync = 2; rx->have = 0; rx->need = 0; }
+    else rx->sync = (b == FRAME_SYNC0) ? 1u : 0u;
+    return false;
+  }
+  rx->buf[rx->have++] = b;
+  if (rx->have == 3u){
+    uint32_t len = frame_get16(rx->buf + 1);
+    if (len > FRAME_MAX_PAYLOAD){ rx->len_errors++; rx->sync = 0; return false; }
+    rx->need = 3u + len + 4u;
+  }
+  if (!rx->need || rx->have < rx->need) return false;
+  rx->sync = 0;
+  uint32_t len = rx->need - 7u;
+  if (crc32c(rx->buf, 3u + len) != frame_get32(rx->buf + 3u + len)){ rx->crc_errors++; return false; }
+  return true;
+}
@@ -1,125 +1,283 @@
 /**
  * @file main.c
- * @brief Pico firmware: Core0 serial bridge, Core1 DB runner via multicore FIFO.
+ * @brief Pico firmware: Core0 serial bridge and query reader, Core1 DB writer via
+ * shared sample ring + FIFO.
  *
  * What it owns:
- *  - FIFO protocol (write/flush/snapshot/latest/export)
- *  - USB-serial command parser emitting lines to stdout (CDC)
+ *  - Sample handoff: SPSC ring in shared SRAM (spsc_ring.h), FIFO doorbell
+ *  - FIFO command protocol (flush/snapshot/close barriers)
+ *  - Core0-side latest/export: direct concurrent-reader queries on Core1's handle
+ *  - USB-serial front end: text commands (one line each) and binary frames
+ *    (frame.h: batched writes with one ack, SoA export)
  *
  * Role in system:
  *  - Demonstration firmware used to validate the Pico build and interact via USB
  */
 #include "pico/stdlib.h"
 #include "pico/multicore.h"
+#include "pico/flash.h"
 #include "stampdb.h"
+#include "spsc_ring.h"
+#include "frame.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
 
-// Dual-core split: Core1 runs DB; Core0 sends commands via FIFO (SPSC)
-// FIFO protocol (each command is 4 words):
-// w0=cmd (1=write,2=flush,3=snapshot,4=close,5=latest,6=export), w1=series (u16) in low 16 bits, w2=ts_ms (u32), w3=value (u32 raw float bits)
-// For cmd=5 (latest), Core1 replies with 3 words: resp_tag=0xDEAD0005, ts_ms, val_bits
+// Dual-core split: Core1 is the DB writer; Core0 queues samples in `ring`, sends barrier
+// commands via FIFO and runs latest/export itself as a concurrent reader (the DB is opened
+// with cfg.concurrent_readers), so a long export never stalls ingest on Core1.
+// FIFO protocol: w0=cmd. cmd=1 (doorbell: samples queued) is a single word; the others
+// carry 3 more (unused) words: 2=flush, 3=snapshot, 4=close.
+// Core1 drains the ring before every command, so a command sees all samples queued before it;
+// Core0 queries first wait until `applied` covers the samples it queued (same guarantee).
+// cmd=2/3 (flush/snapshot) reply (0xDEAD0000|cmd, rc) once queued flash ops have landed.
+#define CMD_DOORBELL 1u
+#define RING_WAIT_US 50000u // producer waits this long on a full ring before dropping
+#define DRAIN_BATCH  64u    // samples per stampdb_write_batch_multi() call
+#define WB_PAGES     8u     // write-behind flash queue (2 KiB of the workspace)
+#define COMMIT_MS    1000u  // open blocks publish at most this long (plus one tick) after their first row
+#define TICK_US      100000u // Core1 wakes at least this often to run stampdb_tick()
 
 static uint8_t ws[64*1024];
+static spsc_ring_t ring; // shared SRAM: Core0 produces, Core1 consumes
+static _Atomic(stampdb_t*) db_shared;   // published by Core1 once open; Core0 only reads through it
+static _Atomic uint32_t applied;        // samples Core1 has written into the DB (Core1-owned)
+
+/** @brief Emit one sealed frame with a single raw stdio call (no CRLF translation; serialized across cores). */
+static void send_frame(const uint8_t *buf, size_t len){ stdio_put_string((const char*)buf, (int)len, false, false); }
+
+/** @brief Core1: drain up to one ring's worth of samples into the DB in batches. */
+static void drain_ring(stampdb_t *db){
+  uint16_t series[DRAIN_BATCH]; uint32_t ts[DRAIN_BATCH]; float vals[DRAIN_BATCH];
+  for (uint32_t done=0; done<SPSC_RING_SLOTS; ){
+    size_t n = spsc_pop(&ring, series, ts, vals, DRAIN_BATCH);
+    if (!n) break;
+    stampdb_write_batch_multi(db, series, ts, vals, n);
+    atomic_store_explicit(&applied, atomic_load_explicit(&applied, memory_order_relaxed) + (uint32_t)n, memory_order_release);
+    done += (uint32_t)n;
+  }
+}
+
+/**
+ * @brief Core0: stream rows of [t0, t1] as FRAME_ROWS frames (SoA, up to
+ * read_batch_rows per frame) followed by FRAME_END with the row count.
+ */
+static void export_binary(stampdb_t *db, uint16_t series, uint32_t t0, uint32_t t1){
+  static uint32_t ts_buf[FRAME_MAX_ROWS]; static float val_buf[FRAME_MAX_ROWS];
+  static uint8_t fb[FRAME_OVERHEAD + FRAME_MAX_PAYLOAD];
+  uint32_t total = 0;
+  stampdb_it_t it;
+  if (stampdb_query_begin(db, series, t0, t1, &it)==STAMPDB_OK){
+    stampdb_query_set_buffer(&it, ts_buf, val_buf, FRAME_MAX_ROWS);
+    const uint32_t *ts; const float *vals; size_t n;
+    while (stampdb_next_batch(&it, &ts, &vals, &n)){
+      uint8_t *p = fb + 5;
+      frame_put16(p, (uint16_t)n); memcpy(p + 2, ts, n*4u); memcpy(p + 2 + n*4u, vals, n*4u); // LE core: wire order
+      send_frame(fb, frame_seal(fb, FRAME_ROWS, (uint16_t)(2u + n*8u)));
+      total += (uint32_t)n;
+    }
+    stampdb_query_end(&it);
+  }
+  frame_put32(fb + 5, total);
+  send_frame(fb, frame_seal(fb, FRAME_END, 4));
+}
 
 /**
- * @brief Core1 entry: owns the DB and processes FIFO commands from Core0.
+ * @brief Core1 entry: owns the DB as its only writer and processes FIFO commands from Core0.
  *
  * Commands:
- *  - 1: write(series, ts, value)
- *  - 2: flush
- *  - 3: snapshot
+ *  - 1: doorbell (drain the sample ring)
+ *  - 2: flush → reply (tag, rc) after the write-behind barrier
+ *  - 3: snapshot → reply (tag, rc)
  *  - 4: close
- *  - 5: latest(series) → reply (tag, ts, val_bits)
- *  - 6: export(series, t0, t1) → print CSV lines + END
+ * Whenever it wakes (command, doorbell or TICK_US without either) it runs the group
+ * commit, so slow series publish within COMMIT_MS without Core0 sending flushes.
  */
+extern uint32_t __flash_binary_end; // linker symbol: end of the firmware image in XIP space
+
 static void core1_entry(void){
   stampdb_t *db=NULL;
-  stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=sizeof(ws),.read_batch_rows=256,.commit_interval_ms=0};
+  // the DB partition starts at the first sector above the firmware and runs to the end of flash
+  uint32_t base = ((uint32_t)((uintptr_t)&__flash_binary_end - XIP_BASE) + 4095u) & ~4095u;
+  // lazy recovery: ingest starts once the head is found; the gc_step idle loop reads the rest
+  stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=sizeof(ws),.read_batch_rows=256,.commit_interval_ms=COMMIT_MS,
+                     .write_behind_pages=WB_PAGES,.concurrent_readers=1,.flash_base=base,.lazy_recovery=1};
   if (stampdb_open(&db,&cfg)!=STAMPDB_OK){ for(;;) tight_loop_contents(); }
+  atomic_store_explicit(&db_shared, db, memory_order_release);
   for(;;){
-    uint32_t cmd = multicore_fifo_pop_blocking();
+    // idle: issue queued page programs/erases, then GC, in ~1 ms slices until there
+    // is nothing left or a command arrives (ingest never waits on a queued op)
+    while (!multicore_fifo_rvalid() && stampdb_flash_step(db, 1000)==STAMPDB_EBUSY) {}
+    while (!multicore_fifo_rvalid() && stampdb_gc_step(db, 1000)==STAMPDB_EBUSY) {}
+    uint32_t cmd = 0;
+    bool woke = multicore_fifo_pop_timeout_us(TICK_US, &cmd);
+    drain_ring(db);
+    stampdb_tick(db, to_ms_since_boot(get_absolute_time()));
+    if (!woke || cmd==CMD_DOORBELL) continue;
     uint32_t w1 = multicore_fifo_pop_blocking();
     uint32_t w2 = multicore_fifo_pop_blocking();
     uint32_t w3 = multicore_fifo_pop_blocking();
-    if (cmd==1){
-      uint16_t series = (uint16_t)(w1 & 0xFFFFu);
-      uint32_t ts = w2;
-      float val; memcpy(&val,&w3,sizeof(val));
-      stampdb_write(db, series, ts, val);
-    } else if (cmd==2){
-      stampdb_flush(db);
-    } else if (cmd==3){
-      stampdb_snapshot_save(db);
+    if (cmd==2 || cmd==3){
+      stampdb_rc rc = cmd==2 ? stampdb_flush(db) : stampdb_snapshot_save(db);
+      multicore_fifo_push_blocking(0xDEAD0000u | cmd);
+      multicore_fifo_push_blocking((uint32_t)rc);
     } else if (cmd==4){
+      atomic_store_explicit(&db_shared, NULL, memory_order_release);
       stampdb_close(db); db=NULL; break;
-    } else if (cmd==5){
-      uint16_t series = (uint16_t)(w1 & 0xFFFFu);
-      uint32_t ts=0; float v=0.0f; stampdb_query_latest(db, series, &ts, &v);
-      uint32_t vb; memcpy(&vb,&v,sizeof(v));
-      multicore_fifo_push_blocking(0xDEAD0005u);
-      multicore_fifo_push_blocking(ts);
-      multicore_fifo_push_blocking(vb);
-    } else if (cmd==6){
-      uint16_t series = (uint16_t)(w1 & 0xFFFFu);
-      uint32_t t0 = w2; uint32_t t1 = w3;
-      stampdb_it_t it; if (stampdb_query_begin(db, series, t0, t1, &it)==STAMPDB_OK){
-        uint32_t ts; float val;
-        while (stampdb_next(&it,&ts,&val)){
-          printf("%u,%.9g\n", (unsigned)ts, (double)val);
-        }
-        stampdb_query_end(&it);
-      }
-      printf("END\n");
     }
+    (void)w1; (void)w2; (void)w3;
   }
 }
 
-/** @brief Core0 helper: enqueue a write command to Core1. */
-static inline void send_write(uint16_t series, uint32_t ts, float v){
-  uint32_t cmd=1, w1=series, w2=ts, w3; memcpy(&w3,&v,sizeof(v));
+/** @brief Core0 helper: send a 4-word command to Core1. */
+static void send_cmd(uint32_t cmd, uint32_t w1, uint32_t w2, uint32_t w3){
   multicore_fifo_push_blocking(cmd); multicore_fifo_push_blocking(w1); multicore_fifo_push_blocking(w2); multicore_fifo_push_blocking(w3);
 }
 
-/** @brief Read a line from USB CDC without blocking forever. */
-static bool read_line(char *buf, int maxlen){
-  int n=0;
-  while (n<maxlen-1){
-    int ch = getchar_timeout_us(0);
-    if (ch == PICO_ERROR_TIMEOUT){ sleep_ms(1); continue; }
-    if (ch == '\r') continue;
-    if (ch == '\n'){ buf[n]='\0'; return true; }
-    buf[n++] = (char)ch;
+/**
+ * @brief Core0 helper: queue a sample for Core1 (no doorbell; see ring_doorbell()).
+ *
+ * A full ring (Core1 inside a long erase) is waited on for RING_WAIT_US, then the
+ * sample is dropped; both are counted.
+ * @return false when the sample was dropped.
+ */
+static bool queue_sample(uint16_t series, uint32_t ts, float v){
+  spsc_sample_t rec = { ts, v, series, 0 };
+  if (!spsc_push(&ring, &rec)){
+    ring.stalls++;
+    uint64_t until = time_us_64() + RING_WAIT_US;
+    while (!spsc_push(&ring, &rec)){
+      if (time_us_64() >= until){ ring.drops++; return false; }
+      tight_loop_contents();
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Core0 helper: tell Core1 samples are queued. Skipped while the FIFO is
+ * full: Core1 then still has words to pop and drains the ring after each pop.
+ */
+static void ring_doorbell(void){ if (multicore_fifo_wready()) multicore_fifo_push_blocking(CMD_DOORBELL); }
+
+/** @brief Core0 helper: flush (2) / snapshot (3) round trip; returns Core1's stampdb_rc once durable. */
+static uint32_t barrier_round_trip(uint32_t cmd){
+  send_cmd(cmd, 0, 0, 0);
+  uint32_t tag=0; do { tag = multicore_fifo_pop_blocking(); } while (tag != (0xDEAD0000u | cmd));
+  return multicore_fifo_pop_blocking();
+}
+
+/**
+ * @brief Core0 helper: the DB handle for a reader query, once Core1 has written every
+ * sample Core0 queued so far (read-your-writes across the ring). NULL when closed.
+ */
+static stampdb_t *reader_db(void){
+  uint32_t queued = atomic_load_explicit(&ring.head, memory_order_relaxed);
+  ring_doorbell();
+  while ((int32_t)(atomic_load_explicit(&applied, memory_order_acquire) - queued) < 0 &&
+         atomic_load_explicit(&db_shared, memory_order_acquire)) tight_loop_contents();
+  return atomic_load_explicit(&db_shared, memory_order_acquire);
+}
+
+/** @brief Core0: latest row straight from the DB's seqlocked table. */
+static stampdb_rc latest_direct(uint16_t series, uint32_t *ts, float *v){
+  stampdb_t *db = reader_db();
+  *ts = 0; *v = 0.0f;
+  return db ? stampdb_query_latest(db, series, ts, v) : STAMPDB_EINVAL;
+}
+
+/** @brief Core0: CSV export of [t0, t1] then END (Core1 keeps ingesting meanwhile). */
+static void export_text(uint16_t series, uint32_t t0, uint32_t t1){
+  stampdb_t *db = reader_db();
+  stampdb_it_t it;
+  if (db && stampdb_query_begin(db, series, t0, t1, &it)==STAMPDB_OK){
+    uint32_t ts; float val;
+    while (stampdb_next(&it,&ts,&val)) printf("%u,%.9g\n", (unsigned)ts, (double)val);
+    stampdb_query_end(&it);
+  }
+  printf("END\n");
+}
+
+/** @brief Core0: one text command line. */
+static void handle_line(const char *line){
+  if (line[0]=='w'){
+    unsigned s=0; unsigned ts=0; float v=0;
+    if (sscanf(line, "w %u %u %f", &s, &ts, &v)==3){ bool ok = queue_sample((uint16_t)s, (uint32_t)ts, v); ring_doorbell(); puts(ok ? "OK" : "BUSY"); }
+    else { puts("ERR"); }
+  } else if (line[0]=='q'){
+    printf("OK %u %u %u %u\n", (unsigned)spsc_depth(&ring), (unsigned)ring.hwm, (unsigned)ring.stalls, (unsigned)ring.drops);
+  } else if (line[0]=='f' || line[0]=='s'){
+    puts(barrier_round_trip(line[0]=='f' ? 2u : 3u)==STAMPDB_OK ? "OK" : "ERR");
+  } else if (line[0]=='l'){
+    unsigned s=0; if (sscanf(line, "l %u", &s)==1){
+      uint32_t ts; float v; latest_direct((uint16_t)s, &ts, &v);
+      printf("OK %u %f\n", (unsigned)ts, (double)v);
+    } else { puts("ERR"); }
+  } else if (line[0]=='e'){
+    unsigned s=0; unsigned t0=0; unsigned t1=0; if (sscanf(line, "e %u %u %u", &s, &t0, &t1)==3){
+      export_text((uint16_t)s, t0, t1);
+    } else { puts("ERR"); }
+  } else {
+    puts("ERR");
   }
-  buf[n]='\0'; return n>0;
 }
 
-/** @brief Core0: parse simple commands and forward to Core1; print responses. */
+/** @brief Core0: acknowledge a frame of `type` with a status and accepted-sample count. */
+static void send_ack(uint8_t type, uint8_t status, uint16_t accepted){
+  uint8_t fb[FRAME_OVERHEAD + 4];
+  fb[5] = type; fb[6] = status; frame_put16(fb + 7, accepted);
+  send_frame(fb, frame_seal(fb, FRAME_ACK, 4));
+}
+
+/** @brief Core0: one CRC-clean binary frame (`buf` = type | len | payload). */
+static void handle_frame(const uint8_t *buf){
+  uint8_t type = buf[0]; uint16_t len = frame_get16(buf + 1); const uint8_t *p = buf + 3;
+  if (type==FRAME_WRITE){
+    uint16_t n = len >= 2u ? frame_get16(p) : 0;
+    if (len < 2u || len != 2u + (uint32_t)n*FRAME_SAMPLE_BYTES){ send_ack(type, FRAME_ST_BAD, 0); return; }
+    uint16_t ok = 0;
+    for (uint16_t i=0;i<n;i++){
+      const uint8_t *r = p + 2 + (size_t)i*FRAME_SAMPLE_BYTES;
+      uint32_t vb = frame_get32(r + 6); float v; memcpy(&v, &vb, sizeof(v));
+      if (queue_sample(frame_get16(r), frame_get32(r + 2), v)) ok++;
+    }
+    ring_doorbell();
+    send_ack(type, ok==n ? STAMPDB_OK : FRAME_ST_BUSY, ok);
+  } else if (type==FRAME_FLUSH || type==FRAME_SNAPSHOT){
+    send_ack(type, (uint8_t)barrier_round_trip(type==FRAME_FLUSH ? 2u : 3u), 0);
+  } else if (type==FRAME_EXPORT && len==10u){
+    stampdb_t *db = reader_db();
+    export_binary(db, frame_get16(p), frame_get32(p + 2), frame_get32(p + 6));
+  } else if (type==FRAME_LATEST && len==2u){
+    uint32_t ts; float v; stampdb_rc rc = latest_direct(frame_get16(p), &ts, &v);
+    uint8_t fb[FRAME_OVERHEAD + 9]; uint32_t vb; memcpy(&vb, &v, sizeof(vb));
+    fb[5] = rc==STAMPDB_OK; frame_put32(fb + 6, ts); frame_put32(fb + 10, vb);
+    send_frame(fb, frame_seal(fb, FRAME_LATEST_R, 9));
+  } else {
+    send_ack(type, FRAME_ST_BAD, 0);
+  }
+}
+
+/**
+ * @brief Core0: USB CDC byte pump. A line starting with 0xA5 switches the parser
+ * into a binary frame until it completes or fails its length/CRC check.
+ */
 int main(void){
   stdio_init_all();
+  flash_safe_execute_core_init(); // Core1's flash ops park this core in SRAM (it reads XIP flash)
   multicore_launch_core1(core1_entry);
-  char line[128];
+  while (!atomic_load_explicit(&db_shared, memory_order_acquire)) tight_loop_contents();
+  static frame_rx_t rx;
+  char line[128]; int n=0;
   while (true){
-    if (!read_line(line, sizeof(line))) continue;
-    if (line[0]=='w'){
-      unsigned s=0; unsigned ts=0; float v=0;
-      if (sscanf(line, "w %u %u %f", &s, &ts, &v)==3){ send_write((uint16_t)s, (uint32_t)ts, v); puts("OK"); }
-      else { puts("ERR"); }
-    } else if (line[0]=='f'){
-      multicore_fifo_push_blocking(2); multicore_fifo_push_blocking(0); multicore_fifo_push_blocking(0); multicore_fifo_push_blocking(0); puts("OK");
-    } else if (line[0]=='s'){
-      multicore_fifo_push_blocking(3); multicore_fifo_push_blocking(0); multicore_fifo_push_blocking(0); multicore_fifo_push_blocking(0); puts("OK");
-    } else if (line[0]=='l'){
-      unsigned s=0; if (sscanf(line, "l %u", &s)==1){
-        multicore_fifo_push_blocking(5); multicore_fifo_push_blocking(s); multicore_fifo_push_blocking(0); multicore_fifo_push_blocking(0);
-        uint32_t tag=0; do { tag = multicore_fifo_pop_blocking(); } while (tag != 0xDEAD0005u);
-        uint32_t ts = multicore_fifo_pop_blocking(); uint32_t vb = multicore_fifo_pop_blocking(); float v; memcpy(&v,&vb,sizeof(v));
-        printf("OK %u %f\n", (unsigned)ts, (double)v);
-      } else { puts("ERR"); }
-    } else if (line[0]=='e'){
-      unsigned s=0; unsigned t0=0; unsigned t1=0; if (sscanf(line, "e %u %u %u", &s, &t0, &t1)==3){
-        multicore_fifo_push_blocking(6); multicore_fifo_push_blocking(s); multicore_fifo_push_blocking(t0); multicore_fifo_push_blocking(t1);
-      } else { puts("ERR"); }
-    } else {
-      puts("ERR");
+    int ch = getchar_timeout_us(0);
+    if (ch == PICO_ERROR_TIMEOUT){ sleep_ms(1); continue; }
+    if (rx.sync || (n==0 && (uint8_t)ch==FRAME_SYNC0)){
+      if (frame_rx_byte(&rx, (uint8_t)ch)) handle_frame(rx.buf);
+      continue;
     }
+    if (ch == '\r') continue;
+    if (ch == '\n' || n == (int)sizeof(line)-1){ line[n]='\0'; if (n) handle_line(line); n=0; continue; }
+    line[n++] = (char)ch;
   }
 }
@@ -4,10 +4,16 @@
  *
  * Role in system:
  *  - Provides XIP-safe erase/program and monotonic clock for quotas/hints.
+ *
+ * Constraints:
+ *  - Erase/program go through flash_safe_execute(): the other core (a concurrent
+ *    reader executing and reading from XIP) is parked in SRAM for the op's duration,
+ *    so it must have called flash_safe_execute_core_init()
  */
 #include "stampdb_internal.h"
 #include "pico/stdlib.h"
 #include "hardware/flash.h"
+#include "pico/flash.h"
 #include "pico/multicore.h"
 
 // These functions must run from SRAM
@@ -17,8 +23,16 @@
 
 extern uint32_t __flash_binary_end; // symbol typically provided by linker
 
+#define FLASH_LOCKOUT_TIMEOUT_MS 100u // waiting for the other core to park
+
+typedef struct { uint32_t addr; const void *src; } flash_op_t;
+static void __not_in_flash_func(do_erase)(void *p){ flash_range_erase(((const flash_op_t*)p)->addr, 4096); }
+static void __not_in_flash_func(do_program)(void *p){ const flash_op_t *op = p; flash_range_program(op->addr, (const uint8_t*)op->src, 256); }
+
 /** @brief Monotonic milliseconds from SDK timebase. */
 uint64_t platform_millis(void){ return to_ms_since_boot(get_absolute_time()); }
+/** @brief Monotonic microseconds from SDK timebase (GC step budgets). */
+uint64_t platform_micros(void){ return to_us_since_boot(get_absolute_time()); }
 
 static uint32_t flash_total_bytes(void){
 #ifdef PICO_FLASH_SIZE_BYTES
@@ -34,20 +48,16 @@ int platform_flash_read(uint32_t addr, void *dst, size_t len){
   memcpy(dst, (const void*)(XIP_BASE + addr), len); return 0;
 }
 
-/** @brief 4 KiB sector erase (runs from SRAM). */
-int __not_in_flash_func(platform_flash_erase_4k)(uint32_t addr){
-  uint32_t ints = save_and_disable_interrupts();
-  flash_range_erase(addr, 4096);
-  restore_interrupts(ints);
-  return 0;
+/** @brief 4 KiB sector erase (runs from SRAM, interrupts off, other core parked); -1 if it never parked. */
+int platform_flash_erase_4k(uint32_t addr){
+  flash_op_t op = { addr, NULL };
+  return flash_safe_execute(do_erase, &op, FLASH_LOCKOUT_TIMEOUT_MS)==PICO_OK ? 0 : -1;
 }
 
-/** @brief 256 B page program (runs from SRAM, 1→0 only). */
-int __not_in_flash_func(platform_flash_program_256)(uint32_t addr, const void *src){
-  uint32_t ints = save_and_disable_interrupts();
-  flash_range_program(addr, (const uint8_t*)src, 256);
-  restore_interrupts(ints);
-  return 0;
+/** @brief 256 B page program (runs from SRAM, 1→0 only, other core parked). */
+int platform_flash_program_256(uint32_t addr, const void *src){
+  flash_op_t op = { addr, src };
+  return flash_safe_execute(do_program, &op, FLASH_LOCKOUT_TIMEOUT_MS)==PICO_OK ? 0 : -1;
 }
 
 /** @brief Total flash size (bytes); adjust if board differs from 2 MiB. */
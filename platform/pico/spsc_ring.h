@@ -0,0 +1,78 @@
+/**
+ * @file spsc_ring.h
+ * @brief Lock-free single-producer/single-consumer sample ring for the Core0→Core1 handoff.
+ *
+ * What it owns:
+ *  - Packed 12 B sample records in a power-of-two ring placed in shared SRAM
+ *  - Producer push and consumer batch pop into SoA columns (stampdb_write_batch_multi layout)
+ *  - Producer-side depth high-water mark and stall/drop counters
+ *
+ * Role in system:
+ *  - Carries samples from the serial core to the DB core without the 8-deep
+ *    hardware FIFO in the loop; the FIFO only rings the doorbell
+ *
+ * Constraints:
+ *  - Exactly one producer and one consumer. Indices are free-running u32 and are
+ *    only ever stored by their owner, so plain acquire/release loads and stores
+ *    suffice (no RMW atomics: Cortex-M0+ has no LDREX/STREX)
+ *  - Header-only and SDK-free so it also builds on the host (tests)
+ */
+#pragma once
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef SPSC_RING_SLOTS
+#define SPSC_RING_SLOTS 1024u // 12 KiB of SRAM
+#endif
+_Static_assert((SPSC_RING_SLOTS & (SPSC_RING_SLOTS - 1u)) == 0, "ring slots must be a power of two");
+
+typedef struct {
+  uint32_t ts;
+  float    value;
+  uint16_t series;
+  uint16_t reserved;
+} spsc_sample_t;
+_Static_assert(sizeof(spsc_sample_t) == 12, "sample record must stay packed");
+
+typedef struct {
+  _Atomic uint32_t head; // next slot to fill (producer-owned)
+  _Atomic uint32_t tail; // next slot to drain (consumer-owned)
+  uint32_t hwm;          // deepest fill seen by the producer
+  uint32_t stalls;       // pushes that found the ring full and waited (producer-owned)
+  uint32_t drops;        // samples given up on after waiting (producer-owned)
+  spsc_sample_t slot[SPSC_RING_SLOTS];
+} spsc_ring_t;
+
+/** @brief Samples queued right now (either side; a snapshot while the other side runs). */
+static inline uint32_t spsc_depth(spsc_ring_t *r){
+  return atomic_load_explicit(&r->head, memory_order_acquire) - atomic_load_explicit(&r->tail, memory_order_acquire);
+}
+
+/** @brief Producer: enqueue one sample; false when the ring is full. */
+static inline bool spsc_push(spsc_ring_t *r, const spsc_sample_t *s){
+  uint32_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+  uint32_t depth = h - atomic_load_explicit(&r->tail, memory_order_acquire);
+  if (depth >= SPSC_RING_SLOTS) return false;
+  r->slot[h & (SPSC_RING_SLOTS - 1u)] = *s;
+  atomic_store_explicit(&r->head, h + 1u, memory_order_release); // publishes the slot
+  if (depth + 1u > r->hwm) r->hwm = depth + 1u;
+  return true;
+}
+
+/**
+ * @brief Consumer: dequeue up to `max` samples into SoA columns.
+ * @return Samples copied; slots are released to the producer before returning.
+ */
+static inline size_t spsc_pop(spsc_ring_t *r, uint16_t *series, uint32_t *ts, float *values, size_t max){
+  uint32_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+  uint32_t n = atomic_load_explicit(&r->head, memory_order_acquire) - t;
+  if (n > max) n = (uint32_t)max;
+  for (uint32_t i=0;i<n;i++){
+    const spsc_sample_t *s = &r->slot[(t + i) & (SPSC_RING_SLOTS - 1u)];
+    series[i] = s->series; ts[i] = s->ts; values[i] = s->value;
+  }
+  atomic_store_explicit(&r->tail, t + n, memory_order_release);
+  return n;
+}
@@ -1,6 +1,12 @@
+import array as _array
 import ctypes as _ct
 import os as _os
-from typing import Iterator, Optional, Tuple
+from typing import Any, Dict, Iterator, List, Optional, Tuple
+
+try:
+    import numpy as _np
+except ImportError:  # numpy is optional; array.array / sequences still work
+    _np = None
 
 _LIB_NAMES = [
     _os.environ.get("STAMPDB_LIB"),
@@ -28,6 +34,7 @@ def _load_lib():
 _lib = _load_lib()
 
 STAMPDB_OK=0
+STAMPDB_EBUSY=2
 
 class _Cfg(_ct.Structure):
     _fields_ = [
@@ -35,26 +42,19 @@ class _Cfg(_ct.Structure):
         ("workspace_bytes", _ct.c_uint32),
         ("read_batch_rows", _ct.c_uint32),
         ("commit_interval_ms", _ct.c_uint32),
-    ]
-
-class _It(_ct.Structure):
-    _fields_ = [
-        ("s", _ct.c_void_p),
-        ("series", _ct.c_uint16),
-        ("t0", _ct.c_uint32),
-        ("t1", _ct.c_uint32),
-        ("seg_idx", _ct.c_uint32),
-        ("page_in_seg", _ct.c_uint32),
-        ("row_idx_in_block", _ct.c_uint32),
-        ("count_in_block", _ct.c_uint16),
-        ("dt_bits", _ct.c_uint8),
-        ("t0_block", _ct.c_uint32),
-        ("bias", _ct.c_float),
-        ("scale", _ct.c_float),
-        ("deltas", _ct.c_uint32*74),
-        ("qvals", _ct.c_int16*74),
-        ("times", _ct.c_uint32*74),
-        ("values", _ct.c_float*74),
+        ("open_builders", _ct.c_uint32),
+        ("page_index", _ct.c_uint32),
+        ("perf", _ct.c_uint32),
+        ("write_behind_pages", _ct.c_uint32),
+        ("concurrent_readers", _ct.c_uint32),
+        ("flash_base", _ct.c_uint32),
+        ("flash_bytes", _ct.c_uint32),
+        ("latest_slots", _ct.c_uint32),
+        ("rollup_bucket_ms", _ct.c_uint32),
+        ("rollup_flash_base", _ct.c_uint32),
+        ("rollup_flash_bytes", _ct.c_uint32),
+        ("block_cache_blocks", _ct.c_uint32),
+        ("lazy_recovery", _ct.c_uint32),
     ]
 
 _lib.stampdb_open.argtypes = [_ct.POINTER(_ct.c_void_p), _ct.POINTER(_Cfg)]
@@ -62,12 +62,27 @@ _lib.stampdb_open.restype = _ct.c_int
 _lib.stampdb_close.argtypes = [_ct.c_void_p]
 _lib.stampdb_write.argtypes = [_ct.c_void_p, _ct.c_uint16, _ct.c_uint32, _ct.c_float]
 _lib.stampdb_write.restype = _ct.c_int
+_lib.stampdb_write_batch.argtypes = [_ct.c_void_p, _ct.c_uint16, _ct.POINTER(_ct.c_uint32), _ct.POINTER(_ct.c_float), _ct.c_size_t]
+_lib.stampdb_write_batch.restype = _ct.c_int
+_lib.stampdb_write_batch_multi.argtypes = [_ct.c_void_p, _ct.POINTER(_ct.c_uint16), _ct.POINTER(_ct.c_uint32), _ct.POINTER(_ct.c_float), _ct.c_size_t]
+_lib.stampdb_write_batch_multi.restype = _ct.c_int
 _lib.stampdb_flush.argtypes = [_ct.c_void_p]
 _lib.stampdb_flush.restype = _ct.c_int
+_lib.stampdb_set_tolerance.argtypes = [_ct.c_void_p, _ct.c_uint16, _ct.c_float]
+_lib.stampdb_set_tolerance.restype = _ct.c_int
+# stampdb_it_t stays opaque: allocate the size the library reports, 8-byte aligned
+_lib.stampdb_it_size.argtypes = []
+_lib.stampdb_it_size.restype = _ct.c_size_t
+_It = _ct.c_uint64 * ((_lib.stampdb_it_size() + 7) // 8)
 _lib.stampdb_query_begin.argtypes = [_ct.c_void_p, _ct.c_uint16, _ct.c_uint32, _ct.c_uint32, _ct.POINTER(_It)]
 _lib.stampdb_query_begin.restype = _ct.c_int
 _lib.stampdb_next.argtypes = [_ct.POINTER(_It), _ct.POINTER(_ct.c_uint32), _ct.POINTER(_ct.c_float)]
 _lib.stampdb_next.restype = _ct.c_bool
+_lib.stampdb_next_batch.argtypes = [_ct.POINTER(_It), _ct.POINTER(_ct.POINTER(_ct.c_uint32)), _ct.POINTER(_ct.POINTER(_ct.c_float)), _ct.POINTER(_ct.c_size_t)]
+_lib.stampdb_next_batch.restype = _ct.c_bool
+_lib.stampdb_query_set_buffer.argtypes = [_ct.POINTER(_It), _ct.POINTER(_ct.c_uint32), _ct.POINTER(_ct.c_float), _ct.c_size_t]
+_lib.stampdb_query_export.argtypes = [_ct.POINTER(_It), _ct.POINTER(_ct.c_uint32), _ct.POINTER(_ct.c_float), _ct.c_size_t]
+_lib.stampdb_query_export.restype = _ct.c_size_t
 _lib.stampdb_query_end.argtypes = [_ct.POINTER(_It)]
 _lib.stampdb_query_latest.argtypes = [_ct.c_void_p, _ct.c_uint16, _ct.POINTER(_ct.c_uint32), _ct.POINTER(_ct.c_float)]
 _lib.stampdb_query_latest.restype = _ct.c_int
@@ -80,13 +95,91 @@ class _Stats(_ct.Structure):
         ("gc_warn_events", _ct.c_uint32),
         ("gc_busy_events", _ct.c_uint32),
         ("recovery_truncations", _ct.c_uint32),
+        ("workspace_used_bytes", _ct.c_uint32),
+        ("page_index_bytes", _ct.c_uint32),
+        ("index_skipped_pages", _ct.c_uint32),
+        ("agg_segments_pushdown", _ct.c_uint32),
+        ("agg_blocks_pushdown", _ct.c_uint32),
+        ("agg_blocks_decoded", _ct.c_uint32),
+        ("gc_deferred_events", _ct.c_uint32),
+        ("gc_preerase_hits", _ct.c_uint32),
+        ("recovery_footer_reads", _ct.c_uint32),
+        ("wb_depth", _ct.c_uint32),
+        ("wb_hwm", _ct.c_uint32),
+        ("wb_full_stalls", _ct.c_uint32),
+        ("wb_read_drains", _ct.c_uint32),
+        ("reader_retries", _ct.c_uint32),
+        ("latest_evictions", _ct.c_uint32),
+        ("latest_misses", _ct.c_uint32),
+        ("rollup_points", _ct.c_uint32),
+        ("agg_rollup_points", _ct.c_uint32),
+        ("tick_commits", _ct.c_uint32),
+        ("block_cache_hits", _ct.c_uint32),
+        ("block_cache_misses", _ct.c_uint32),
+        ("recovery_pending_segs", _ct.c_uint32),
+        ("recovery_ready", _ct.c_uint32),
+    ]
+_PERF_BUCKETS = 20
+_PERF_OPS = 14
+class _PerfHist(_ct.Structure):
+    _fields_ = [
+        ("count", _ct.c_uint32),
+        ("max_us", _ct.c_uint32),
+        ("total_us", _ct.c_uint64),
+        ("bytes", _ct.c_uint64),
+        ("hist", _ct.c_uint32*_PERF_BUCKETS),
+    ]
+class _Perf(_ct.Structure):
+    _fields_ = [
+        ("enabled", _ct.c_uint32),
+        ("reserved", _ct.c_uint32),
+        ("ops", _PerfHist*_PERF_OPS),
     ]
+_lib.stampdb_perf_info.argtypes = [_ct.c_void_p, _ct.POINTER(_Perf), _ct.c_int]
+_lib.stampdb_perf_info.restype = _ct.c_int
+_lib.stampdb_perf_op_name.argtypes = [_ct.c_uint32]
+_lib.stampdb_perf_op_name.restype = _ct.c_char_p
+_lib.stampdb_gc_step.argtypes = [_ct.c_void_p, _ct.c_uint32]
+_lib.stampdb_gc_step.restype = _ct.c_int
+_lib.stampdb_recover_step.argtypes = [_ct.c_void_p, _ct.c_uint32]
+_lib.stampdb_recover_step.restype = _ct.c_int
+_lib.stampdb_flash_step.argtypes = [_ct.c_void_p, _ct.c_uint32]
+_lib.stampdb_flash_step.restype = _ct.c_int
+_lib.stampdb_tick.argtypes = [_ct.c_void_p, _ct.c_uint32]
+_lib.stampdb_tick.restype = _ct.c_int
 _lib.stampdb_info.argtypes = [_ct.c_void_p, _ct.POINTER(_Stats)]
+class _Agg(_ct.Structure):
+    _fields_ = [
+        ("bucket_start_ms", _ct.c_uint32),
+        ("count", _ct.c_uint32),
+        ("min", _ct.c_float),
+        ("max", _ct.c_float),
+        ("sum", _ct.c_float),
+    ]
+_lib.stampdb_query_aggregate.argtypes = [_ct.c_void_p, _ct.c_uint16, _ct.c_uint32, _ct.c_uint32, _ct.c_uint32, _ct.POINTER(_Agg), _ct.c_uint32, _ct.POINTER(_ct.c_uint32)]
+_lib.stampdb_query_aggregate.restype = _ct.c_int
+
+_COLUMN_TYPES = {
+    _ct.c_uint16: ("H", "uint16"),
+    _ct.c_uint32: ("I", "uint32"),
+    _ct.c_float: ("f", "float32"),
+}
+
+def _column(obj: Any, ctype):
+    """Return (keepalive, pointer, length) for a contiguous column, copying only on dtype mismatch."""
+    typecode, np_dtype = _COLUMN_TYPES[ctype]
+    if _np is not None and isinstance(obj, _np.ndarray):
+        arr = _np.ascontiguousarray(obj, dtype=np_dtype)
+        return arr, arr.ctypes.data_as(_ct.POINTER(ctype)), int(arr.size)
+    if not (isinstance(obj, _array.array) and obj.typecode == typecode):
+        obj = _array.array(typecode, obj)
+    addr, n = obj.buffer_info()
+    return obj, _ct.cast(addr, _ct.POINTER(ctype)), n
 
 class StampDB:
-    def __init__(self, workspace_bytes: int = 1<<20, read_batch_rows: int = 512, commit_interval_ms: int = 0):
+    def __init__(self, workspace_bytes: int = 1<<20, read_batch_rows: int = 512, commit_interval_ms: int = 0, open_builders: int = 0, page_index: bool = False, perf: bool = False, write_behind_pages: int = 0, concurrent_readers: bool = False, flash_base: int = 0, flash_bytes: int = 0, latest_slots: int = 0, rollup_bucket_ms: int = 0, rollup_flash_base: int = 0, rollup_flash_bytes: int = 0, block_cache_blocks: int = 0, lazy_recovery: bool = False):
         self._ws = _ct.create_string_buffer(workspace_bytes)
-        self._cfg = _Cfg(_ct.addressof(self._ws), workspace_bytes, read_batch_rows, commit_interval_ms)
+        self._cfg = _Cfg(_ct.addressof(self._ws), workspace_bytes, read_batch_rows, commit_interval_ms, open_builders, 1 if page_index else 0, 1 if perf else 0, write_behind_pages, 1 if concurrent_readers else 0, flash_base, flash_bytes, latest_slots, rollup_bucket_ms, rollup_flash_base, rollup_flash_bytes, block_cache_blocks, 1 if lazy_recovery else 0)
         self._db = _ct.c_void_p()
         rc = _lib.stampdb_open(_ct.byref(self._db), _ct.byref(self._cfg))
         if rc != STAMPDB_OK:
@@ -102,21 +195,120 @@ class StampDB:
         if rc != STAMPDB_OK:
             raise RuntimeError(f"stampdb_write rc={rc}")
 
+    def write_batch(self, series: int, ts_ms: Any, values: Any):
+        """Append columns of samples for one series (numpy arrays, array.array or sequences)."""
+        ts_keep, ts_p, n = _column(ts_ms, _ct.c_uint32)
+        v_keep, v_p, nv = _column(values, _ct.c_float)
+        if n != nv:
+            raise ValueError("ts_ms and values must have the same length")
+        rc = _lib.stampdb_write_batch(self._db, series, ts_p, v_p, n)
+        if rc != STAMPDB_OK:
+            raise RuntimeError(f"stampdb_write_batch rc={rc}")
+
+    def write_batch_multi(self, series: Any, ts_ms: Any, values: Any):
+        """Append rows for mixed series; row i goes to series[i]."""
+        s_keep, s_p, n = _column(series, _ct.c_uint16)
+        ts_keep, ts_p, nt = _column(ts_ms, _ct.c_uint32)
+        v_keep, v_p, nv = _column(values, _ct.c_float)
+        if not (n == nt == nv):
+            raise ValueError("series, ts_ms and values must have the same length")
+        rc = _lib.stampdb_write_batch_multi(self._db, s_p, ts_p, v_p, n)
+        if rc != STAMPDB_OK:
+            raise RuntimeError(f"stampdb_write_batch_multi rc={rc}")
+
     def flush(self):
         rc = _lib.stampdb_flush(self._db)
         if rc != STAMPDB_OK:
             raise RuntimeError(f"stampdb_flush rc={rc}")
 
-    def query(self, series: int, t0_ms: int, t1_ms: int) -> Iterator[Tuple[int,float]]:
+    def set_tolerance(self, series: int, max_abs_err: Optional[float]):
+        """Max abs value error for a series (0.0 = lossless, None = Fixed16 default); applies from its next block."""
+        rc = _lib.stampdb_set_tolerance(self._db, series, -1.0 if max_abs_err is None else float(max_abs_err))
+        if rc != STAMPDB_OK:
+            raise RuntimeError(f"stampdb_set_tolerance rc={rc}")
+
+    def write_numpy(self, series: Any, ts_ms: Any, values: Any):
+        """Append numpy columns without per-row calls (uint32 ts, float32 values; other dtypes are converted once).
+
+        `series` is one id for all rows, or a uint16 column with one id per row.
+        """
+        if _np is None:
+            raise RuntimeError("write_numpy needs numpy")
+        if _np.ndim(series) == 0:
+            self.write_batch(int(series), _np.asarray(ts_ms), _np.asarray(values))
+        else:
+            self.write_batch_multi(_np.asarray(series), _np.asarray(ts_ms), _np.asarray(values))
+
+    def _begin(self, series: int, t0_ms: int, t1_ms: int) -> "_It":
         it = _It()
         rc = _lib.stampdb_query_begin(self._db, series, t0_ms, t1_ms, _ct.byref(it))
         if rc != STAMPDB_OK:
             raise RuntimeError(f"stampdb_query_begin rc={rc}")
+        return it
+
+    def query_batches(self, series: int, t0_ms: int, t1_ms: int) -> Iterator[Tuple[List[int], List[float]]]:
+        """Yield (timestamps, values) column slices, one decoded block per batch."""
+        it = self._begin(series, t0_ms, t1_ms)
+        try:
+            ts = _ct.POINTER(_ct.c_uint32)()
+            vals = _ct.POINTER(_ct.c_float)()
+            n = _ct.c_size_t()
+            while _lib.stampdb_next_batch(_ct.byref(it), _ct.byref(ts), _ct.byref(vals), _ct.byref(n)):
+                yield ts[:n.value], vals[:n.value]
+        finally:
+            _lib.stampdb_query_end(_ct.byref(it))
+
+    def query(self, series: int, t0_ms: int, t1_ms: int, chunk_rows: int = 4096) -> Iterator[Tuple[int,float]]:
+        """Yield (ts, value) rows; fetched chunk_rows at a time through the bulk export."""
+        it = self._begin(series, t0_ms, t1_ms)
+        ts = _array.array("I", bytes(4 * chunk_rows))
+        vals = _array.array("f", bytes(4 * chunk_rows))
+        ts_p = _ct.cast(ts.buffer_info()[0], _ct.POINTER(_ct.c_uint32))
+        v_p = _ct.cast(vals.buffer_info()[0], _ct.POINTER(_ct.c_float))
         try:
-            ts = _ct.c_uint32()
-            val = _ct.c_float()
-            while _lib.stampdb_next(_ct.byref(it), _ct.byref(ts), _ct.byref(val)):
-                yield int(ts.value), float(val.value)
+            while True:
+                n = _lib.stampdb_query_export(_ct.byref(it), ts_p, v_p, chunk_rows)
+                yield from zip(ts[:n], vals[:n])
+                if n < chunk_rows:
+                    break
+        finally:
+            _lib.stampdb_query_end(_ct.byref(it))
+
+    def query_numpy(self, series: int, t0_ms: int, t1_ms: int, ts_out: Any = None, vals_out: Any = None) -> Tuple[Any, Any]:
+        """Rows of [t0_ms..t1_ms] as (uint32 ts, float32 values) numpy arrays, filled in C.
+
+        With preallocated ts_out/vals_out (contiguous uint32/float32 of equal length) rows
+        go straight into them and views of the filled prefix are returned; rows past their
+        length are not read. Otherwise arrays are allocated, growing geometrically.
+        """
+        if _np is None:
+            raise RuntimeError("query_numpy needs numpy")
+        if (ts_out is None) != (vals_out is None):
+            raise ValueError("pass both ts_out and vals_out, or neither")
+        if ts_out is not None:
+            for a, dt in ((ts_out, _np.uint32), (vals_out, _np.float32)):
+                if not isinstance(a, _np.ndarray) or a.dtype != dt or not a.flags.c_contiguous or not a.flags.writeable:
+                    raise ValueError("ts_out/vals_out must be writable contiguous uint32/float32 arrays")
+            if ts_out.size != vals_out.size:
+                raise ValueError("ts_out and vals_out must have the same length")
+        it = self._begin(series, t0_ms, t1_ms)
+        try:
+            if ts_out is not None:
+                n = _lib.stampdb_query_export(_ct.byref(it), ts_out.ctypes.data_as(_ct.POINTER(_ct.c_uint32)),
+                                              vals_out.ctypes.data_as(_ct.POINTER(_ct.c_float)), ts_out.size)
+                return ts_out[:n], vals_out[:n]
+            ts = _np.empty(4096, dtype=_np.uint32)
+            vals = _np.empty(4096, dtype=_np.float32)
+            n = 0
+            while True:
+                want = ts.size - n
+                got = _lib.stampdb_query_export(_ct.byref(it), _ct.cast(ts.ctypes.data + 4 * n, _ct.POINTER(_ct.c_uint32)),
+                                                _ct.cast(vals.ctypes.data + 4 * n, _ct.POINTER(_ct.c_float)), want)
+                n += got
+                if got < want:  # trim only when the tail wastes more than the rows take
+                    return (ts[:n], vals[:n]) if 2 * n >= ts.size else (ts[:n].copy(), vals[:n].copy())
+                ts = _np.concatenate((ts, _np.empty(ts.size, dtype=_np.uint32)))
+                vals = _np.concatenate((vals, _np.empty(vals.size, dtype=_np.float32)))
         finally:
             _lib.stampdb_query_end(_ct.byref(it))
 
@@ -128,14 +320,67 @@ class StampDB:
             return None
         return int(ts.value), float(val.value)
 
+    def aggregate(self, series: int, t0_ms: int, t1_ms: int, bucket_ms: int = 0) -> List[Dict[str, float]]:
+        """Per-bucket count/min/max/sum/mean over [t0_ms..t1_ms] (bucket_ms=0: one bucket)."""
+        nb = (t1_ms - t0_ms) // bucket_ms + 1 if bucket_ms else 1
+        out = (_Agg * nb)()
+        n = _ct.c_uint32()
+        rc = _lib.stampdb_query_aggregate(self._db, series, t0_ms, t1_ms, bucket_ms, out, nb, _ct.byref(n))
+        if rc != STAMPDB_OK:
+            raise RuntimeError(f"aggregate rc={rc}")
+        return [{"t_ms": b.bucket_start_ms, "count": b.count, "min": b.min, "max": b.max, "sum": b.sum,
+                 "mean": (b.sum / b.count) if b.count else float("nan")} for b in out[:n.value]]
+
+    def gc_step(self, budget_us: int) -> bool:
+        """Run idle GC for up to budget_us; True when no GC work remains."""
+        rc = _lib.stampdb_gc_step(self._db, budget_us)
+        if rc not in (STAMPDB_OK, STAMPDB_EBUSY):
+            raise RuntimeError(f"stampdb_gc_step rc={rc}")
+        return rc == STAMPDB_OK
+
+    def recover_step(self, budget_us: int) -> bool:
+        """Settle a lazy open's pending segments for up to budget_us; True once recovery is complete."""
+        rc = _lib.stampdb_recover_step(self._db, budget_us)
+        if rc not in (STAMPDB_OK, STAMPDB_EBUSY):
+            raise RuntimeError(f"stampdb_recover_step rc={rc}")
+        return rc == STAMPDB_OK
+
+    def tick(self, now_ms: int):
+        """Group commit: publish open blocks older than commit_interval_ms on the now_ms clock."""
+        rc = _lib.stampdb_tick(self._db, now_ms & 0xFFFFFFFF)
+        if rc != STAMPDB_OK:
+            raise RuntimeError(f"stampdb_tick rc={rc}")
+
+    def flash_step(self, budget_us: int) -> bool:
+        """Issue queued write-behind flash ops for up to budget_us; True when the queue is empty."""
+        rc = _lib.stampdb_flash_step(self._db, budget_us)
+        if rc not in (STAMPDB_OK, STAMPDB_EBUSY):
+            raise RuntimeError(f"stampdb_flash_step rc={rc}")
+        return rc == STAMPDB_OK
+
     def snapshot(self):
         rc = _lib.stampdb_snapshot_save(self._db)
         if rc != STAMPDB_OK:
             raise RuntimeError(f"snapshot rc={rc}")
 
-    def info(self):
+    def perf(self, reset: bool = False) -> Dict[str, Dict[str, Any]]:
+        """Per-op perf counters ({} unless built with STAMPDB_ENABLE_PERF and opened with perf=True)."""
+        p = _Perf()
+        if _lib.stampdb_perf_info(self._db, _ct.byref(p), 1 if reset else 0) != STAMPDB_OK or not p.enabled:
+            return {}
+        out: Dict[str, Dict[str, Any]] = {}
+        for i in range(_PERF_OPS):
+            h = p.ops[i]
+            out[_lib.stampdb_perf_op_name(i).decode()] = {
+                "count": h.count, "total_us": h.total_us, "max_us": h.max_us,
+                "bytes": h.bytes, "hist": list(h.hist),
+            }
+        return out
+
+    def info(self, perf: bool = False):
         st = _Stats()
         _lib.stampdb_info(self._db, _ct.byref(st))
+        extra = {"perf": self.perf()} if perf else {}
         return {
             "seg_seq_head": st.seg_seq_head,
             "seg_seq_tail": st.seg_seq_tail,
@@ -144,6 +389,30 @@ class StampDB:
             "gc_warn_events": st.gc_warn_events,
             "gc_busy_events": st.gc_busy_events,
             "recovery_truncations": st.recovery_truncations,
+            "workspace_used_bytes": st.workspace_used_bytes,
+            "page_index_bytes": st.page_index_bytes,
+            "index_skipped_pages": st.index_skipped_pages,
+            "agg_segments_pushdown": st.agg_segments_pushdown,
+            "agg_blocks_pushdown": st.agg_blocks_pushdown,
+            "agg_blocks_decoded": st.agg_blocks_decoded,
+            "gc_deferred_events": st.gc_deferred_events,
+            "gc_preerase_hits": st.gc_preerase_hits,
+            "recovery_footer_reads": st.recovery_footer_reads,
+            "wb_depth": st.wb_depth,
+            "wb_hwm": st.wb_hwm,
+            "wb_full_stalls": st.wb_full_stalls,
+            "wb_read_drains": st.wb_read_drains,
+            "reader_retries": st.reader_retries,
+            "latest_evictions": st.latest_evictions,
+            "latest_misses": st.latest_misses,
+            "rollup_points": st.rollup_points,
+            "agg_rollup_points": st.agg_rollup_points,
+            "tick_commits": st.tick_commits,
+            "block_cache_hits": st.block_cache_hits,
+            "block_cache_misses": st.block_cache_misses,
+            "recovery_pending_segs": st.recovery_pending_segs,
+            "recovery_ready": bool(st.recovery_ready),
+            **extra,
         }
 
 __all__ = ["StampDB"]
@@ -1,6 +1,38 @@
 import serial
+import struct
 import time
-from typing import Iterator, Tuple
+from array import array
+from typing import Iterable, Iterator, List, Optional, Tuple
+
+# Binary framing (platform/pico/frame.h): A5 5A | u8 type | u16 len | payload | u32 crc32c
+_SYNC = b"\xA5\x5A"
+_F_WRITE, _F_FLUSH, _F_SNAPSHOT, _F_EXPORT, _F_LATEST = 0x01, 0x02, 0x03, 0x04, 0x05
+_F_ACK, _F_ROWS, _F_END, _F_LATEST_R = 0x81, 0x84, 0x85, 0x86
+_MAX_PAYLOAD = 4096
+_MAX_SAMPLES = (_MAX_PAYLOAD - 2) // 10
+_ST_BUSY = 0xF1
+
+try:
+    from crc32c import crc32c as _crc32c  # optional C extension
+except ImportError:
+    _CRC_TABLE: List[int] = []
+
+    def _crc32c(data: bytes) -> int:
+        if not _CRC_TABLE:
+            for i in range(256):
+                c = i
+                for _ in range(8):
+                    c = (c >> 1) ^ 0x82F63B78 if c & 1 else c >> 1
+                _CRC_TABLE.append(c)
+        crc = 0xFFFFFFFF
+        for b in data:
+            crc = _CRC_TABLE[(crc ^ b) & 0xFF] ^ (crc >> 8)
+        return crc ^ 0xFFFFFFFF
+
+
+def _frame(ftype: int, payload: bytes = b"") -> bytes:
+    body = struct.pack("<BH", ftype, len(payload)) + payload
+    return _SYNC + body + struct.pack("<I", _crc32c(body))
 
 class StampDBSerial:
     def __init__(self, port: str, baud: int = 115200, timeout: float = 1.0):
@@ -31,6 +63,119 @@ class StampDBSerial:
         _, ts_s, val_s = resp.split()
         return int(ts_s), float(val_s)
 
+    def queue_stats(self) -> Tuple[int, int, int, int]:
+        """Core0->Core1 sample ring: (depth, high-water mark, stalls, drops)."""
+        self.ser.write(b"q\n")
+        resp = self.ser.readline().decode().strip()
+        while resp == "OK":  # acks of earlier writes
+            resp = self.ser.readline().decode().strip()
+        if not resp.startswith("OK "):
+            raise RuntimeError(f"Bad response: {resp}")
+        depth, hwm, stalls, drops = (int(x) for x in resp.split()[1:5])
+        return depth, hwm, stalls, drops
+
+    # --- binary fast path -------------------------------------------------
+    def _read_frame(self) -> Tuple[int, bytes]:
+        """Next CRC-clean frame; skips text and resyncs on corrupt frames."""
+        while True:
+            b = self.ser.read(1)
+            if not b:
+                raise TimeoutError("no frame from device")
+            if b != _SYNC[:1] or self.ser.read(1) != _SYNC[1:]:
+                continue
+            hdr = self.ser.read(3)
+            if len(hdr) < 3:
+                raise TimeoutError("truncated frame")
+            ftype, n = struct.unpack("<BH", hdr)
+            if n > _MAX_PAYLOAD:
+                continue
+            rest = self.ser.read(n + 4)
+            if len(rest) < n + 4:
+                raise TimeoutError("truncated frame")
+            payload, (crc,) = rest[:n], struct.unpack("<I", rest[n:])
+            if _crc32c(hdr + payload) == crc:
+                return ftype, payload
+
+    def _ack(self, ftype: int) -> Tuple[int, int]:
+        while True:
+            t, p = self._read_frame()
+            if t == _F_ACK and p[0] == ftype:
+                _, status, accepted = struct.unpack("<BBH", p)
+                return status, accepted
+
+    def write_batch(self, samples: Iterable[Tuple[int, int, float]]) -> int:
+        """Send (series, ts_ms, value) samples in frames of up to 409, one ack each.
+
+        Returns samples accepted; fewer than sent means the device dropped some
+        (its Core0->Core1 ring stayed full, see queue_stats()).
+        """
+        accepted = 0
+        buf = bytearray()
+        count = 0
+
+        def send() -> int:
+            self.ser.write(_frame(_F_WRITE, struct.pack("<H", count) + bytes(buf)))
+            status, ok = self._ack(_F_WRITE)
+            if status not in (0, _ST_BUSY):
+                raise RuntimeError(f"write frame rejected: status {status}")
+            return ok
+
+        for series, ts_ms, value in samples:
+            buf += struct.pack("<HIf", series, ts_ms, value)
+            count += 1
+            if count == _MAX_SAMPLES:
+                accepted += send()
+                buf.clear()
+                count = 0
+        if count:
+            accepted += send()
+        return accepted
+
+    def flush_sync(self):
+        """Binary flush; returns once every earlier write is durable on flash."""
+        self.ser.write(_frame(_F_FLUSH))
+        status, _ = self._ack(_F_FLUSH)
+        if status != 0:
+            raise RuntimeError(f"flush failed: status {status}")
+
+    def snapshot_sync(self):
+        self.ser.write(_frame(_F_SNAPSHOT))
+        status, _ = self._ack(_F_SNAPSHOT)
+        if status != 0:
+            raise RuntimeError(f"snapshot failed: status {status}")
+
+    def latest_bin(self, series: int) -> Optional[Tuple[int, float]]:
+        """Newest (ts_ms, value) for a series, or None when it has no rows."""
+        self.ser.write(_frame(_F_LATEST, struct.pack("<H", series)))
+        while True:
+            t, p = self._read_frame()
+            if t == _F_LATEST_R:
+                found, ts, val = struct.unpack("<BIf", p)
+                return (ts, val) if found else None
+
+    def export_arrays(self, series: int, t0: int, t1: int) -> Iterator[Tuple[array, array]]:
+        """Binary export: yields (ts array('I'), value array('f')) chunks of up to 256 rows."""
+        self.ser.write(_frame(_F_EXPORT, struct.pack("<HII", series, t0, t1)))
+        rows = 0
+        while True:
+            t, p = self._read_frame()
+            if t == _F_END:
+                (total,) = struct.unpack("<I", p)
+                if total != rows:
+                    raise RuntimeError(f"export ended after {rows} of {total} rows")
+                return
+            if t != _F_ROWS:
+                continue
+            (n,) = struct.unpack_from("<H", p)
+            ts = array("I", p[2:2 + 4 * n])
+            vals = array("f", p[2 + 4 * n:2 + 8 * n])
+            rows += n
+            yield ts, vals
+
+    def export_fast(self, series: int, t0: int, t1: int) -> Iterator[Tuple[int, float]]:
+        for ts, vals in self.export_arrays(series, t0, t1):
+            yield from zip(ts, vals)
+
     def export(self, series: int, t0: int, t1: int) -> Iterator[Tuple[int,float]]:
         self.ser.write(f"e {series} {t0} {t1}\n".encode())
         # Expect lines: ts,value until 'END' line
@@ -1,19 +1,34 @@
 /**
  * @file flash.c
- * @brief Host NOR flash simulator: 1→0 program, 4 KiB erase, persisted to disk.
+ * @brief Host NOR flash simulator: 1→0 program, 4 KiB erase, write-through to disk.
  *
  * What it owns:
- *  - In-memory flash image with periodic persistence to `flash.bin`
+ *  - Flash image backed by `flash.bin`, mapped MAP_SHARED (default) or held as a
+ *    private copy with only the touched range written back per operation
  *  - Read/erase/program operations enforcing NOR semantics
  *
+ *  - Optional timing model: per-op latency (+ jitter) charged to a virtual clock,
+ *    per-op counters (see sim_flash.h)
+ *  - One-shot fault injection per op kind (sim_flash_fail_nth)
+ *
  * Notes:
- *  - `sim_flash_read` reloads from disk to reflect external mutations by tests.
+ *  - Reads never touch the file; external mutation of the image is picked up
+ *    through the shared mapping, or after an explicit `sim_flash_reload()`.
+ *  - Durability follows STAMPDB_SIM_SYNC (see sim_flash.h).
  */
+#include "sim_flash.h"
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
-#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <unistd.h>
+
+enum { MODE_MMAP=0, MODE_FILE=1 };
+enum { SYNC_NONE=0, SYNC_MSYNC=1, SYNC_FSYNC=2 };
 
 static const char *get_flash_path(void){
   const char *p = getenv("STAMPDB_FLASH_PATH");
@@ -21,36 +36,210 @@ static const char *get_flash_path(void){
 }
 static uint8_t *flash_mem = NULL;
 static uint32_t flash_bytes = 4*1024*1024; // default 4 MiB
+static int flash_fd = -1;
+static int flash_mode = MODE_MMAP;
+static int flash_sync = SYNC_NONE;
+
+/* ---- timing model ------------------------------------------------------- */
+static sim_flash_timing_t timing;             // all zero = instant ops, wall clock
+static atomic_bool timing_on;
+static bool timing_pinned;                    // set by sim_flash_set_timing(): env no longer applies
+static atomic_bool timing_env_read;           // cleared by sim_flash_reload()
+static _Atomic uint64_t clock_ns;             // virtual clock
+static _Atomic uint64_t op_index;             // jitter sequence position
+static _Atomic uint64_t st_ops[SIM_OP_COUNT], st_bytes[SIM_OP_COUNT], st_busy_ns[SIM_OP_COUNT], st_max_ns[SIM_OP_COUNT];
+static _Atomic uint32_t fail_in[SIM_OP_COUNT];  // ops of that kind until an injected failure (0 = none armed)
+
+/** @brief RP2350 board flash (W25Q-class QSPI NOR): typical sector erase/page program, XIP-rate reads. */
+static const sim_flash_timing_t timing_rp2350 = { .erase_us = 45000, .program_us = 500, .read_ns_per_byte = 30 };
+
+/** @brief splitmix64: jitter draw `i` of stream `seed` (stateless, so threads can share it). */
+static uint64_t mix64(uint64_t x){
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull; x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+/** @brief STAMPDB_SIM_TIMING / STAMPDB_SIM_JITTER (ignored once timing was set in code). */
+static void timing_from_env(void){
+  atomic_store(&timing_env_read, true);
+  if (timing_pinned) return;
+  sim_flash_timing_t t = {0};
+  const char *e = getenv("STAMPDB_SIM_TIMING");
+  if (e && strcmp(e, "rp2350")==0) t = timing_rp2350;
+  else if (e && *e && strcmp(e, "off")!=0){
+    unsigned long a = 0, b = 0, c = 0;
+    if (sscanf(e, "%lu,%lu,%lu", &a, &b, &c) >= 2){ t.erase_us = (uint32_t)a; t.program_us = (uint32_t)b; t.read_ns_per_byte = (uint32_t)c; }
+  }
+  const char *j = getenv("STAMPDB_SIM_JITTER");
+  if (j && *j){
+    unsigned long pct = 0, seed = 1;
+    sscanf(j, "%lu,%lu", &pct, &seed);
+    t.jitter_pct = (uint32_t)(pct > 100u ? 100u : pct); t.seed = (uint32_t)seed;
+  }
+  timing = t;
+  atomic_store(&timing_on, t.erase_us || t.program_us || t.read_ns_per_byte);
+}
 
-/** @brief Lazy allocation + initial load from disk (or 0xFF fill). */
+/** @brief Charge one op to the counters and, with the model on, its latency to the clock. */
+static void account(int op, size_t bytes){
+  if (!atomic_load_explicit(&timing_env_read, memory_order_relaxed)) timing_from_env();
+  atomic_fetch_add_explicit(&st_ops[op], 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&st_bytes[op], bytes, memory_order_relaxed);
+  if (!atomic_load_explicit(&timing_on, memory_order_relaxed)) return;
+  uint64_t ns = op == SIM_OP_ERASE ? timing.erase_us*1000ull : op == SIM_OP_PROGRAM ? timing.program_us*1000ull
+              : (uint64_t)timing.read_ns_per_byte*bytes;
+  if (timing.jitter_pct && ns){
+    uint64_t span = 2u*(uint64_t)timing.jitter_pct + 1u; // uniform in [-pct, +pct] percent
+    uint64_t r = mix64(timing.seed ^ mix64(atomic_fetch_add_explicit(&op_index, 1, memory_order_relaxed))) % span;
+    ns = ns*(100u - timing.jitter_pct + r)/100u;
+  }
+  atomic_fetch_add_explicit(&clock_ns, ns, memory_order_relaxed);
+  atomic_fetch_add_explicit(&st_busy_ns[op], ns, memory_order_relaxed);
+  uint64_t m = atomic_load_explicit(&st_max_ns[op], memory_order_relaxed);
+  while (ns > m && !atomic_compare_exchange_weak_explicit(&st_max_ns[op], &m, ns, memory_order_relaxed, memory_order_relaxed)) {}
+}
+
+/** @brief Fill [from..to) of the backing file with erased bytes. */
+static void fill_erased(int fd, off_t from, off_t to){
+  uint8_t ff[4096]; memset(ff, 0xFF, sizeof(ff));
+  while (from < to){
+    size_t n = (size_t)((to - from) < (off_t)sizeof(ff) ? (to - from) : (off_t)sizeof(ff));
+    if (pwrite(fd, ff, n, from) != (ssize_t)n) return;
+    from += (off_t)n;
+  }
+}
+
+/** @brief Lazy open + map (or load) of the image; missing/short files are extended with 0xFF. */
 static void ensure_loaded(void){
   if (flash_mem) return;
   const char *env = getenv("STAMPDB_SIM_FLASH_BYTES");
   if (env) { unsigned long v = strtoul(env, NULL, 10); if (v>=4096) flash_bytes = (uint32_t)v; }
+  const char *mode = getenv("STAMPDB_SIM_MODE");
+  flash_mode = (mode && strcmp(mode, "file")==0) ? MODE_FILE : MODE_MMAP;
+  const char *sync = getenv("STAMPDB_SIM_SYNC");
+  flash_sync = (sync && strcmp(sync, "fsync")==0) ? SYNC_FSYNC : (sync && strcmp(sync, "msync")==0) ? SYNC_MSYNC : SYNC_NONE;
+
+  flash_fd = open(get_flash_path(), O_RDWR | O_CREAT, 0644);
+  if (flash_fd >= 0){
+    struct stat st;
+    off_t have = (fstat(flash_fd, &st)==0) ? st.st_size : 0;
+    if (have != (off_t)flash_bytes && ftruncate(flash_fd, (off_t)flash_bytes) != 0){ close(flash_fd); flash_fd = -1; }
+    else if (have < (off_t)flash_bytes) fill_erased(flash_fd, have, (off_t)flash_bytes);
+  }
+  if (flash_fd >= 0 && flash_mode == MODE_MMAP){
+    void *m = mmap(NULL, flash_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, flash_fd, 0);
+    if (m != MAP_FAILED){ flash_mem = (uint8_t*)m; return; }
+  }
+  flash_mode = MODE_FILE; // no file or mapping unavailable: private copy
   flash_mem = (uint8_t*)malloc(flash_bytes);
-  FILE *f = fopen(get_flash_path(), "rb");
-  if (f){ fread(flash_mem,1,flash_bytes,f); fclose(f); }
-  else { memset(flash_mem,0xFF,flash_bytes); }
+  if (!flash_mem) return;
+  if (flash_fd < 0 || pread(flash_fd, flash_mem, flash_bytes, 0) != (ssize_t)flash_bytes) memset(flash_mem, 0xFF, flash_bytes);
 }
 
-/** @brief Persist entire image to disk. */
-static void persist(void){ FILE *f=fopen(get_flash_path(),"wb"); if(!f) return; fwrite(flash_mem,1,flash_bytes,f); fclose(f);} 
+/** @brief Write back [addr..addr+len) after a mutation and apply the sync policy. */
+static void write_through(uint32_t addr, uint32_t len){
+  if (flash_fd < 0) return;
+  if (flash_mode == MODE_FILE){
+    if (pwrite(flash_fd, flash_mem + addr, len, (off_t)addr) != (ssize_t)len) return;
+    if (flash_sync != SYNC_NONE) fsync(flash_fd);
+    return;
+  }
+  if (flash_sync == SYNC_NONE) return;
+  uintptr_t pg = (uintptr_t)sysconf(_SC_PAGESIZE);
+  uintptr_t lo = ((uintptr_t)(flash_mem + addr)) & ~(pg - 1u);
+  uintptr_t hi = (uintptr_t)(flash_mem + addr + len);
+  msync((void*)lo, (size_t)(hi - lo), MS_SYNC);
+  if (flash_sync == SYNC_FSYNC) fsync(flash_fd);
+}
 
-/** @brief Read from flash (refreshes in-memory view from disk). */
+/** @brief Read from flash (served from the mapping/copy; no file I/O). */
 int sim_flash_read(uint32_t addr, void *dst, size_t len){
-  ensure_loaded();
-  // Refresh from disk to honor external modifications by tests
-  FILE *f = fopen(get_flash_path(), "rb");
-  if (f){ fread(flash_mem,1,flash_bytes,f); fclose(f); }
-  else { memset(flash_mem,0xFF,flash_bytes); }
-  if (addr+len>flash_bytes) return -1; memcpy(dst, flash_mem+addr, len); return 0;
+  ensure_loaded(); if (!flash_mem) return -1;
+  if ((uint64_t)addr+len>flash_bytes) return -1; memcpy(dst, flash_mem+addr, len); account(SIM_OP_READ, len); return 0;
+}
+
+/** @brief True when this op of kind `op` is the armed one (disarms it). */
+static bool fail_due(int op){
+  uint32_t n = atomic_load(&fail_in[op]);
+  while (n && !atomic_compare_exchange_weak(&fail_in[op], &n, n - 1u)) {}
+  return n == 1u;
 }
 
 /** @brief Erase a 4 KiB sector (fills with 0xFF). */
-int sim_flash_erase_4k(uint32_t addr){ ensure_loaded(); if (addr%4096) return -1; if (addr+4096>flash_bytes) return -1; memset(flash_mem+addr, 0xFF, 4096); persist(); return 0; }
+int sim_flash_erase_4k(uint32_t addr){
+  ensure_loaded(); if (!flash_mem) return -1;
+  if (addr%4096) return -1; if ((uint64_t)addr+4096>flash_bytes) return -1;
+  if (fail_due(SIM_OP_ERASE)) return -1;
+  memset(flash_mem+addr, 0xFF, 4096); write_through(addr, 4096); account(SIM_OP_ERASE, 4096); return 0;
+}
 
 /** @brief Program a 256 B page using NOR 1→0 (bitwise AND with existing). */
-int sim_flash_program_256(uint32_t addr, const void *src){ ensure_loaded(); if (addr%256) return -1; if (addr+256>flash_bytes) return -1; const uint8_t *s=(const uint8_t*)src; for (size_t i=0;i<256;i++){ flash_mem[addr+i] = flash_mem[addr+i] & s[i]; } persist(); return 0; }
+int sim_flash_program_256(uint32_t addr, const void *src){
+  ensure_loaded(); if (!flash_mem) return -1;
+  if (addr%256) return -1; if ((uint64_t)addr+256>flash_bytes) return -1;
+  if (fail_due(SIM_OP_PROGRAM)) return -1;
+  const uint8_t *s=(const uint8_t*)src; for (size_t i=0;i<256;i++){ flash_mem[addr+i] = flash_mem[addr+i] & s[i]; }
+  write_through(addr, 256); account(SIM_OP_PROGRAM, 256); return 0;
+}
 
 /** @brief Total simulated flash size (bytes). */
 uint32_t sim_flash_size_bytes(void){ ensure_loaded(); return flash_bytes; }
+
+/** @brief Unmap/free the image and close the file; next access re-opens it. */
+void sim_flash_reload(void){
+  if (flash_mem){
+    if (flash_mode == MODE_MMAP) munmap(flash_mem, flash_bytes); else free(flash_mem);
+    flash_mem = NULL;
+  }
+  if (flash_fd >= 0){ close(flash_fd); flash_fd = -1; }
+  atomic_store(&timing_env_read, false);
+}
+
+/** @brief Flush the whole image (msync for mappings) and fsync the file. */
+int sim_flash_sync(void){
+  if (!flash_mem || flash_fd < 0) return 0;
+  if (flash_mode == MODE_MMAP && msync(flash_mem, flash_bytes, MS_SYNC) != 0) return -1;
+  return fsync(flash_fd)==0 ? 0 : -1;
+}
+
+/** @brief Pin a timing model (NULL: instant ops, wall clock); the clock keeps its value. */
+void sim_flash_set_timing(const sim_flash_timing_t *t){
+  timing_pinned = true;
+  timing = t ? *t : (sim_flash_timing_t){0};
+  if (timing.jitter_pct > 100u) timing.jitter_pct = 100u;
+  atomic_store(&op_index, 0);
+  atomic_store(&timing_on, t && (t->erase_us || t->program_us || t->read_ns_per_byte));
+}
+
+/** @brief Current model (env parsed on first use after a reload); true when it is on. */
+bool sim_flash_get_timing(sim_flash_timing_t *out){
+  if (!atomic_load_explicit(&timing_env_read, memory_order_relaxed)) timing_from_env();
+  if (out) *out = timing;
+  return atomic_load(&timing_on);
+}
+
+/** @brief The RP2350 preset used by STAMPDB_SIM_TIMING=rp2350. */
+sim_flash_timing_t sim_flash_timing_rp2350(void){ return timing_rp2350; }
+
+uint64_t sim_clock_us(void){ return atomic_load_explicit(&clock_ns, memory_order_relaxed) / 1000u; }
+void sim_clock_advance_us(uint64_t us){ atomic_fetch_add_explicit(&clock_ns, us*1000u, memory_order_relaxed); }
+
+/** @brief Per-op counters since start or the last reset. */
+void sim_flash_stats(sim_flash_stats_t *out, bool reset){
+  for (int op=0; op<SIM_OP_COUNT; op++){
+    sim_flash_op_stats_t *o = &out->op[op];
+    if (reset){
+      o->ops = atomic_exchange(&st_ops[op], 0); o->bytes = atomic_exchange(&st_bytes[op], 0);
+      o->busy_us = atomic_exchange(&st_busy_ns[op], 0) / 1000u; o->max_us = (uint32_t)(atomic_exchange(&st_max_ns[op], 0) / 1000u);
+    } else {
+      o->ops = atomic_load(&st_ops[op]); o->bytes = atomic_load(&st_bytes[op]);
+      o->busy_us = atomic_load(&st_busy_ns[op]) / 1000u; o->max_us = (uint32_t)(atomic_load(&st_max_ns[op]) / 1000u);
+    }
+  }
+}
+
+/** @brief Arm (or with 0, disarm) a one-shot failure of the `nth` next erase/program. */
+void sim_flash_fail_nth(int op, uint32_t nth){
+  if (op == SIM_OP_ERASE || op == SIM_OP_PROGRAM) atomic_store(&fail_in[op], nth);
+}
@@ -1,24 +1,29 @@
 /**
  * @file platform_sim.c
- * @brief Host platform glue: wall-clock and NOR flash shim bindings.
+ * @brief Host platform glue: clocks and NOR flash shim bindings.
  *
  * Role in system:
- *  - Bridges core to `sim/flash.c` and provides millisecond clock.
+ *  - Bridges core to `sim/flash.c` and provides millisecond/microsecond clocks:
+ *    the wall clock, or the simulator's virtual clock while its timing model is on.
  */
 #include "stampdb_internal.h"
+#include "sim_flash.h"
 #include <time.h>
 #include <string.h>
 
 /** @brief Monotonic milliseconds used for quotas and hint cadence. */
 uint64_t platform_millis(void){
+  if (sim_flash_get_timing(NULL)) return sim_clock_us() / 1000u;
   struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
   return (uint64_t)ts.tv_sec*1000ull + (uint64_t)(ts.tv_nsec/1000000ull);
 }
 
-extern int sim_flash_read(uint32_t addr, void *dst, size_t len);
-extern int sim_flash_erase_4k(uint32_t addr);
-extern int sim_flash_program_256(uint32_t addr, const void *src);
-extern uint32_t sim_flash_size_bytes(void);
+/** @brief Monotonic microseconds (GC step budgets). */
+uint64_t platform_micros(void){
+  if (sim_flash_get_timing(NULL)) return sim_clock_us();
+  struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000ull + (uint64_t)(ts.tv_nsec/1000ull);
+}
 
 /** @brief NOR read/erase/program; 1→0 programming is enforced by the shim. */
 int platform_flash_read(uint32_t addr, void *dst, size_t len){ return sim_flash_read(addr, dst, len); }
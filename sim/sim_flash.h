@@ -0,0 +1,91 @@
+/**
+ * @file sim_flash.h
+ * @brief Host NOR flash simulator API (backing store for platform_sim.c).
+ *
+ * What it owns:
+ *  - Read/erase/program entry points with NOR semantics (1→0 program, 4 KiB erase)
+ *  - Backing-store control: reload after external mutation, explicit sync
+ *  - Timing model: per-op latency (+ deterministic jitter) charged to a virtual
+ *    clock that replaces the wall clock behind platform_millis()/platform_micros(),
+ *    and per-op counters (always kept)
+ *
+ * Environment (read on first access and on every reload):
+ *  - STAMPDB_FLASH_PATH: image path (default `flash.bin`)
+ *  - STAMPDB_SIM_FLASH_BYTES: device size (default 4 MiB)
+ *  - STAMPDB_SIM_MODE: `mmap` (default, MAP_SHARED write-through) or `file`
+ *    (private RAM copy, touched ranges written back with pwrite)
+ *  - STAMPDB_SIM_SYNC: `none` (default, OS writeback), `msync` (flush touched
+ *    pages after each erase/program), `fsync` (msync + fsync after each op)
+ *  - STAMPDB_SIM_TIMING: `off` (default: instant ops, wall clock), `rp2350`, or
+ *    `ERASE_US,PROGRAM_US[,READ_NS_PER_BYTE]`
+ *  - STAMPDB_SIM_JITTER: `PCT[,SEED]`, uniform ±PCT% on every timed op (seed 1)
+ *
+ * Timing model:
+ *  - Each op adds its latency to the virtual clock instead of sleeping, so runs are
+ *    fast and, single-threaded, bit-for-bit repeatable. CPU time is not modeled:
+ *    callers advance the clock for sample periods and idle time.
+ *  - An op blocks its caller and moves the one shared clock, which is how an erase
+ *    with XIP stalled looks to every core on the device.
+ *  - Enable it before stampdb_open(): deadlines taken from the wall clock do not
+ *    carry over to the virtual one.
+ *
+ * Fault injection:
+ *  - sim_flash_fail_nth() makes one upcoming erase or program fail with -1, leaving
+ *    the image untouched (tests of the write-behind failure path)
+ */
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int      sim_flash_read(uint32_t addr, void *dst, size_t len);
+int      sim_flash_erase_4k(uint32_t addr);
+int      sim_flash_program_256(uint32_t addr, const void *src);
+uint32_t sim_flash_size_bytes(void);
+
+/**
+ * @brief Drop the current mapping/copy; the next access re-opens the image.
+ *
+ * Call after deleting/replacing the image file or, in `file` mode, after
+ * mutating it externally. In `mmap` mode in-place writes by other handles are
+ * visible without a reload.
+ */
+void     sim_flash_reload(void);
+/** @brief Flush the whole image to stable storage regardless of the sync policy. */
+int      sim_flash_sync(void);
+
+/** @brief Per-op latencies; all-zero latencies turn the model off. */
+typedef struct {
+  uint32_t erase_us;         // per 4 KiB erase
+  uint32_t program_us;       // per 256 B program
+  uint32_t read_ns_per_byte; // reads scale with length
+  uint32_t jitter_pct;       // uniform ±pct on each op (0..100)
+  uint32_t seed;             // jitter stream
+} sim_flash_timing_t;
+
+enum { SIM_OP_READ=0, SIM_OP_ERASE=1, SIM_OP_PROGRAM=2, SIM_OP_COUNT=3 };
+typedef struct { uint64_t ops, bytes, busy_us; uint32_t max_us; } sim_flash_op_stats_t;
+/** @brief Counters per op (`op[SIM_OP_*]`); busy/max are modeled time, 0 with the model off. */
+typedef struct { sim_flash_op_stats_t op[SIM_OP_COUNT]; } sim_flash_stats_t;
+
+/** @brief Pin a model (NULL: off), overriding the environment; restarts the jitter stream. */
+void     sim_flash_set_timing(const sim_flash_timing_t *t);
+/** @brief Active model into `out` (may be NULL); true when the model is on. */
+bool     sim_flash_get_timing(sim_flash_timing_t *out);
+/** @brief RP2350 board flash preset (45 ms erase, 0.5 ms program, 30 ns/B read). */
+sim_flash_timing_t sim_flash_timing_rp2350(void);
+/** @brief Virtual clock (µs): the sum of modeled op latencies and explicit advances. */
+uint64_t sim_clock_us(void);
+void     sim_clock_advance_us(uint64_t us);
+/** @brief Copy the per-op counters; `reset` zeroes them. */
+void     sim_flash_stats(sim_flash_stats_t *out, bool reset);
+/** @brief Fail the `nth` next op of kind `op` (SIM_OP_ERASE/SIM_OP_PROGRAM; 1 = the next one) once; 0 disarms. */
+void     sim_flash_fail_nth(int op, uint32_t nth);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,6 +1,6 @@
 /**
  * @file codec.c
- * @brief Fixed16 value quantization and timestamp delta codec for 224 B payloads.
+ * @brief Timestamp and value lane codecs for 224 B payloads.
  *
  * What it owns:
  *  - Payload encoder/decoder and block header pack/unpack with header CRC
@@ -9,7 +9,10 @@
  *  - Writer builds blocks that fit a single 256 B page (224 B payload + 32 B header)
  *
  * Constraints:
- *  - dt_bits chooses 8-bit or 16-bit delta lanes; values are 16-bit signed (Fixed16)
+ *  - dt_bits selects the timestamp lane: fixed 8/16-bit deltas or bit-packed
+ *    delta-of-delta (STAMPDB_DT_DOD)
+ *  - val_lane selects the value lane: Fixed-point at 16/12/8 bits against the
+ *    header bias/scale, or lossless XOR-float (no bias/scale, no header aggregates)
  */
 #include "stampdb_internal.h"
 #include <string.h>
@@ -19,49 +22,201 @@ static inline void wr16(uint8_t *p, uint16_t v){p[0]=(uint8_t)(v&0xFF);p[1]=(uin
 static inline uint32_t rd32(const uint8_t *p){return (uint32_t)p[0]|((uint32_t)p[1]<<8)|((uint32_t)p[2]<<16)|((uint32_t)p[3]<<24);} 
 static inline void wr32(uint8_t *p, uint32_t v){p[0]=(uint8_t)(v&0xFF);p[1]=(uint8_t)(v>>8);p[2]=(uint8_t)(v>>16);p[3]=(uint8_t)(v>>24);} 
 
+/** @brief LSB-first bit writer shared by the DOD and value lanes. */
+typedef struct { uint8_t *p; uint64_t acc; uint32_t n; } bitw_t;
+static inline void bw_put(bitw_t *b, uint32_t v, uint8_t w){
+  if (!w) return;
+  b->acc |= (uint64_t)(w == 32 ? v : (v & ((1u << w) - 1u))) << b->n; b->n += w;
+  while (b->n >= 8){ *b->p++ = (uint8_t)b->acc; b->acc >>= 8; b->n -= 8; }
+}
+static inline void bw_flush(bitw_t *b){ if (b->n){ *b->p++ = (uint8_t)b->acc; b->acc = 0; b->n = 0; } }
+
+/** @brief Bounded LSB-first bit reader; `bad` latches on reading past `end`. */
+typedef struct { const uint8_t *p, *end; uint64_t acc; uint32_t n; bool bad; } bitr_t;
+static inline uint32_t br_get(bitr_t *r, uint8_t w){
+  if (!w) return 0;
+  while (r->n < w){
+    if (r->p >= r->end){ r->bad = true; return 0; }
+    r->acc |= (uint64_t)(*r->p++) << r->n; r->n += 8;
+  }
+  uint32_t v = (uint32_t)(r->acc & (w == 32 ? 0xFFFFFFFFull : ((1ull << w) - 1u)));
+  r->acc >>= w; r->n -= w;
+  return v;
+}
+
+/** @brief Delta-of-delta lane: row i>=2 stores zigzag(delta[i]-delta[i-1]) in `w` bits, LSB-first. */
+static size_t dod_encode(uint8_t *p, const uint32_t *d, uint16_t count){
+  uint8_t w = 0;
+  for (uint16_t i=2;i<count;i++){ uint8_t bw = codec_bit_width(codec_zigzag((int32_t)(d[i]-d[i-1]))); if (bw > w) w = bw; }
+  size_t n = codec_dod_lane_bytes(count, w);
+  if (n > STAMPDB_PAYLOAD_BYTES) return 0;
+  wr32(p, count > 1 ? d[1] : 0u); p[4] = w;
+  bitw_t b = { p + 5, 0, 0 };
+  for (uint16_t i=2;i<count;i++) bw_put(&b, codec_zigzag((int32_t)(d[i]-d[i-1])), w);
+  bw_flush(&b);
+  return n;
+}
+
+/**
+ * @brief Walk a delta-of-delta lane; deltas (if non-NULL) get every row's delta.
+ * @return Lane bytes, or 0 when the width byte or lane length is out of range.
+ */
+static size_t dod_decode(const uint8_t *p, uint16_t count, uint32_t *deltas, uint32_t *sum_out){
+  uint8_t w = p[4];
+  size_t n = codec_dod_lane_bytes(count, w);
+  if (w > 32 || n > STAMPDB_PAYLOAD_BYTES) return 0;
+  uint32_t d = rd32(p), sum = 0;
+  bitr_t r = { p + 5, p + n, 0, 0, false };
+  for (uint16_t i=0;i<count;i++){
+    uint32_t di = 0;
+    if (i == 1) di = d;
+    else if (i >= 2){ uint32_t z = br_get(&r, w); d += (uint32_t)((int32_t)(z >> 1) ^ -(int32_t)(z & 1u)); di = d; }
+    if (deltas) deltas[i] = di;
+    sum += di;
+  }
+  if (sum_out) *sum_out = sum;
+  return n;
+}
+
+/** @brief Bytes taken by the timestamp lane (values start right after); 0 if malformed. */
+static size_t ts_lane_bytes(const uint8_t *payload, uint8_t dt_bits, uint16_t count){
+  if (dt_bits == STAMPDB_DT_DOD){
+    size_t n = codec_dod_lane_bytes(count, payload[4]);
+    return (payload[4] > 32 || n > STAMPDB_PAYLOAD_BYTES) ? 0 : n;
+  }
+  return (size_t)count * (dt_bits==8 ? 1u : 2u);
+}
+
+static inline uint32_t f2u(float f){ uint32_t u; memcpy(&u, &f, 4); return u; }
+static inline float u2f(uint32_t u){ float f; memcpy(&f, &u, 4); return f; }
+
+/** @brief XOR-float lane (see codec_xor_cost for the bit layout); 0 if it exceeds `room`. */
+static size_t xor_encode(uint8_t *p, size_t room, const float *vals, uint16_t count){
+  codec_xor_t x; uint32_t bits = 0;
+  for (uint16_t i=0;i<count;i++) bits += codec_xor_cost(&x, f2u(vals[i]), i);
+  size_t n = (bits + 7u) >> 3;
+  if (n > room) return 0;
+  bitw_t b = { p, 0, 0 }; codec_xor_t st;
+  for (uint16_t i=0;i<count;i++){
+    uint32_t v = f2u(vals[i]);
+    if (i == 0){ codec_xor_cost(&st, v, 0); bw_put(&b, v, 32); continue; }
+    uint32_t d = v ^ st.prev; uint8_t lead = st.lead, len = st.len;
+    // the fit test itself: a new window 10 bits shorter costs the same as reusing the old one
+    bool reuse = d && len && (uint32_t)__builtin_clz(d) >= lead && 32u - (uint32_t)__builtin_ctz(d) <= (uint32_t)lead + len;
+    codec_xor_cost(&st, v, i);
+    if (!d){ bw_put(&b, 0u, 1); continue; }
+    if (reuse){ bw_put(&b, 1u, 2); bw_put(&b, d >> (32u - lead - len), len); continue; } // previous window
+    bw_put(&b, 3u, 2); bw_put(&b, st.lead, 5); bw_put(&b, st.len - 1u, 5);
+    bw_put(&b, d >> (32u - st.lead - st.len), st.len);
+  }
+  bw_flush(&b);
+  return n;
+}
+
+/** @brief Decode `count` XOR-lane values from [p, end); false on a truncated or malformed lane. */
+static bool xor_decode(const uint8_t *p, const uint8_t *end, uint16_t count, float *out){
+  bitr_t r = { p, end, 0, 0, false };
+  uint32_t prev = 0; uint8_t lead = 0, len = 0;
+  for (uint16_t i=0;i<count;i++){
+    if (i == 0) prev = br_get(&r, 32);
+    else if (br_get(&r, 1)){
+      if (br_get(&r, 1)){ lead = (uint8_t)br_get(&r, 5); len = (uint8_t)(br_get(&r, 5) + 1u); if (lead + len > 32u) return false; }
+      else if (!len) return false;
+      prev ^= br_get(&r, len) << (32u - lead - len);
+    }
+    if (r.bad) return false;
+    out[i] = u2f(prev);
+  }
+  return true;
+}
+
 /**
- * @brief Encode timestamp deltas and quantized values into the 224 B payload area.
+ * @brief Encode timestamp deltas and values into the 224 B payload area.
  *
  * Inputs:
  *  - dst224: destination buffer (exactly 224 bytes)
- *  - dt_bits: 8 or 16; selects delta lane width
- *  - ts_deltas: array of `count` deltas (0..65535)
- *  - qvals: array of `count` quantized values (int16)
- *  - count: number of samples in the block
+ *  - h: dt_bits (8/16 fixed delta lane or STAMPDB_DT_DOD), val_lane and count
+ *  - ts_deltas: array of `count` deltas (deltas[0] is 0: row 0 sits at the header t0)
+ *  - qvals: `count` quantized values (quantized lanes; must fit the lane's bits)
+ *  - vals: `count` raw values (XOR lane)
  *
  * Notes:
- *  - Payload is zero-filled with 0xFF for NOR cleanliness.
+ *  - Remainder is filled with 0xFF for NOR cleanliness.
+ *  - The DOD lane is `u32 delta[1] | u8 w | (count-2) zigzag dods at w bits`; a
+ *    constant cadence costs 5 bytes for the whole block (w = 0).
+ *  - Quantized values are packed LSB-first at 8/12/16 bits, so Q16 keeps the
+ *    original little-endian int16 layout.
  */
-size_t codec_encode_payload(uint8_t *dst224, uint8_t dt_bits, const uint32_t *ts_deltas, const int16_t *qvals, uint16_t count){
-  // layout: deltas then qvals
-  uint8_t *p = dst224;
-  if (dt_bits==8){
+size_t codec_encode_payload(uint8_t *dst224, const block_header_t *h, const uint32_t *ts_deltas, const int16_t *qvals, const float *vals){
+  uint8_t *p = dst224; uint16_t count = h->count;
+  memset(dst224, 0xFF, STAMPDB_PAYLOAD_BYTES);
+  if (h->dt_bits==8){
+    if (count > STAMPDB_PAYLOAD_BYTES) return 0;
     for (uint16_t i=0;i<count;i++) *p++=(uint8_t)ts_deltas[i];
-  } else {
+  } else if (h->dt_bits==16){
+    if (count > STAMPDB_PAYLOAD_BYTES/2u) return 0;
     for (uint16_t i=0;i<count;i++){ wr16(p,(uint16_t)ts_deltas[i]); p+=2; }
+  } else {
+    size_t n = dod_encode(p, ts_deltas, count);
+    if (!n) return 0;
+    p += n;
+  }
+  size_t room = STAMPDB_PAYLOAD_BYTES - (size_t)(p - dst224);
+  if (h->val_lane == STAMPDB_VAL_XOR){
+    size_t n = xor_encode(p, room, vals, count);
+    if (!n && count) return 0;
+    p += n;
+  } else {
+    uint8_t w = codec_val_bits(h->val_lane);
+    if (codec_val_lane_bytes(h->val_lane, count, 0) > room) return 0;
+    bitw_t b = { p, 0, 0 };
+    for (uint16_t i=0;i<count;i++) bw_put(&b, (uint16_t)qvals[i], w);
+    bw_flush(&b); p = b.p;
   }
-  for (uint16_t i=0;i<count;i++){ wr16(p,(uint16_t)qvals[i]); p+=2; }
   size_t used = (size_t)(p - dst224);
   for (size_t i=used;i<STAMPDB_PAYLOAD_BYTES;i++) dst224[i]=0xFF;
   return used;
 }
 
+/** @brief Sign-extend a `w`-bit two's complement field. */
+static inline int32_t sext(uint32_t v, uint8_t w){ uint32_t m = 1u << (w - 1u); return (int32_t)(v ^ m) - (int32_t)m; }
+
 /**
- * @brief Decode payload back into delta and qval arrays.
+ * @brief Decode payload back into deltas and values (fixed-width lanes use the bulk kernels).
  */
-size_t codec_decode_payload(const uint8_t *src224, uint8_t dt_bits, uint32_t *ts_deltas, int16_t *qvals, uint16_t count){
-  const uint8_t *p = src224;
-  if (dt_bits==8){
-    for (uint16_t i=0;i<count;i++) ts_deltas[i]=*p++;
+size_t codec_decode_payload(const uint8_t *src224, const block_header_t *h, uint32_t *ts_deltas, float *values){
+  const uint8_t *p = src224; uint16_t count = h->count;
+  if (h->dt_bits==8){
+    if (count > STAMPDB_PAYLOAD_BYTES) return 0;
+    codec_widen_u8(ts_deltas, p, count); p += count;
+  } else if (h->dt_bits==16){
+    if (count > STAMPDB_PAYLOAD_BYTES/2u) return 0;
+    codec_widen_u16le(ts_deltas, p, count); p += 2u*count;
+  } else {
+    size_t n = dod_decode(p, count, ts_deltas, NULL);
+    if (!n) return 0;
+    p += n;
+  }
+  const uint8_t *end = src224 + STAMPDB_PAYLOAD_BYTES;
+  if (h->val_lane == STAMPDB_VAL_XOR) return xor_decode(p, end, count, values) ? (size_t)(end - src224) : 0;
+  if (codec_val_lane_bytes(h->val_lane, count, 0) > (size_t)(end - p)) return 0;
+  if (h->val_lane == STAMPDB_VAL_Q16){
+    codec_dequant_i16le(values, p, count, h->bias, h->scale); p += 2u*count;
+  } else if (h->val_lane == STAMPDB_VAL_Q8){
+    codec_dequant_i8(values, p, count, h->bias, h->scale); p += count;
   } else {
-    for (uint16_t i=0;i<count;i++){ ts_deltas[i]=rd16(p); p+=2; }
+    bitr_t r = { p, end, 0, 0, false }; uint8_t w = codec_val_bits(h->val_lane);
+    for (uint16_t i=0;i<count;i++) values[i] = codec_dequant(h->bias, h->scale, (int16_t)sext(br_get(&r, w), w));
+    p = r.p;
   }
-  for (uint16_t i=0;i<count;i++){ qvals[i]=(int16_t)rd16(p); p+=2; }
   return (size_t)(p - src224);
 }
 
 /**
- * @brief Pack block header and compute header CRC over first 28 bytes.
+ * @brief Pack a v2 block header and compute header CRC over first 28 bytes.
+ *
+ * v2 layout adds: byte 12 bits5..6 = value lane, bit7 = aggregates exact,
+ * bytes 13..15 = int24 sum of qvals.
  */
 void codec_pack_header(uint8_t out32[STAMPDB_HEADER_BYTES], const block_header_t *h){
   memset(out32, 0xFF, STAMPDB_HEADER_BYTES);
@@ -69,7 +224,10 @@ void codec_pack_header(uint8_t out32[STAMPDB_HEADER_BYTES], const block_header_t
   wr16(out32+4, h->series);
   wr16(out32+6, h->count);
   wr32(out32+8, h->t0_ms);
-  out32[12]=h->dt_bits;
+  out32[12]=(uint8_t)((h->dt_bits & STAMPDB_HDR_DT_MASK) | ((h->val_lane << STAMPDB_HDR_VAL_SHIFT) & STAMPDB_HDR_VAL_MASK) |
+                     (h->agg_exact ? STAMPDB_HDR_AGG_EXACT : 0u));
+  uint32_t qs = (uint32_t)h->qsum & 0xFFFFFFu;
+  out32[13]=(uint8_t)qs; out32[14]=(uint8_t)(qs>>8); out32[15]=(uint8_t)(qs>>16);
   memcpy(out32+16, &h->bias, 4);
   memcpy(out32+20, &h->scale, 4);
   wr32(out32+24, h->payload_crc);
@@ -78,21 +236,77 @@ void codec_pack_header(uint8_t out32[STAMPDB_HEADER_BYTES], const block_header_t
 }
 
 /**
- * @brief Verify and unpack block header; returns false on CRC or magic mismatch.
+ * @brief Verify and unpack block header (v1 or v2); returns false on CRC or magic mismatch.
  */
 bool codec_unpack_header(block_header_t *h, const uint8_t in32[STAMPDB_HEADER_BYTES]){
-  if (rd32(in32+0) != STAMPDB_BLOCK_MAGIC) return false;
+  uint32_t magic = rd32(in32+0);
+  if (magic != STAMPDB_BLOCK_MAGIC && magic != STAMPDB_BLOCK_MAGIC_V1) return false;
   // Use aligned reads to avoid potential faults on some MCUs
   uint32_t hc = rd32(in32+28);
   uint32_t calc = crc32c(in32, 28);
   if (hc != calc) return false;
+  h->version = (magic == STAMPDB_BLOCK_MAGIC) ? 2 : 1;
   h->series = rd16(in32+4);
   h->count = rd16(in32+6);
   h->t0_ms = rd32(in32+8);
-  h->dt_bits = in32[12];
+  if (h->version >= 2){
+    h->dt_bits = in32[12] & STAMPDB_HDR_DT_MASK;
+    h->val_lane = (uint8_t)((in32[12] & STAMPDB_HDR_VAL_MASK) >> STAMPDB_HDR_VAL_SHIFT);
+    h->agg_exact = (in32[12] & STAMPDB_HDR_AGG_EXACT) != 0;
+    uint32_t qs = (uint32_t)in32[13] | ((uint32_t)in32[14]<<8) | ((uint32_t)in32[15]<<16);
+    h->qsum = (int32_t)(qs ^ 0x800000u) - 0x800000; // sign-extend int24
+  } else {
+    h->dt_bits = in32[12]; h->val_lane = STAMPDB_VAL_Q16; h->agg_exact = false; h->qsum = 0;
+  }
   memcpy(&h->bias, in32+16, 4);
   memcpy(&h->scale, in32+20, 4);
   h->payload_crc = rd32(in32+24);
   h->header_crc = hc;
   return true;
 }
+
+/**
+ * @brief Block min/max/sum from header metadata alone.
+ *
+ * Exact blocks quantize their extremes to -qlim/+qlim of their lane (or scale 0),
+ * so min/max equal the decoded extreme rows bit for bit; sum is count*bias + scale*qsum.
+ * @return false for v1 headers, XOR-lane blocks, or blocks whose extremes were clamped.
+ */
+bool codec_block_aggregate(const block_header_t *h, float *min_out, float *max_out, float *sum_out){
+  if (h->version < 2 || !h->agg_exact || h->val_lane == STAMPDB_VAL_XOR) return false;
+  int32_t lim = codec_qlim(h->val_lane);
+  *min_out = codec_dequant(h->bias, h->scale, (int16_t)-lim);
+  *max_out = codec_dequant(h->bias, h->scale, (int16_t)lim);
+  *sum_out = (float)h->count * h->bias + h->scale * (float)h->qsum;
+  return true;
+}
+
+/**
+ * @brief Sum the timestamp lane to get the block's last timestamp (values untouched).
+ */
+uint32_t codec_block_last_ts(const block_header_t *h, const uint8_t *payload){
+  uint32_t t = h->t0_ms; const uint8_t *p = payload;
+  if (h->dt_bits==8){ for (uint16_t i=0;i<h->count;i++) t += *p++; }
+  else if (h->dt_bits==16){ for (uint16_t i=0;i<h->count;i++){ t += rd16(p); p+=2; } }
+  else { uint32_t sum = 0; if (dod_decode(p, h->count, NULL, &sum)) t += sum; }
+  return t;
+}
+
+/**
+ * @brief Value of the last row: quantized lanes index it directly, the XOR lane
+ * has to be walked from the first row.
+ */
+float codec_block_last_value(const block_header_t *h, const uint8_t *payload){
+  size_t lane = ts_lane_bytes(payload, h->dt_bits, h->count);
+  if (h->count == 0 || !lane || h->count > STAMPDB_BLOCK_MAX_ROWS) return h->bias;
+  const uint8_t *p = payload + lane, *end = payload + STAMPDB_PAYLOAD_BYTES;
+  if (h->val_lane == STAMPDB_VAL_XOR){
+    float v[STAMPDB_BLOCK_MAX_ROWS];
+    return xor_decode(p, end, h->count, v) ? v[h->count-1u] : h->bias;
+  }
+  if (lane + codec_val_lane_bytes(h->val_lane, h->count, 0) > STAMPDB_PAYLOAD_BYTES) return h->bias;
+  uint8_t w = codec_val_bits(h->val_lane); size_t bit = (size_t)(h->count-1u) * w;
+  bitr_t r = { p + (bit >> 3), end, 0, 0, false };
+  br_get(&r, (uint8_t)(bit & 7u));
+  return codec_dequant(h->bias, h->scale, (int16_t)sext(br_get(&r, w), w));
+}
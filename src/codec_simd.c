@@ -0,0 +1,236 @@
+/**
+ * @file codec_simd.c
+ * @brief Bulk decode kernels: delta widening, timestamp prefix sum, Fixed16/8 dequantization.
+ *
+ * What it owns:
+ *  - Scalar reference kernels (`codec_kernels_scalar`, used by tests/bench as ground truth)
+ *  - One vector kernel set picked at build time: AVX2 or SSE2 (x86), NEON (AArch64/ARMv7),
+ *    or Armv8-M DSP SIMD32 (RP2350 Cortex-M33); otherwise the scalar set
+ *
+ * Role in system:
+ *  - Hot loops behind codec_decode_payload() and the iterator's block load
+ *
+ * Constraints:
+ *  - Payload lanes are little-endian and unaligned; kernels only load within
+ *    [src, src + n * width), so the 224 B payload buffer is never over-read
+ *  - Dequantization is `bias + scale * q` as a separate multiply and add, so every
+ *    kernel matches codec_dequant() bit for bit (header aggregates rely on it); this
+ *    file and codec.c build with -ffp-contract=off so no compiler fuses it into an FMA
+ *  - STAMPDB_CODEC_SCALAR=1 forces the scalar set
+ */
+#include "stampdb_internal.h"
+#include <string.h>
+
+#if !STAMPDB_CODEC_SCALAR && (defined(__AVX2__) || defined(__SSE2__))
+#define CODEC_SIMD_X86 1
+#include <immintrin.h>
+#elif !STAMPDB_CODEC_SCALAR && defined(__ARM_NEON)
+#define CODEC_SIMD_NEON 1
+#include <arm_neon.h>
+#elif !STAMPDB_CODEC_SCALAR && defined(__ARM_FEATURE_SIMD32)
+#define CODEC_SIMD_DSP 1
+#include <arm_acle.h>
+#endif
+
+static void widen_u8_scalar(uint32_t *dst, const uint8_t *src, size_t n){ for (size_t i=0;i<n;i++) dst[i] = src[i]; }
+static void widen_u16_scalar(uint32_t *dst, const uint8_t *src, size_t n){ for (size_t i=0;i<n;i++) dst[i] = (uint32_t)src[2*i] | ((uint32_t)src[2*i+1] << 8); }
+static uint32_t prefix_sum_scalar(uint32_t *times, const uint32_t *deltas, size_t n, uint32_t t0){
+  for (size_t i=0;i<n;i++){ t0 += deltas[i]; times[i] = t0; }
+  return t0;
+}
+static void dequant_i16_scalar(float *dst, const uint8_t *src, size_t n, float bias, float scale){
+  for (size_t i=0;i<n;i++) dst[i] = codec_dequant(bias, scale, (int16_t)((uint16_t)src[2*i] | ((uint16_t)src[2*i+1] << 8)));
+}
+static void dequant_i8_scalar(float *dst, const uint8_t *src, size_t n, float bias, float scale){
+  for (size_t i=0;i<n;i++) dst[i] = codec_dequant(bias, scale, (int8_t)src[i]);
+}
+
+const codec_kernels_t codec_kernels_scalar = {
+  "scalar", widen_u8_scalar, widen_u16_scalar, prefix_sum_scalar, dequant_i16_scalar, dequant_i8_scalar
+};
+
+#if CODEC_SIMD_X86
+/** @brief Inclusive prefix sum of four u32 lanes plus a carried-in base. */
+static inline __m128i scan4(__m128i x, __m128i base){
+  x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+  x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+  return _mm_add_epi32(x, base);
+}
+static uint32_t prefix_sum_vec(uint32_t *times, const uint32_t *deltas, size_t n, uint32_t t0){
+  size_t i = 0; __m128i base = _mm_set1_epi32((int)t0);
+  for (; i + 4 <= n; i += 4){
+    __m128i x = scan4(_mm_loadu_si128((const __m128i*)(deltas + i)), base);
+    _mm_storeu_si128((__m128i*)(times + i), x);
+    base = _mm_shuffle_epi32(x, 0xFF);
+  }
+  return prefix_sum_scalar(times + i, deltas + i, n - i, (uint32_t)_mm_cvtsi128_si32(base));
+}
+#if defined(__AVX2__)
+#define CODEC_SIMD_NAME "avx2"
+static void widen_u8_vec(uint32_t *dst, const uint8_t *src, size_t n){
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) _mm256_storeu_si256((__m256i*)(dst + i), _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i))));
+  widen_u8_scalar(dst + i, src + i, n - i);
+}
+static void widen_u16_vec(uint32_t *dst, const uint8_t *src, size_t n){
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) _mm256_storeu_si256((__m256i*)(dst + i), _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + 2*i))));
+  widen_u16_scalar(dst + i, src + 2*i, n - i);
+}
+static inline void dequant8(float *dst, __m256i q, __m256 vb, __m256 vs){
+  _mm256_storeu_ps(dst, _mm256_add_ps(vb, _mm256_mul_ps(vs, _mm256_cvtepi32_ps(q))));
+}
+static void dequant_i16_vec(float *dst, const uint8_t *src, size_t n, float bias, float scale){
+  size_t i = 0; __m256 vb = _mm256_set1_ps(bias), vs = _mm256_set1_ps(scale);
+  for (; i + 8 <= n; i += 8) dequant8(dst + i, _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + 2*i))), vb, vs);
+  dequant_i16_scalar(dst + i, src + 2*i, n - i, bias, scale);
+}
+static void dequant_i8_vec(float *dst, const uint8_t *src, size_t n, float bias, float scale){
+  size_t i = 0; __m256 vb = _mm256_set1_ps(bias), vs = _mm256_set1_ps(scale);
+  for (; i + 8 <= n; i += 8) dequant8(dst + i, _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)(src + i))), vb, vs);
+  dequant_i8_scalar(dst + i, src + i, n - i, bias, scale);
+}
+#else
+#define CODEC_SIMD_NAME "sse2"
+static void widen_u8_vec(uint32_t *dst, const uint8_t *src, size_t n){
+  size_t i = 0; const __m128i z = _mm_setzero_si128();
+  for (; i + 8 <= n; i += 8){
+    __m128i w = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(src + i)), z);
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(w, z));
+    _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(w, z));
+  }
+  widen_u8_scalar(dst + i, src + i, n - i);
+}
+static void widen_u16_vec(uint32_t *dst, const uint8_t *src, size_t n){
+  size_t i = 0; const __m128i z = _mm_setzero_si128();
+  for (; i + 8 <= n; i += 8){
+    __m128i w = _mm_loadu_si128((const __m128i*)(src + 2*i));
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(w, z));
+    _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(w, z));
+  }
+  widen_u16_scalar(dst + i, src + 2*i, n - i);
+}
+/** @brief Dequantize eight int16 lanes (sign-extended by duplicate-unpack + arithmetic shift). */
+static inline void dequant8(float *dst, __m128i q16, __m128 vb, __m128 vs){
+  __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(q16, q16), 16), hi = _mm_srai_epi32(_mm_unpackhi_epi16(q16, q16), 16);
+  _mm_storeu_ps(dst, _mm_add_ps(vb, _mm_mul_ps(vs, _mm_cvtepi32_ps(lo))));
+  _mm_storeu_ps(dst + 4, _mm_add_ps(vb, _mm_mul_ps(vs, _mm_cvtepi32_ps(hi))));
+}
+static void dequant_i16_vec(float *dst, const uint8_t *src, size_t n, float bias, float scale){
+  size_t i = 0; __m128 vb = _mm_set1_ps(bias), vs = _mm_set1_ps(scale);
+  for (; i + 8 <= n; i += 8) dequant8(dst + i, _mm_loadu_si128((const __m128i*)(src + 2*i)), vb, vs);
+  dequant_i16_scalar(dst + i, src + 2*i, n - i, bias, scale);
+}
+static void dequant_i8_vec(float *dst, const uint8_t *src, size_t n, float bias, float scale){
+  size_t i = 0; __m128 vb = _mm_set1_ps(bias), vs = _mm_set1_ps(scale);
+  for (; i + 8 <= n; i += 8){
+    __m128i b = _mm_loadl_epi64((const __m128i*)(src + i));
+    dequant8(dst + i, _mm_srai_epi16(_mm_unpacklo_epi8(b, b), 8), vb, vs);
+  }
+  dequant_i8_scalar(dst + i, src + i, n - i, bias, scale);
+}
+#endif
+#elif CODEC_SIMD_NEON
+#define CODEC_SIMD_NAME "neon"
+static void widen_u8_vec(uint32_t *dst, const uint8_t *src, size_t n){
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8){
+    uint16x8_t w = vmovl_u8(vld1_u8(src + i));
+    vst1q_u32(dst + i, vmovl_u16(vget_low_u16(w))); vst1q_u32(dst + i + 4, vmovl_u16(vget_high_u16(w)));
+  }
+  widen_u8_scalar(dst + i, src + i, n - i);
+}
+static void widen_u16_vec(uint32_t *dst, const uint8_t *src, size_t n){
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8){
+    uint16x8_t w = vreinterpretq_u16_u8(vld1q_u8(src + 2*i));
+    vst1q_u32(dst + i, vmovl_u16(vget_low_u16(w))); vst1q_u32(dst + i + 4, vmovl_u16(vget_high_u16(w)));
+  }
+  widen_u16_scalar(dst + i, src + 2*i, n - i);
+}
+static uint32_t prefix_sum_vec(uint32_t *times, const uint32_t *deltas, size_t n, uint32_t t0){
+  size_t i = 0; const uint32x4_t z = vdupq_n_u32(0); uint32x4_t base = vdupq_n_u32(t0);
+  for (; i + 4 <= n; i += 4){
+    uint32x4_t x = vld1q_u32(deltas + i);
+    x = vaddq_u32(x, vextq_u32(z, x, 3));
+    x = vaddq_u32(x, vextq_u32(z, x, 2));
+    x = vaddq_u32(x, base);
+    vst1q_u32(times + i, x);
+    base = vdupq_n_u32(vgetq_lane_u32(x, 3));
+  }
+  return prefix_sum_scalar(times + i, deltas + i, n - i, vgetq_lane_u32(base, 0));
+}
+static inline void dequant8(float *dst, int16x8_t q, float32x4_t vb, float32x4_t vs){
+  vst1q_f32(dst, vaddq_f32(vb, vmulq_f32(vs, vcvtq_f32_s32(vmovl_s16(vget_low_s16(q))))));
+  vst1q_f32(dst + 4, vaddq_f32(vb, vmulq_f32(vs, vcvtq_f32_s32(vmovl_s16(vget_high_s16(q))))));
+}
+static void dequant_i16_vec(float *dst, const uint8_t *src, size_t n, float bias, float scale){
+  size_t i = 0; float32x4_t vb = vdupq_n_f32(bias), vs = vdupq_n_f32(scale);
+  for (; i + 8 <= n; i += 8) dequant8(dst + i, vreinterpretq_s16_u8(vld1q_u8(src + 2*i)), vb, vs);
+  dequant_i16_scalar(dst + i, src + 2*i, n - i, bias, scale);
+}
+static void dequant_i8_vec(float *dst, const uint8_t *src, size_t n, float bias, float scale){
+  size_t i = 0; float32x4_t vb = vdupq_n_f32(bias), vs = vdupq_n_f32(scale);
+  for (; i + 8 <= n; i += 8) dequant8(dst + i, vmovl_s8(vld1_s8((const int8_t*)(src + i))), vb, vs);
+  dequant_i8_scalar(dst + i, src + i, n - i, bias, scale);
+}
+#elif CODEC_SIMD_DSP
+#define CODEC_SIMD_NAME "dsp-simd32"
+/* Cortex-M33: one word load feeds four u8 / two u16 lanes (UXTB16/SXTB16 split byte
+ * pairs into halfwords); float conversion and the prefix sum stay scalar FPU/ALU work. */
+static inline uint32_t ld32(const uint8_t *p){ uint32_t w; memcpy(&w, p, 4); return w; }
+static void widen_u8_vec(uint32_t *dst, const uint8_t *src, size_t n){
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4){
+    uint32_t w = ld32(src + i), e = __uxtb16(w), o = __uxtb16(__ror(w, 8));
+    dst[i] = e & 0xFFFFu; dst[i+1] = o & 0xFFFFu; dst[i+2] = e >> 16; dst[i+3] = o >> 16;
+  }
+  widen_u8_scalar(dst + i, src + i, n - i);
+}
+static void widen_u16_vec(uint32_t *dst, const uint8_t *src, size_t n){
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2){ uint32_t w = ld32(src + 2*i); dst[i] = w & 0xFFFFu; dst[i+1] = w >> 16; }
+  widen_u16_scalar(dst + i, src + 2*i, n - i);
+}
+static uint32_t prefix_sum_vec(uint32_t *times, const uint32_t *deltas, size_t n, uint32_t t0){
+  return prefix_sum_scalar(times, deltas, n, t0);
+}
+static void dequant_i16_vec(float *dst, const uint8_t *src, size_t n, float bias, float scale){
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2){
+    uint32_t w = ld32(src + 2*i);
+    dst[i] = codec_dequant(bias, scale, (int16_t)w); dst[i+1] = codec_dequant(bias, scale, (int16_t)(w >> 16));
+  }
+  dequant_i16_scalar(dst + i, src + 2*i, n - i, bias, scale);
+}
+static void dequant_i8_vec(float *dst, const uint8_t *src, size_t n, float bias, float scale){
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4){
+    uint32_t w = ld32(src + i), e = (uint32_t)__sxtb16(w), o = (uint32_t)__sxtb16(__ror(w, 8));
+    dst[i]   = codec_dequant(bias, scale, (int16_t)e); dst[i+1] = codec_dequant(bias, scale, (int16_t)o);
+    dst[i+2] = codec_dequant(bias, scale, (int16_t)(e >> 16)); dst[i+3] = codec_dequant(bias, scale, (int16_t)(o >> 16));
+  }
+  dequant_i8_scalar(dst + i, src + i, n - i, bias, scale);
+}
+#endif
+
+#ifdef CODEC_SIMD_NAME
+const codec_kernels_t codec_kernels_active = {
+  CODEC_SIMD_NAME, widen_u8_vec, widen_u16_vec, prefix_sum_vec, dequant_i16_vec, dequant_i8_vec
+};
+void codec_widen_u8(uint32_t *dst, const uint8_t *src, size_t n){ widen_u8_vec(dst, src, n); }
+void codec_widen_u16le(uint32_t *dst, const uint8_t *src, size_t n){ widen_u16_vec(dst, src, n); }
+uint32_t codec_prefix_sum(uint32_t *times, const uint32_t *deltas, size_t n, uint32_t t0){ return prefix_sum_vec(times, deltas, n, t0); }
+void codec_dequant_i16le(float *dst, const uint8_t *src, size_t n, float bias, float scale){ dequant_i16_vec(dst, src, n, bias, scale); }
+void codec_dequant_i8(float *dst, const uint8_t *src, size_t n, float bias, float scale){ dequant_i8_vec(dst, src, n, bias, scale); }
+#else
+/** @brief No vector unit selected: the active set is the scalar one. */
+const codec_kernels_t codec_kernels_active = {
+  "scalar", widen_u8_scalar, widen_u16_scalar, prefix_sum_scalar, dequant_i16_scalar, dequant_i8_scalar
+};
+void codec_widen_u8(uint32_t *dst, const uint8_t *src, size_t n){ widen_u8_scalar(dst, src, n); }
+void codec_widen_u16le(uint32_t *dst, const uint8_t *src, size_t n){ widen_u16_scalar(dst, src, n); }
+uint32_t codec_prefix_sum(uint32_t *times, const uint32_t *deltas, size_t n, uint32_t t0){ return prefix_sum_scalar(times, deltas, n, t0); }
+void codec_dequant_i16le(float *dst, const uint8_t *src, size_t n, float bias, float scale){ dequant_i16_scalar(dst, src, n, bias, scale); }
+void codec_dequant_i8(float *dst, const uint8_t *src, size_t n, float bias, float scale){ dequant_i8_scalar(dst, src, n, bias, scale); }
+#endif
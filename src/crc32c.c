@@ -3,46 +3,108 @@
  * @brief CRC-32C (Castagnoli) computation used for payloads/headers/footers.
  *
  * What it owns:
- *  - `crc32c()` implementation with a lazily-initialized 256-entry table
+ *  - `crc32c()` front end dispatching to the fastest available kernel
+ *  - Portable slicing-by-8 kernel over const pre-generated tables (`crc32c_table.h`)
+ *  - Host kernels: SSE4.2 `crc32` (runtime cpuid check) and ARMv8 CRC extension
+ *    (compile-time, `__ARM_FEATURE_CRC32`)
  *
  * Role in system:
  *  - Guards integrity of payloads (224 B), headers (28 B), and segment footers
  *
  * Constraints:
- *  - Table init is not thread-safe; DB is single-threaded on Pico/host usage
+ *  - No mutable state: tables are const and dispatch is a pure cpuid query, so
+ *    calls are safe from any thread/core without initialization ordering
+ *  - Slicing kernel assumes a little-endian core (RP2350, x86, AArch64); big-endian
+ *    builds fall back to the byte loop
  */
-#include <stdint.h>
-#include <stddef.h>
+#include "stampdb_internal.h"
+#include "crc32c_table.h"
+#include <string.h>
 
-static uint32_t table[256];
-static int table_init = 0;
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define CRC32C_HAVE_SSE42 1
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#define CRC32C_HAVE_ARMV8 1
+#include <arm_acle.h>
+#endif
 
-/**
- * @brief Initialize CRC table for polynomial 0x1EDC6F41 (Castagnoli).
- */
-static void init_table(void) {
-  uint32_t poly = 0x1EDC6F41u; // Castagnoli
-  for (uint32_t i = 0; i < 256; ++i) {
-    uint32_t crc = i;
-    for (int j = 0; j < 8; ++j) {
-      if (crc & 1) crc = (crc >> 1) ^ poly;
-      else crc >>= 1;
-    }
-    table[i] = crc;
-  }
-  table_init = 1;
+/** @brief Advance a (non-inverted) CRC state one byte at a time. */
+static inline uint32_t crc_bytes(uint32_t crc, const uint8_t *p, size_t len){
+  while (len--) crc = crc32c_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+  return crc;
 }
 
-/**
- * @brief Compute CRC-32C over `len` bytes.
- * @return Bitwise-inverted CRC (standard CRC-32C output).
- */
-uint32_t crc32c(const void *data, size_t len) {
-  if (!table_init) init_table();
+/** @brief Reference byte-at-a-time kernel (used by tests/bench as ground truth). */
+uint32_t crc32c_bytewise(const void *data, size_t len){
+  return ~crc_bytes(~0u, (const uint8_t*)data, len);
+}
+
+/** @brief Portable slicing-by-8 kernel: 8 table lookups per 8 input bytes. */
+uint32_t crc32c_sw(const void *data, size_t len){
   const uint8_t *p = (const uint8_t*)data;
   uint32_t crc = ~0u;
-  for (size_t i = 0; i < len; ++i) {
-    crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  for (; len >= 8; p += 8, len -= 8){
+    uint32_t lo, hi; memcpy(&lo, p, 4); memcpy(&hi, p + 4, 4);
+    lo ^= crc;
+    crc = crc32c_table[7][lo & 0xFF] ^ crc32c_table[6][(lo >> 8) & 0xFF] ^
+          crc32c_table[5][(lo >> 16) & 0xFF] ^ crc32c_table[4][lo >> 24] ^
+          crc32c_table[3][hi & 0xFF] ^ crc32c_table[2][(hi >> 8) & 0xFF] ^
+          crc32c_table[1][(hi >> 16) & 0xFF] ^ crc32c_table[0][hi >> 24];
   }
+#endif
+  return ~crc_bytes(crc, p, len);
+}
+
+#if CRC32C_HAVE_SSE42
+/** @brief SSE4.2 kernel (only call when `crc32c_hw_available()`). */
+__attribute__((target("sse4.2")))
+uint32_t crc32c_hw(const void *data, size_t len){
+  const uint8_t *p = (const uint8_t*)data;
+#if defined(__x86_64__)
+  uint64_t c = 0xFFFFFFFFu;
+  for (; len >= 8; p += 8, len -= 8){ uint64_t w; memcpy(&w, p, 8); c = _mm_crc32_u64(c, w); }
+  uint32_t crc = (uint32_t)c;
+#else
+  uint32_t crc = ~0u;
+#endif
+  for (; len >= 4; p += 4, len -= 4){ uint32_t w; memcpy(&w, p, 4); crc = _mm_crc32_u32(crc, w); }
+  while (len--) crc = _mm_crc32_u8(crc, *p++);
+  return ~crc;
+}
+/** @brief True when the running CPU implements SSE4.2. */
+int crc32c_hw_available(void){ return __builtin_cpu_supports("sse4.2") ? 1 : 0; }
+const char *crc32c_hw_name(void){ return "sse4.2"; }
+#elif CRC32C_HAVE_ARMV8
+/** @brief ARMv8 CRC extension kernel (selected at compile time). */
+uint32_t crc32c_hw(const void *data, size_t len){
+  const uint8_t *p = (const uint8_t*)data;
+  uint32_t crc = ~0u;
+#if defined(__aarch64__)
+  for (; len >= 8; p += 8, len -= 8){ uint64_t w; memcpy(&w, p, 8); crc = __crc32cd(crc, w); }
+#endif
+  for (; len >= 4; p += 4, len -= 4){ uint32_t w; memcpy(&w, p, 4); crc = __crc32cw(crc, w); }
+  while (len--) crc = __crc32cb(crc, *p++);
   return ~crc;
 }
+int crc32c_hw_available(void){ return 1; }
+const char *crc32c_hw_name(void){ return "armv8-crc"; }
+#else
+/** @brief No hardware kernel on this target; aliases the portable kernel. */
+uint32_t crc32c_hw(const void *data, size_t len){ return crc32c_sw(data, len); }
+int crc32c_hw_available(void){ return 0; }
+const char *crc32c_hw_name(void){ return "none"; }
+#endif
+
+/**
+ * @brief Compute CRC-32C over `len` bytes.
+ * @return Bitwise-inverted CRC (standard CRC-32C output; "123456789" -> 0xE3069283).
+ */
+uint32_t crc32c(const void *data, size_t len){
+#if CRC32C_HAVE_ARMV8
+  return crc32c_hw(data, len);
+#else
+  return crc32c_hw_available() ? crc32c_hw(data, len) : crc32c_sw(data, len);
+#endif
+}
@@ -1,12 +1,15 @@
 /**
  * @file meta_lfs.c
- * @brief Metadata persistence (snapshots + head hints) in a raw meta region.
+ * @brief Metadata persistence (snapshots, head hints, zone-map checkpoint) in a raw meta region.
  *
- * Implementation: Use three dedicated 4 KiB sectors at the top of flash.
- *  - Sector 0: Snapshot A (first 256 B page stores the record)
- *  - Sector 1: Snapshot B
- *  - Sector 2: Head hint (addr + seq + crc in first 256 B page)
- * Each write erases the owning sector, then writes one 256 B page.
+ * Implementation: Use dedicated 4 KiB sectors at the top of the DB's flash partition.
+ *  - Sectors 0..1: Snapshot log (one 256 B record per page, 32 records)
+ *  - Sector 2: Head hint log (16 records)
+ *  - Sectors 3..: Zone-map checkpoint (header page, then a packed per-segment stream)
+ * Snapshots and hints are appended; loads pick the newest valid record by
+ * sequence number and a log sector is erased only when the cursor wraps into it.
+ * The checkpoint erases the sectors it needs, programs its stream pages, and
+ * programs its header page last, so a torn save is never accepted.
  */
 #include "stampdb_internal.h"
 #include <string.h>
@@ -14,55 +17,255 @@
 #define META_SECTOR_BYTES 4096u
 #define META_PAGE_BYTES   256u
 
-static inline uint32_t meta_base(void){ return platform_flash_size_bytes() - STAMPDB_META_RESERVED; }
-static inline uint32_t meta_snap_a_base(void){ return meta_base() + 0u * META_SECTOR_BYTES; }
-static inline uint32_t meta_snap_b_base(void){ return meta_base() + 1u * META_SECTOR_BYTES; }
-static inline uint32_t meta_head_base(void){   return meta_base() + 2u * META_SECTOR_BYTES; }
+static inline uint32_t meta_base(const stampdb_state_t *s){ return s->flash_bytes - STAMPDB_META_RESERVED; }
+static inline uint32_t meta_zm_base(const stampdb_state_t *s){ return meta_base(s) + 3u * META_SECTOR_BYTES; }
+
+/* Zone-map checkpoint: stream pages carry META_ZM_CHUNK bytes plus their own CRC. */
+#define META_ZM_MAGIC   0x315A4D53u /* 'SMZ1' */
+#define META_ZM_SECTORS (STAMPDB_META_RESERVED / META_SECTOR_BYTES > 3u ? STAMPDB_META_RESERVED / META_SECTOR_BYTES - 3u : 0u)
+#define META_ZM_CHUNK   (META_PAGE_BYTES - 4u)
+#define META_ZM_BLOOM_BITS 0x80u /* series-set tag (exact counts are <= 15) */
+#define META_ZM_BLOOM_RAW  0x81u
+#define META_ZM_CAP     ((META_ZM_SECTORS * (META_SECTOR_BYTES / META_PAGE_BYTES) - (META_ZM_SECTORS ? 1u : 0u)) * META_ZM_CHUNK)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t seg_count;
+  uint32_t head_idx; // head segment at save time (unsealed, so recorded as no footer)
+  uint32_t head_seq;
+  uint32_t bytes;    // stream length
+  uint32_t crc;      // CRC32C over the header with crc=0
+} meta_zm_hdr_t;
 
 static int page_all_ff(const uint8_t *p){ for (size_t i=0;i<META_PAGE_BYTES;i++){ if (p[i]!=0xFF) return 0; } return 1; }
 
-static int read_record(uint32_t base_addr, void *dst, size_t len){
+static int read_record(stampdb_state_t *s, uint32_t base_addr, void *dst, size_t len){
   uint8_t page[META_PAGE_BYTES];
-  if (platform_flash_read(base_addr, page, sizeof(page))!=0) return -1;
+  if (flash_read(s, base_addr, page, sizeof(page))!=0) return -1;
   if (page_all_ff(page)) return -1; // treat erased as missing
   if (len > sizeof(page)) return -1;
   memcpy(dst, page, len);
   return 0;
 }
 
-static int write_record(uint32_t base_addr, const void *src, size_t len){
-  if (len > META_PAGE_BYTES) return -1;
-  uint8_t page[META_PAGE_BYTES]; memset(page, 0xFF, sizeof(page)); memcpy(page, src, len);
-  if (platform_flash_erase_4k(base_addr)!=0) return -1;
-  return platform_flash_program_256(base_addr, page);
+/*
+ * Record logs: each record is one 256 B page `meta_rec_hdr_t | payload`, appended
+ * at the log's cursor. A sector is erased only when the cursor enters it, so the
+ * newest record always survives in another sector (snapshots) or is rewritten
+ * right after the erase (head hint, a single-sector log of hints only).
+ */
+#define META_LOG_MAGIC 0x314C4D53u /* 'SML1' */
+#define META_PAGES_PER_SECTOR (META_SECTOR_BYTES / META_PAGE_BYTES)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t crc; // CRC32C over seq and payload
+  uint32_t seq; // append order (wrap-safe compare)
+} meta_rec_hdr_t;
+
+/** @brief Geometry of one log: `sectors` consecutive meta sectors from `first`. */
+typedef struct { uint32_t first, sectors; } meta_log_geo_t;
+static const meta_log_geo_t LOG_SNAP = { 0u, 2u };
+static const meta_log_geo_t LOG_HINT = { 2u, 1u };
+
+static inline uint32_t log_page_addr(const stampdb_state_t *s, meta_log_geo_t g, uint32_t page){ return meta_base(s) + g.first*META_SECTOR_BYTES + page*META_PAGE_BYTES; }
+static uint32_t rec_crc(const uint8_t *page, size_t len){ return crc32c(page + 8, 4u + len); } // seq + payload
+
+/**
+ * @brief Find the newest valid record and the append cursor; copies the newest
+ * payload to `dst` when non-NULL. @return 0 when a record was found.
+ */
+static int log_scan(stampdb_state_t *s, meta_log_geo_t g, meta_log_t *lg, void *dst, size_t len){
+  uint32_t pages = g.sectors*META_PAGES_PER_SECTOR; bool found = false;
+  lg->next_page = 0; lg->next_seq = 0; lg->scanned = true;
+  for (uint32_t p=0;p<pages;p++){
+    uint8_t page[META_PAGE_BYTES]; meta_rec_hdr_t h;
+    if (flash_read(s, log_page_addr(s, g, p), page, sizeof(page))!=0) continue;
+    memcpy(&h, page, sizeof(h));
+    if (h.magic != META_LOG_MAGIC || rec_crc(page, len) != h.crc) continue;
+    if (found && (int32_t)(h.seq - (lg->next_seq - 1u)) <= 0) continue;
+    found = true; lg->next_seq = h.seq + 1u; lg->next_page = (uint16_t)((p + 1u) % pages);
+    if (dst) memcpy(dst, page + sizeof(h), len);
+  }
+  return found ? 0 : -1;
+}
+
+/** @brief Append one record at the cursor, erasing a sector only when the cursor enters it. */
+static int log_append(stampdb_state_t *s, meta_log_geo_t g, meta_log_t *lg, const void *src, size_t len){
+  if (sizeof(meta_rec_hdr_t) + len > META_PAGE_BYTES) return -1;
+  if (!lg->scanned) log_scan(s, g, lg, NULL, len);
+  uint32_t pages = g.sectors*META_PAGES_PER_SECTOR, p = lg->next_page % pages;
+  uint8_t page[META_PAGE_BYTES];
+  // skip pages a torn append left non-blank; the sector start is always erased first
+  for (uint32_t k=0; p % META_PAGES_PER_SECTOR && k<META_PAGES_PER_SECTOR; k++, p = (p + 1u) % pages){
+    if (flash_read(s, log_page_addr(s, g, p), page, sizeof(page))!=0) return -1;
+    if (page_all_ff(page)) break;
+  }
+  if (p % META_PAGES_PER_SECTOR == 0 && flash_erase_4k(s, log_page_addr(s, g, p))!=0) return -1;
+  meta_rec_hdr_t h = { META_LOG_MAGIC, 0, lg->next_seq };
+  memset(page, 0xFF, sizeof(page)); memcpy(page, &h, sizeof(h)); memcpy(page + sizeof(h), src, len);
+  h.crc = rec_crc(page, len); memcpy(page, &h, sizeof(h));
+  if (flash_program_256(s, log_page_addr(s, g, p), page)!=0) return -1;
+  lg->next_page = (uint16_t)((p + 1u) % pages); lg->next_seq++;
+  return 0;
 }
 
-/** @brief Load newest valid snapshot (A/B); 0 on success. */
-int meta_load_snapshot(stampdb_snapshot_t *out){
-  stampdb_snapshot_t a={0}, b={0}; int va=0, vb=0;
-  if (read_record(meta_snap_a_base(), &a, sizeof(a))==0){ uint32_t c=a.crc; a.crc=0; if (crc32c(&a,sizeof(a))==c) { a.crc=c; va=1; } }
-  if (read_record(meta_snap_b_base(), &b, sizeof(b))==0){ uint32_t c=b.crc; b.crc=0; if (crc32c(&b,sizeof(b))==c) { b.crc=c; vb=1; } }
-  if (!va && !vb) return -1;
-  *out = (!vb || (va && a.seg_seq_head >= b.seg_seq_head)) ? a : b;
+/** @brief Load the newest valid snapshot record; 0 on success. */
+int meta_load_snapshot(stampdb_state_t *s, stampdb_snapshot_t *out){
+  stampdb_snapshot_t rec;
+  if (log_scan(s, LOG_SNAP, &s->meta_snap_log, &rec, sizeof(rec))!=0) return -1;
+  uint32_t c = rec.crc; rec.crc = 0; if (crc32c(&rec, sizeof(rec))!=c) return -1;
+  rec.crc = c; *out = rec;
   return 0;
 }
 
-/** @brief Save snapshot by toggling A/B target based on seg_seq_head parity. */
-int meta_save_snapshot(const stampdb_snapshot_t *snap){
-  stampdb_snapshot_t s=*snap; s.crc=0; s.crc=crc32c(&s,sizeof(s));
-  uint32_t base = (snap->seg_seq_head & 1u) ? meta_snap_a_base() : meta_snap_b_base();
-  return write_record(base, &s, sizeof(s));
+/** @brief Append a snapshot record to the snapshot log (sectors 0..1). */
+int meta_save_snapshot(stampdb_state_t *s, const stampdb_snapshot_t *snap){
+  stampdb_snapshot_t rec=*snap; rec.crc=0; rec.crc=crc32c(&rec,sizeof(rec));
+  return log_append(s, LOG_SNAP, &s->meta_snap_log, &rec, sizeof(rec));
 }
 
-/** @brief Load ring head hint record with CRC; 0 on success. */
-int meta_load_head_hint(uint32_t *addr_out, uint32_t *seq_out){
-  struct {uint32_t addr; uint32_t seq; uint32_t crc;} h;
-  if (read_record(meta_head_base(), &h, sizeof(h))!=0) return -1;
-  uint32_t c=h.crc; h.crc=0; if (crc32c(&h,sizeof(h))!=c) return -1; *addr_out=h.addr; *seq_out=h.seq; return 0;
+typedef struct {uint32_t addr; uint32_t seq;} meta_hint_t;
+
+/** @brief Load the newest ring head hint record; 0 on success. */
+int meta_load_head_hint(stampdb_state_t *s, uint32_t *addr_out, uint32_t *seq_out){
+  meta_hint_t h;
+  if (log_scan(s, LOG_HINT, &s->meta_hint_log, &h, sizeof(h))!=0) return -1;
+  *addr_out=h.addr; *seq_out=h.seq; return 0;
 }
 
-/** @brief Save ring head hint in its dedicated sector. */
-int meta_save_head_hint(uint32_t addr, uint32_t seq){
-  struct {uint32_t addr; uint32_t seq; uint32_t crc;} h={addr,seq,0}; h.crc=crc32c(&h,sizeof(h));
-  return write_record(meta_head_base(), &h, sizeof(h));
+/** @brief Append a ring head hint to the hint log (sector 2). */
+int meta_save_head_hint(stampdb_state_t *s, uint32_t addr, uint32_t seq){
+  meta_hint_t h={addr,seq};
+  return log_append(s, LOG_HINT, &s->meta_hint_log, &h, sizeof(h));
+}
+
+/** @brief Checkpoint stream cursor; `s == NULL` only counts bytes (sizing pass). */
+typedef struct {
+  stampdb_state_t *s;
+  uint32_t addr;  // next stream page
+  uint32_t bytes; // stream bytes produced/consumed
+  uint32_t fill;  // cursor within `page`
+  bool ok;
+  uint8_t page[META_PAGE_BYTES];
+} zm_stream_t;
+
+static void zs_flush(zm_stream_t *z){
+  if (!z->s || !z->fill) return;
+  memset(z->page + z->fill, 0xFF, META_ZM_CHUNK - z->fill);
+  uint32_t c = crc32c(z->page, META_ZM_CHUNK); memcpy(z->page + META_ZM_CHUNK, &c, 4);
+  if (flash_program_256(z->s, z->addr, z->page)!=0) z->ok = false;
+  z->addr += META_PAGE_BYTES; z->fill = 0;
+}
+static void zs_put(zm_stream_t *z, uint8_t b){
+  if (z->bytes >= META_ZM_CAP){ z->ok = false; return; }
+  z->bytes++;
+  if (!z->s) return;
+  z->page[z->fill++] = b;
+  if (z->fill == META_ZM_CHUNK) zs_flush(z);
+}
+/** @brief Inverse of codec_zigzag(). */
+static inline int32_t zz_dec(uint32_t v){ return (int32_t)(v >> 1) ^ -(int32_t)(v & 1u); }
+static void zs_var(zm_stream_t *z, uint32_t v){ while (v >= 0x80u){ zs_put(z, (uint8_t)(v | 0x80u)); v >>= 7; } zs_put(z, (uint8_t)v); }
+
+static uint8_t zs_get(zm_stream_t *z){
+  if (!z->ok) return 0;
+  if (z->fill == META_ZM_CHUNK || z->bytes == 0){
+    uint32_t c;
+    if (z->bytes >= META_ZM_CAP || flash_read(z->s, z->addr, z->page, META_PAGE_BYTES)!=0){ z->ok = false; return 0; }
+    memcpy(&c, z->page + META_ZM_CHUNK, 4);
+    if (crc32c(z->page, META_ZM_CHUNK) != c){ z->ok = false; return 0; }
+    z->addr += META_PAGE_BYTES; z->fill = 0;
+  }
+  z->bytes++;
+  return z->page[z->fill++];
+}
+static uint32_t zs_get_var(zm_stream_t *z){
+  uint32_t v = 0;
+  for (uint32_t sh=0; sh<35u && z->ok; sh+=7){ uint8_t b = zs_get(z); v |= (uint32_t)(b & 0x7Fu) << sh; if (!(b & 0x80u)) return v; }
+  z->ok = false; return 0;
+}
+
+/**
+ * @brief Encode one entry per segment: block count (0 = no footer on flash), then for sealed segments varints of
+ * (head_seq - seqno), zigzag t_min delta to the previous sealed entry and
+ * (t_max - t_min), then the series set: the id count and u8 ids for an exact bitmap;
+ * for a Bloom filter META_ZM_BLOOM_BITS and its set bit positions the same way, or
+ * META_ZM_BLOOM_RAW and the 32 filter bytes when that is shorter.
+ */
+static void zm_encode(zm_stream_t *z, const stampdb_state_t *s, uint32_t head_idx){
+  uint32_t prev_t = 0;
+  for (uint32_t i=0;i<s->seg_count && z->ok;i++){
+    const seg_summary_t *sm = &s->segs[i];
+    if (i == head_idx || !sm->valid || sm->block_count==0){ zs_put(z, 0); continue; }
+    if (sm->block_count > STAMPDB_DATA_PAGES_PER_SEG){ z->ok = false; return; }
+    zs_put(z, (uint8_t)sm->block_count);
+    zs_var(z, s->head.seg_seqno - sm->seg_seqno); zs_var(z, codec_zigzag((int32_t)(sm->t_min - prev_t))); zs_var(z, sm->t_max - sm->t_min);
+    prev_t = sm->t_min;
+    uint32_t n = 0;
+    for (uint32_t b=0;b<STAMPDB_SERIES_FILTER_BYTES;b++) n += (uint32_t)__builtin_popcount(sm->series_filter[b]);
+    if (sm->series_bloom && n > STAMPDB_SERIES_FILTER_BYTES){
+      zs_put(z, META_ZM_BLOOM_RAW);
+      for (uint32_t b=0;b<STAMPDB_SERIES_FILTER_BYTES;b++) zs_put(z, sm->series_filter[b]);
+      continue;
+    }
+    if (sm->series_bloom) zs_put(z, META_ZM_BLOOM_BITS);
+    zs_put(z, (uint8_t)n); // exact: n <= block_count, one id per series; Bloom: set bit positions
+    for (uint32_t id=0; id<STAMPDB_SERIES_EXACT; id++) if (sm->series_filter[id>>3] & (1u<<(id&7))) zs_put(z, (uint8_t)id);
+  }
+}
+
+/**
+ * @brief Save the zone map of sealed segments as a checkpoint for recovery.
+ * @return 0 when written or when it does not fit (the previous checkpoint stays
+ * valid: recovery only reads more footers); -1 on flash error.
+ */
+int meta_save_zonemap(stampdb_state_t *s){
+  uint32_t head_idx = s->head.addr / STAMPDB_SEG_BYTES;
+  zm_stream_t z; memset(&z, 0, sizeof(z)); z.ok = true;
+  zm_encode(&z, s, head_idx);
+  if (!z.ok || META_ZM_CAP == 0) return 0;
+  uint32_t pages = 1u + (z.bytes + META_ZM_CHUNK - 1u) / META_ZM_CHUNK;
+  uint32_t pages_per_sector = META_SECTOR_BYTES / META_PAGE_BYTES;
+  for (uint32_t k=0; k*pages_per_sector < pages; k++) if (flash_erase_4k(s, meta_zm_base(s) + k*META_SECTOR_BYTES)!=0) return -1;
+  meta_zm_hdr_t h = { META_ZM_MAGIC, s->seg_count, head_idx, s->head.seg_seqno, z.bytes, 0 };
+  memset(&z, 0, sizeof(z)); z.ok = true; z.s = s; z.addr = meta_zm_base(s) + META_PAGE_BYTES;
+  zm_encode(&z, s, head_idx); zs_flush(&z);
+  if (!z.ok || z.bytes != h.bytes) return -1;
+  h.crc = crc32c(&h, sizeof(h));
+  memset(z.page, 0xFF, sizeof(z.page)); memcpy(z.page, &h, sizeof(h));
+  return flash_program_256(s, meta_zm_base(s), z.page); // header last: publishes the checkpoint
+}
+
+/**
+ * @brief Load the zone-map checkpoint into `s->segs` (segments it records without a
+ * footer come back invalid). On failure `s->segs` is partially written; callers rescan.
+ * @return 0 on success with the checkpoint's head segment and seqno; -1 when missing,
+ * torn, or taken with a different ring geometry.
+ */
+int meta_load_zonemap(stampdb_state_t *s, uint32_t *head_idx, uint32_t *head_seq){
+  meta_zm_hdr_t h;
+  if (META_ZM_CAP == 0 || read_record(s, meta_zm_base(s), &h, sizeof(h))!=0) return -1;
+  uint32_t c = h.crc; h.crc = 0;
+  if (h.magic != META_ZM_MAGIC || crc32c(&h, sizeof(h)) != c || h.seg_count != s->seg_count || h.head_idx >= h.seg_count || h.bytes > META_ZM_CAP) return -1;
+  zm_stream_t z; memset(&z, 0, sizeof(z)); z.ok = true; z.s = s; z.addr = meta_zm_base(s) + META_PAGE_BYTES;
+  uint32_t prev_t = 0;
+  for (uint32_t i=0;i<s->seg_count && z.ok;i++){
+    seg_summary_t *sm = &s->segs[i]; memset(sm, 0, sizeof(*sm)); sm->addr_first = i*STAMPDB_SEG_BYTES;
+    uint8_t tag = zs_get(&z);
+    if (tag == 0) continue;
+    if (tag > STAMPDB_DATA_PAGES_PER_SEG){ z.ok = false; break; }
+    sm->block_count = tag;
+    sm->seg_seqno = h.head_seq - zs_get_var(&z); sm->t_min = prev_t = prev_t + (uint32_t)zz_dec(zs_get_var(&z)); sm->t_max = sm->t_min + zs_get_var(&z);
+    uint32_t n = zs_get(&z);
+    if (n == META_ZM_BLOOM_RAW){ sm->series_bloom = true; for (uint32_t b=0;b<STAMPDB_SERIES_FILTER_BYTES;b++) sm->series_filter[b] = zs_get(&z); }
+    else {
+      if (n == META_ZM_BLOOM_BITS){ sm->series_bloom = true; n = zs_get(&z); }
+      while (n-- > 0){ uint8_t id = zs_get(&z); sm->series_filter[id>>3] |= (uint8_t)(1u<<(id&7)); }
+    }
+    sm->valid = true;
+  }
+  if (!z.ok || z.bytes != h.bytes) return -1;
+  *head_idx = h.head_idx; *head_seq = h.head_seq;
+  return 0;
 }
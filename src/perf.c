@@ -0,0 +1,54 @@
+/**
+ * @file perf.c
+ * @brief Optional latency/byte instrumentation: log2 histograms per operation.
+ *
+ * What it owns:
+ *  - `perf_record()` used by the inline flash wrappers and API/phase timers
+ *  - `stampdb_perf_info()` / `stampdb_perf_op_name()` public surface
+ *
+ * Role in system:
+ *  - Attribute write/query latency to flash ops, segment rotation, head hints, GC
+ *
+ * Constraints:
+ *  - Compiled in only with STAMPDB_ENABLE_PERF; enabled per DB by `cfg.perf`
+ *  - Table lives in the workspace (no heap); recording is O(1) with no flash I/O
+ */
+#include "stampdb_internal.h"
+#include <string.h>
+
+static const char *const op_names[STAMPDB_PERF_OP_COUNT] = {
+  "flash_read", "flash_program", "flash_erase", "write", "flush", "query_begin", "query_block",
+  "latest", "aggregate", "snapshot", "gc_step", "rotate", "head_hint", "gc_reclaim",
+};
+
+const char *stampdb_perf_op_name(uint32_t op){ return op < STAMPDB_PERF_OP_COUNT ? op_names[op] : "?"; }
+
+#if STAMPDB_ENABLE_PERF
+/** @brief Bucket for a duration: 0 for <1 µs, else floor(log2(us))+1, clamped. */
+static inline uint32_t perf_bucket(uint64_t us){
+  uint32_t b = 0; while (us){ b++; us >>= 1; }
+  return b < STAMPDB_PERF_BUCKETS ? b : STAMPDB_PERF_BUCKETS - 1u;
+}
+
+void perf_record(stampdb_perf_t *p, uint32_t op, uint64_t t0_us, uint32_t bytes){
+  uint64_t us = platform_micros() - t0_us;
+  stampdb_perf_hist_t *h = &p->ops[op];
+  h->count++; h->total_us += us; h->bytes += bytes;
+  if (us > h->max_us) h->max_us = us > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)us;
+  h->hist[perf_bucket(us)]++;
+}
+
+stampdb_rc stampdb_perf_info(stampdb_t *db, stampdb_perf_t *out, int reset){
+  if (!db || !out) return STAMPDB_EINVAL;
+  stampdb_state_t *s = &db->s;
+  if (!s->perf){ memset(out, 0, sizeof(*out)); return STAMPDB_OK; }
+  *out = *s->perf;
+  if (reset){ memset(s->perf, 0, sizeof(*s->perf)); s->perf->enabled = 1; }
+  return STAMPDB_OK;
+}
+#else
+stampdb_rc stampdb_perf_info(stampdb_t *db, stampdb_perf_t *out, int reset){
+  (void)db; (void)reset; if (out) memset(out, 0, sizeof(*out));
+  return STAMPDB_EINVAL;
+}
+#endif
@@ -3,67 +3,256 @@
  * @brief Range iterator over CRC-verified blocks with zone-map skipping.
  *
  * What it owns:
- *  - Iterator begin/next/end and latest lookup
+ *  - Iterator begin/next/end, latest lookup, and bucketed aggregates
+ *  - Decoded-block LRU cache consulted by the iterator (cfg.block_cache_blocks)
+ *  - Whole-ring block scan for (parallel) offline export
+ *  - Aggregate planner: wide ranges from the rollup tier, edges from raw rows
  *
  * Role in system:
  *  - Streams results in constant RAM (SoA decode per block)
+ *
+ * Constraints:
+ *  - Safe to run on reader threads/cores next to the single writer: zone-map entries,
+ *    page-index entries, the head rollups and latest rows are copied under the
+ *    `zm_seq` seqlock, and a segment is re-validated (same seqno, still holding data)
+ *    after each page read, so a page that GC erased or reused mid-read is dropped
  */
 #include "stampdb_internal.h"
 #include <string.h>
 
-static bool bitmap_has(const uint8_t *bm, uint16_t series){ return (bm[series>>3] & (1u<<(series&7))) != 0; }
+/** @brief Wrap-aware overlap of an index entry's [t0..t0+span] (rounded up) with [t0..t1]. */
+static bool pidx_overlaps(const page_index_t *e, uint32_t t0, uint32_t t1){
+  if (e->span == 0xFFFFu) return true; // span unknown: assume overlap
+  uint32_t last = e->t0 + (uint32_t)e->span * STAMPDB_PIDX_SPAN_UNIT_MS;
+  return ts_in_range(e->t0, t0, t1) || ts_in_range(last, t0, t1) || ts_in_range(t0, e->t0, last);
+}
 
-/** @brief Initialize an iterator over [t0_ms..t1_ms] for a series. */
-stampdb_rc stampdb_query_begin(stampdb_t *db, uint16_t series, uint32_t t0_ms, uint32_t t1_ms, stampdb_it_t *it){
-  if (!db || !it) return STAMPDB_EINVAL;
-  stampdb_state_t *s=&db->s;
+static bool seg_live(const stampdb_state_t *s, const seg_summary_t *sm){
+  return sm->valid && sm->block_count>0 && !(s->concurrent && sm->erase_queued);
+}
+
+/**
+ * @brief Reader copy of segment `phys`' zone-map entry; false when it holds no readable data.
+ * A pending entry (lazy open) is resolved from its footer first; a copy that still says
+ * `pending` came from a concurrent reader's own footer read: skip the page index for it.
+ */
+static bool seg_snapshot(stampdb_state_t *s, uint32_t phys, seg_summary_t *out){
+  uint32_t q;
+  do { q = zm_read_begin(s); *out = s->segs[phys]; } while (zm_read_retry(s, q));
+  if (out->pending) ring_zm_resolve(s, phys, out);
+  return seg_live(s, out);
+}
+
+/** @brief True while segment `phys` still holds lap `seqno` (or is still unread); false (counted) once GC reclaimed or reused it. */
+static bool seg_still(stampdb_state_t *s, uint32_t phys, uint32_t seqno){
+  seg_summary_t sm; uint32_t q;
+  do { q = zm_read_begin(s); sm = s->segs[phys]; } while (zm_read_retry(s, q));
+  if (sm.pending || (seg_live(s, &sm) && sm.seg_seqno == seqno)) return true;
+  stat_add(&s->reader_retries, 1);
+  return false;
+}
+
+/** @brief Reader copy of one page-index entry. */
+static page_index_t pidx_entry(stampdb_state_t *s, uint32_t phys, uint32_t page){
+  page_index_t e; uint32_t q;
+  do { q = zm_read_begin(s); e = s->pidx[phys*STAMPDB_DATA_PAGES_PER_SEG + page]; } while (zm_read_retry(s, q));
+  return e;
+}
+
+/** @brief Wrap-aware overlap of a segment's zone map with [t0..t1]. */
+static bool seg_overlaps(const seg_summary_t *sm, uint32_t t0, uint32_t t1){
+  return ts_in_range(sm->t_min, t0, t1) || ts_in_range(sm->t_max, t0, t1) || ts_in_range(t0, sm->t_min, sm->t_max);
+}
+
+int bcache_init(stampdb_state_t *s, uint32_t slots){
+  s->bc_keys = NULL; s->bc_rows = NULL; s->bc_slots = 0;
+  if (!slots) return 0;
+  s->bc_keys = (bcache_key_t*)ws_alloc(s, sizeof(bcache_key_t)*slots, _Alignof(bcache_key_t));
+  s->bc_rows = (bcache_rows_t*)ws_alloc(s, sizeof(bcache_rows_t)*slots, _Alignof(bcache_rows_t));
+  if (!s->bc_keys || !s->bc_rows) return -1;
+  for (uint32_t i=0;i<slots;i++){ s->bc_keys[i].addr = STAMPDB_BCACHE_FREE; s->bc_keys[i].last_use = 0; }
+  s->bc_slots = slots;
+  return 0;
+}
+
+void bcache_invalidate_segment(stampdb_state_t *s, uint32_t seg_idx){
+  uint32_t lo = seg_idx*STAMPDB_SEG_BYTES, hi = lo + STAMPDB_SEG_BYTES;
+  for (uint32_t i=0;i<s->bc_slots;i++){
+    bcache_key_t *k = &s->bc_keys[i];
+    if (k->addr != STAMPDB_BCACHE_FREE && k->addr >= lo && k->addr < hi){ k->addr = STAMPDB_BCACHE_FREE; k->last_use = 0; }
+  }
+}
+
+/** @brief Cached block at page `addr` of lap `seqno`, or NULL. */
+static bcache_key_t *bcache_find(stampdb_state_t *s, uint32_t addr, uint32_t seqno){
+  for (uint32_t i=0;i<s->bc_slots;i++){
+    bcache_key_t *k = &s->bc_keys[i];
+    if (k->addr == addr && k->seg_seqno == seqno) return k;
+  }
+  return NULL;
+}
+
+/** @brief Keep the iterator's freshly decoded block (before clipping), replacing the least recently used. */
+static void bcache_insert(stampdb_state_t *s, uint32_t addr, uint32_t seqno, const stampdb_it_t *it){
+  uint32_t v = 0;
+  for (uint32_t i=1;i<s->bc_slots && s->bc_keys[v].addr != STAMPDB_BCACHE_FREE;i++)
+    if (s->bc_keys[i].addr == STAMPDB_BCACHE_FREE || s->bc_keys[i].last_use < s->bc_keys[v].last_use) v = i;
+  bcache_key_t *k = &s->bc_keys[v];
+  k->addr = addr; k->seg_seqno = seqno; k->last_use = ++s->bc_tick;
+  k->series = it->series; k->count = it->count_in_block;
+  memcpy(s->bc_rows[v].times, it->times, sizeof(uint32_t)*k->count);
+  memcpy(s->bc_rows[v].values, it->values, sizeof(float)*k->count);
+}
+
+/**
+ * @brief Initialize an iterator over [t0_ms..t1_ms] for a series.
+ *
+ * Walks segments oldest-first from the head at begin time. When the zone map is
+ * sorted (and the window doesn't wrap), a binary search skips to the first
+ * segment whose t_max reaches t0 and iteration stops at the first t_min past t1.
+ * The head and the search read one seqlock-consistent zone map.
+ */
+void query_begin_state(stampdb_state_t *s, uint16_t series, uint32_t t0_ms, uint32_t t1_ms, stampdb_it_t *it){
   memset(it, 0, sizeof(*it));
   it->s = s; it->series = series; it->t0 = t0_ms; it->t1 = t1_ms;
-  it->seg_idx = 0; it->page_in_seg = 0; it->row_idx_in_block = 0; it->count_in_block = 0;
+  it->page_in_seg = 0; it->row_idx_in_block = 0; it->count_in_block = 0;
+  uint32_t q;
+  do {
+    q = zm_read_begin(s);
+    it->seg_idx = 0; it->zm_sorted = 0;
+    it->seg_origin = s->head.addr / STAMPDB_SEG_BYTES;
+    it->head_seqno = s->head.seg_seqno;
+    if (s->zm_sorted && ts_le(t0_ms, t1_ms)){
+      it->zm_sorted = 1;
+      // used segments occupy logical [hi+1-used .. hi]; hi excludes an empty head
+      const seg_summary_t *head = &s->segs[it->seg_origin];
+      uint32_t end = (head->valid && head->block_count>0) ? s->seg_count : s->seg_count - 1u;
+      uint32_t lo = (s->used_seg_count <= end) ? end - s->used_seg_count : 0u, hi = end;
+      while (lo < hi){
+        uint32_t mid = lo + (hi - lo)/2u;
+        if (ts_lt(s->segs[ring_phys(s, it->seg_origin, mid)].t_max, t0_ms)) lo = mid + 1u; else hi = mid;
+      }
+      it->seg_idx = lo;
+    }
+  } while (zm_read_retry(s, q));
+}
+
+stampdb_rc stampdb_query_begin(stampdb_t *db, uint16_t series, uint32_t t0_ms, uint32_t t1_ms, stampdb_it_t *it){
+  if (!db || !it) return STAMPDB_EINVAL;
+  uint64_t pt = perf_begin(&db->s);
+  query_begin_state(&db->s, series, t0_ms, t1_ms, it);
+  perf_end(&db->s, STAMPDB_PERF_QUERY_BEGIN, pt);
   return STAMPDB_OK;
 }
 
+/** @brief First row in [lo, hi) with times[i] > t (or >= t when `incl`); rows are non-decreasing. */
+static uint32_t rows_bound(const uint32_t *times, uint32_t lo, uint32_t hi, uint32_t t, bool incl){
+  while (lo < hi){
+    uint32_t mid = lo + (hi - lo)/2u;
+    if (incl ? times[mid] < t : times[mid] <= t) lo = mid + 1u; else hi = mid;
+  }
+  return lo;
+}
+
+/**
+ * @brief Clip the decoded block to [t0..t1]: [row_idx_in_block, count_in_block) is then
+ * exactly the in-range rows. Binary search when the block is numerically ordered;
+ * a block spanning the u32 wrap is compacted in place instead.
+ */
+static void clip_block(stampdb_it_t *it){
+  uint32_t n = it->count_in_block;
+  if (n == 0 || it->t0 > it->t1){ it->row_idx_in_block = it->count_in_block = 0; return; }
+  if (it->times[0] <= it->times[n-1u]){
+    uint32_t lo = rows_bound(it->times, 0, n, it->t0, true);
+    it->row_idx_in_block = lo;
+    it->count_in_block = (uint16_t)rows_bound(it->times, lo, n, it->t1, false);
+    return;
+  }
+  uint32_t k = 0;
+  for (uint32_t i=0;i<n;i++){
+    if (it->times[i] < it->t0 || it->times[i] > it->t1) continue;
+    it->times[k] = it->times[i]; it->values[k] = it->values[i]; k++;
+  }
+  it->row_idx_in_block = 0; it->count_in_block = (uint16_t)k;
+}
+
 /**
  * @brief Internal: load next matching block into iterator buffers.
  *
  * Notes:
- *  - Uses zone-map (t_min,t_max)+series bitmap to skip irrelevant segments
- *  - Verifies header and payload CRC before decoding
+ *  - Visits segments in seqno order (logical positions from `seg_origin`)
+ *  - Uses zone-map (t_min,t_max)+series set (bitmap or Bloom filter) to skip irrelevant segments
+ *  - With the optional page index, reads only pages of the target series/window
+ *  - Blocks in the block cache are served from RAM (same page and lap: same content)
+ *  - Verifies header and payload CRC before decoding; the block is clipped to the window
+ *  - Works on seqlock copies of the zone map; a segment reclaimed or reused since it
+ *    was entered (or written in a lap after begin) is skipped rather than misread
  */
 static bool load_next_block(stampdb_it_t *it){
   stampdb_state_t *s = it->s;
   uint64_t visited_pages = 0;
   const uint64_t max_pages = (uint64_t)s->seg_count * (uint64_t)STAMPDB_DATA_PAGES_PER_SEG;
   while (it->seg_idx < s->seg_count){
-    seg_summary_t *sm = &s->segs[it->seg_idx];
+    uint32_t phys = ring_phys(s, it->seg_origin, it->seg_idx);
+    seg_summary_t sm;
+    bool live = seg_snapshot(s, phys, &sm);
+    // GC overtook the iterator: the slot was reclaimed or reused since its first page was read
+    if (it->page_in_seg > 0 && (!live || sm.seg_seqno != it->cur_seqno)){ stat_add(&s->reader_retries, 1); it->seg_idx++; it->page_in_seg=0; continue; }
+    // a lap written after begin would break seqno order
+    if (live && (int32_t)(sm.seg_seqno - it->head_seqno) > 0){ it->seg_idx++; it->page_in_seg=0; continue; }
+    it->cur_seqno = sm.seg_seqno;
+    // sorted zone map: every later segment starts past t1 as well
+    if (it->zm_sorted && live && ts_lt(it->t1, sm.t_min)){ it->seg_idx = s->seg_count; return false; }
     // --- Zone-map skip (wrap-aware) ----------------------------------------
-    if (!sm->valid || sm->block_count==0 || !bitmap_has(sm->series_bitmap, it->series)) { it->seg_idx++; it->page_in_seg=0; continue; }
+    if (!live || !series_set_has(sm.series_filter, sm.series_bloom, it->series)) { it->seg_idx++; it->page_in_seg=0; continue; }
     // If entire seg time window outside query window, skip
-    // We treat overlap if either sm->t_min..sm->t_max intersects it->t0..it->t1 under wrap semantics
-    bool overlap = ts_in_range(sm->t_min, it->t0, it->t1) || ts_in_range(sm->t_max, it->t0, it->t1) || ts_in_range(it->t0, sm->t_min, sm->t_max);
-    if (!overlap){
+    // We treat overlap if either sm.t_min..sm.t_max intersects it->t0..it->t1 under wrap semantics
+    if (!seg_overlaps(&sm, it->t0, it->t1)){
       it->seg_idx++; it->page_in_seg=0; continue;
     }
     // scan pages within seg
     while (it->page_in_seg < STAMPDB_DATA_PAGES_PER_SEG){
       if (++visited_pages > (max_pages + 1)) { return false; }
-      uint32_t addr = sm->addr_first + it->page_in_seg*STAMPDB_PAGE_BYTES;
+      if (s->pidx && !sm.pending){
+        // page index: stop at the first unwritten page, skip other series/windows without I/O
+        page_index_t e = pidx_entry(s, phys, it->page_in_seg);
+        if (e.series == STAMPDB_PIDX_EMPTY) break;
+        if (e.series != it->series || !pidx_overlaps(&e, it->t0, it->t1)){ it->page_in_seg++; stat_add(&s->pidx_skipped_pages, 1); continue; }
+      }
+      uint32_t addr = sm.addr_first + it->page_in_seg*STAMPDB_PAGE_BYTES;
+      bcache_key_t *c = s->bc_slots ? bcache_find(s, addr, sm.seg_seqno) : NULL;
+      if (c){
+        // decoded before: no flash read, CRC or decode (another series' block is just skipped)
+        it->page_in_seg++;
+        if (c->series != it->series) continue;
+        c->last_use = ++s->bc_tick; // only served blocks count as used
+        const bcache_rows_t *r = &s->bc_rows[c - s->bc_keys];
+        memcpy(it->times, r->times, sizeof(uint32_t)*c->count);
+        memcpy(it->values, r->values, sizeof(float)*c->count);
+        it->count_in_block = c->count; it->t0_block = r->times[0];
+        s->bc_hits++;
+        clip_block(it);
+        return true;
+      }
       block_header_t h; uint8_t page[STAMPDB_PAGE_BYTES];
-      if (platform_flash_read(addr, page, STAMPDB_PAGE_BYTES)!=0) { it->seg_idx++; it->page_in_seg=0; break; }
+      // unreadable/unpublished page or bad payload ends this segment (advanced below)
+      if (flash_read_shared(s, addr, page, STAMPDB_PAGE_BYTES)!=0) break;
+      if (!seg_still(s, phys, sm.seg_seqno)) break; // the copy may mix laps: drop it
       const uint8_t *payload = page;
       const uint8_t *hdr = page + STAMPDB_PAYLOAD_BYTES;
-      if (!codec_unpack_header(&h, hdr)) { it->seg_idx++; it->page_in_seg=0; break; }
+      if (!codec_unpack_header(&h, hdr)) break;
       it->page_in_seg++;
       if (h.series != it->series) continue; // skip CRC for non-target series
-      if (crc32c(payload, STAMPDB_PAYLOAD_BYTES) != h.payload_crc){ s->crc_errors++; it->seg_idx++; it->page_in_seg=0; break; }
+      if (h.count > STAMPDB_BLOCK_MAX_ROWS || crc32c(payload, STAMPDB_PAYLOAD_BYTES) != h.payload_crc ||
+          !codec_decode_payload(payload, &h, it->deltas, it->values)){ stat_add(&s->crc_errors, 1); break; }
       it->count_in_block = h.count;
       it->dt_bits = h.dt_bits;
       it->t0_block = h.t0_ms;
       it->bias = h.bias; it->scale = h.scale;
-      codec_decode_payload(payload, h.dt_bits, it->deltas, it->qvals, h.count);
-      // reconstruct times and values
-      uint32_t t = h.t0_ms; for (uint16_t i=0;i<h.count;i++){ t += it->deltas[i]; it->times[i]=t; it->values[i] = it->bias + it->scale * (float)it->qvals[i]; }
-      it->row_idx_in_block = 0;
+      // reconstruct times (values were decoded in place)
+      codec_prefix_sum(it->times, it->deltas, h.count, h.t0_ms);
+      if (s->bc_slots){ bcache_insert(s, addr, sm.seg_seqno, it); s->bc_misses++; }
+      clip_block(it);
       return true;
     }
     // reached end of segment without finding a matching/valid block; advance to next segment
@@ -73,62 +262,350 @@ static bool load_next_block(stampdb_it_t *it){
   return false;
 }
 
+/** @brief Make sure the iterator holds unread in-range rows; false when exhausted. */
+static bool fill_rows(stampdb_it_t *it){
+  while (it->row_idx_in_block >= it->count_in_block){
+    uint64_t pt = perf_begin((stampdb_state_t*)it->s);
+    bool more = load_next_block(it);
+    perf_end((stampdb_state_t*)it->s, STAMPDB_PERF_QUERY_BLOCK, pt);
+    if (!more) return false;
+  }
+  return true;
+}
+
 /** @brief Step iterator and deliver next row in range; false when exhausted. */
 bool stampdb_next(stampdb_it_t *it, uint32_t *ts_ms, float *val){
-  while (1){
-    if (it->row_idx_in_block < it->count_in_block){
-      uint32_t t = it->times[it->row_idx_in_block];
-      float v    = it->values[it->row_idx_in_block];
-      it->row_idx_in_block++;
-      if (t < it->t0 || t > it->t1) continue;
-      if (ts_ms) *ts_ms = t; if (val) *val = v; return true;
+  if (!fill_rows(it)) return false;
+  uint32_t i = it->row_idx_in_block++;
+  if (ts_ms) *ts_ms = it->times[i]; if (val) *val = it->values[i];
+  return true;
+}
+
+/** @brief Attach (or detach, cap 0) a caller buffer that stampdb_next_batch() coalesces into. */
+void stampdb_query_set_buffer(stampdb_it_t *it, uint32_t *ts_buf, float *val_buf, size_t cap){
+  if (!ts_buf || !val_buf) cap = 0;
+  it->buf_ts = ts_buf; it->buf_vals = val_buf; it->buf_cap = (uint32_t)(cap > 0xFFFFFFFFu ? 0xFFFFFFFFu : cap);
+}
+
+/** @brief Copy up to `cap` next rows across blocks into caller columns; rows copied (0 = exhausted). */
+size_t stampdb_query_export(stampdb_it_t *it, uint32_t *ts, float *vals, size_t cap){
+  if (!it || !ts || !vals) return 0;
+  size_t k = 0;
+  while (k < cap && fill_rows(it)){
+    size_t m = it->count_in_block - it->row_idx_in_block;
+    if (m > cap - k) m = cap - k;
+    memcpy(ts + k, &it->times[it->row_idx_in_block], m*sizeof(uint32_t));
+    memcpy(vals + k, &it->values[it->row_idx_in_block], m*sizeof(float));
+    it->row_idx_in_block += (uint32_t)m; k += m;
+  }
+  return k;
+}
+
+/** @brief Iterator size for opaque allocation (ctypes and other FFI bindings). */
+size_t stampdb_it_size(void){ return sizeof(stampdb_it_t); }
+
+/**
+ * @brief Next run of in-range rows as SoA slices.
+ *
+ * Without a buffer the slices alias the iterator's decoded block (one block per
+ * call). With one, rows are copied across blocks up to min(buffer cap,
+ * read_batch_rows). Slices stay valid until the next call on the iterator.
+ */
+bool stampdb_next_batch(stampdb_it_t *it, const uint32_t **ts, const float **vals, size_t *n){
+  if (!it || !ts || !vals || !n) return false;
+  *n = 0;
+  if (!it->buf_cap){
+    if (!fill_rows(it)) return false;
+    *ts = &it->times[it->row_idx_in_block]; *vals = &it->values[it->row_idx_in_block];
+    *n = it->count_in_block - it->row_idx_in_block;
+    it->row_idx_in_block = it->count_in_block;
+    return true;
+  }
+  stampdb_state_t *s = it->s;
+  size_t cap = it->buf_cap < s->read_batch_rows ? it->buf_cap : s->read_batch_rows;
+  size_t k = stampdb_query_export(it, it->buf_ts, it->buf_vals, cap);
+  *ts = it->buf_ts; *vals = it->buf_vals; *n = k;
+  return k > 0;
+}
+
+stampdb_rc stampdb_scan_begin(stampdb_t *db, stampdb_scan_t *sc){
+  if (!db || !sc) return STAMPDB_EINVAL;
+  stampdb_state_t *s = &db->s; uint32_t q;
+  do { q = zm_read_begin(s); sc->origin = s->head.addr / STAMPDB_SEG_BYTES; sc->head_seqno = s->head.seg_seqno; } while (zm_read_retry(s, q));
+  sc->segs = s->seg_count;
+  return STAMPDB_OK;
+}
+
+/** @brief Every readable block of positions [pos0, pos1): same page walk and checks as load_next_block, any series. */
+stampdb_rc stampdb_scan_range(stampdb_t *db, const stampdb_scan_t *sc, uint32_t pos0, uint32_t pos1, stampdb_scan_fn fn, void *user){
+  if (!db || !sc || !fn || sc->segs != db->s.seg_count) return STAMPDB_EINVAL;
+  stampdb_state_t *s = &db->s;
+  if (pos1 > sc->segs) pos1 = sc->segs;
+  uint32_t deltas[STAMPDB_BLOCK_MAX_ROWS], times[STAMPDB_BLOCK_MAX_ROWS]; float vals[STAMPDB_BLOCK_MAX_ROWS];
+  for (uint32_t pos=pos0; pos<pos1; pos++){
+    uint32_t phys = ring_phys(s, sc->origin, pos);
+    seg_summary_t sm;
+    if (!seg_snapshot(s, phys, &sm) || (int32_t)(sm.seg_seqno - sc->head_seqno) > 0) continue;
+    for (uint32_t p=0; p<STAMPDB_DATA_PAGES_PER_SEG; p++){
+      uint32_t addr = sm.addr_first + p*STAMPDB_PAGE_BYTES;
+      block_header_t h; uint8_t page[STAMPDB_PAGE_BYTES];
+      if (flash_read_shared(s, addr, page, STAMPDB_PAGE_BYTES)!=0 || !seg_still(s, phys, sm.seg_seqno)) break;
+      if (!codec_unpack_header(&h, page + STAMPDB_PAYLOAD_BYTES)) break;
+      if (h.count > STAMPDB_BLOCK_MAX_ROWS || crc32c(page, STAMPDB_PAYLOAD_BYTES) != h.payload_crc ||
+          !codec_decode_payload(page, &h, deltas, vals)){ stat_add(&s->crc_errors, 1); break; }
+      codec_prefix_sum(times, deltas, h.count, h.t0_ms);
+      fn(user, h.series, times, vals, h.count);
     }
-    if (!load_next_block(it)) return false;
   }
+  return STAMPDB_OK;
 }
 
 /** @brief End iterator; currently a no-op (reserved for future). */
 void stampdb_query_end(stampdb_it_t *it){ (void)it; }
 
 /**
- * @brief Find the latest row for a series by scanning newest segments backwards.
+ * @brief Aggregate query window: [t0 .. t0+span] split into buckets of bucket_ms (0 = one).
+ * Only rows in the clip [lo .. hi] count: the whole window, or the part of it one source
+ * (raw ring or rollup tier) answers.
  */
-stampdb_rc stampdb_query_latest(stampdb_t *db, uint16_t series, uint32_t *out_ts_ms, float *out_value){
-  if (!db) return STAMPDB_EINVAL;
-  stampdb_state_t *s = &db->s;
-  // find the newest block for series
-  int32_t best_seg = -1; int32_t best_page = -1; block_header_t best_h;
-  for (int32_t seg=(int32_t)s->seg_count-1; seg>=0; --seg){
-    seg_summary_t *sm=&s->segs[seg];
-    if (!sm->valid || sm->block_count==0 || !bitmap_has(sm->series_bitmap, series)) continue;
-    for (int32_t p=(int32_t)STAMPDB_DATA_PAGES_PER_SEG-1; p>=0; --p){
-      uint32_t addr = sm->addr_first + (uint32_t)p*STAMPDB_PAGE_BYTES;
-      uint8_t hdr[STAMPDB_HEADER_BYTES];
-      platform_flash_read(addr+STAMPDB_PAYLOAD_BYTES, hdr, STAMPDB_HEADER_BYTES);
-      block_header_t h; if (!codec_unpack_header(&h, hdr)) continue;
+typedef struct {
+  uint32_t t0, span, bucket_ms;
+  uint32_t lo, hi;
+  stampdb_agg_t *out;
+} agg_window_t;
+
+/** @brief Bucket index of ts, or false when outside the window or its clip. */
+static bool agg_bucket_of(const agg_window_t *w, uint32_t ts, uint32_t *bk){
+  uint32_t off = ts - w->t0;
+  if (off > w->span || (uint32_t)(ts - w->lo) > (uint32_t)(w->hi - w->lo)) return false;
+  *bk = w->bucket_ms ? off / w->bucket_ms : 0u;
+  return true;
+}
+
+/** @brief True when [a..b] lies inside the clip and within a single bucket. */
+static bool agg_whole_bucket(const agg_window_t *w, uint32_t a, uint32_t b, uint32_t *bk){
+  uint32_t ba, bb;
+  if (!agg_bucket_of(w, a, &ba) || !agg_bucket_of(w, b, &bb)) return false;
+  if ((uint32_t)(b - w->t0) < (uint32_t)(a - w->t0)) return false;
+  *bk = ba; return ba == bb;
+}
+
+static void agg_add(stampdb_agg_t *b, uint32_t count, float mn, float mx, float sum){
+  if (count == 0) return;
+  if (b->count == 0){ b->min = mn; b->max = mx; b->sum = sum; }
+  else { if (mn < b->min) b->min = mn; if (mx > b->max) b->max = mx; b->sum += sum; }
+  b->count += count;
+}
+
+/**
+ * @brief Raw-ring rows of the clip into the window's buckets, with metadata pushdown.
+ *
+ * Per matching segment (zone map), in order of preference:
+ *  1) Footer rollup (RAM copy for the head segment) when the series' rows in the
+ *     segment fall inside one bucket
+ *  2) Block header aggregates when the block falls inside one bucket
+ *  3) Decode the block and bucket its rows individually
+ * Payload CRC is verified before header aggregates or rows are used. Next to a
+ * concurrent writer, a segment GC reclaims mid-query contributes only the blocks
+ * read before it went.
+ */
+static void agg_raw(stampdb_state_t *s, uint16_t series, const agg_window_t *w){
+  stampdb_agg_t *out = w->out;
+  for (uint32_t seg=0; seg<s->seg_count; seg++){
+    // zone-map entry and, for the head, its RAM rollups from one seqlock section
+    seg_summary_t sm; seg_rollup_table_t rt; bool is_head; uint32_t q;
+    do {
+      q = zm_read_begin(s);
+      sm = s->segs[seg]; is_head = seg == s->head.addr / STAMPDB_SEG_BYTES;
+      if (is_head) rt = s->head_rollups;
+    } while (zm_read_retry(s, q));
+    if (sm.pending) ring_zm_resolve(s, seg, &sm); // never the head
+    if (!seg_live(s, &sm)) continue;
+    if (!series_set_has(sm.series_filter, sm.series_bloom, series) || !seg_overlaps(&sm, w->lo, w->hi)) continue;
+    // 1) segment rollup
+    const seg_rollup_table_t *rp = NULL;
+    if (is_head) rp = &rt;
+    else {
+      if (ring_read_rollups(s, sm.addr_first, &rt)==0) rp = &rt;
+      if (!seg_still(s, seg, sm.seg_seqno)) continue; // reclaimed while reading its footer
+    }
+    const seg_rollup_t *e = NULL;
+    if (rp) for (uint16_t i=0;i<rp->n;i++) if (rp->r[i].series == series){ e = &rp->r[i]; break; }
+    uint32_t bk;
+    if (e && e->rows != STAMPDB_ROLLUP_UNUSABLE && agg_whole_bucket(w, e->t_min, e->t_max, &bk)){
+      agg_add(&out[bk], e->rows, e->min, e->max, e->sum); stat_add(&s->agg_segments_pushdown, 1); continue;
+    }
+    // 2)/3) per block
+    for (uint32_t p=0;p<STAMPDB_DATA_PAGES_PER_SEG;p++){
+      if (s->pidx && !sm.pending){
+        page_index_t pe = pidx_entry(s, seg, p);
+        if (pe.series == STAMPDB_PIDX_EMPTY) break;
+        if (pe.series != series || !pidx_overlaps(&pe, w->lo, w->hi)){ stat_add(&s->pidx_skipped_pages, 1); continue; }
+      }
+      uint8_t page[STAMPDB_PAGE_BYTES]; block_header_t h;
+      if (flash_read_shared(s, sm.addr_first + p*STAMPDB_PAGE_BYTES, page, sizeof(page))!=0) break;
+      if (!seg_still(s, seg, sm.seg_seqno)) break;
+      if (!codec_unpack_header(&h, page + STAMPDB_PAYLOAD_BYTES)) break;
       if (h.series != series) continue;
-      best_seg = seg; best_page = p; best_h = h; break;
+      if (h.count > STAMPDB_BLOCK_MAX_ROWS || crc32c(page, STAMPDB_PAYLOAD_BYTES) != h.payload_crc){ stat_add(&s->crc_errors, 1); break; }
+      uint32_t last = codec_block_last_ts(&h, page);
+      float mn, mx, sum;
+      if (agg_whole_bucket(w, h.t0_ms, last, &bk) && codec_block_aggregate(&h, &mn, &mx, &sum)){
+        agg_add(&out[bk], h.count, mn, mx, sum); stat_add(&s->agg_blocks_pushdown, 1); continue;
+      }
+      uint32_t deltas[STAMPDB_BLOCK_MAX_ROWS]; float vals[STAMPDB_BLOCK_MAX_ROWS];
+      if (!codec_decode_payload(page, &h, deltas, vals)){ stat_add(&s->crc_errors, 1); break; }
+      uint32_t t = h.t0_ms;
+      for (uint16_t i=0;i<h.count;i++){
+        t += deltas[i];
+        if (!agg_bucket_of(w, t, &bk)) continue;
+        agg_add(&out[bk], 1, vals[i], vals[i], vals[i]);
+      }
+      stat_add(&s->agg_blocks_decoded, 1);
     }
-    if (best_seg>=0) break;
   }
-  if (best_seg<0) return STAMPDB_EINVAL;
-  // get last row in that block
-  uint8_t payload[STAMPDB_PAYLOAD_BYTES];
-  uint32_t addr = s->segs[best_seg].addr_first + (uint32_t)best_page*STAMPDB_PAGE_BYTES;
-  platform_flash_read(addr, payload, STAMPDB_PAYLOAD_BYTES);
-  uint32_t t = best_h.t0_ms;
-  if (best_h.dt_bits==8){ const uint8_t *pr=payload; for (uint16_t i=0;i<best_h.count;i++) t += *pr++; }
-  else { const uint8_t *pr=payload; for (uint16_t i=0;i<best_h.count;i++){ t += (uint16_t)(pr[0]|(pr[1]<<8)); pr+=2; } }
-  int16_t q = 0;
-  // load last qval
-  const uint8_t *qptr = payload + ((best_h.dt_bits==8)?best_h.count:(best_h.count*2));
-  q = (int16_t)(qptr[(best_h.count-1)*2] | (qptr[(best_h.count-1)*2+1]<<8));
-  float v = best_h.bias + best_h.scale * (float)q;
-  if (out_ts_ms) *out_ts_ms = t;
+}
+
 /**
- * Hard cap for page scans per iterator call to avoid unbounded loops under
- * unexpected corruption: seg_count * data_pages_per_segment + 1.
+ * @brief Rollup-tier points of the clip into the window's buckets; returns points used.
+ * A point is the rows bucket+0..3 in order (min, max, sum, count); one torn by a power
+ * cut mid-emit is skipped. Several points of one bucket simply add up.
  */
-  if (out_value) *out_value = v;
+static uint32_t agg_tier(stampdb_state_t *s, uint16_t series, const agg_window_t *w, stampdb_it_t *it){
+  uint32_t tb = s->rollup_bucket_ms, ts, bucket = 0, k = 0, used = 0, bk;
+  float v, f[STAMPDB_ROLLUP_FIELDS];
+  query_begin_state(s->tier, series, w->lo, w->hi, it);
+  while (stampdb_next(it, &ts, &v)){
+    uint32_t b = ts - ts % tb, field = ts % tb;
+    if (field != k || (k && b != bucket)){ k = 0; if (field) continue; }
+    bucket = b; f[k++] = v;
+    if (k < STAMPDB_ROLLUP_FIELDS) continue;
+    k = 0;
+    if (agg_bucket_of(w, bucket, &bk)){ agg_add(&w->out[bk], (uint32_t)f[3], f[0], f[1], f[2]); used++; }
+  }
+  return used;
+}
+
+/** @brief First retained row of `series` in seqno order: its oldest row when written in time order. */
+static bool first_row_ts(stampdb_state_t *s, uint16_t series, stampdb_it_t *it, uint32_t *out){
+  float v;
+  query_begin_state(s, series, 0u, 0xFFFFFFFFu, it);
+  return stampdb_next(it, out, &v);
+}
+
+/**
+ * @brief Query planner: the whole tier buckets [*m0, *m1) of [t0..t1] to read from the
+ * rollup tier instead of raw rows, or false to stay on the raw ring.
+ *
+ * Needs output buckets made of whole tier buckets (bucket_ms 0, or a multiple with an
+ * aligned t0) and a numeric (non-wrapping) range. Tier-servable spans, each from the
+ * series' first whole bucket in the tier: the completeness window [ru_lo, ru_hi), and
+ * every bucket before its oldest raw row's bucket ends (joined when they touch). The
+ * widest overlap with the query wins if it covers STAMPDB_ROLLUP_MIN_BUCKETS. Per-series
+ * bounds because blocks of different series publish out of time order across segments.
+ */
+static bool rollup_plan(stampdb_state_t *s, uint16_t series, uint32_t t0, uint32_t t1, uint32_t bucket_ms, stampdb_it_t *it,
+                        uint64_t *m0, uint64_t *m1){
+  uint32_t tb = s->rollup_bucket_ms, lo, hi, raw_t, tier_t, q;
+  if (!s->tier || t0 > t1 || (bucket_ms && (bucket_ms % tb || t0 % tb))) return false;
+  if (!first_row_ts(s->tier, series, it, &tier_t)) return false;
+  do { q = zm_read_begin(s); lo = s->ru_lo; hi = s->ru_hi; } while (zm_read_retry(s, q));
+  uint64_t a = ((uint64_t)t0 + tb - 1u) / tb * tb, b = ((uint64_t)t1 + 1u) / tb * tb; // query's whole buckets [a, b)
+  uint64_t tier_lo = ((uint64_t)tier_t + tb - 1u) / tb * tb;
+  uint64_t old_a = tier_lo, old_b = first_row_ts(s, series, it, &raw_t) ? ((uint64_t)raw_t + tb - 1u) / tb * tb : UINT64_MAX;
+  uint64_t win_a = lo > tier_lo ? lo : tier_lo, win_b = hi;
+  if (old_a < old_b && win_a <= old_b && win_b > old_b) old_b = win_b;
+  uint64_t oa = a > old_a ? a : old_a, ob = b < old_b ? b : old_b, wa = a > win_a ? a : win_a, wb = b < win_b ? b : win_b;
+  if (ob < oa) ob = oa;
+  if (wb < wa) wb = wa;
+  if (ob - oa >= wb - wa){ *m0 = oa; *m1 = ob; } else { *m0 = wa; *m1 = wb; }
+  return *m1 - *m0 >= (uint64_t)STAMPDB_ROLLUP_MIN_BUCKETS * tb;
+}
+
+/**
+ * @brief Bucketed count/min/max/sum: the planner's tier span from rollup points, the
+ * rest (or everything) from the raw ring (see agg_raw).
+ */
+stampdb_rc stampdb_query_aggregate(stampdb_t *db, uint16_t series, uint32_t t0_ms, uint32_t t1_ms, uint32_t bucket_ms,
+                                   stampdb_agg_t *out, uint32_t out_cap, uint32_t *out_n){
+  if (!db || !out_n || (out_cap && !out)) return STAMPDB_EINVAL;
+  stampdb_state_t *s = &db->s;
+  uint64_t pt = perf_begin(s);
+  agg_window_t w = { t0_ms, t1_ms - t0_ms, bucket_ms, t0_ms, t1_ms, out };
+  uint64_t nb = bucket_ms ? (uint64_t)w.span / bucket_ms + 1u : 1u;
+  if (nb > out_cap) return STAMPDB_EINVAL;
+  for (uint32_t i=0;i<(uint32_t)nb;i++){ memset(&out[i], 0, sizeof(out[i])); out[i].bucket_start_ms = t0_ms + i*bucket_ms; }
+  *out_n = (uint32_t)nb;
+  uint64_t m0, m1; stampdb_it_t it; // planner and tier scratch
+  if (rollup_plan(s, series, t0_ms, t1_ms, bucket_ms, &it, &m0, &m1)){
+    agg_window_t tw = w; tw.lo = (uint32_t)m0; tw.hi = (uint32_t)(m1 - 1u);
+    stat_add(&s->agg_rollup_points, agg_tier(s, series, &tw, &it));
+    if (m0 > t0_ms){ w.hi = (uint32_t)(m0 - 1u); agg_raw(s, series, &w); }
+    if (m1 <= t1_ms){ w.lo = (uint32_t)m1; w.hi = t1_ms; agg_raw(s, series, &w); }
+  } else agg_raw(s, series, &w);
+  perf_end(s, STAMPDB_PERF_AGGREGATE, pt);
+  return STAMPDB_OK;
+}
+
+/**
+ * @brief Newest flushed block of `series` on flash: segments newest-first (skipped by their
+ * series set), pages backwards. Only reached for series not in the latest cache, whose rows
+ * are all flushed (unflushed entries are never evicted).
+ */
+bool latest_from_flash(stampdb_state_t *s, uint16_t series, latest_entry_t *out){
+  uint32_t origin, head_pages, head_seq, q;
+  do { q = zm_read_begin(s); origin = s->head.addr / STAMPDB_SEG_BYTES; head_pages = s->head.page_index; head_seq = s->head.seg_seqno; } while (zm_read_retry(s, q));
+  for (uint32_t k=0;k<s->seg_count;k++){
+    uint32_t phys = ring_phys(s, origin, s->seg_count - 1u - k); // newest first
+    seg_summary_t sm;
+    if (!seg_snapshot(s, phys, &sm) || (int32_t)(sm.seg_seqno - head_seq) > 0) continue;
+    if (!series_set_has(sm.series_filter, sm.series_bloom, series)) continue;
+    uint32_t pages = sm.seg_seqno == head_seq ? head_pages : STAMPDB_DATA_PAGES_PER_SEG;
+    if (pages > STAMPDB_DATA_PAGES_PER_SEG) pages = STAMPDB_DATA_PAGES_PER_SEG;
+    for (uint32_t p=pages; p-- > 0; ){
+      if (s->pidx && !sm.pending){
+        page_index_t pe = pidx_entry(s, phys, p);
+        if (pe.series != series){ stat_add(&s->pidx_skipped_pages, 1); continue; }
+      }
+      uint32_t addr = sm.addr_first + p*STAMPDB_PAGE_BYTES;
+      uint8_t page[STAMPDB_PAGE_BYTES]; block_header_t h;
+      if (flash_read_shared(s, addr, page, sizeof(page))!=0) break;
+      if (!seg_still(s, phys, sm.seg_seqno)) break;
+      if (!codec_unpack_header(&h, page + STAMPDB_PAYLOAD_BYTES) || h.series != series) continue;
+      if (h.count == 0 || h.count > STAMPDB_BLOCK_MAX_ROWS || crc32c(page, STAMPDB_PAYLOAD_BYTES) != h.payload_crc){ stat_add(&s->crc_errors, 1); continue; }
+      out->ts = codec_block_last_ts(&h, page); out->value = codec_block_last_value(&h, page);
+      out->page_addr = addr; out->series = series; out->valid = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief Latest row for a series: a RAM lookup in the latest cache, else a flash lookup.
+ *
+ * Includes rows still staged in an open builder (their value is not yet
+ * quantized); EINVAL when the series has no retained rows. A flash lookup by the
+ * single-threaded owner re-caches its result.
+ */
+stampdb_rc stampdb_query_latest(stampdb_t *db, uint16_t series, uint32_t *out_ts_ms, float *out_value){
+  if (!db || series >= STAMPDB_MAX_SERIES) return STAMPDB_EINVAL;
+  stampdb_state_t *s = &db->s;
+  uint64_t pt = perf_begin(s);
+  latest_entry_t e; uint32_t q; bool cached;
+  do {
+    q = zm_read_begin(s);
+    const latest_entry_t *c = latest_find(s, series);
+    cached = c != NULL; if (cached) e = *c;
+  } while (zm_read_retry(s, q));
+  if (!cached){
+    stat_add(&s->latest_misses, 1);
+    if (!latest_from_flash(s, series, &e)) e.valid = false;
+    else if (!s->concurrent) latest_update(s, series, e.ts, e.value, e.page_addr);
+  }
+  perf_end(s, STAMPDB_PERF_LATEST, pt); // misses that found nothing included: they walked flash
+  if (!e.valid) return STAMPDB_EINVAL;
+  if (out_ts_ms) *out_ts_ms = e.ts;
+  if (out_value) *out_value = e.value;
   return STAMPDB_OK;
 }
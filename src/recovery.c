@@ -1,12 +1,95 @@
 /**
  * @file recovery.c
- * @brief Recovery coordination (currently delegated to ring_scan_and_recover).
+ * @brief Recovery refinements layered on top of ring_scan_and_recover.
+ *
+ * What it owns:
+ *  - Rebuilding the optional per-page index from on-flash block headers
+ *  - Seeding the latest-row cache from the newest blocks (at open, or when a lazy
+ *    open's zone map completes)
  *
  * Notes:
- *  - Kept as a placeholder translation unit for future recovery refinements.
+ *  - Ring head/zone-map recovery itself lives in ring.c (ring_scan_and_recover)
  */
 #include "stampdb_internal.h"
 #include <string.h>
 
-// Recovery on open: handled by ring_scan_and_recover in ring.c
-// This file can contain additional validation logic if needed later.
+/**
+ * @brief Index one segment's pages from their headers and delta columns; stops at the
+ * first invalid header, matching the iterator. Payload CRC is not checked here; the
+ * iterator still verifies every page it reads.
+ */
+void recovery_index_segment(stampdb_state_t *s, uint32_t seg_idx){
+  pidx_clear_segment(s, seg_idx);
+  uint32_t base = seg_idx*STAMPDB_SEG_BYTES;
+  for (uint32_t p=0;p<STAMPDB_DATA_PAGES_PER_SEG;p++){
+    uint32_t addr = base + p*STAMPDB_PAGE_BYTES;
+    uint8_t hdr[STAMPDB_HEADER_BYTES]; block_header_t h;
+    if (flash_read(s, addr+STAMPDB_PAYLOAD_BYTES, hdr, sizeof(hdr))!=0 || !codec_unpack_header(&h, hdr)) break;
+    uint8_t deltas[STAMPDB_PAYLOAD_BYTES];
+    size_t n = h.dt_bits==STAMPDB_DT_DOD ? STAMPDB_PAYLOAD_BYTES : (size_t)h.count * (h.dt_bits==8 ? 1u : 2u);
+    if (n > sizeof(deltas) || flash_read(s, addr, deltas, n)!=0) break;
+    pidx_record(s, addr, &h, codec_block_last_ts(&h, deltas));
+  }
+}
+
+/**
+ * @brief Rebuild the page index by reading each written page's header and delta column.
+ *
+ * Only segments with a live summary (plus the head segment) are visited; pending ones
+ * of a lazy open are indexed when they settle.
+ */
+void recovery_rebuild_page_index(stampdb_state_t *s){
+  if (!s->pidx) return;
+  uint32_t head_idx = s->head.addr / STAMPDB_SEG_BYTES;
+  for (uint32_t i=0;i<s->seg_count;i++){
+    const seg_summary_t *sm = &s->segs[i];
+    if (i != head_idx && (!sm->valid || sm->block_count==0)){ pidx_clear_segment(s, i); continue; }
+    recovery_index_segment(s, i);
+  }
+}
+
+/**
+ * @brief Seed the latest cache by walking segments newest-first.
+ *
+ * Within a segment pages are read backwards; a series is settled by its first
+ * (newest) block seen. With exact bitmaps the walk stops once every series present
+ * in any of them is settled, so only the recent tail of the ring is touched in
+ * practice. Bloom segments cannot list their series: the walk reads at most
+ * STAMPDB_LATEST_SEED_BLOOM_SEGS of them and stops at the next one (or when the
+ * cache has no free slot), leaving older series to stampdb_query_latest's flash lookup.
+ * Stopping rather than skipping keeps every seeded entry the newest of its series.
+ */
+void recovery_seed_latest(stampdb_state_t *s){
+  uint8_t want[STAMPDB_SERIES_FILTER_BYTES]; memset(want, 0, sizeof(want));
+  uint32_t bloom_left = 0;
+  for (uint32_t i=0;i<s->seg_count;i++){
+    const seg_summary_t *sm = &s->segs[i];
+    if (!sm->valid || sm->block_count==0) continue;
+    if (sm->series_bloom){ bloom_left++; continue; }
+    for (uint32_t b=0;b<STAMPDB_SERIES_FILTER_BYTES;b++) want[b] |= sm->series_filter[b];
+  }
+  uint32_t origin = s->head.addr / STAMPDB_SEG_BYTES, bloom_budget = STAMPDB_LATEST_SEED_BLOOM_SEGS;
+  for (uint32_t k=0;k<s->seg_count;k++){
+    uint32_t pos = s->seg_count - 1u - k; // newest first
+    uint32_t idx = ring_phys(s, origin, pos);
+    const seg_summary_t *sm = &s->segs[idx];
+    if (!sm->valid || sm->block_count==0) continue;
+    bool pending = sm->series_bloom, left = bloom_left > 0;
+    for (uint32_t b=0;b<STAMPDB_SERIES_FILTER_BYTES;b++){ if (!sm->series_bloom && (sm->series_filter[b] & want[b])) pending = true; if (want[b]) left = true; }
+    if (!left) break;
+    if (sm->series_bloom){ if (!bloom_budget--) break; bloom_left--; }
+    if (!pending) continue;
+    uint32_t pages = (idx == origin) ? s->head.page_index : STAMPDB_DATA_PAGES_PER_SEG;
+    for (uint32_t p=pages; p-- > 0; ){
+      uint32_t addr = idx*STAMPDB_SEG_BYTES + p*STAMPDB_PAGE_BYTES;
+      uint8_t page[STAMPDB_PAGE_BYTES]; block_header_t h;
+      if (flash_read(s, addr, page, sizeof(page))!=0 || !codec_unpack_header(&h, page + STAMPDB_PAYLOAD_BYTES)) continue;
+      if (h.series >= STAMPDB_MAX_SERIES) continue;
+      if (!latest_find(s, h.series)){
+        if (h.count == 0 || h.count > STAMPDB_BLOCK_MAX_ROWS || crc32c(page, STAMPDB_PAYLOAD_BYTES) != h.payload_crc) continue;
+        if (!latest_seed(s, h.series, codec_block_last_ts(&h, page), codec_block_last_value(&h, page), addr)) return;
+      }
+      if (h.series < STAMPDB_SERIES_EXACT) want[h.series>>3] &= (uint8_t)~(1u<<(h.series&7));
+    }
+  }
+}
@@ -4,7 +4,9 @@
  *
  * What it owns:
  *  - Segment footer I/O (CRC-protected), head/tail movement
- *  - Header-last publish; block write path; GC quota
+ *  - Header-last publish; block write path; GC quota and idle-time step (pre-erase)
+ *  - O(1) tail tracking: `tail_seqno` maps to a slot relative to the head
+ *  - Lazy open: head located from the head hint, older zone-map entries settled later
  *
  * Role in system:
  *  - Central storage orchestrator used by writer, recovery, and iterator
@@ -27,11 +29,11 @@ static inline uint32_t align_down(uint32_t x, uint32_t a){return x - (x % a);}
  *
  * Returns: 0 on success; -1 on invalid/missing footer
  */
-static int read_footer(uint32_t seg_base, seg_footer_t *out){
+static int read_footer(stampdb_state_t *s, uint32_t seg_base, seg_footer_t *out){
   uint8_t page[STAMPDB_PAGE_BYTES];
-  if (platform_flash_read(seg_base + (STAMPDB_PAGES_PER_SEG-1)*STAMPDB_PAGE_BYTES, page, sizeof(page)) != 0) return -1;
+  if (flash_read_shared(s, seg_base + (STAMPDB_PAGES_PER_SEG-1)*STAMPDB_PAGE_BYTES, page, sizeof(page)) != 0) return -1;
   uint32_t magic = (uint32_t)page[0] | ((uint32_t)page[1]<<8) | ((uint32_t)page[2]<<16) | ((uint32_t)page[3]<<24);
-  if (magic != STAMPDB_FOOTER_MAGIC) return -1;
+  if (magic != STAMPDB_FOOTER_MAGIC && magic != STAMPDB_FOOTER_MAGIC_BLOOM) return -1;
   memcpy(out, page, sizeof(seg_footer_t));
   // verify crc
   uint32_t crc = out->crc;
@@ -47,27 +49,85 @@ static int read_footer(uint32_t seg_base, seg_footer_t *out){
  *
  * Steps:
  *  1) Build footer with magic and CRC
- *  2) Program last page of the segment
+ *  2) Append the per-series rollup table (own CRC) after the footer struct
+ *  3) Program last page of the segment
  */
-static int write_footer(uint32_t seg_base, const seg_footer_t *footer){
+static int write_footer(stampdb_state_t *s, uint32_t seg_base, const seg_footer_t *footer, const seg_rollup_table_t *rollups){
   uint8_t page[STAMPDB_PAGE_BYTES];
   memset(page, 0xFF, sizeof(page));
   seg_footer_t tmp = *footer;
-  tmp.magic = STAMPDB_FOOTER_MAGIC;
+  if (tmp.magic != STAMPDB_FOOTER_MAGIC_BLOOM) tmp.magic = STAMPDB_FOOTER_MAGIC;
   tmp.crc = 0;
   uint32_t crc = crc32c(&tmp, sizeof(tmp));
   tmp.crc = crc;
   memcpy(page, &tmp, sizeof(tmp));
-  return platform_flash_program_256(seg_base + (STAMPDB_PAGES_PER_SEG-1)*STAMPDB_PAGE_BYTES, page);
+  seg_rollup_table_t rt = *rollups;
+  rt.reserved = 0; rt.crc = 0; rt.crc = crc32c(&rt, sizeof(rt));
+  memcpy(page + sizeof(seg_footer_t), &rt, sizeof(rt));
+  return flash_program_256(s, seg_base + (STAMPDB_PAGES_PER_SEG-1)*STAMPDB_PAGE_BYTES, page);
+}
+
+/** @brief Read the rollup table stored after a segment's footer; 0 on success. */
+int ring_read_rollups(stampdb_state_t *s, uint32_t seg_base, seg_rollup_table_t *out){
+  uint32_t addr = seg_base + (STAMPDB_PAGES_PER_SEG-1)*STAMPDB_PAGE_BYTES + (uint32_t)sizeof(seg_footer_t);
+  if (flash_read_shared(s, addr, out, sizeof(*out)) != 0) return -1;
+  if (out->n > STAMPDB_FOOTER_ROLLUPS) return -1;
+  uint32_t crc = out->crc; out->crc = 0;
+  uint32_t calc = crc32c(out, sizeof(*out));
+  out->crc = crc;
+  return (crc == calc) ? 0 : -1;
+}
+
+/** @brief Physical index of the segment holding `tail_seqno` (O(1): seqnos are contiguous up to the head). */
+static inline uint32_t ring_tail_idx(const stampdb_state_t *s){
+  uint32_t head_idx = s->head.addr / STAMPDB_SEG_BYTES;
+  return (head_idx + s->seg_count - (s->head.seg_seqno - s->tail_seqno)) % s->seg_count;
+}
+
+/**
+ * @brief Clamp `tail_seqno` into the ring's lap and step it past data-free slots.
+ *
+ * Each step is permanent (the tail only moves forward), so the cost amortizes to
+ * O(1) per rotation/reclaim; only the first call after open may walk the ring.
+ */
+static void tail_normalize(stampdb_state_t *s){
+  uint32_t lag_max = s->seg_count - 1u;
+  if ((uint32_t)(s->head.seg_seqno - s->tail_seqno) > lag_max) s->tail_seqno = s->head.seg_seqno - lag_max;
+  if (s->lazy) return; // pending entries may hold the tail: walked once the zone map is complete
+  while (s->tail_seqno != s->head.seg_seqno){
+    const seg_summary_t *sm = &s->segs[ring_tail_idx(s)];
+    if (sm->valid && sm->block_count>0 && sm->seg_seqno==s->tail_seqno) break;
+    s->tail_seqno++;
+  }
+}
+
+/** @brief Fold one published block into the head segment's per-series rollups. */
+static void rollup_add(stampdb_state_t *s, const block_header_t *h, uint32_t last_t){
+  seg_rollup_table_t *rt = &s->head_rollups;
+  seg_rollup_t *e = NULL;
+  for (uint16_t i=0;i<rt->n;i++) if (rt->r[i].series == h->series){ e = &rt->r[i]; break; }
+  if (!e){
+    if (rt->n >= STAMPDB_FOOTER_ROLLUPS) return; // table full: series stays absent
+    e = &rt->r[rt->n++]; memset(e, 0, sizeof(*e)); e->series = h->series; e->t_min = h->t0_ms; e->t_max = last_t;
+  }
+  if (e->rows == STAMPDB_ROLLUP_UNUSABLE) return;
+  float mn, mx, sum;
+  if (!codec_block_aggregate(h, &mn, &mx, &sum)){ e->rows = STAMPDB_ROLLUP_UNUSABLE; return; }
+  if (e->rows == 0 || mn < e->min) e->min = mn;
+  if (e->rows == 0 || mx > e->max) e->max = mx;
+  e->sum = (e->rows == 0) ? sum : e->sum + sum;
+  if (h->t0_ms < e->t_min) e->t_min = h->t0_ms;
+  if (last_t > e->t_max) e->t_max = last_t;
+  e->rows = (uint16_t)(e->rows + h->count);
 }
 
 /**
  * @brief Read a full page (payload+header) and verify header and payload CRC.
  * @return 0 on OK; -1 on header error; -2 on payload CRC error.
  */
-static int read_block(uint32_t page_addr, block_header_t *hout, uint8_t payload[STAMPDB_PAYLOAD_BYTES]){
+static int read_block(stampdb_state_t *s, uint32_t page_addr, block_header_t *hout, uint8_t payload[STAMPDB_PAYLOAD_BYTES]){
   uint8_t page[STAMPDB_PAGE_BYTES];
-  if (platform_flash_read(page_addr, page, sizeof(page))!=0) return -1;
+  if (flash_read(s, page_addr, page, sizeof(page))!=0) return -1;
   // split
   memcpy(payload, page, STAMPDB_PAYLOAD_BYTES);
   uint8_t hdr[STAMPDB_HEADER_BYTES];
@@ -78,128 +138,269 @@ static int read_block(uint32_t page_addr, block_header_t *hout, uint8_t payload[
   return 0;
 }
 
+/** @brief True when the 256 B page at `addr` is still erased (all 0xFF). */
+static bool page_is_blank(stampdb_state_t *s, uint32_t addr){
+  uint8_t page[STAMPDB_PAGE_BYTES];
+  if (flash_read(s, addr, page, sizeof(page))!=0) return false;
+  for (size_t i=0;i<sizeof(page);i++) if (page[i]!=0xFFu) return false;
+  return true;
+}
+
+/**
+ * @brief Rebuild the head segment's zone-map entry and rollups from its pages below
+ * `pages`, stopping at the first invalid one; returns the number accepted.
+ */
+static uint32_t head_probe(stampdb_state_t *s, uint32_t idx, uint32_t pages){
+  uint32_t base = idx*STAMPDB_SEG_BYTES;
+  seg_summary_t *sm = &s->segs[idx];
+  memset(sm, 0, sizeof(*sm)); memset(&s->head_rollups, 0, sizeof(s->head_rollups));
+  sm->addr_first = base; sm->seg_seqno = s->head.seg_seqno; sm->t_min = 0xFFFFFFFFu; sm->t_max = 0; sm->valid = true;
+  uint32_t p = 0;
+  for (; p<pages; p++){
+    block_header_t h; uint8_t payload[STAMPDB_PAYLOAD_BYTES];
+    if (read_block(s, base + p*STAMPDB_PAGE_BYTES, &h, payload)!=0) break;
+    if (h.t0_ms < sm->t_min) sm->t_min = h.t0_ms;
+    uint32_t last_t = codec_block_last_ts(&h, payload);
+    if (last_t > sm->t_max) sm->t_max = last_t;
+    sm->block_count++;
+    series_set_add(sm->series_filter, &sm->series_bloom, h.series);
+    rollup_add(s, &h, last_t);
+  }
+  return p;
+}
+
+/** @brief Zone-map entry of segment `i` from its footer (invalid when missing/corrupt); 0 when one was read. */
+static int footer_summary(stampdb_state_t *s, uint32_t i, seg_summary_t *sm){
+  seg_footer_t f;
+  memset(sm, 0, sizeof(*sm)); sm->addr_first = i*STAMPDB_SEG_BYTES;
+  if (read_footer(s, i*STAMPDB_SEG_BYTES, &f)!=0) return -1;
+  sm->seg_seqno = f.seg_seqno; sm->t_min = f.t_min; sm->t_max = f.t_max; sm->block_count = f.block_count;
+  memcpy(sm->series_filter, f.series_filter, STAMPDB_SERIES_FILTER_BYTES);
+  sm->series_bloom = f.magic == STAMPDB_FOOTER_MAGIC_BLOOM;
+  sm->valid = true;
+  return 0;
+}
+
+/** @brief Rebuild `segs[i]` from the segment's footer at open; 0 when one was read. */
+static int zm_load_footer(stampdb_state_t *s, uint32_t i){
+  if (s->segs[i].pending) s->lazy_left--;
+  s->recovery_footer_reads++;
+  return footer_summary(s, i, &s->segs[i]);
+}
+
+/**
+ * @brief Seed the zone map from the meta checkpoint and read only the footers it
+ * cannot vouch for; false when there is no usable checkpoint.
+ *
+ *  - Forward: segments sealed since the checkpoint follow its head in ring order with
+ *    seqno >= its head seqno; refresh them up to the first other footer (the live head).
+ *    A checkpoint more than a lap old degrades to reading every footer.
+ *  - Backward: GC reclaims oldest-first, so re-check checkpointed segments oldest-first
+ *    until one footer still matches; the ones before it were erased since.
+ */
+static bool zm_from_checkpoint(stampdb_state_t *s){
+  uint32_t ck_idx, ck_seq, k = 0;
+  if (meta_load_zonemap(s, &ck_idx, &ck_seq)!=0) return false;
+  for (; k<s->seg_count; k++){
+    uint32_t i = (ck_idx + k) % s->seg_count;
+    if (zm_load_footer(s, i)!=0 || (int32_t)(s->segs[i].seg_seqno - ck_seq) < 0) break;
+  }
+  for (uint32_t j=k+1; j<s->seg_count; j++){
+    uint32_t i = (ck_idx + j) % s->seg_count;
+    if (!s->segs[i].valid) continue;
+    uint32_t seq = s->segs[i].seg_seqno;
+    if (zm_load_footer(s, i)==0 && s->segs[i].seg_seqno == seq) break;
+  }
+  return true;
+}
+
+/**
+ * @brief Lazy open: place the head from the head hint (or a newer snapshot) plus the
+ * footers sealed since, leaving every other zone-map entry pending.
+ *
+ * The hint is saved at each rotation, so it trails the newest seal by at most the
+ * segments sealed before a cut; they are read forward in seqno order. The result is
+ * cross-checked: the slot found must not hold a newer lap and its predecessor must be
+ * the newest seal. False (the caller scans) without a start point or on any mismatch.
+ */
+static bool zm_lazy_head(stampdb_state_t *s, const stampdb_snapshot_t *snap, uint32_t *head_idx, uint32_t *head_seq){
+  uint32_t ring = s->seg_count*STAMPDB_SEG_BYTES, idx = 0, seq = 0, a, q;
+  if (meta_load_head_hint(s, &a, &q)==0 && a < ring){ idx = a / STAMPDB_SEG_BYTES; seq = q; }
+  if (snap && snap->head_addr < ring && (!seq || (int32_t)(snap->seg_seq_head - seq) > 0)){ idx = snap->head_addr / STAMPDB_SEG_BYTES; seq = snap->seg_seq_head; }
+  if (!seq) return false;
+  for (uint32_t i=0;i<s->seg_count;i++){ seg_summary_t *sm = &s->segs[i]; memset(sm, 0, sizeof(*sm)); sm->addr_first = i*STAMPDB_SEG_BYTES; sm->pending = true; }
+  s->lazy_left = s->seg_count;
+  uint32_t k = 0;
+  for (;; k++, idx = (idx + 1u) % s->seg_count, seq++){
+    if (k == s->seg_count) return false;
+    zm_load_footer(s, idx);
+    if (!s->segs[idx].valid || s->segs[idx].seg_seqno != seq) break;
+  }
+  if (s->segs[idx].valid && (int32_t)(s->segs[idx].seg_seqno - seq) > 0) return false; // start point a lap behind
+  if (k == 0 && seq > 1u){
+    uint32_t prev = (idx + s->seg_count - 1u) % s->seg_count;
+    if (s->segs[prev].pending) zm_load_footer(s, prev);
+    if (!s->segs[prev].valid || s->segs[prev].seg_seqno != seq - 1u) return false;
+  }
+  *head_idx = idx; *head_seq = seq;
+  return true;
+}
+
 /**
  * @brief Recovery entry: rebuild zone map and locate ring head, truncating torn tails.
  *
  * Inputs:
  *  - s: DB state (workspace cursors and config pre-initialized)
  *  - snap_opt: Optional trusted snapshot to seed head/tail/epoch
+ *  - lazy: only locate the head (zm_lazy_head) and leave the rest of the zone map
+ *    pending for ring_recover_step / ring_zm_resolve; falls back to the full build
  *
  * Steps (high level):
- *  1) Scan segment footers to build zone map summary
- *  2) Use snapshot and/or head hint if present
- *  3) Probe tail segment to find first free page; truncate after first invalid
+ *  1) Build the zone map from the meta checkpoint plus footers sealed since, or
+ *     by scanning every segment footer
+ *  2) Place head after the newest sealed segment (snapshot/hint if none sealed)
+ *  3) Probe head segment to find first free page; truncate after first invalid
  */
-int ring_scan_and_recover(stampdb_state_t *s, const stampdb_snapshot_t *snap_opt){
+int ring_scan_and_recover(stampdb_state_t *s, const stampdb_snapshot_t *snap_opt, bool lazy){
   // Build zone map by scanning footers; fallback to deep scan if missing
-  uint32_t flash_bytes = platform_flash_size_bytes();
-  uint32_t usable_bytes = (flash_bytes > STAMPDB_META_RESERVED) ? (flash_bytes - STAMPDB_META_RESERVED) : flash_bytes;
-  s->seg_count = usable_bytes / STAMPDB_SEG_BYTES;
+  s->seg_count = (s->flash_bytes - STAMPDB_META_RESERVED) / STAMPDB_SEG_BYTES; // partition checked by open
   size_t need = sizeof(seg_summary_t) * (size_t)s->seg_count;
   uintptr_t cur = (uintptr_t)s->ws_cur;
   uintptr_t end = (uintptr_t)s->ws_begin + s->ws_size;
   if (cur + need > end) return -1; // insufficient workspace
   s->segs = (seg_summary_t*)s->ws_cur;
   s->ws_cur += need;
-  for (uint32_t i=0;i<s->seg_count;i++){
-    s->segs[i].valid=false;
+  uint32_t head_idx = 0, lazy_seq = 0;
+  s->lazy = lazy && zm_lazy_head(s, snap_opt, &head_idx, &lazy_seq);
+  if (!s->lazy){
+    for (uint32_t i=0;i<s->seg_count;i++) s->segs[i].pending = false; // a failed lazy attempt: rebuilt below
+    s->lazy_left = 0;
+    if (!zm_from_checkpoint(s)) for (uint32_t i=0;i<s->seg_count;i++) zm_load_footer(s, i);
   }
-
   bool any=false;
   s->used_seg_count = 0;
-  for (uint32_t i=0;i<s->seg_count;i++){
-    uint32_t base = i*STAMPDB_SEG_BYTES;
-    seg_footer_t f;
-    if (read_footer(base, &f)==0){
-      seg_summary_t *sm=&s->segs[i];
-      sm->addr_first = base;
-      sm->seg_seqno = f.seg_seqno;
-      sm->t_min = f.t_min;
-      sm->t_max = f.t_max;
-      sm->block_count = f.block_count;
-      memcpy(sm->series_bitmap, f.series_bitmap, STAMPDB_SERIES_BITMAP_BYTES);
-      sm->valid=true; any=true; if (sm->block_count>0) s->used_seg_count++;
-    }
-  }
+  for (uint32_t i=0;i<s->seg_count;i++) if (s->segs[i].valid && s->segs[i].block_count>0) s->used_seg_count++;
 
-  if (snap_opt){
-    // trust snapshot head, but probe tail to ensure consistency
-    s->head.addr = snap_opt->head_addr;
-    s->head.page_index = ((s->head.addr % STAMPDB_SEG_BYTES)/STAMPDB_PAGE_BYTES);
-    s->head.seg_seqno = snap_opt->seg_seq_head;
-    s->tail_seqno = snap_opt->seg_seq_tail;
-    s->epoch_id = snap_opt->epoch_id;
+  // --- Head placement -----------------------------------------------------
+  // Footers are authoritative: the head is the segment after the newest sealed
+  // one. Snapshot seeds epoch/tail; snapshot/hint only place the head while no
+  // segment has been sealed yet (or, lazily, for the forward walk above).
+  uint32_t best_i=0; uint32_t best_seq=0; any=false;
+  if (!s->lazy) for (uint32_t i=0;i<s->seg_count;i++) if (s->segs[i].valid && (!any || s->segs[i].seg_seqno > best_seq)){ any=true; best_seq=s->segs[i].seg_seqno; best_i=i; }
+  s->head.seg_seqno = 1; s->tail_seqno = 1;
+  if (snap_opt){ s->tail_seqno = snap_opt->seg_seq_tail; s->epoch_id = snap_opt->epoch_id; }
+  if (s->lazy){
+    s->head.seg_seqno = lazy_seq;
+    if (!snap_opt) s->tail_seqno = lazy_seq - s->seg_count;
+    s->lazy_origin = head_idx; s->lazy_cursor = 0;
+  } else if (any){
+    head_idx = (best_i + 1) % s->seg_count;
+    s->head.seg_seqno = best_seq + 1;
+    if (!snap_opt) s->tail_seqno = best_seq - (s->seg_count-1);
+  } else if (snap_opt && snap_opt->head_addr < s->seg_count*STAMPDB_SEG_BYTES){
+    head_idx = snap_opt->head_addr / STAMPDB_SEG_BYTES; s->head.seg_seqno = snap_opt->seg_seq_head;
   } else {
-    // Try head hint first
     uint32_t hint_addr=0, hint_seq=0;
-    if (meta_load_head_hint(&hint_addr, &hint_seq)==0){
-      uint32_t usable_bytes = s->seg_count * STAMPDB_SEG_BYTES;
-      if (hint_addr < usable_bytes){
-        s->head.addr = hint_addr;
-        s->head.page_index = ((s->head.addr % STAMPDB_SEG_BYTES)/STAMPDB_PAGE_BYTES);
-        s->head.seg_seqno = hint_seq;
-      }
-    }
-    // pick head as next page after last valid block in newest seg (by footer); if none, probe seg 0 by scanning pages
-    uint32_t best_i=0; uint32_t best_seq=0; any=false;
-    for (uint32_t i=0;i<s->seg_count;i++) if (s->segs[i].valid && (!any || s->segs[i].seg_seqno > best_seq)){ any=true; best_seq=s->segs[i].seg_seqno; best_i=i; }
-    if (any){
-      s->head.seg_seqno = s->segs[best_i].seg_seqno + 1;
-      s->head.addr = best_i*STAMPDB_SEG_BYTES; // will probe for first free page
-      s->head.page_index = 0;
-      s->tail_seqno = best_seq - (s->seg_count-1);
-    } else {
-      // No footers found: treat as possibly fresh or partially written; probe segment 0
-      s->head.seg_seqno = 1;
-      s->tail_seqno = 1;
-      s->head.addr = 0;
-      s->head.page_index = 0;
-      // Build a summary for seg 0 by scanning pages
-      uint32_t base = 0; seg_summary_t *sm=&s->segs[0]; memset(sm,0,sizeof(*sm)); sm->addr_first=0; sm->seg_seqno=1; sm->t_min=0xFFFFFFFFu; sm->t_max=0; sm->block_count=0; sm->valid=true;
-      for (uint32_t p=0;p<STAMPDB_DATA_PAGES_PER_SEG;p++){
-        block_header_t h; uint8_t payload[STAMPDB_PAYLOAD_BYTES];
-        if (read_block(base + p*STAMPDB_PAGE_BYTES, &h, payload)!=0) break;
-        if (h.t0_ms < sm->t_min) sm->t_min = h.t0_ms;
-        uint32_t last_t = h.t0_ms;
-        if (h.dt_bits==8){ const uint8_t *pr=payload; for (uint16_t i=0;i<h.count;i++) last_t += *pr++; }
-        else { const uint8_t *pr=payload; for (uint16_t i=0;i<h.count;i++){ last_t += (uint16_t)(pr[0]|(pr[1]<<8)); pr+=2; } }
-        if (last_t > sm->t_max) sm->t_max = last_t;
-        sm->block_count++;
-        sm->series_bitmap[h.series>>3] |= (1u<<(h.series&7));
-      }
-      s->used_seg_count = (sm->block_count>0) ? 1u : 0u;
-    }
+    if (meta_load_head_hint(s, &hint_addr, &hint_seq)==0 && hint_addr < s->seg_count*STAMPDB_SEG_BYTES){ head_idx = hint_addr / STAMPDB_SEG_BYTES; s->head.seg_seqno = hint_seq; }
   }
-
-  // --- Recovery: probe tail of current head segment ------------------------
-  // Scan pages forward; stop at first invalid header; keep last valid offset.
-  uint32_t cur_seg_base = align_down(s->head.addr, STAMPDB_SEG_BYTES);
-  uint32_t first_free_page = 0;
-  bool had_valid=false; bool broke=false;
-  uint64_t visited_pages = 0;
-  const uint64_t max_pages = (uint64_t)s->seg_count * (uint64_t)STAMPDB_DATA_PAGES_PER_SEG;
-  for (uint32_t p=0;p<STAMPDB_DATA_PAGES_PER_SEG;p++){
-    if (++visited_pages > (max_pages + 1)) { broke=true; break; }
-    block_header_t h; uint8_t payload[STAMPDB_PAYLOAD_BYTES];
-    int r = read_block(cur_seg_base + p*STAMPDB_PAGE_BYTES, &h, payload);
-    if (r!=0){ first_free_page = p; broke=true; break; }
-    had_valid=true;
-    first_free_page = p+1;
+  uint32_t cur_seg_base = head_idx*STAMPDB_SEG_BYTES;
+  seg_summary_t *sm = &s->segs[head_idx];
+  if (sm->valid){
+    // sealed footer from an older lap: power was lost between sealing the
+    // previous segment and erasing this one; finish the rotation's erase
+    flash_erase_4k(s, cur_seg_base);
+    if (sm->block_count>0 && s->used_seg_count>0) s->used_seg_count--;
   }
-  if (broke && had_valid) s->recovery_truncations++;
+
+  // --- Recovery: probe the head segment -----------------------------------
+  // Scan pages forward; stop at first invalid header; keep last valid offset;
+  // rebuild the head segment's zone-map entry from the accepted pages.
+  uint32_t first_free_page = head_probe(s, head_idx, STAMPDB_DATA_PAGES_PER_SEG);
+  if (sm->block_count>0) s->used_seg_count++;
+  if (first_free_page>0 && first_free_page<STAMPDB_DATA_PAGES_PER_SEG) s->recovery_truncations++;
   s->head.page_index = first_free_page;
   s->head.addr = cur_seg_base + first_free_page*STAMPDB_PAGE_BYTES;
   s->last_hint_ms = (uint32_t)platform_millis();
+  // full but unsealed (power lost before the footer), or the first free page is torn
+  // (payload programmed, header not): seal and rotate now rather than program over it
+  if (s->head.page_index >= STAMPDB_DATA_PAGES_PER_SEG || !page_is_blank(s, s->head.addr)) ring_finalize_segment_and_rotate(s);
+  tail_normalize(s);
+  ring_zm_recompute_sorted(s);
+  if (!s->lazy) recovery_seed_latest(s);
   return 0;
 }
 
+/** @brief Lazy open, last entry settled: the tail walk, sort flag and latest seeding open skipped. */
+static void recover_finish(stampdb_state_t *s){
+  zm_write_begin(s);
+  s->lazy = false;
+  tail_normalize(s);
+  ring_zm_recompute_sorted(s);
+  zm_write_end(s);
+  recovery_seed_latest(s);
+}
+
+/** @brief Writer: read pending segment `idx`'s footer, index its pages, then publish the entry. */
+static void zm_settle(stampdb_state_t *s, uint32_t idx){
+  seg_summary_t sm;
+  s->recovery_footer_reads++;
+  footer_summary(s, idx, &sm);
+  if (s->pidx && sm.valid) recovery_index_segment(s, idx); // readers ignore the index of pending segments
+  zm_write_begin(s);
+  s->segs[idx] = sm; s->lazy_left--;
+  if (sm.valid && sm.block_count>0) s->used_seg_count++;
+  zm_write_end(s);
+}
+
+/**
+ * @brief Settle pending entries newest-first (physical slots backwards from the head at
+ * open; slots reused since are skipped), `budget_us` checked before each footer read
+ * after the first.
+ * @return OK once the zone map is complete and finished, EBUSY while entries remain.
+ */
+stampdb_rc ring_recover_step(stampdb_state_t *s, uint32_t budget_us){
+  uint64_t t0 = platform_micros(); bool any = false;
+  while (s->lazy_left && s->lazy_cursor < s->seg_count){
+    uint32_t idx = (s->lazy_origin + s->seg_count - 1u - s->lazy_cursor) % s->seg_count;
+    if (!s->segs[idx].pending){ s->lazy_cursor++; continue; }
+    if (any && platform_micros() - t0 >= budget_us) return STAMPDB_EBUSY;
+    zm_settle(s, idx); s->lazy_cursor++; any = true;
+  }
+  if (s->lazy) recover_finish(s);
+  return STAMPDB_OK;
+}
+
+/**
+ * @brief A query reached pending segment `idx`. Single-threaded the writer's settle runs
+ * (and may finish recovery); concurrent readers read the footer into `out` only, keeping
+ * `pending` set in the copy so they do not trust the page index. The copy stands while
+ * the slot is still pending afterwards: a rotation reusing it publishes before erasing.
+ */
+void ring_zm_resolve(stampdb_state_t *s, uint32_t idx, seg_summary_t *out){
+  if (!s->concurrent){
+    if (s->segs[idx].pending) zm_settle(s, idx);
+    if (s->lazy && !s->lazy_left) recover_finish(s);
+    *out = s->segs[idx];
+    return;
+  }
+  seg_summary_t sm; uint32_t q;
+  footer_summary(s, idx, &sm);
+  do { q = zm_read_begin(s); *out = s->segs[idx]; } while (zm_read_retry(s, q));
+  if (out->pending){ *out = sm; out->pending = true; }
+}
+
+static int gc_erase_segment(stampdb_state_t *s, uint32_t idx);
+static int32_t preerase_candidate(const stampdb_state_t *s);
+
 /**
  * @brief Seal current segment with an aggregated footer and rotate to next segment.
  *
  * Side effects:
  *  - Writes footer; erases next segment; updates zone map entry for new head
+ *  - With write-behind on, also queues the erase of the next data-free segment ahead
  */
 int ring_finalize_segment_and_rotate(stampdb_state_t *s){
+  uint64_t pt = perf_begin(s);
   // gather stats from the segment we are finalizing
   uint32_t base = align_down(s->head.addr, STAMPDB_SEG_BYTES);
   // Build footer directly from in-RAM summary for this segment
@@ -212,33 +413,162 @@ int ring_finalize_segment_and_rotate(stampdb_state_t *s){
     f.t_min = sm->t_min;
     f.t_max = sm->t_max;
     f.block_count = sm->block_count;
-    memcpy(f.series_bitmap, sm->series_bitmap, STAMPDB_SERIES_BITMAP_BYTES);
+    memcpy(f.series_filter, sm->series_filter, STAMPDB_SERIES_FILTER_BYTES);
+    if (sm->series_bloom) f.magic = STAMPDB_FOOTER_MAGIC_BLOOM;
   } else {
     f.t_min = 0xFFFFFFFFu; f.t_max = 0; f.block_count = 0;
-    memset(f.series_bitmap, 0, STAMPDB_SERIES_BITMAP_BYTES);
+    memset(f.series_filter, 0, STAMPDB_SERIES_FILTER_BYTES);
   }
-  f.crc = 0;
-  f.crc = crc32c(&f, sizeof(f));
-  // write footer last page
-  write_footer(base, &f);
+  // write footer last page (CRC computed by write_footer)
+  write_footer(s, base, &f, &s->head_rollups);
 
-  // advance to next segment
+  // advance to next segment; the zone map moves first (readers re-validate against it),
+  // then the erase and head hint reach flash in the same order as before
   uint32_t next_base = (base + STAMPDB_SEG_BYTES) % (s->seg_count*STAMPDB_SEG_BYTES);
-  platform_flash_erase_4k(next_base);
+  uint32_t idx = next_base / STAMPDB_SEG_BYTES;
+  bool pre_erased = s->segs[idx].erased; // reclaimed/pre-erased by GC: no erase on the write path
+  zm_write_begin(s);
+  memset(&s->head_rollups, 0, sizeof(s->head_rollups));
   s->head.seg_seqno++;
   s->head.addr = next_base;
   s->head.page_index = 0;
-  // persist head hint only on segment rotation to reduce wear
-  meta_save_head_hint(s->head.addr, s->head.seg_seqno);
-  s->last_hint_ms = (uint32_t)platform_millis();
-  // update zone map entry
-  uint32_t idx = next_base / STAMPDB_SEG_BYTES;
+  // update zone map entry (the oldest segment is overwritten when the ring is full)
+  if (s->segs[idx].valid && s->segs[idx].block_count>0 && s->used_seg_count>0) s->used_seg_count--;
+  if (s->segs[idx].pending){ s->segs[idx].pending = false; s->lazy_left--; } // lazy open: the oldest lap goes unread
   s->segs[idx].addr_first = next_base;
   s->segs[idx].seg_seqno = s->head.seg_seqno;
-  s->segs[idx].t_min = 0xFFFFFFFFu; s->segs[idx].t_max = 0; s->segs[idx].block_count = 0; memset(s->segs[idx].series_bitmap,0,STAMPDB_SERIES_BITMAP_BYTES); s->segs[idx].valid=true;
+  s->segs[idx].t_min = 0xFFFFFFFFu; s->segs[idx].t_max = 0; s->segs[idx].block_count = 0; memset(s->segs[idx].series_filter,0,STAMPDB_SERIES_FILTER_BYTES); s->segs[idx].series_bloom=false; s->segs[idx].valid=true;
+  s->segs[idx].erased = true; s->segs[idx].erase_lost = false;
+  if (!pre_erased && s->wb.slots) s->segs[idx].erase_queued = true;
+  pidx_clear_segment(s, idx);
+  latest_invalidate_segment(s, idx);
+  bcache_invalidate_segment(s, idx);
+  tail_normalize(s);
+  if (!s->zm_sorted) ring_zm_recompute_sorted(s); // unsorted segment may have aged out
+  zm_write_end(s);
+  if (pre_erased) s->gc_preerase_hits++;
+  else if (flash_erase_4k(s, next_base)!=0) ring_op_lost(s, next_base, true); // redone before the first program
+  // persist head hint only on segment rotation to reduce wear
+  uint64_t ph = perf_begin(s);
+  meta_save_head_hint(s, s->head.addr, s->head.seg_seqno);
+  perf_end(s, STAMPDB_PERF_HEAD_HINT, ph);
+  s->last_hint_ms = (uint32_t)platform_millis();
+  if (s->wb.slots){
+    // write-behind: queue the next data-free segment's erase now, a segment ahead of need
+    int32_t pre = preerase_candidate(s);
+    if (pre >= 0) gc_erase_segment(s, (uint32_t)pre);
+  }
+  perf_end(s, STAMPDB_PERF_ROTATE, pt);
+  return 0;
+}
+
+/**
+ * @brief Recompute `zm_sorted`: used segments must form one run ending at the head
+ * (an empty head is allowed) with non-decreasing t_min and t_max in seqno order.
+ */
+void ring_zm_recompute_sorted(stampdb_state_t *s){
+  if (s->lazy){ s->zm_sorted = false; return; } // pending entries would look like gaps
+  uint32_t origin = s->head.addr / STAMPDB_SEG_BYTES;
+  const seg_summary_t *prev = NULL; bool gap=false, sorted=true; uint32_t used=0;
+  for (uint32_t pos=0; pos<s->seg_count; pos++){
+    const seg_summary_t *sm = &s->segs[ring_phys(s, origin, pos)];
+    if (!sm->valid || sm->block_count==0){ if (prev && pos != s->seg_count-1u) gap=true; continue; }
+    if (gap) sorted=false;
+    if (prev && (ts_lt(sm->t_min, prev->t_min) || ts_lt(sm->t_max, prev->t_max))) sorted=false;
+    prev = sm; used++;
+  }
+  s->zm_sorted = sorted && used == s->used_seg_count;
+}
+
+/** @brief Record a published block in the page index (no-op when disabled). */
+void pidx_record(stampdb_state_t *s, uint32_t page_addr, const block_header_t *h, uint32_t last_ts){
+  if (!s->pidx) return;
+  uint32_t seg = page_addr / STAMPDB_SEG_BYTES, page = (page_addr % STAMPDB_SEG_BYTES) / STAMPDB_PAGE_BYTES;
+  if (seg >= s->seg_count || page >= STAMPDB_DATA_PAGES_PER_SEG) return;
+  uint32_t span = (uint32_t)(last_ts - h->t0_ms);
+  uint32_t q = (span + STAMPDB_PIDX_SPAN_UNIT_MS - 1u) / STAMPDB_PIDX_SPAN_UNIT_MS;
+  page_index_t *e = &s->pidx[seg*STAMPDB_DATA_PAGES_PER_SEG + page];
+  e->t0 = h->t0_ms; e->series = h->series; e->span = (uint16_t)(q > 0xFFFFu ? 0xFFFFu : q);
+}
+
+int latest_init(stampdb_state_t *s, uint32_t slots){
+  uint32_t n = 1u, want = slots ? slots : STAMPDB_DEFAULT_LATEST_SLOTS;
+  if (want < 2u*s->builder_count) want = 2u*s->builder_count; // unflushed entries always find a victim
+  while (n < want) n <<= 1;
+  s->latest = (latest_entry_t*)ws_alloc(s, sizeof(latest_entry_t)*n, _Alignof(latest_entry_t));
+  if (!s->latest) return -1;
+  memset(s->latest, 0, sizeof(latest_entry_t)*n);
+  for (uint32_t i=0;i<n;i++) s->latest[i].series = STAMPDB_PIDX_EMPTY;
+  s->latest_slots = n; s->latest_probe = 0;
   return 0;
 }
 
+const latest_entry_t *latest_find(const stampdb_state_t *s, uint16_t series){
+  uint32_t mask = s->latest_slots - 1u, home = series_hash(series) & mask;
+  for (uint32_t d=0; d<s->latest_probe; d++){
+    const latest_entry_t *e = &s->latest[(home + d) & mask];
+    if (e->series == series) return e;
+  }
+  return NULL;
+}
+
+/**
+ * @brief Slot for `series`: its own entry, else a victim near its home (never used, then
+ * no retained rows, then the oldest flushed row). Unflushed entries are never taken, so the
+ * search may run past the window; `latest_probe` grows to cover it. NULL only when
+ * `evict` is false and no free slot is in the window.
+ */
+static latest_entry_t *latest_slot(stampdb_state_t *s, uint16_t series, bool evict){
+  latest_entry_t *own = (latest_entry_t*)latest_find(s, series);
+  if (own) return own;
+  uint32_t mask = s->latest_slots - 1u, home = series_hash(series) & mask;
+  latest_entry_t *victim = NULL; uint32_t vd = 0, vrank = 0;
+  for (uint32_t d=0; d<s->latest_slots && (d<STAMPDB_LATEST_PROBE || !victim); d++){
+    latest_entry_t *e = &s->latest[(home + d) & mask];
+    uint32_t rank = e->series == STAMPDB_PIDX_EMPTY ? 3u : !e->valid ? 2u : e->page_addr != STAMPDB_LATEST_UNFLUSHED ? 1u : 0u;
+    if (!rank || (!evict && rank < 3u)) continue;
+    if (!victim || rank > vrank || (rank == 1u && vrank == 1u && ts_lt(e->ts, victim->ts))){ victim = e; vd = d; vrank = rank; }
+    if (rank == 3u) break;
+  }
+  if (!victim) return NULL;
+  if (vd + 1u > s->latest_probe) s->latest_probe = vd + 1u;
+  if (vrank == 1u) s->latest_evictions++;
+  victim->series = series; victim->valid = false;
+  return victim;
+}
+
+void latest_update(stampdb_state_t *s, uint16_t series, uint32_t ts, float value, uint32_t page_addr){
+  zm_write_begin(s);
+  latest_entry_t *e = latest_slot(s, series, true);
+  e->ts = ts; e->value = value; e->page_addr = page_addr; e->valid = true;
+  zm_write_end(s);
+}
+
+bool latest_seed(stampdb_state_t *s, uint16_t series, uint32_t ts, float value, uint32_t page_addr){
+  zm_write_begin(s);
+  latest_entry_t *e = latest_slot(s, series, false);
+  if (e){ e->ts = ts; e->value = value; e->page_addr = page_addr; e->valid = true; }
+  zm_write_end(s);
+  return e != NULL;
+}
+
+/** @brief Forget latest rows whose block lived in an erased segment (the key stays: no rows retained). */
+void latest_invalidate_segment(stampdb_state_t *s, uint32_t seg_idx){
+  if (!s->latest) return;
+  uint32_t lo = seg_idx*STAMPDB_SEG_BYTES, hi = lo + STAMPDB_SEG_BYTES;
+  for (uint32_t i=0;i<s->latest_slots;i++){
+    latest_entry_t *e = &s->latest[i];
+    if (e->valid && e->page_addr != STAMPDB_LATEST_UNFLUSHED && e->page_addr >= lo && e->page_addr < hi) e->valid = false;
+  }
+}
+
+/** @brief Mark every page of a segment empty in the page index. */
+void pidx_clear_segment(stampdb_state_t *s, uint32_t seg_idx){
+  if (!s->pidx || seg_idx >= s->seg_count) return;
+  page_index_t *e = &s->pidx[seg_idx*STAMPDB_DATA_PAGES_PER_SEG];
+  for (uint32_t p=0;p<STAMPDB_DATA_PAGES_PER_SEG;p++){ e[p].t0 = 0; e[p].series = STAMPDB_PIDX_EMPTY; e[p].span = 0; }
+}
+
 /**
  * @brief Publish one block to flash with header-last, power-cut safe order.
  *
@@ -249,6 +579,15 @@ int ring_finalize_segment_and_rotate(stampdb_state_t *s){
  */
 int ring_write_block(stampdb_state_t *s, const block_header_t *h, const uint8_t payload[STAMPDB_PAYLOAD_BYTES]){
   uint32_t page_addr = s->head.addr;
+  seg_summary_t *hs = &s->segs[page_addr / STAMPDB_SEG_BYTES];
+  if (hs->erase_lost){
+    // its erase failed or was dropped (ring_op_lost restarted the head): redo it first
+    zm_write_begin(s);
+    hs->erase_lost = false; hs->erased = true;
+    if (s->wb.slots) hs->erase_queued = true;
+    zm_write_end(s);
+    if (flash_erase_4k(s, hs->addr_first)!=0){ ring_op_lost(s, hs->addr_first, true); return -1; }
+  }
   // --- Commit block (header-last, power-cut safe) --------------------------
   // 1) payload bytes (ignored if header missing)
   // 2) header at page tail (atomic publish)
@@ -256,7 +595,7 @@ int ring_write_block(stampdb_state_t *s, const block_header_t *h, const uint8_t
   uint8_t page[STAMPDB_PAGE_BYTES];
   memcpy(page, payload, STAMPDB_PAYLOAD_BYTES);
   memset(page + STAMPDB_PAYLOAD_BYTES, 0xFF, STAMPDB_HEADER_BYTES);
-  int rc = platform_flash_program_256(page_addr, page);
+  int rc = flash_program_256(s, page_addr, page);
   if (rc!=0) return -1;
 
   // Prepare header bytes
@@ -265,11 +604,12 @@ int ring_write_block(stampdb_state_t *s, const block_header_t *h, const uint8_t
   // Page image #2: only header bytes (1->0), payload all 0xFF to avoid changes
   memset(page, 0xFF, sizeof(page));
   memcpy(page + STAMPDB_PAYLOAD_BYTES, hdr, STAMPDB_HEADER_BYTES);
-  rc = platform_flash_program_256(page_addr, page);
+  rc = flash_program_256(s, page_addr, page);
   if (rc!=0) return -2;
 
   // advance head
   s->blocks_written++;
+  zm_write_begin(s);
   s->head.page_index++;
   s->head.addr += STAMPDB_PAGE_BYTES;
 
@@ -277,20 +617,22 @@ int ring_write_block(stampdb_state_t *s, const block_header_t *h, const uint8_t
   uint32_t seg_idx = (page_addr / STAMPDB_SEG_BYTES);
   seg_summary_t *sm = &s->segs[seg_idx];
   if (!sm->valid){ sm->valid=true; sm->seg_seqno=s->head.seg_seqno; sm->addr_first=seg_idx*STAMPDB_SEG_BYTES; }
+  sm->erased = false;
   if (h->t0_ms < sm->t_min) sm->t_min = h->t0_ms;
-  uint32_t last_t = h->t0_ms;
-  // compute last ts
-  if (h->dt_bits==8){
-    const uint8_t *pr = payload;
-    for (uint16_t i=0;i<h->count;i++) last_t += *pr++;
-  } else {
-    const uint8_t *pr = payload;
-    for (uint16_t i=0;i<h->count;i++){ last_t += (uint16_t)(pr[0]|(pr[1]<<8)); pr+=2; }
-  }
+  uint32_t last_t = codec_block_last_ts(h, payload);
   if (last_t > sm->t_max) sm->t_max = last_t;
   if (sm->block_count == 0) s->used_seg_count++;
   sm->block_count++;
-  sm->series_bitmap[h->series >> 3] |= (1u << (h->series & 7));
+  series_set_add(sm->series_filter, &sm->series_bloom, h->series);
+  pidx_record(s, page_addr, h, last_t);
+  rollup_add(s, h, last_t);
+  latest_update(s, h->series, last_t, codec_block_last_value(h, payload), page_addr);
+  if (s->zm_sorted && s->seg_count > 1){
+    // only the head summary changed: compare against its seqno predecessor
+    const seg_summary_t *prev = &s->segs[(seg_idx + s->seg_count - 1u) % s->seg_count];
+    if (prev->valid && prev->block_count>0 && (ts_lt(sm->t_min, prev->t_min) || ts_lt(sm->t_max, prev->t_max))) s->zm_sorted = false;
+  }
+  zm_write_end(s);
 
   if (s->head.page_index >= STAMPDB_DATA_PAGES_PER_SEG){
     ring_finalize_segment_and_rotate(s);
@@ -300,39 +642,148 @@ int ring_write_block(stampdb_state_t *s, const block_header_t *h, const uint8_t
 }
 
 /**
- * @brief Reclaim oldest segment when free watermark <10% (busy at 5%).
+ * @brief Undo what a lost data-region op promised: a write-behind op dropped by a
+ * failure (write_behind.c) or a synchronous erase that failed.
  *
- * Quota: ≤2 seg/s; non_blocking returns EBUSY if quota exhausted.
+ *  - Erase: the sector keeps its previous contents and nothing of the current lap
+ *    reached it (its programs queue behind the erase), so it leaves the maps; as the
+ *    head it restarts at its first page, and the erase is redone before the first
+ *    program (`erase_lost`). Not erased, a data-free one is picked again for pre-erase.
+ *  - Program into the head segment: the head steps back to that page, so no blank
+ *    page is left before later ones; its summary and rollups are rebuilt from the
+ *    pages before it and latest rows that pointed past it are looked up again.
+ */
+void ring_op_lost(stampdb_state_t *s, uint32_t addr, bool erase){
+  uint32_t idx = addr / STAMPDB_SEG_BYTES;
+  if (idx >= s->seg_count) return; // meta: log appends skip pages left non-blank on their own
+  seg_summary_t *sm = &s->segs[idx];
+  bool head = idx == s->head.addr / STAMPDB_SEG_BYTES;
+  if (!erase && (!head || addr >= s->head.addr)) return;
+  uint32_t keep = erase ? 0u : (addr % STAMPDB_SEG_BYTES) / STAMPDB_PAGE_BYTES;
+  zm_write_begin(s);
+  if (sm->valid && sm->block_count>0 && s->used_seg_count>0) s->used_seg_count--;
+  if (head){
+    s->head.page_index = head_probe(s, idx, keep);
+    s->head.addr = idx*STAMPDB_SEG_BYTES + s->head.page_index*STAMPDB_PAGE_BYTES;
+  } else {
+    sm->t_min=0xFFFFFFFFu; sm->t_max=0; sm->block_count=0; memset(sm->series_filter,0,STAMPDB_SERIES_FILTER_BYTES); sm->series_bloom=false;
+  }
+  if (sm->block_count>0) s->used_seg_count++;
+  if (erase){ sm->erased = false; sm->erase_queued = false; sm->erase_lost = head; }
+  if (s->pidx) for (uint32_t p=keep; p<STAMPDB_DATA_PAGES_PER_SEG; p++){
+    page_index_t *e = &s->pidx[idx*STAMPDB_DATA_PAGES_PER_SEG + p];
+    e->t0 = 0; e->series = STAMPDB_PIDX_EMPTY; e->span = 0;
+  }
+  bcache_invalidate_segment(s, idx);
+  zm_write_end(s);
+  uint32_t lo = idx*STAMPDB_SEG_BYTES + keep*STAMPDB_PAGE_BYTES, hi = (idx + 1u)*STAMPDB_SEG_BYTES;
+  for (uint32_t i=0; s->latest && i<s->latest_slots; i++){
+    latest_entry_t *e = &s->latest[i], found;
+    if (!e->valid || e->page_addr == STAMPDB_LATEST_UNFLUSHED || e->page_addr < lo || e->page_addr >= hi) continue;
+    if (latest_from_flash(s, e->series, &found)) latest_seed(s, e->series, found.ts, found.value, found.page_addr);
+    else { zm_write_begin(s); e->valid = false; zm_write_end(s); }
+  }
+}
+
+/** @brief Erase segment `idx` and drop it from the zone map, page index, latest table and block cache. */
+static int gc_erase_segment(stampdb_state_t *s, uint32_t idx){
+  seg_summary_t *sm = &s->segs[idx];
+  // drop it from the reader-visible maps before its flash changes
+  zm_write_begin(s);
+  if (sm->valid && sm->block_count>0 && s->used_seg_count>0) s->used_seg_count--;
+  sm->t_min=0xFFFFFFFFu; sm->t_max=0; sm->block_count=0; memset(sm->series_filter,0,STAMPDB_SERIES_FILTER_BYTES); sm->series_bloom=false;
+  sm->erased = true; sm->erase_lost = false;
+  if (s->wb.slots) sm->erase_queued = true;
+  pidx_clear_segment(s, idx);
+  latest_invalidate_segment(s, idx);
+  bcache_invalidate_segment(s, idx);
+  zm_write_end(s);
+  if (flash_erase_4k(s, idx*STAMPDB_SEG_BYTES)!=0){ ring_op_lost(s, idx*STAMPDB_SEG_BYTES, true); return -1; }
+  return 0;
+}
+
+/** @brief Reclaim the tail segment; 1 when erased, 0 when nothing reclaimable, -1 on I/O error. */
+static int gc_reclaim_tail(stampdb_state_t *s){
+  tail_normalize(s);
+  if (s->tail_seqno == s->head.seg_seqno) return 0; // only the head holds data
+  uint32_t idx = ring_tail_idx(s);
+  if (gc_erase_segment(s, idx)!=0) return -1;
+  zm_write_begin(s);
+  s->tail_seqno++; tail_normalize(s);
+  if (!s->zm_sorted) ring_zm_recompute_sorted(s);
+  zm_write_end(s);
+  return 1;
+}
+
+/** @brief True while free segments are below the warn watermark plus `extra` segments. */
+static inline bool gc_below_watermark(const stampdb_state_t *s, uint32_t extra){
+  return (s->seg_count - s->used_seg_count)*100u < STAMPDB_GC_WARN_FREE_PCT*s->seg_count + extra*100u;
+}
+
+/**
+ * @brief Reclaim the tail segment when free watermark <10% (busy at 5%).
+ *
+ * Quota: ≤2 seg/s per DB. When the window is exhausted a blocking caller defers
+ * (rotation still erases the slot ahead of the head, so the ring keeps moving);
+ * non_blocking returns EBUSY. Never waits.
  */
 int ring_gc_reclaim_if_needed(stampdb_state_t *s, bool non_blocking){
-  // Watermarks: warn at 10%, busy at 5%
-  uint32_t used = s->used_seg_count;
-  uint32_t free = s->seg_count - used;
-  if (free*100u < 10u*s->seg_count) s->gc_warn_events++;
-  if (free*100u < 5u*s->seg_count) s->gc_busy_events++;
-  if (free*100u >= 10u*s->seg_count) return 0; // plenty free
-
-  // enforce quota ≤2 seg/s
-  static uint64_t last_erase_ms = 0; static uint32_t erased_in_window = 0; static uint64_t window_start = 0;
+  uint32_t free = s->seg_count - s->used_seg_count;
+  if (free*100u < STAMPDB_GC_BUSY_FREE_PCT*s->seg_count) s->gc_busy_events++;
+  if (s->lazy) return 0; // tail unknown until the zone map is complete; rotation keeps erasing ahead
+  if (!gc_below_watermark(s, 0)) return 0; // plenty free
+  s->gc_warn_events++;
+
   uint64_t now = platform_millis();
-  if (now - window_start >= 1000){ window_start = now; erased_in_window = 0; }
-  if (erased_in_window >= 2){
+  if (now - s->gc_window_start_ms >= 1000){ s->gc_window_start_ms = now; s->gc_erased_in_window = 0; }
+  if (s->gc_erased_in_window >= STAMPDB_GC_QUOTA_SEG_PER_SEC){
     if (non_blocking){ s->gc_busy_events++; return STAMPDB_EBUSY; }
-    // block until next window
-    while ((platform_millis() - window_start) < 1000) {}
-    window_start = platform_millis(); erased_in_window = 0;
+    s->gc_deferred_events++;
+    return 0;
   }
+  uint64_t pt = perf_begin(s);
+  int r = gc_reclaim_tail(s);
+  perf_end(s, STAMPDB_PERF_GC_RECLAIM, pt);
+  if (r<0) return STAMPDB_EIO;
+  if (r>0) s->gc_erased_in_window++;
+  return 0;
+}
 
-  // reclaim the oldest (tail) segment
-  uint32_t oldest_seq = 0xFFFFFFFFu; uint32_t oldest_idx = 0;
-  for (uint32_t i=0;i<s->seg_count;i++) if (s->segs[i].valid && s->segs[i].block_count>0){
-    if (s->segs[i].seg_seqno < oldest_seq){ oldest_seq = s->segs[i].seg_seqno; oldest_idx = i; }
+/** @brief Nearest data-free, not-known-erased segment within PREERASE_AHEAD of the head, or -1. */
+static int32_t preerase_candidate(const stampdb_state_t *s){
+  uint32_t head_idx = s->head.addr / STAMPDB_SEG_BYTES;
+  for (uint32_t k=1; k<=STAMPDB_GC_PREERASE_AHEAD && k<s->seg_count; k++){
+    const seg_summary_t *sm = &s->segs[(head_idx + k) % s->seg_count];
+    if (sm->pending || (sm->valid && sm->block_count>0)) break; // retained data: reclaimed only under pressure
+    if (!sm->erased) return (int32_t)((head_idx + k) % s->seg_count);
+  }
+  return -1;
+}
+
+/**
+ * @brief Idle-time GC bounded by `budget_us` (checked before each erase; one erase
+ * may overrun it).
+ *
+ * Order of work: settle a lazy open's pending zone-map entries (ring_recover_step),
+ * reclaim the tail while free space is below the warn watermark plus
+ * STAMPDB_GC_PREERASE_AHEAD segments (so the next rotations neither cross the
+ * watermark nor erase), then erase data-free segments just ahead of the head whose
+ * state is unknown (e.g. after open). Not rate-limited by the foreground quota.
+ *
+ * @return OK when no work is left, EBUSY when the budget ran out first, EIO on erase failure.
+ */
+stampdb_rc ring_gc_step(stampdb_state_t *s, uint32_t budget_us){
+  uint64_t t0 = platform_micros();
+  if (s->lazy && ring_recover_step(s, budget_us)!=STAMPDB_OK) return STAMPDB_EBUSY;
+  for (;;){
+    bool reclaim = gc_below_watermark(s, STAMPDB_GC_PREERASE_AHEAD) && s->tail_seqno != s->head.seg_seqno;
+    int32_t pre = reclaim ? -1 : preerase_candidate(s);
+    if (!reclaim && pre < 0) return STAMPDB_OK;
+    if (platform_micros() - t0 >= budget_us) return STAMPDB_EBUSY;
+    if (reclaim){
+      int r = gc_reclaim_tail(s);
+      if (r<0) return STAMPDB_EIO;
+      if (r==0) return STAMPDB_OK;
+    } else if (gc_erase_segment(s, (uint32_t)pre)!=0) return STAMPDB_EIO;
   }
-  uint32_t base = oldest_idx*STAMPDB_SEG_BYTES;
-  platform_flash_erase_4k(base);
-  if (s->segs[oldest_idx].block_count > 0 && s->used_seg_count > 0) s->used_seg_count--;
-  s->segs[oldest_idx].t_min=0xFFFFFFFFu; s->segs[oldest_idx].t_max=0; s->segs[oldest_idx].block_count=0; memset(s->segs[oldest_idx].series_bitmap,0,STAMPDB_SERIES_BITMAP_BYTES);
-  erased_in_window++;
-  (void)last_erase_ms;
-  return 0;
 }
@@ -3,8 +3,9 @@
  * @brief Public API implementation: open/close, write/flush, snapshot/info.
  *
  * What it owns:
- *  - Workspace management and writer block builder (bias/scale, Fixed16)
- *  - Epoch wrap tracking and commit policy
+ *  - Workspace management and per-series block builders (bias/scale, Fixed16, LRU eviction)
+ *  - Epoch wrap tracking and commit policy (size, flush, per-block deadlines via stampdb_tick)
+ *  - Rollup tier feed: per-builder bucket accumulators emitted into the tier ring
  *
  * Role in system:
  *  - Bridges API calls to ring/codec/platform primitives
@@ -14,89 +15,308 @@
 #include <string.h>
 #include <math.h>
 
+/** @brief Value tolerance of a series (STAMPDB_TOLERANCE_DEFAULT unless set). */
+static float series_tolerance(const stampdb_state_t *s, uint16_t series){
+  if (s->rollup_tier) return STAMPDB_TOLERANCE_LOSSLESS;
+  if (series < STAMPDB_SERIES_EXACT) return s->tolerance[series];
+  for (uint32_t i=0;i<s->tol_ext_count;i++) if (s->tol_ext[i].series == series) return s->tol_ext[i].tol;
+  return STAMPDB_TOLERANCE_DEFAULT;
+}
+
+/** @brief Initialize a builder for a series starting at ts. */
+static void begin_block(stampdb_state_t *s, stampdb_builder_t *b, uint16_t series, uint32_t ts, float val){
+  b->series = series; b->t0 = ts; b->last_ts = ts; b->count=0; b->min = val; b->max = val; b->max_dt = 0; b->dod_bits = 0;
+  b->tol = series_tolerance(s, series); b->val_lane = STAMPDB_VAL_Q16; b->xor_bits = 0;
+  b->deadline_ms = s->commit_clock_ms + s->commit_interval_ms;
+}
+
+/**
+ * @brief Smallest timestamp lane for `n` rows; ties keep the fixed-width lanes.
+ * @param bytes_out timestamp lane bytes, may be NULL
+ */
+static uint8_t ts_lane_choose(uint32_t n, uint32_t max_dt, uint8_t dod_bits, size_t *bytes_out){
+  size_t best = codec_dod_lane_bytes((uint16_t)n, dod_bits); uint8_t lane = STAMPDB_DT_DOD;
+  if (max_dt <= 0xFFFFu && 2u*n <= best){ best = 2u*n; lane = 16; }
+  if (max_dt <= 0xFFu && n <= best){ best = n; lane = 8; }
+  if (bytes_out) *bytes_out = best;
+  return lane;
+}
+
 /**
- * @brief Bump-pointer allocator inside the user-provided workspace.
+ * @brief Narrowest value lane whose rounding error (scale/2) stays within `tol` over [minv, maxv].
+ * Negative tolerance keeps the Fixed16 default; 0 selects the lossless XOR lane.
  */
-static void* ws_alloc(stampdb_state_t *s, size_t sz, size_t align){
-  uintptr_t cur = (uintptr_t)s->ws_cur;
-  uintptr_t aligned = (cur + (align-1)) & ~(uintptr_t)(align-1);
-  if (aligned + sz > (uintptr_t)s->ws_begin + s->ws_size) return NULL;
-  s->ws_cur = (uint8_t*)(aligned + sz);
-  return (void*)aligned;
+static uint8_t val_lane_choose(float tol, float minv, float maxv){
+  if (tol < 0.0f) return STAMPDB_VAL_Q16;
+  if (tol == 0.0f) return STAMPDB_VAL_XOR;
+  float range = maxv - minv;
+  if (range <= 4.0f * (float)codec_qlim(STAMPDB_VAL_Q8) * tol) return STAMPDB_VAL_Q8;
+  if (range <= 4.0f * (float)codec_qlim(STAMPDB_VAL_Q12) * tol) return STAMPDB_VAL_Q12;
+  return STAMPDB_VAL_Q16;
 }
 
-/** @brief Initialize a new block builder for a series starting at ts. */
-static void begin_block(stampdb_state_t *s, uint16_t series, uint32_t ts, float val){
-  s->cur_series = series; s->cur_t0 = ts; s->last_ts = ts; s->cur_count=0; s->cur_min = val; s->cur_max = val; s->cur_dt_bits = 8; // start optimistic
+static size_t push_run(stampdb_state_t *s, uint16_t series, const uint32_t *ts, const float *vals, size_t n);
+
+/**
+ * @brief Emit a builder's rollup accumulator into the tier as one point: rows
+ * bucket+0..3 = min, max, sum, count. A bucket emitted twice (flush, eviction, late
+ * rows) yields two points that readers merge; a full tier reclaims its oldest segment.
+ */
+static void rollup_emit(stampdb_state_t *s, stampdb_builder_t *b){
+  if (!b->ru_n) return;
+  stampdb_state_t *t = s->tier;
+  uint32_t ts[STAMPDB_ROLLUP_FIELDS]; float v[STAMPDB_ROLLUP_FIELDS] = { b->ru_min, b->ru_max, b->ru_sum, (float)b->ru_n };
+  for (uint32_t f=0; f<STAMPDB_ROLLUP_FIELDS; f++) ts[f] = b->ru_bucket + f;
+  b->ru_n = 0; s->rollup_points++;
+  size_t i=0;
+  while (i<STAMPDB_ROLLUP_FIELDS){
+    if (ring_gc_reclaim_if_needed(t, false)!=0) return;
+    i += push_run(t, b->series, ts+i, v+i, STAMPDB_ROLLUP_FIELDS-i);
+  }
+}
+
+/** @brief Fold the rows of a block about to publish into its builder's accumulator (written values, pre-quantization). */
+static void rollup_fold(stampdb_state_t *s, stampdb_builder_t *b){
+  if (!s->tier) return;
+  uint32_t t = b->t0, tb = s->rollup_bucket_ms;
+  for (uint16_t i=0;i<b->count;i++){
+    t += b->deltas[i];
+    uint32_t bucket = t - t % tb; float v = b->vals[i];
+    if (b->ru_n && bucket != b->ru_bucket) rollup_emit(s, b);
+    if (!b->ru_n){ b->ru_bucket = bucket; b->ru_min = v; b->ru_max = v; b->ru_sum = 0.0f; }
+    if (v < b->ru_min) b->ru_min = v; if (v > b->ru_max) b->ru_max = v;
+    b->ru_sum += v; b->ru_n++;
+  }
 }
 
 /**
- * @brief Close current block: quantize values, choose delta lane, encode and publish.
+ * @brief Close a builder's block: quantize values, choose lanes, encode and publish.
  *
  * Steps:
- *  1) Compute bias/scale and quantize to int16
- *  2) Pick dt_bits by max delta
+ *  1) Quantized lanes: bias/scale map the extremes to +/-qlim of the lane chosen
+ *     while staging (plus qvals sum/extremes for aggregates); XOR keeps raw floats
+ *  2) Pick the smallest timestamp lane (u8/u16 deltas or delta-of-delta)
  *  3) Encode payload + header and publish via ring_write_block()
  */
-static void finalize_and_write_block(stampdb_state_t *s){
-  if (s->cur_count==0) return;
-  // compute bias/scale
-  float minv = s->cur_min, maxv = s->cur_max;
-  if (maxv < minv) maxv = minv;
-  float scale = (maxv - minv) / 65535.0f; if (scale == 0) scale = 1e-9f;
-  float bias = 0.5f*(maxv + minv);
-  // quantize
-  for (uint16_t i=0;i<s->cur_count;i++){
-    float v = s->stg_vals[i];
-    float qf = roundf((v - bias)/scale);
-    if (qf < -32768.0f) qf = -32768.0f; if (qf > 32767.0f) qf = 32767.0f;
-    s->stg_qvals[i] = (int16_t)qf;
-  }
-  // choose dt_bits by max delta
-  uint32_t max_dt = 0; for (uint16_t i=0;i<s->cur_count;i++){ if (s->stg_deltas[i] > max_dt) max_dt = s->stg_deltas[i]; }
-  uint8_t dt_bits = (max_dt <= 255)? 8 : 16; s->cur_dt_bits = dt_bits;
+static void finalize_and_write_block(stampdb_state_t *s, stampdb_builder_t *b){
+  if (b->count==0) return;
+  block_header_t h; memset(&h,0,sizeof(h));
+  h.series = b->series; h.count = b->count; h.t0_ms = b->t0; h.version = 2; h.val_lane = b->val_lane;
+  if (b->val_lane != STAMPDB_VAL_XOR){
+    // compute bias/scale
+    float minv = b->min, maxv = b->max;
+    if (maxv < minv) maxv = minv;
+    // extremes map to -qlim/+qlim so block min/max are recoverable from bias/scale
+    int32_t lim = codec_qlim(b->val_lane);
+    float scale = (maxv - minv) / (2.0f * (float)lim);
+    float bias = 0.5f*(maxv + minv);
+    // quantize; track qvals extremes/sum for the header aggregates
+    int32_t qmin = lim, qmax = -lim, qsum = 0;
+    for (uint16_t i=0;i<b->count;i++){
+      float v = b->vals[i];
+      float qf = (scale > 0) ? roundf((v - bias)/scale) : 0.0f;
+      if (qf < (float)(-lim - 1)) qf = (float)(-lim - 1); if (qf > (float)lim) qf = (float)lim;
+      b->qvals[i] = (int16_t)qf;
+      if (b->qvals[i] < qmin) qmin = b->qvals[i]; if (b->qvals[i] > qmax) qmax = b->qvals[i];
+      qsum += b->qvals[i];
+    }
+    h.bias = bias; h.scale = scale; h.qsum = qsum;
+    h.agg_exact = (scale == 0) || (qmin == -lim && qmax == lim);
+  }
+  h.dt_bits = ts_lane_choose(b->count, b->max_dt, b->dod_bits, NULL);
   // encode payload
   uint8_t payload[STAMPDB_PAYLOAD_BYTES];
-  memset(payload, 0xFF, sizeof(payload));
-  codec_encode_payload(payload, dt_bits, s->stg_deltas, s->stg_qvals, s->cur_count);
-  // header
-  block_header_t h; memset(&h,0,sizeof(h));
-  h.series = s->cur_series; h.count = s->cur_count; h.t0_ms = s->cur_t0; h.dt_bits = dt_bits; h.bias = bias; h.scale = scale;
+  codec_encode_payload(payload, &h, b->deltas, b->qvals, b->vals);
   h.payload_crc = crc32c(payload, STAMPDB_PAYLOAD_BYTES);
   ring_write_block(s, &h, payload);
-  s->cur_count=0;
+  rollup_fold(s, b);
+  b->count=0;
+}
+
+/**
+ * @brief Find the open builder for a series, else a free slot, else evict the LRU one.
+ *
+ * Eviction publishes the coldest block (possibly short) so interleaved series
+ * each keep filling their own page instead of closing on every series change.
+ * A slot keeps its series' rollup accumulator while idle; reusing it for another
+ * series emits that first (slots without one are preferred).
+ */
+static stampdb_builder_t* acquire_builder(stampdb_state_t *s, uint16_t series){
+  stampdb_builder_t *free_slot = NULL, *lru = NULL;
+  for (uint32_t i=0;i<s->builder_count;i++){
+    stampdb_builder_t *b = &s->builders[i];
+    if ((b->count || b->ru_n) && b->series == series) return b;
+    if (b->count==0){ if (!free_slot || (free_slot->ru_n && !b->ru_n)) free_slot = b; continue; }
+    if (!lru || (int32_t)(b->last_use - lru->last_use) < 0) lru = b;
+  }
+  if (free_slot){ rollup_emit(s, free_slot); return free_slot; }
+  finalize_and_write_block(s, lru);
+  rollup_emit(s, lru);
+  return lru;
+}
+
+/** @brief Lane state of a builder after a prospective append (committed only if the row fits). */
+typedef struct {
+  uint32_t max_dt;
+  uint8_t  dod_bits;
+  uint8_t  val_lane;
+  codec_xor_t xor_st;
+  uint32_t xor_bits;
+} row_lanes_t;
+
+/**
+ * @brief True if one more row (delta `dt`, value `v`) keeps the block within the payload
+ * budget under the cheapest lanes; reports the lane state to commit on append.
+ * Deltas must move forward (< 2^31) so t0/last stay the block's time bounds.
+ */
+static bool row_fits(const stampdb_builder_t *b, uint32_t dt, float v, row_lanes_t *out){
+  uint32_t n = (uint32_t)b->count + 1u;
+  out->max_dt = dt > b->max_dt ? dt : b->max_dt;
+  out->dod_bits = b->dod_bits;
+  if (b->count >= 2){ uint8_t w = codec_bit_width(codec_zigzag((int32_t)(dt - b->deltas[b->count-1]))); if (w > out->dod_bits) out->dod_bits = w; }
+  float mn = b->count && b->min < v ? b->min : v, mx = b->count && b->max > v ? b->max : v;
+  out->val_lane = val_lane_choose(b->tol, mn, mx);
+  out->xor_st = b->xor_st; out->xor_bits = b->xor_bits;
+  if (out->val_lane == STAMPDB_VAL_XOR){ uint32_t u; memcpy(&u, &v, 4); out->xor_bits += codec_xor_cost(&out->xor_st, u, b->count); }
+  size_t bytes; ts_lane_choose(n, out->max_dt, out->dod_bits, &bytes);
+  bytes += codec_val_lane_bytes(out->val_lane, (uint16_t)n, out->xor_bits);
+  return bytes <= STAMPDB_PAYLOAD_BYTES && dt <= 0x7FFFFFFFu && n <= STAMPDB_BLOCK_MAX_ROWS;
+}
+
+/** @brief Epoch wrap detection: increment epoch if ts wraps by more than half range. */
+static void observe_ts(stampdb_state_t *s, uint32_t ts_ms){
+  if (s->blocks_written>0){
+    if (ts_ms < s->last_ts_observed && (s->last_ts_observed - ts_ms) > 0x80000000u){
+      s->epoch_id++;
+    }
+  }
+  s->last_ts_observed = ts_ms;
 }
 
 /**
- * @brief Add a sample to builder; auto-closes block if payload budget exceeded.
+ * @brief Rollup completeness on write: a row older than ru_hi pulls the window back to
+ * its bucket (the tier only gets it at the next publish); ru_max feeds the next flush.
  */
-static void push_sample(stampdb_state_t *s, uint16_t series, uint32_t ts, float val){
-  // if new series or overflow, finalize current block
-  if (s->cur_count>0 && (series != s->cur_series)) finalize_and_write_block(s);
-  if (s->cur_count==0) begin_block(s, series, ts, val);
+static void rollup_observe(stampdb_state_t *s, uint32_t ts){
+  if (ts < s->ru_hi){
+    uint32_t f = ts - ts % s->rollup_bucket_ms;
+    zm_write_begin(s); s->ru_hi = f < s->ru_lo ? s->ru_lo : f; zm_write_end(s);
+  }
+  if (ts > s->ru_max) s->ru_max = ts;
+}
 
-  // compute dt
-  uint32_t dt = (s->cur_count==0)? 0 : (ts - s->last_ts);
-  // estimate space usage if we add this row
-  uint16_t cur = s->cur_count;
-  uint8_t dt_bits_est = s->cur_dt_bits;
-  if (dt > 255) dt_bits_est = 16;
-  size_t payload_used = (size_t)((dt_bits_est==8)?(cur+1):((cur+1)*2)) + (size_t)((cur+1)*2);
-  if (payload_used > STAMPDB_PAYLOAD_BYTES){
-    finalize_and_write_block(s);
-    begin_block(s, series, ts, val);
-    cur = 0; dt = 0; dt_bits_est=8;
+/**
+ * @brief Stage a run of rows for one series straight into its builder.
+ *
+ * Appends until the next row would overflow the payload (or delta range), then
+ * publishes the block. Returns rows consumed; 0 only when the already-open
+ * block had to be closed first, so the next call starts a fresh block.
+ */
+static size_t push_run(stampdb_state_t *s, uint16_t series, const uint32_t *ts, const float *vals, size_t n){
+  stampdb_builder_t *b = acquire_builder(s, series);
+  if (b->count==0) begin_block(s, b, series, ts[0], vals[0]);
+  size_t i=0;
+  for (; i<n; i++){
+    uint32_t dt = (b->count==0)? 0 : (ts[i] - b->last_ts);
+    float v = vals[i];
+    row_lanes_t ln;
+    if (!row_fits(b, dt, v, &ln)) break;
+    observe_ts(s, ts[i]);
+    if (s->tier) rollup_observe(s, ts[i]);
+    b->deltas[b->count] = dt;
+    b->vals[b->count] = v;
+    if (v < b->min) b->min = v; if (v > b->max) b->max = v;
+    b->max_dt = ln.max_dt; b->dod_bits = ln.dod_bits;
+    b->val_lane = ln.val_lane; b->xor_st = ln.xor_st; b->xor_bits = ln.xor_bits;
+    b->count++;
+    b->last_ts = ts[i];
   }
-  // append
-  if (cur==0) s->stg_deltas[0]=0; else s->stg_deltas[cur]=dt;
-  s->stg_vals[cur]=val;
-  if (val < s->cur_min) s->cur_min = val; if (val > s->cur_max) s->cur_max = val;
-  s->cur_count++;
-  s->last_ts = ts;
+  b->last_use = ++s->use_tick;
+  if (i>0) latest_update(s, series, ts[i-1], vals[i-1], STAMPDB_LATEST_UNFLUSHED);
+  // size closes here; deadlines (commit_interval_ms) in stampdb_tick
+  if (i<n || b->count>=STAMPDB_BLOCK_MAX_ROWS) finalize_and_write_block(s, b);
+  return i;
 }
 
 // Platform abstraction for host sim is defined in sim/platform_sim.c
 
+/**
+ * @brief Open one ring on its partition (flash_bytes 0 = to the end of the device):
+ * builders, latest and block caches, recovery (`lazy`: head only, see ring_scan_and_recover),
+ * page index and write-behind queue, carved from the workspace at s->ws_cur.
+ */
+static stampdb_rc state_open(stampdb_state_t *s, const stampdb_cfg_t *cfg, uint32_t flash_base, uint32_t flash_bytes,
+                             uint32_t latest_slots, uint32_t write_behind_pages, uint32_t block_cache_blocks, bool lazy){
+  s->read_batch_rows = cfg->read_batch_rows ? cfg->read_batch_rows : 256;
+  s->commit_interval_ms = cfg->commit_interval_ms;
+  s->concurrent = cfg->concurrent_readers != 0;
+  uint32_t dev = platform_flash_size_bytes();
+  s->flash_base = flash_base;
+  s->flash_bytes = flash_bytes ? flash_bytes : (flash_base < dev ? dev - flash_base : 0u);
+  if ((s->flash_base | s->flash_bytes) % STAMPDB_SEG_BYTES || s->flash_base > dev || s->flash_bytes > dev - s->flash_base ||
+      s->flash_bytes < STAMPDB_META_RESERVED + 2u*STAMPDB_SEG_BYTES) return STAMPDB_EINVAL;
+  s->builder_count = cfg->open_builders ? cfg->open_builders : STAMPDB_DEFAULT_OPEN_BUILDERS;
+  if (s->builder_count > STAMPDB_MAX_OPEN_BUILDERS) return STAMPDB_EINVAL;
+
+  // builder table + per-builder staging buffers sized for max rows
+  s->builders = (stampdb_builder_t*)ws_alloc(s, sizeof(stampdb_builder_t)*s->builder_count, _Alignof(stampdb_builder_t));
+  if (!s->builders) return STAMPDB_EINVAL;
+  memset(s->builders, 0, sizeof(stampdb_builder_t)*s->builder_count);
+  for (uint32_t i=0;i<s->builder_count;i++){
+    stampdb_builder_t *b = &s->builders[i];
+    b->deltas = (uint32_t*)ws_alloc(s, sizeof(uint32_t)*STAMPDB_BLOCK_MAX_ROWS, _Alignof(uint32_t));
+    b->qvals  = (int16_t*) ws_alloc(s, sizeof(int16_t)*STAMPDB_BLOCK_MAX_ROWS, _Alignof(int16_t));
+    b->vals   = (float*)   ws_alloc(s, sizeof(float)*STAMPDB_BLOCK_MAX_ROWS, _Alignof(float));
+    if (!b->deltas || !b->qvals || !b->vals) return STAMPDB_EINVAL;
+  }
+  if (latest_init(s, latest_slots)!=0) return STAMPDB_EINVAL;
+  if (bcache_init(s, block_cache_blocks)!=0) return STAMPDB_EINVAL;
+
+  // Recovery: try A/B snapshot, else scan
+  stampdb_snapshot_t snap; stampdb_snapshot_t *snap_ptr = NULL;
+  if (meta_load_snapshot(s, &snap)==0){ snap_ptr = &snap; }
+  if (ring_scan_and_recover(s, snap_ptr, lazy) != 0) return STAMPDB_EINVAL;
+  if (cfg->page_index){
+    s->pidx = (page_index_t*)ws_alloc(s, sizeof(page_index_t)*(size_t)s->seg_count*STAMPDB_DATA_PAGES_PER_SEG, _Alignof(page_index_t));
+    if (!s->pidx) return STAMPDB_EINVAL;
+    recovery_rebuild_page_index(s);
+  }
+  // after recovery, so its repairs hit flash before open returns
+  if (wb_init(s, write_behind_pages)!=0) return STAMPDB_EINVAL;
+  return STAMPDB_OK;
+}
+
+/**
+ * @brief Open the rollup tier as a second state in the workspace, on its own partition:
+ * every series lossless, synchronous flash, the main latest cache unused (minimum size),
+ * no block cache. Its completeness window starts past the newest raw row, since rows
+ * published before a power cut may have left their bucket accumulators unemitted.
+ */
+static stampdb_rc rollup_open(stampdb_state_t *s, const stampdb_cfg_t *cfg){
+  uint32_t base = cfg->rollup_flash_base, bytes = cfg->rollup_flash_bytes, tb = cfg->rollup_bucket_ms;
+  if (tb < STAMPDB_ROLLUP_FIELDS || !bytes) return STAMPDB_EINVAL;
+  if (base < s->flash_base + s->flash_bytes && s->flash_base < base + bytes) return STAMPDB_EINVAL; // overlaps the main partition
+  stampdb_state_t *t = (stampdb_state_t*)ws_alloc(s, sizeof(stampdb_state_t), _Alignof(stampdb_state_t));
+  if (!t) return STAMPDB_EINVAL;
+  memset(t, 0, sizeof(*t));
+  t->ws_begin = s->ws_begin; t->ws_size = s->ws_size; t->ws_cur = s->ws_cur;
+  t->rollup_tier = true; t->perf = s->perf;
+  stampdb_rc rc = state_open(t, cfg, base, bytes, 1u, 0u, 0u, false);
+  s->ws_cur = t->ws_cur;
+  if (rc != STAMPDB_OK) return rc;
+  s->tier = t; s->rollup_bucket_ms = tb;
+  bool any = false;
+  for (uint32_t i=0;i<s->seg_count;i++){
+    const seg_summary_t *sm = &s->segs[i];
+    if (!sm->valid || sm->block_count==0) continue;
+    if (!any || sm->t_max > s->ru_max) s->ru_max = sm->t_max;
+    any = true;
+  }
+  uint64_t lo = any ? (uint64_t)(s->ru_max - s->ru_max % tb) + tb : 0u;
+  s->ru_lo = s->ru_hi = lo > 0xFFFFFFFFu ? 0xFFFFFFFFu : (uint32_t)lo;
+  return STAMPDB_OK;
+}
+
 /**
  * @brief Open DB and recover ring state; allocate buffers in workspace.
  */
@@ -108,76 +328,210 @@ stampdb_rc stampdb_open(stampdb_t **db, const stampdb_cfg_t *cfg){
   s->ws_begin = (uint8_t*)cfg->workspace;
   s->ws_size = cfg->workspace_bytes;
   s->ws_cur = (uint8_t*)cfg->workspace + sizeof(*inst);
-  s->read_batch_rows = cfg->read_batch_rows ? cfg->read_batch_rows : 256;
-  s->commit_interval_ms = cfg->commit_interval_ms;
-
-  // staging buffers sized for max rows
-  s->stg_deltas = (uint32_t*)ws_alloc(s, sizeof(uint32_t)*74, _Alignof(uint32_t));
-  s->stg_qvals  = (int16_t*) ws_alloc(s, sizeof(int16_t)*74, _Alignof(int16_t));
-  s->stg_vals   = (float*)   ws_alloc(s, sizeof(float)*74, _Alignof(float));
-  if (!s->stg_deltas || !s->stg_qvals || !s->stg_vals) return STAMPDB_EINVAL;
-
-  // Recovery: try A/B snapshot, else scan
-  stampdb_snapshot_t snap; stampdb_snapshot_t *snap_ptr = NULL;
-  if (meta_load_snapshot(&snap)==0){ snap_ptr = &snap; }
-  if (ring_scan_and_recover(s, snap_ptr) != 0) return STAMPDB_EINVAL;
+#if STAMPDB_ENABLE_PERF
+  // first, so recovery and meta loads are already counted
+  if (cfg->perf){
+    s->perf = (stampdb_perf_t*)ws_alloc(s, sizeof(stampdb_perf_t), _Alignof(stampdb_perf_t));
+    if (!s->perf) return STAMPDB_EINVAL;
+    memset(s->perf, 0, sizeof(*s->perf)); s->perf->enabled = 1;
+  }
+#endif
+  s->tolerance = (float*)ws_alloc(s, sizeof(float)*STAMPDB_SERIES_EXACT, _Alignof(float));
+  if (!s->tolerance) return STAMPDB_EINVAL;
+  for (uint32_t i=0;i<STAMPDB_SERIES_EXACT;i++) s->tolerance[i] = STAMPDB_TOLERANCE_DEFAULT;
 
+  // the tier seeds its completeness window from the full main zone map: eager then
+  stampdb_rc rc = state_open(s, cfg, cfg->flash_base, cfg->flash_bytes, cfg->latest_slots, cfg->write_behind_pages,
+                             cfg->concurrent_readers ? 0u : cfg->block_cache_blocks, cfg->lazy_recovery && !cfg->rollup_bucket_ms);
+  if (rc == STAMPDB_OK && cfg->rollup_bucket_ms) rc = rollup_open(s, cfg);
+  if (rc != STAMPDB_OK) return rc;
   *db = inst;
   return STAMPDB_OK;
 }
 
-/** @brief Close DB; storage state remains intact. */
-void stampdb_close(stampdb_t *db){ (void)db; }
+/** @brief Close DB: issue queued flash ops; storage state remains intact. */
+void stampdb_close(stampdb_t *db){ if (db){ wb_sync(&db->s); if (db->s.tier) wb_sync(db->s.tier); } }
 
 /**
  * @brief Append a single sample; may trigger GC and/or finalize blocks.
  */
 stampdb_rc stampdb_write(stampdb_t *db, uint16_t series, uint32_t ts_ms, float value){
-  if (!db || series>=STAMPDB_MAX_SERIES) return STAMPDB_EINVAL;
-  stampdb_state_t *s=&db->s;
-  // retention/GC
-  int rc = ring_gc_reclaim_if_needed(s, false);
-  if (rc==STAMPDB_EBUSY) return STAMPDB_EBUSY;
+  return stampdb_write_batch(db, series, &ts_ms, &value, 1);
+}
 
-  // epoch wrap detection: increment epoch if ts wraps by more than half range
-  if (s->blocks_written>0){
-    if (ts_ms < s->last_ts_observed && (s->last_ts_observed - ts_ms) > 0x80000000u){
-      s->epoch_id++;
-    }
+/**
+ * @brief Append a column of samples for one series.
+ *
+ * Rows are staged in block-sized chunks; the GC watermark is checked once per
+ * chunk rather than once per row.
+ */
+stampdb_rc stampdb_write_batch(stampdb_t *db, uint16_t series, const uint32_t *ts_ms, const float *values, size_t n){
+  if (!db || series>=STAMPDB_MAX_SERIES || (n && (!ts_ms || !values))) return STAMPDB_EINVAL;
+  stampdb_state_t *s=&db->s;
+  uint64_t pt = perf_begin(s);
+  stampdb_rc rc = STAMPDB_OK; size_t i=0;
+  while (i<n){
+    // retention/GC
+    int gc = ring_gc_reclaim_if_needed(s, false);
+    if (gc!=0){ rc = (stampdb_rc)gc; break; }
+    i += push_run(s, series, ts_ms+i, values+i, n-i);
   }
-  s->last_ts_observed = ts_ms;
-
-  push_sample(s, series, ts_ms, value);
+  perf_end(s, STAMPDB_PERF_WRITE, pt);
+  return rc;
+}
 
-  // commit by size only if commit_interval_ms==0 or on block close
-  if (s->cur_count>=74) finalize_and_write_block(s);
+/** @brief Append samples for mixed series; consecutive rows of the same series are staged as one run. */
+stampdb_rc stampdb_write_batch_multi(stampdb_t *db, const uint16_t *series, const uint32_t *ts_ms, const float *values, size_t n){
+  if (!db || (n && (!series || !ts_ms || !values))) return STAMPDB_EINVAL;
+  size_t i=0;
+  while (i<n){
+    size_t j=i+1; while (j<n && series[j]==series[i]) j++;
+    stampdb_rc rc = stampdb_write_batch(db, series[i], ts_ms+i, values+i, j-i);
+    if (rc!=STAMPDB_OK) return rc;
+    i=j;
+  }
   return STAMPDB_OK;
 }
 
-/** @brief Force publish of current block. */
+/**
+ * @brief Flush half of the rollup tier: emit every accumulator, publish the tier's open
+ * blocks, then extend the completeness window past the newest row written.
+ */
+static int rollup_flush(stampdb_state_t *s){
+  stampdb_state_t *t = s->tier;
+  uint32_t tb = s->rollup_bucket_ms;
+  for (uint32_t i=0;i<s->builder_count;i++) rollup_emit(s, &s->builders[i]);
+  for (uint32_t i=0;i<t->builder_count;i++) finalize_and_write_block(t, &t->builders[i]);
+  if (wb_sync(t)!=0) return -1;
+  uint64_t hi = (uint64_t)(s->ru_max - s->ru_max % tb) + tb;
+  if (hi > 0xFFFFFFFFu) hi = s->ru_max - s->ru_max % tb; // top bucket never claimed
+  if (hi > s->ru_hi){ zm_write_begin(s); s->ru_hi = (uint32_t)hi; zm_write_end(s); }
+  return 0;
+}
+
+/** @brief Force publish of every open block; durability barrier for write-behind ops (and the rollup tier). */
 stampdb_rc stampdb_flush(stampdb_t *db){
   if (!db) return STAMPDB_EINVAL;
   stampdb_state_t *s=&db->s;
-  finalize_and_write_block(s);
+  uint64_t pt = perf_begin(s);
+  for (uint32_t i=0;i<s->builder_count;i++) finalize_and_write_block(s, &s->builders[i]);
+  int rc = wb_sync(s);
+  if (s->tier && rollup_flush(s)!=0) rc = -1;
+  perf_end(s, STAMPDB_PERF_FLUSH, pt);
+  return rc==0 ? STAMPDB_OK : STAMPDB_EIO;
+}
+
+/**
+ * @brief Publish the open blocks of one ring whose deadline passed, plus (in the same
+ * pass) those due within the group window, so slow series share the publish burst.
+ */
+static void commit_due(stampdb_state_t *s, uint32_t now_ms){
+  uint32_t ahead = s->commit_interval_ms / STAMPDB_COMMIT_GROUP_DIV;
+  bool expired = false;
+  for (uint32_t i=0;i<s->builder_count;i++){
+    const stampdb_builder_t *b = &s->builders[i];
+    if (b->count && (int32_t)(now_ms - b->deadline_ms) >= 0){ expired = true; break; }
+  }
+  if (!expired) return;
+  for (uint32_t i=0;i<s->builder_count;i++){
+    stampdb_builder_t *b = &s->builders[i];
+    if (!b->count || (int32_t)(now_ms + ahead - b->deadline_ms) < 0) continue;
+    finalize_and_write_block(s, b); s->tick_commits++;
+  }
+}
+
+/**
+ * @brief Advance the tick clock new blocks' deadlines start from. Blocks opened before the
+ * first tick have no clock to measure against: their deadline starts at that tick.
+ */
+static void commit_clock(stampdb_state_t *s, uint32_t now_ms){
+  s->commit_clock_ms = now_ms;
+  if (s->commit_clock_valid) return;
+  s->commit_clock_valid = true;
+  for (uint32_t i=0;i<s->builder_count;i++) s->builders[i].deadline_ms = now_ms + s->commit_interval_ms;
+}
+
+/** @brief Deadline-driven group commit (see stampdb.h); also advances the clock new blocks' deadlines start from. */
+stampdb_rc stampdb_tick(stampdb_t *db, uint32_t now_ms){
+  if (!db) return STAMPDB_EINVAL;
+  stampdb_state_t *s=&db->s;
+  commit_clock(s, now_ms);
+  if (s->tier) commit_clock(s->tier, now_ms);
+  if (!s->commit_interval_ms) return STAMPDB_OK;
+  commit_due(s, now_ms);
+  if (s->tier) commit_due(s->tier, now_ms);
   return STAMPDB_OK;
 }
 
-/** @brief Persist A/B snapshot (head/tail/epoch). */
-stampdb_rc stampdb_snapshot_save(stampdb_t *db){
+/** @brief Issue queued write-behind ops for up to `budget_us` (at least one per call). */
+stampdb_rc stampdb_flash_step(stampdb_t *db, uint32_t budget_us){
   if (!db) return STAMPDB_EINVAL;
   stampdb_state_t *s=&db->s;
+  uint64_t t0 = platform_micros();
+  do {
+    if (wb_issue_one(s)!=0) return STAMPDB_EIO;
+  } while (s->wb.count && platform_micros() - t0 < budget_us);
+  return s->wb.count ? STAMPDB_EBUSY : STAMPDB_OK;
+}
+
+/** @brief Set a series' value tolerance; applies from its next block. */
+stampdb_rc stampdb_set_tolerance(stampdb_t *db, uint16_t series, float max_abs_err){
+  if (!db || series>=STAMPDB_MAX_SERIES || max_abs_err != max_abs_err) return STAMPDB_EINVAL;
+  stampdb_state_t *s = &db->s;
+  float tol = max_abs_err < 0.0f ? STAMPDB_TOLERANCE_DEFAULT : max_abs_err;
+  if (series < STAMPDB_SERIES_EXACT){ s->tolerance[series] = tol; return STAMPDB_OK; }
+  uint32_t i = 0;
+  while (i < s->tol_ext_count && s->tol_ext[i].series != series) i++;
+  if (tol == STAMPDB_TOLERANCE_DEFAULT){ if (i < s->tol_ext_count) s->tol_ext[i] = s->tol_ext[--s->tol_ext_count]; return STAMPDB_OK; }
+  if (i == s->tol_ext_count){
+    if (i == STAMPDB_TOLERANCE_EXT_SLOTS) return STAMPDB_ENOSPACE;
+    s->tol_ext_count++;
+  }
+  s->tol_ext[i].series = series; s->tol_ext[i].tol = tol;
+  return STAMPDB_OK;
+}
+
+/** @brief Run idle-time GC for up to `budget_us` (see ring_gc_step); the rollup tier's once the main ring has none left. */
+stampdb_rc stampdb_gc_step(stampdb_t *db, uint32_t budget_us){
+  if (!db) return STAMPDB_EINVAL;
+  uint64_t pt = perf_begin(&db->s);
+  stampdb_rc rc = ring_gc_step(&db->s, budget_us);
+  if (rc == STAMPDB_OK && db->s.tier) rc = ring_gc_step(db->s.tier, budget_us);
+  perf_end(&db->s, STAMPDB_PERF_GC_STEP, pt);
+  return rc;
+}
+
+/** @brief Settle a lazy open's pending zone-map entries for up to `budget_us` (see ring_recover_step). */
+stampdb_rc stampdb_recover_step(stampdb_t *db, uint32_t budget_us){
+  if (!db) return STAMPDB_EINVAL;
+  return ring_recover_step(&db->s, budget_us);
+}
+
+/** @brief Zone-map checkpoint, then the A/B snapshot (head/tail/epoch) of one ring; 0 when both are on flash. */
+static int state_snapshot_save(stampdb_state_t *s){
+  if (s->lazy) ring_recover_step(s, UINT32_MAX); // the checkpoint and tail need the whole zone map
   stampdb_snapshot_t snap={0};
   snap.version = 1;
   snap.epoch_id = s->epoch_id;
   snap.seg_seq_head = s->head.seg_seqno;
-  // choose tail as oldest valid seg
-  uint32_t oldest = 0xFFFFFFFFu; for (uint32_t i=0;i<s->seg_count;i++) if (s->segs[i].valid && s->segs[i].block_count>0 && s->segs[i].seg_seqno<oldest) oldest=s->segs[i].seg_seqno;
-  if (oldest==0xFFFFFFFFu) oldest=s->head.seg_seqno;
-  snap.seg_seq_tail = oldest;
+  snap.seg_seq_tail = s->tail_seqno;
   snap.head_addr = s->head.addr;
   snap.crc = 0; snap.crc = crc32c(&snap, sizeof(snap));
-  if (meta_save_snapshot(&snap)!=0) return STAMPDB_EIO;
-  return STAMPDB_OK;
+  int rc = meta_save_zonemap(s);
+  if (rc==0) rc = meta_save_snapshot(s, &snap);
+  if (wb_sync(s)!=0) rc = -1;
+  return rc;
+}
+
+/** @brief Persist the zone-map checkpoint, then the A/B snapshot, of the main ring and the rollup tier. */
+stampdb_rc stampdb_snapshot_save(stampdb_t *db){
+  if (!db) return STAMPDB_EINVAL;
+  stampdb_state_t *s=&db->s;
+  uint64_t pt = perf_begin(s);
+  int rc = state_snapshot_save(s);
+  if (s->tier && state_snapshot_save(s->tier)!=0) rc = -1;
+  perf_end(s, STAMPDB_PERF_SNAPSHOT, pt);
+  return rc==0 ? STAMPDB_OK : STAMPDB_EIO;
 }
 
 /** @brief Populate lightweight stats; pointers may be NULL. */
@@ -190,5 +544,25 @@ void stampdb_info(stampdb_t *db, stampdb_stats_t* out){
   out->crc_errors=s->crc_errors; 
   out->gc_warn_events=s->gc_warn_events; 
   out->gc_busy_events=s->gc_busy_events; 
+  out->gc_deferred_events=s->gc_deferred_events;
+  out->gc_preerase_hits=s->gc_preerase_hits;
+  out->recovery_footer_reads=s->recovery_footer_reads;
   out->recovery_truncations=s->recovery_truncations; 
+  out->recovery_pending_segs=s->lazy_left;
+  out->recovery_ready=!s->lazy;
+  out->workspace_used_bytes=(uint32_t)(s->ws_cur - s->ws_begin);
+  out->page_index_bytes=s->pidx ? (uint32_t)(sizeof(page_index_t)*s->seg_count*STAMPDB_DATA_PAGES_PER_SEG) : 0;
+  out->index_skipped_pages=s->pidx_skipped_pages;
+  out->agg_segments_pushdown=s->agg_segments_pushdown;
+  out->agg_blocks_pushdown=s->agg_blocks_pushdown;
+  out->agg_blocks_decoded=s->agg_blocks_decoded;
+  out->wb_depth=s->wb.count;
+  out->wb_hwm=s->wb.hwm;
+  out->wb_full_stalls=s->wb.full_stalls;
+  out->wb_read_drains=s->wb.read_drains;
+  out->reader_retries=s->reader_retries;
+  out->latest_evictions=s->latest_evictions; out->latest_misses=s->latest_misses;
+  out->rollup_points=s->rollup_points; out->agg_rollup_points=s->agg_rollup_points;
+  out->tick_commits=s->tick_commits;
+  out->block_cache_hits=s->bc_hits; out->block_cache_misses=s->bc_misses;
 }
@@ -11,9 +11,14 @@
  *
  * Constraints:
  *  - No external allocations; all pointers derive from `stampdb_cfg_t.workspace`
+ *  - Flash addresses are relative to the DB's partition (`flash_base`); only the
+ *    flash_* wrappers below add the base before calling the platform
  *  - Flash ops obey 4 KiB erase / 256 B program; header-last commit ordering
+ *  - One writer thread; readers on other threads/cores see the zone map, head,
+ *    page index and latest table only through the `zm_seq` seqlock (zm_read_*)
  */
 #pragma once
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
@@ -32,18 +37,60 @@ extern "C" {
 #define STAMPDB_PAYLOAD_BYTES 224u
 #define STAMPDB_HEADER_BYTES   32u
 
-#define STAMPDB_BLOCK_MAGIC 0x424C4B31u /* 'BLK1' */
-#define STAMPDB_FOOTER_MAGIC 0x53464731u /* 'SFG1' */
+#define STAMPDB_BLOCK_MAGIC 0x424C4B32u /* 'BLK2': v2 header with block aggregates */
+#define STAMPDB_BLOCK_MAGIC_V1 0x424C4B31u /* 'BLK1': still readable, no aggregates */
+#define STAMPDB_HDR_DT_MASK 0x1Fu     // header byte 12: timestamp lane (8/16 = delta width, or STAMPDB_DT_DOD)
+#define STAMPDB_DT_DOD 1u             // timestamp lane: u32 first delta, u8 width, bit-packed zigzag delta-of-deltas
+#define STAMPDB_HDR_VAL_SHIFT 5u      // header byte 12 bits 5..6: value lane (STAMPDB_VAL_*)
+#define STAMPDB_HDR_VAL_MASK 0x60u
+#define STAMPDB_HDR_AGG_EXACT 0x80u   // header byte 12: min/max/sum derivable from header
 
-#define STAMPDB_SERIES_BITMAP_BYTES 32u // 256-bit
-#define STAMPDB_MAX_SERIES 256u
+/* Value lanes: Fixed-point at 16/12/8 bits (bit-packed LSB-first) or lossless XOR-float. */
+#define STAMPDB_VAL_Q16 0u            // legacy lane (v1 blocks, zero bits on v2)
+#define STAMPDB_VAL_Q8  1u
+#define STAMPDB_VAL_Q12 2u
+#define STAMPDB_VAL_XOR 3u            // Gorilla-style: raw first value, then XOR vs previous
+#define STAMPDB_FOOTER_MAGIC 0x53464731u /* 'SFG1': series set is an exact 256-bit bitmap */
+#define STAMPDB_FOOTER_MAGIC_BLOOM 0x53464732u /* 'SFG2': series set is a 256-bit Bloom filter */
+
+/* Per-segment series set: exact bitmap while every id is < 256, else a one-block Bloom filter. */
+#define STAMPDB_SERIES_FILTER_BYTES 32u // 256 bits either way
+#define STAMPDB_SERIES_EXACT 256u       // ids below this fit the exact bitmap
+#define STAMPDB_SERIES_BLOOM_K 4u       // bits per id; <= 15 ids per segment: ~0.2% false positives
+#define STAMPDB_MAX_SERIES 0xFFFFu      // ids 0..0xFFFE; 0xFFFF is the "no series" sentinel (STAMPDB_PIDX_EMPTY)
+
+/* Latest-row cache: open addressing over `latest_slots` entries keyed by series. */
+#define STAMPDB_DEFAULT_LATEST_SLOTS 256u
+#define STAMPDB_LATEST_PROBE 8u         // victim search window for a new series
+#define STAMPDB_LATEST_SEED_BLOOM_SEGS 8u // open seeds from at most this many Bloom segments (rest: on demand)
+#define STAMPDB_TOLERANCE_EXT_SLOTS 32u // tolerances for ids >= STAMPDB_SERIES_EXACT
+
+/* Rollup tier (cfg.rollup_bucket_ms): one point = 4 rows at bucket_start + field. */
+#define STAMPDB_ROLLUP_FIELDS 4u       // min, max, sum, count
+#define STAMPDB_ROLLUP_MIN_BUCKETS 4u  // narrower tier-servable middles stay on the raw ring
 #ifndef STAMPDB_META_RESERVED
-#define STAMPDB_META_RESERVED (32768u) // reserved at top of flash for snapshots + head hint (raw meta region)
+#define STAMPDB_META_RESERVED (32768u) // reserved at the top of each DB partition for snapshots, head hint, zone-map checkpoint (raw meta region)
 #endif
 #define STAMPDB_LAYOUT_VERSION 1
 
+/* GC: free-segment watermarks (percent of ring) and foreground reclaim quota. */
+#define STAMPDB_GC_WARN_FREE_PCT 10u
+#define STAMPDB_GC_BUSY_FREE_PCT 5u
+#define STAMPDB_GC_QUOTA_SEG_PER_SEC 2u
+#define STAMPDB_GC_PREERASE_AHEAD 2u // gc_step keeps this many segments erased beyond the watermark
+
+/* Writer block builders (one open block per series). */
+#define STAMPDB_DEFAULT_OPEN_BUILDERS 4u
+#define STAMPDB_MAX_OPEN_BUILDERS 64u
+#define STAMPDB_COMMIT_GROUP_DIV 4u // a tick publishing an expired block also takes those due within interval/4
+
+/* Optional per-page index (cfg.page_index): one 8 B entry per data page. */
+#define STAMPDB_PIDX_EMPTY 0xFFFFu     // series value marking an unwritten/invalid page
+#define STAMPDB_PIDX_SPAN_UNIT_MS 16u  // span granularity; rounded up, 0xFFFF = unbounded
+
 static inline bool ts_le(uint32_t a, uint32_t b){ return (uint32_t)(b - a) < 0x80000000u; }
 static inline bool ts_ge(uint32_t a, uint32_t b){ return ts_le(b,a); }
+static inline bool ts_lt(uint32_t a, uint32_t b){ return !ts_le(b,a); }
 static inline bool ts_in_range(uint32_t t, uint32_t t0, uint32_t t1){
   if (ts_le(t0, t1)) return ts_le(t0, t) && ts_le(t, t1);
   // wrapped window
@@ -54,11 +101,18 @@ static inline bool ts_in_range(uint32_t t, uint32_t t0, uint32_t t1){
 _Static_assert(sizeof(float) == 4, "float must be 4 bytes (binary32)");
 _Static_assert(sizeof(uint32_t) == 4, "uint32_t must be 4 bytes");
 
-/** @brief Compute CRC32C (Castagnoli) over a buffer. */
+/** @brief Compute CRC32C (Castagnoli) over a buffer (dispatches to the fastest kernel). */
 uint32_t crc32c(const void *data, size_t len);
+/* Individual CRC32C kernels (tests/bench); all return the same value as crc32c(). */
+uint32_t crc32c_bytewise(const void *data, size_t len);
+uint32_t crc32c_sw(const void *data, size_t len);
+uint32_t crc32c_hw(const void *data, size_t len); // only meaningful when crc32c_hw_available()
+int crc32c_hw_available(void);
+const char *crc32c_hw_name(void);
 
 /* Platform glue for clock and flash I/O (host/pico). */
 uint64_t platform_millis(void);
+uint64_t platform_micros(void);
 int platform_flash_read(uint32_t addr, void *dst, size_t len);
 int platform_flash_erase_4k(uint32_t addr);
 int platform_flash_program_256(uint32_t addr, const void *src);
@@ -74,10 +128,36 @@ typedef struct {
   uint32_t crc;
 } stampdb_snapshot_t;
 
-int meta_load_snapshot(stampdb_snapshot_t *out);
-int meta_save_snapshot(const stampdb_snapshot_t *snap);
-int meta_load_head_hint(uint32_t *addr_out, uint32_t *seq_out);
-int meta_save_head_hint(uint32_t addr, uint32_t seq);
+/** @brief Append cursor of one meta record log (RAM; rebuilt by its first load/append after open). */
+typedef struct {
+  uint32_t next_seq;
+  uint16_t next_page; // within the log
+  bool     scanned;
+} meta_log_t;
+
+/**
+ * @brief Write-behind flash queue (cfg.write_behind_pages): erases and page programs
+ * staged in workspace slots and issued strictly in order, so header-last publishes and
+ * meta commit orders hold on flash exactly as issued. slots == 0: synchronous I/O.
+ */
+typedef struct {
+  uint32_t *addr;   // per slot: target address | WB_ERASE
+  uint8_t  *pages;  // per slot: 256 B page image (unused by erases)
+  uint32_t slots, head, count; // FIFO; oldest op at `head`
+  uint32_t hwm;          // deepest queue seen
+  uint32_t full_stalls;  // enqueues that had to issue the oldest op first
+  uint32_t read_drains;  // reads that overlapped a queued op and drained the queue
+  int      error;        // first failed op since the last barrier (queue dropped behind it; enqueues refused)
+} wb_queue_t;
+#define WB_ERASE 1u // low address bit: slot is a 4 KiB erase (page/sector addresses are aligned)
+
+typedef struct stampdb_state stampdb_state_t;
+int meta_load_snapshot(stampdb_state_t *s, stampdb_snapshot_t *out);
+int meta_save_snapshot(stampdb_state_t *s, const stampdb_snapshot_t *snap);
+int meta_load_head_hint(stampdb_state_t *s, uint32_t *addr_out, uint32_t *seq_out);
+int meta_save_head_hint(stampdb_state_t *s, uint32_t addr, uint32_t seq);
+int meta_save_zonemap(stampdb_state_t *s);
+int meta_load_zonemap(stampdb_state_t *s, uint32_t *head_idx, uint32_t *head_seq);
 
 /* Block header used for publish (payload CRC, header CRC). */
 typedef struct {
@@ -85,21 +165,96 @@ typedef struct {
   uint16_t series;
   uint16_t count;
   uint32_t t0_ms;
-  uint8_t  dt_bits; // 8 or 16
+  uint8_t  dt_bits; // timestamp lane: 8 or 16 (delta width) or STAMPDB_DT_DOD
+  uint8_t  val_lane; // STAMPDB_VAL_* (v1: always Q16)
   float    bias;
   float    scale;
   uint32_t payload_crc;
   uint32_t header_crc;
+  uint8_t  version;   // 1 = 'BLK1', 2 = 'BLK2' (set by unpack)
+  bool     agg_exact; // extremes quantized to +/-codec_qlim() (v2, quantized lanes only)
+  int32_t  qsum;      // sum of qvals, int24 on flash (v2)
 } block_header_t;
 
-/** @brief Encode deltas+qvals into 224B payload; zero-fills remainder. */
-size_t codec_encode_payload(uint8_t *dst224, uint8_t dt_bits, const uint32_t *ts_deltas, const int16_t *qvals, uint16_t count);
-/** @brief Decode payload into caller buffers (deltas then qvals). */
-size_t codec_decode_payload(const uint8_t *src224, uint8_t dt_bits, uint32_t *ts_deltas, int16_t *qvals, uint16_t count);
+/** @brief Dequantize one Fixed16 value; the single formula shared by readers and aggregates (callers build without FMA contraction). */
+static inline float codec_dequant(float bias, float scale, int16_t q){ return bias + scale * (float)q; }
+
+/** @brief Bits per value of a quantized lane (0 for the XOR lane). */
+static inline uint8_t codec_val_bits(uint8_t lane){ return lane==STAMPDB_VAL_Q8 ? 8u : lane==STAMPDB_VAL_Q12 ? 12u : lane==STAMPDB_VAL_Q16 ? 16u : 0u; }
+/** @brief Largest quantized magnitude of a lane; block extremes map to +/- this. */
+static inline int32_t codec_qlim(uint8_t lane){ return (1 << (codec_val_bits(lane) - 1u)) - 1; }
+
+/** @brief Running state of the XOR-float lane; each row's cost depends on the previous row. */
+typedef struct {
+  uint32_t prev; // previous value's bits
+  uint8_t  lead; // current meaningful-bit window: leading zeros ...
+  uint8_t  len;  // ... and length (0 = no window yet)
+} codec_xor_t;
+
+/**
+ * @brief Bits the XOR lane spends on row `row` with float bits `v`; advances `x`.
+ * Row 0 is raw (32); then '0' for a repeat, '10'+window bits when the XOR fits the
+ * previous window, else '11' + 5b leading zeros + 5b (length-1) + meaningful bits.
+ */
+static inline uint32_t codec_xor_cost(codec_xor_t *x, uint32_t v, uint16_t row){
+  if (row == 0){ x->prev = v; x->lead = 0; x->len = 0; return 32u; }
+  uint32_t d = v ^ x->prev; x->prev = v;
+  if (!d) return 1u;
+  uint8_t lead = (uint8_t)__builtin_clz(d), trail = (uint8_t)__builtin_ctz(d);
+  if (x->len && lead >= x->lead && 32u - trail <= (uint32_t)x->lead + x->len) return 2u + x->len;
+  x->lead = lead; x->len = (uint8_t)(32u - lead - trail);
+  return 12u + x->len;
+}
+
+/** @brief Bytes of a value lane for `count` rows (`xor_bits` = summed codec_xor_cost for the XOR lane). */
+static inline size_t codec_val_lane_bytes(uint8_t lane, uint16_t count, uint32_t xor_bits){
+  return lane==STAMPDB_VAL_XOR ? (xor_bits + 7u) >> 3 : ((size_t)count * codec_val_bits(lane) + 7u) >> 3;
+}
+
+/* Bulk decode kernels (codec_simd.c): vector set selected at build time. Lanes are
+ * little-endian bytes; dequantization matches codec_dequant() exactly. */
+void     codec_widen_u8(uint32_t *dst, const uint8_t *src, size_t n);
+void     codec_widen_u16le(uint32_t *dst, const uint8_t *src, size_t n);
+/** @brief times[i] = t0 + deltas[0..i] (mod 2^32); returns the last time (t0 if n is 0). */
+uint32_t codec_prefix_sum(uint32_t *times, const uint32_t *deltas, size_t n, uint32_t t0);
+void     codec_dequant_i16le(float *dst, const uint8_t *src, size_t n, float bias, float scale);
+void     codec_dequant_i8(float *dst, const uint8_t *src, size_t n, float bias, float scale);
+/** @brief One kernel set; tests/bench compare `codec_kernels_active` against the scalar set. */
+typedef struct {
+  const char *name;
+  void     (*widen_u8)(uint32_t *dst, const uint8_t *src, size_t n);
+  void     (*widen_u16le)(uint32_t *dst, const uint8_t *src, size_t n);
+  uint32_t (*prefix_sum)(uint32_t *times, const uint32_t *deltas, size_t n, uint32_t t0);
+  void     (*dequant_i16le)(float *dst, const uint8_t *src, size_t n, float bias, float scale);
+  void     (*dequant_i8)(float *dst, const uint8_t *src, size_t n, float bias, float scale);
+} codec_kernels_t;
+extern const codec_kernels_t codec_kernels_scalar;
+extern const codec_kernels_t codec_kernels_active;
+
+/** @brief Zigzag-map a signed delta-of-delta so small magnitudes get few bits. */
+static inline uint32_t codec_zigzag(int32_t v){ return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+/** @brief Bits needed to store `v` (0 for 0). */
+static inline uint8_t codec_bit_width(uint32_t v){ uint8_t w=0; while (v){ w++; v >>= 1; } return w; }
+/** @brief Bytes of a delta-of-delta timestamp lane for `count` rows at `w` bits per dod. */
+static inline size_t codec_dod_lane_bytes(uint16_t count, uint8_t w){ return 5u + (((size_t)(count > 2 ? count - 2 : 0) * w + 7u) >> 3); }
+
+/**
+ * @brief Encode a block's lanes (h->dt_bits, h->val_lane, h->count) into the 224 B payload
+ * (0xFF-fills remainder); quantized lanes read `qvals`, the XOR lane `vals`. 0 if they do not fit.
+ */
+size_t codec_encode_payload(uint8_t *dst224, const block_header_t *h, const uint32_t *ts_deltas, const int16_t *qvals, const float *vals);
+/** @brief Decode payload into deltas and dequantized (or exact, XOR lane) values; 0 on a malformed lane. */
+size_t codec_decode_payload(const uint8_t *src224, const block_header_t *h, uint32_t *ts_deltas, float *values);
 /** @brief Serialize header (includes header CRC over bytes 0..27). */
 void   codec_pack_header(uint8_t out32[STAMPDB_HEADER_BYTES], const block_header_t *h);
 /** @brief Parse header and verify header CRC. */
 bool   codec_unpack_header(block_header_t *h, const uint8_t in32[STAMPDB_HEADER_BYTES]);
+/** @brief Value of the block's last row (dequantized, or exact for the XOR lane). */
+float  codec_block_last_value(const block_header_t *h, const uint8_t *payload);
+/** @brief Min/max/sum from a v2 header; false if the block must be decoded instead. */
+bool   codec_block_aggregate(const block_header_t *h, float *min_out, float *max_out, float *sum_out);
+/** @brief Timestamp of the last row (t0 + sum of deltas) without decoding values. */
+uint32_t codec_block_last_ts(const block_header_t *h, const uint8_t *payload);
 
 // Ring manager
 typedef struct {
@@ -108,10 +263,32 @@ typedef struct {
   uint32_t t_min;
   uint32_t t_max;
   uint32_t block_count;
-  uint8_t  series_bitmap[STAMPDB_SERIES_BITMAP_BYTES];
+  uint8_t  series_filter[STAMPDB_SERIES_FILTER_BYTES]; // exact bitmap ('SFG1') or Bloom filter ('SFG2')
   uint32_t crc;
 } seg_footer_t;
 
+/**
+ * @brief Per-series rollup of one segment, stored in the footer page after seg_footer_t.
+ * rows == STAMPDB_ROLLUP_UNUSABLE: a block lacked exact aggregates; decode instead.
+ */
+typedef struct {
+  uint16_t series;
+  uint16_t rows;
+  uint32_t t_min, t_max;
+  float    min, max, sum;
+} seg_rollup_t;
+
+#define STAMPDB_FOOTER_ROLLUPS 8u
+#define STAMPDB_ROLLUP_UNUSABLE 0xFFFFu
+/** @brief Rollup table (first STAMPDB_FOOTER_ROLLUPS series of a segment; others absent). */
+typedef struct {
+  uint16_t n;        // 0xFFFF on a blank page
+  uint16_t reserved;
+  seg_rollup_t r[STAMPDB_FOOTER_ROLLUPS];
+  uint32_t crc;      // CRC32C over the table with crc=0
+} seg_rollup_table_t;
+_Static_assert(sizeof(seg_footer_t) + sizeof(seg_rollup_table_t) <= STAMPDB_PAGE_BYTES, "footer + rollups must fit one page");
+
 typedef struct {
   uint32_t addr; // absolute addr in flash to next free page start
   uint16_t page_index; // within current segment [0..15)
@@ -124,59 +301,367 @@ typedef struct {
   uint32_t t_min;
   uint32_t t_max;
   uint32_t block_count;
-  uint8_t  series_bitmap[STAMPDB_SERIES_BITMAP_BYTES];
+  uint8_t  series_filter[STAMPDB_SERIES_FILTER_BYTES];
+  bool     series_bloom; // series_filter is a Bloom filter (some id >= STAMPDB_SERIES_EXACT)
   bool     valid;
+  bool     erased; // known all-0xFF since erase (RAM-only; false after open)
+  bool     erase_queued; // its erase still sits in the write-behind queue: flash may hold the previous lap
+  bool     erase_lost; // head only: its erase failed or was dropped; redone before the first program
+  bool     pending; // lazy open: footer not read yet (fields other than addr_first unset); in a reader's copy: read, not stored
 } seg_summary_t;
 
+/**
+ * @brief Per-page index entry: lets the iterator skip pages of other series or
+ * outside the query window without reading them. Conservative: `span` rounds up.
+ */
+typedef struct {
+  uint32_t t0;     // first row timestamp
+  uint16_t series; // STAMPDB_PIDX_EMPTY = no block
+  uint16_t span;   // (t_last - t0) in STAMPDB_PIDX_SPAN_UNIT_MS, saturating
+} page_index_t;
+_Static_assert(sizeof(page_index_t) == 8, "page index entry must stay 8 bytes");
+
+/**
+ * @brief Newest row of one series (RAM-only cache entry). page_addr locates the flash block
+ * the row lives in, or STAMPDB_LATEST_UNFLUSHED while it is still in an open builder
+ * (such entries are never evicted). valid=false with a key: the series has no retained rows.
+ */
+typedef struct {
+  uint32_t ts;
+  float    value;
+  uint32_t page_addr;
+  uint16_t series; // STAMPDB_PIDX_EMPTY = slot never used
+  bool     valid;
+} latest_entry_t;
+#define STAMPDB_LATEST_UNFLUSHED 0xFFFFFFFFu
+
+/**
+ * @brief Block cache key (cfg.block_cache_blocks): a published page is immutable until its
+ * segment is erased, so (page address, lap) identifies one decoded block for good.
+ */
+typedef struct {
+  uint32_t addr;      // page address; STAMPDB_BCACHE_FREE = unused
+  uint32_t seg_seqno; // lap of the owning segment when decoded
+  uint32_t last_use;  // LRU stamp (s->bc_tick)
+  uint16_t series;
+  uint16_t count;
+} bcache_key_t;
+/** @brief Rows of one cached block in the iterator's SoA form (times reconstructed). */
 typedef struct {
+  uint32_t times[STAMPDB_BLOCK_MAX_ROWS];
+  float    values[STAMPDB_BLOCK_MAX_ROWS];
+} bcache_rows_t;
+#define STAMPDB_BCACHE_FREE 0xFFFFFFFFu
+
+/** @brief Value tolerance override for an id >= STAMPDB_SERIES_EXACT. */
+typedef struct { uint16_t series; float tol; } tolerance_ext_t;
+
+/** @brief One open block for a series; staging arrays are carved from the workspace. */
+typedef struct {
+  uint16_t series;
+  uint16_t count;    // 0 = slot free
+  uint32_t t0;
+  uint32_t last_ts;
+  uint32_t max_dt;   // largest delta staged (u8/u16 lane eligibility)
+  uint8_t  dod_bits; // widest zigzag delta-of-delta staged (rows 2..)
+  uint8_t  val_lane; // narrowest value lane meeting `tol` for the rows staged
+  float    tol;      // series tolerance captured at block start (see stampdb_set_tolerance)
+  codec_xor_t xor_st; // XOR lane state after the last staged row
+  uint32_t xor_bits; // XOR lane bits for the rows staged
+  float    min;
+  float    max;
+  uint32_t last_use; // LRU stamp (s->use_tick at last append)
+  uint32_t deadline_ms; // commit deadline: tick clock at block start + commit_interval_ms
+  // rollup accumulator of `series` (rows of published blocks in one tier bucket; ru_n = 0: empty)
+  uint32_t ru_bucket, ru_n;
+  float    ru_min, ru_max, ru_sum;
+  uint32_t *deltas;  // up to STAMPDB_BLOCK_MAX_ROWS
+  int16_t  *qvals;
+  float    *vals;
+} stampdb_builder_t;
+
+struct stampdb_state {
   // workspace-backed containers
   uint8_t *ws_begin;
   uint32_t ws_size;
   uint8_t *ws_cur;
 
+  // flash partition: [flash_base, flash_base + flash_bytes) on the device, meta region at its top
+  uint32_t flash_base;
+  uint32_t flash_bytes;
+
   // zone map cache of all segments (constant RAM)
   seg_summary_t *segs;
   uint32_t seg_count;
   uint32_t used_seg_count; // segments with block_count>0
+  page_index_t *pidx;      // seg_count * DATA_PAGES_PER_SEG entries, or NULL (disabled)
+  seg_rollup_table_t head_rollups; // per-series rollups of the head segment (footer-bound)
+  latest_entry_t *latest; // latest_slots cache entries (workspace)
+  uint32_t latest_slots;   // power of two
+  uint32_t latest_probe;   // longest probe any entry needs (lookups stop here)
+  float *tolerance;        // STAMPDB_SERIES_EXACT value tolerances (workspace), STAMPDB_TOLERANCE_DEFAULT if unset
+  tolerance_ext_t tol_ext[STAMPDB_TOLERANCE_EXT_SLOTS]; // ids >= STAMPDB_SERIES_EXACT with a tolerance set
+  uint32_t tol_ext_count;
+  stampdb_perf_t *perf;    // latency histograms (workspace), or NULL (disabled/compiled out)
+  bool zm_sorted; // used segments contiguous in seqno order with monotonic t_min/t_max
+  _Atomic uint32_t zm_seq; // seqlock over segs/pidx/head_rollups/latest/head/zm_sorted: odd while the writer updates
+  uint32_t zm_wr_depth;    // writer-only nesting depth of zm_write_begin()
+  bool concurrent;         // cfg.concurrent_readers: query paths never drain the write-behind queue
 
   // ring head/tail
   ring_head_t head;
   uint32_t tail_seqno;
 
-  // write buffer for building blocks
-  uint16_t cur_series;
-  uint32_t cur_t0;
-  uint8_t  cur_dt_bits;
-  float    cur_min;
-  float    cur_max;
-  uint16_t cur_count;
-  uint32_t last_ts;
+  // open block builders (in workspace), evicted least-recently-used first
+  stampdb_builder_t *builders;
+  uint32_t builder_count;
+  uint32_t use_tick;
   uint32_t last_hint_ms;
   uint32_t last_ts_observed;
 
   uint32_t blocks_written;
-  uint32_t crc_errors;
+  _Atomic uint32_t crc_errors; // reader-side counters (stat_add): concurrent readers bump them
   uint32_t epoch_id;
   uint32_t gc_warn_events;
   uint32_t gc_busy_events;
+  uint32_t gc_deferred_events; // foreground reclaims skipped: quota window exhausted
+  uint32_t gc_preerase_hits;   // rotations that found the next segment already erased
+  uint64_t gc_window_start_ms; // foreground quota window
+  uint32_t gc_erased_in_window;
   uint32_t recovery_truncations;
-
-  // staging arrays (in workspace)
-  uint32_t *stg_deltas;  // up to 74/56
-  int16_t  *stg_qvals;
-  float    *stg_vals;
+  uint32_t recovery_footer_reads; // footer pages read by the last open (and its lazy completion)
+  uint32_t lazy_left;      // lazy open: zone-map entries still pending
+  uint32_t lazy_origin, lazy_cursor; // background settle order: physical slots backwards from the head at open
+  bool lazy;               // lazy open not finished (tail, sort flag, latest seeding wait for the last entry)
+  meta_log_t meta_snap_log;
+  meta_log_t meta_hint_log;
+  wb_queue_t wb;
+  _Atomic uint32_t pidx_skipped_pages; // pages skipped via the page index (no flash read)
+  _Atomic uint32_t agg_segments_pushdown, agg_blocks_pushdown, agg_blocks_decoded;
+  _Atomic uint32_t reader_retries;     // seqlock retries + segments a concurrent reader lost to GC
+  uint32_t latest_evictions;   // flushed latest entries replaced by another series
+  _Atomic uint32_t latest_misses; // latest queries answered from flash
+  bcache_key_t *bc_keys;       // block cache: bc_slots keys + rows (workspace), or NULL (disabled)
+  bcache_rows_t *bc_rows;
+  uint32_t bc_slots, bc_tick;
+  uint32_t bc_hits, bc_misses;
 
   uint32_t read_batch_rows;
-  uint32_t commit_interval_ms;
-} stampdb_state_t;
+  uint32_t commit_interval_ms; // 0 = blocks close by size/flush only
+  uint32_t commit_clock_ms;    // now_ms of the latest stampdb_tick (deadline base of new blocks)
+  bool     commit_clock_valid; // a tick happened: until then, open blocks get their deadline at the first one
+  uint32_t tick_commits;       // blocks published by deadline
+
+  // rollup tier: a second ring (own partition, lossless, synchronous) fed one point per
+  // series and bucket as raw blocks publish. The tier holds every row with ts in
+  // [ru_lo, ru_hi) (seqlock-published); older buckets only as far as it retains them.
+  stampdb_state_t *tier;   // NULL = no tier (and inside the tier itself)
+  bool rollup_tier;        // this state is a tier: every series stored lossless
+  uint32_t rollup_bucket_ms;
+  uint32_t ru_lo, ru_hi;   // completeness window, whole buckets
+  uint32_t ru_max;         // newest ts written (flush moves ru_hi past its bucket)
+  uint32_t rollup_points;  // points emitted into the tier
+  _Atomic uint32_t agg_rollup_points; // tier points aggregates used instead of raw rows
+};
 
 struct stampdb { stampdb_state_t s; };
 
+/* Perf instrumentation (src/perf.c). Compiled out unless STAMPDB_ENABLE_PERF; the
+ * inline wrappers below then reduce to the bare platform calls. */
+#ifndef STAMPDB_ENABLE_PERF
+#define STAMPDB_ENABLE_PERF 0
+#endif
+#if STAMPDB_ENABLE_PERF
+void perf_record(stampdb_perf_t *p, uint32_t op, uint64_t t0_us, uint32_t bytes);
+#endif
+/** @brief Start timestamp for perf_end (0 when perf is off). */
+static inline uint64_t perf_begin(const stampdb_state_t *s){
+#if STAMPDB_ENABLE_PERF
+  if (s->perf) return platform_micros();
+#endif
+  (void)s; return 0;
+}
+/** @brief Record one `op` that began at `t0_us`. */
+static inline void perf_end(stampdb_state_t *s, uint32_t op, uint64_t t0_us){
+#if STAMPDB_ENABLE_PERF
+  if (s->perf) perf_record(s->perf, op, t0_us, 0);
+#endif
+  (void)s; (void)op; (void)t0_us;
+}
+/** @brief Issue a flash op now (timed + byte-counted when perf is on); used by the write-behind worker. */
+static inline int flash_erase_now(stampdb_state_t *s, uint32_t addr){
+  addr += s->flash_base;
+#if STAMPDB_ENABLE_PERF
+  if (s->perf){ uint64_t t0 = platform_micros(); int r = platform_flash_erase_4k(addr); perf_record(s->perf, STAMPDB_PERF_FLASH_ERASE, t0, 4096u); return r; }
+#endif
+  return platform_flash_erase_4k(addr);
+}
+static inline int flash_program_now(stampdb_state_t *s, uint32_t addr, const void *src){
+  addr += s->flash_base;
+#if STAMPDB_ENABLE_PERF
+  if (s->perf){ uint64_t t0 = platform_micros(); int r = platform_flash_program_256(addr, src); perf_record(s->perf, STAMPDB_PERF_FLASH_PROGRAM, t0, 256u); return r; }
+#endif
+  return platform_flash_program_256(addr, src);
+}
+
+/* Write-behind queue (src/write_behind.c). */
+int  wb_init(stampdb_state_t *s, uint32_t slots);
+int  wb_enqueue(stampdb_state_t *s, uint32_t addr, const void *page);
+/** @brief Issue the oldest queued op; 0 when done or nothing queued, -1 on flash failure. */
+int  wb_issue_one(stampdb_state_t *s);
+/** @brief Issue every queued op (no error reset). */
+void wb_drain(stampdb_state_t *s);
+/** @brief Durability barrier: drain, then return and clear the sticky error (0 = all ops landed). */
+int  wb_sync(stampdb_state_t *s);
+bool wb_overlaps(const stampdb_state_t *s, uint32_t addr, size_t len);
+
+/**
+ * @brief Flash access used by the core. With write-behind on, erases and programs are
+ * queued (failures surface at the next wb_sync; until then every op fails) and a read that
+ * overlaps a queued op drains the queue first, so reads always see earlier writes.
+ */
+static inline int flash_read(stampdb_state_t *s, uint32_t addr, void *dst, size_t len){
+  if (s->wb.count && wb_overlaps(s, addr, len)){ s->wb.read_drains++; wb_drain(s); }
+#if STAMPDB_ENABLE_PERF
+  if (s->perf){ uint64_t t0 = platform_micros(); int r = platform_flash_read(s->flash_base + addr, dst, len); perf_record(s->perf, STAMPDB_PERF_FLASH_READ, t0, (uint32_t)len); return r; }
+#endif
+  return platform_flash_read(s->flash_base + addr, dst, len);
+}
+static inline int flash_erase_4k(stampdb_state_t *s, uint32_t addr){
+  return s->wb.slots ? wb_enqueue(s, addr | WB_ERASE, NULL) : flash_erase_now(s, addr);
+}
+static inline int flash_program_256(stampdb_state_t *s, uint32_t addr, const void *src){
+  return s->wb.slots ? wb_enqueue(s, addr, src) : flash_program_now(s, addr, src);
+}
+
+/**
+ * @brief Query-path flash read. With concurrent readers it never touches the write-behind
+ * queue (a reader must not issue the writer's ops): queued pages read as unwritten and
+ * segments whose erase is queued are skipped via `erase_queued`. Otherwise flash_read().
+ */
+static inline int flash_read_shared(stampdb_state_t *s, uint32_t addr, void *dst, size_t len){
+  return s->concurrent ? platform_flash_read(s->flash_base + addr, dst, len) : flash_read(s, addr, dst, len);
+}
+
+/** @brief Bump a reader-side stats counter: relaxed, so concurrent readers (scan_range workers) never race. */
+static inline void stat_add(_Atomic uint32_t *c, uint32_t n){ atomic_fetch_add_explicit(c, n, memory_order_relaxed); }
+
+/*
+ * Zone-map seqlock (single writer, any number of readers; no RMW atomics needed).
+ * The writer brackets RAM-only updates of reader-visible state; flash I/O stays
+ * outside so readers never spin across an erase. Zone-map entries change before the
+ * flash they describe (reclaim marks a segment empty, rotation assigns its new seqno,
+ * then erase/program), so a reader that re-validates a segment after reading its
+ * page catches any GC that overtook it.
+ */
+static inline void zm_write_begin(stampdb_state_t *s){
+  if (s->zm_wr_depth++) return;
+  atomic_store_explicit(&s->zm_seq, atomic_load_explicit(&s->zm_seq, memory_order_relaxed) + 1u, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+static inline void zm_write_end(stampdb_state_t *s){
+  if (--s->zm_wr_depth) return;
+  atomic_store_explicit(&s->zm_seq, atomic_load_explicit(&s->zm_seq, memory_order_relaxed) + 1u, memory_order_release);
+}
+/** @brief Reader: wait out a writer update; pass the result to zm_read_retry(). */
+static inline uint32_t zm_read_begin(stampdb_state_t *s){
+  uint32_t q;
+  while ((q = atomic_load_explicit(&s->zm_seq, memory_order_acquire)) & 1u) {}
+  return q;
+}
+/** @brief Reader: true when the writer ran since zm_read_begin() returned `q` (copy again). */
+static inline bool zm_read_retry(stampdb_state_t *s, uint32_t q){
+  atomic_thread_fence(memory_order_acquire);
+  if (atomic_load_explicit(&s->zm_seq, memory_order_relaxed) == q) return false;
+  stat_add(&s->reader_retries, 1);
+  return true;
+}
+
+/** @brief Bump-pointer allocator inside the user-provided workspace; NULL when exhausted. */
+static inline void* ws_alloc(stampdb_state_t *s, size_t sz, size_t align){
+  uintptr_t cur = (uintptr_t)s->ws_cur;
+  uintptr_t aligned = (cur + (align-1)) & ~(uintptr_t)(align-1);
+  if (aligned + sz > (uintptr_t)s->ws_begin + s->ws_size) return NULL;
+  s->ws_cur = (uint8_t*)(aligned + sz);
+  return (void*)aligned;
+}
+
 /* Recovery / scanning core. */
-int ring_scan_and_recover(stampdb_state_t *s, const stampdb_snapshot_t *snap_opt);
+int ring_scan_and_recover(stampdb_state_t *s, const stampdb_snapshot_t *snap_opt, bool lazy);
+/** @brief Lazy open: settle pending zone-map entries for up to `budget_us`, then finish; OK once complete. */
+stampdb_rc ring_recover_step(stampdb_state_t *s, uint32_t budget_us);
+/** @brief Lazy open: full summary of pending segment `idx` for a query (stored unless readers are concurrent). */
+void ring_zm_resolve(stampdb_state_t *s, uint32_t idx, seg_summary_t *out);
 int ring_write_block(stampdb_state_t *s, const block_header_t *h, const uint8_t payload[STAMPDB_PAYLOAD_BYTES]);
 int ring_finalize_segment_and_rotate(stampdb_state_t *s);
+/** @brief A data-region erase/program at `addr` was lost (dropped by write-behind or failed): roll the maps and head back. */
+void ring_op_lost(stampdb_state_t *s, uint32_t addr, bool erase);
 int ring_gc_reclaim_if_needed(stampdb_state_t *s, bool non_blocking);
+/** @brief Iterator begin over any ring (the main one or the rollup tier). */
+void query_begin_state(stampdb_state_t *s, uint16_t series, uint32_t t0_ms, uint32_t t1_ms, stampdb_it_t *it);
+/** @brief Idle-time GC: reclaim below the watermark, then pre-erase ahead of the head. */
+stampdb_rc ring_gc_step(stampdb_state_t *s, uint32_t budget_us);
+/** @brief Physical index of the segment at logical position `pos` from `origin` (the head at
+ * that time): pos 0 is the oldest slot (just after the head), seg_count-1 the head itself. */
+static inline uint32_t ring_phys(const stampdb_state_t *s, uint32_t origin, uint32_t pos){ return (origin + 1u + pos) % s->seg_count; }
+/** @brief Recompute `zm_sorted` with one pass over the zone map in seqno order. */
+void ring_zm_recompute_sorted(stampdb_state_t *s);
+/** @brief Read the rollup table stored after a segment's footer; 0 on success. */
+int ring_read_rollups(stampdb_state_t *s, uint32_t seg_base, seg_rollup_table_t *out);
+/** @brief Record a published block in the page index (no-op when disabled). */
+void pidx_record(stampdb_state_t *s, uint32_t page_addr, const block_header_t *h, uint32_t last_ts);
+/** @brief Mark every page of segment `seg_idx` empty in the page index. */
+void pidx_clear_segment(stampdb_state_t *s, uint32_t seg_idx);
+/** @brief Bit positions of an id in the Bloom filter: bytes of a mixed 32-bit hash. */
+static inline uint32_t series_hash(uint16_t series){
+  uint32_t x = ((uint32_t)series + 1u) * 0x9E3779B1u;
+  x ^= x >> 16; x *= 0x7FEB352Du; x ^= x >> 15; x *= 0x846CA68Bu; x ^= x >> 16;
+  return x;
+}
+static inline void bloom_set(uint8_t *f, uint16_t series){
+  uint32_t h = series_hash(series);
+  for (uint32_t k=0;k<STAMPDB_SERIES_BLOOM_K;k++){ uint8_t b = (uint8_t)(h >> (8u*k)); f[b>>3] |= (uint8_t)(1u<<(b&7)); }
+}
+/** @brief Add an id to a segment's series set; the first id >= 256 re-hashes the exact bitmap into a Bloom filter. */
+static inline void series_set_add(uint8_t f[STAMPDB_SERIES_FILTER_BYTES], bool *bloom, uint16_t series){
+  if (!*bloom && series >= STAMPDB_SERIES_EXACT){
+    uint8_t exact[STAMPDB_SERIES_FILTER_BYTES];
+    for (uint32_t b=0;b<STAMPDB_SERIES_FILTER_BYTES;b++){ exact[b] = f[b]; f[b] = 0; }
+    for (uint32_t id=0;id<STAMPDB_SERIES_EXACT;id++) if (exact[id>>3] & (1u<<(id&7))) bloom_set(f, (uint16_t)id);
+    *bloom = true;
+  }
+  if (*bloom) bloom_set(f, series); else f[series>>3] |= (uint8_t)(1u<<(series&7));
+}
+/** @brief Segment may hold `series` (exact for bitmaps; Bloom: no false negatives). */
+static inline bool series_set_has(const uint8_t f[STAMPDB_SERIES_FILTER_BYTES], bool bloom, uint16_t series){
+  if (!bloom) return series < STAMPDB_SERIES_EXACT && (f[series>>3] & (1u<<(series&7))) != 0;
+  uint32_t h = series_hash(series);
+  for (uint32_t k=0;k<STAMPDB_SERIES_BLOOM_K;k++){ uint8_t b = (uint8_t)(h >> (8u*k)); if (!(f[b>>3] & (1u<<(b&7)))) return false; }
+  return true;
+}
+
+/** @brief Allocate the latest cache (`slots` rounded up to a power of two, at least 2x the builders). */
+int latest_init(stampdb_state_t *s, uint32_t slots);
+/** @brief Cached entry of `series` or NULL (not cached): readers call it inside a seqlock section. */
+const latest_entry_t *latest_find(const stampdb_state_t *s, uint16_t series);
+/** @brief Set a series' latest row (last written wins; one seqlock update per call); evicts a flushed entry when needed. */
+void latest_update(stampdb_state_t *s, uint16_t series, uint32_t ts, float value, uint32_t page_addr);
+/** @brief Insert a row only into a free slot (recovery seeding); false when that would evict. */
+bool latest_seed(stampdb_state_t *s, uint16_t series, uint32_t ts, float value, uint32_t page_addr);
+/** @brief Newest flushed block of `series` on flash (newest segments first); false when none is retained. */
+bool latest_from_flash(stampdb_state_t *s, uint16_t series, latest_entry_t *out);
+/** @brief Forget latest rows whose block lived in an erased segment. */
+void latest_invalidate_segment(stampdb_state_t *s, uint32_t seg_idx);
+/** @brief Seed the latest table from the newest block of each series on flash. */
+void recovery_seed_latest(stampdb_state_t *s);
+/** @brief Allocate `slots` block cache entries (0 = disabled). */
+int  bcache_init(stampdb_state_t *s, uint32_t slots);
+/** @brief Drop cached blocks of segment `seg_idx` before it is erased. */
+void bcache_invalidate_segment(stampdb_state_t *s, uint32_t seg_idx);
+/** @brief Rebuild the page index from block headers after recovery. */
+void recovery_rebuild_page_index(stampdb_state_t *s);
+/** @brief Page index of one segment from its block headers (lazy open settles segments one by one). */
+void recovery_index_segment(stampdb_state_t *s, uint32_t seg_idx);
 
 /* Query iterator internal definition (public form in stampdb.h). */
 typedef struct stampdb_it stampdb_it_t; // defined in public header
@@ -0,0 +1,99 @@
+/**
+ * @file write_behind.c
+ * @brief Write-behind flash queue: staged erases/page programs issued in order.
+ *
+ * What it owns:
+ *  - FIFO of `slots` ops carved from the workspace (4 B address + 256 B page image each)
+ *  - Worker step (`wb_issue_one`), drain, and the durability barrier (`wb_sync`)
+ *  - Queue-depth high-water mark, full-queue stalls, read-triggered drains
+ *
+ * Role in system:
+ *  - Lets block publish, segment rotation and meta appends return without waiting
+ *    for flash; the writer's idle time (stampdb_flash_step) or the next barrier
+ *    (flush/snapshot/close) issues the ops. On the Pico that moves interrupts-off
+ *    program/erase stalls out of the ingest path.
+ *
+ * Constraints:
+ *  - Strict FIFO: the payload→header order of a block publish and the record→header
+ *    order of meta commits reach flash exactly as issued, so power-cut safety is
+ *    unchanged; a cut only loses the ops still queued (as if issued later)
+ *  - A failed op drops every op queued behind it (later headers must not publish over
+ *    a missing payload); the error is sticky until the next wb_sync, and enqueues fail
+ *    meanwhile, so callers see it as they would a synchronous op
+ *  - Dropped data-region ops are handed back to the ring (ring_op_lost): an erase that
+ *    never happened leaves its segment not-erased, and a head that ran ahead of flash
+ *    steps back, so nothing is later programmed over the old contents
+ *  - Issuing a data-segment erase clears its `erase_queued` zone-map flag, which is
+ *    what lets concurrent readers see the segment again (they never drain the queue)
+ */
+#include "stampdb_internal.h"
+#include <string.h>
+
+/** @brief Carve `slots` queue entries from the workspace (0 = write-behind off). */
+int wb_init(stampdb_state_t *s, uint32_t slots){
+  memset(&s->wb, 0, sizeof(s->wb));
+  if (!slots) return 0;
+  s->wb.addr = (uint32_t*)ws_alloc(s, sizeof(uint32_t)*slots, _Alignof(uint32_t));
+  s->wb.pages = (uint8_t*)ws_alloc(s, (size_t)STAMPDB_PAGE_BYTES*slots, 4);
+  if (!s->wb.addr || !s->wb.pages) return -1;
+  s->wb.slots = slots;
+  return 0;
+}
+
+/** @brief Drop the op at `head` and every op behind it, oldest first; the queue is empty before the ring sees them. */
+static void wb_fail(stampdb_state_t *s){
+  wb_queue_t *q = &s->wb;
+  uint32_t at = q->head, n = q->count;
+  q->error = -1; q->head = (q->head + q->count) % q->slots; q->count = 0;
+  for (uint32_t k=0; k<n; k++){
+    uint32_t a = q->addr[(at + k) % q->slots];
+    ring_op_lost(s, a & ~WB_ERASE, (a & WB_ERASE) != 0);
+  }
+}
+
+int wb_issue_one(stampdb_state_t *s){
+  wb_queue_t *q = &s->wb;
+  if (!q->count) return 0;
+  uint32_t a = q->addr[q->head];
+  int rc = (a & WB_ERASE) ? flash_erase_now(s, a & ~WB_ERASE) : flash_program_now(s, a, q->pages + (size_t)q->head*STAMPDB_PAGE_BYTES);
+  if (rc != 0){ wb_fail(s); return -1; }
+  q->head = (q->head + 1u) % q->slots; q->count--;
+  uint32_t seg = (a & ~WB_ERASE) / STAMPDB_SEG_BYTES;
+  if ((a & WB_ERASE) && seg < s->seg_count){ zm_write_begin(s); s->segs[seg].erase_queued = false; zm_write_end(s); }
+  return 0;
+}
+
+/**
+ * @brief Queue one op (`addr | WB_ERASE` for an erase); a full queue issues its oldest op
+ * first. -1 when that op fails or an earlier failure has not reached wb_sync yet.
+ */
+int wb_enqueue(stampdb_state_t *s, uint32_t addr, const void *page){
+  wb_queue_t *q = &s->wb;
+  if ((addr & WB_ERASE) ? ((addr & ~WB_ERASE) % STAMPDB_SEG_BYTES) : (addr % STAMPDB_PAGE_BYTES)) return -1;
+  if (q->error) return -1;
+  if (q->count == q->slots){ q->full_stalls++; if (wb_issue_one(s)!=0) return -1; }
+  uint32_t i = (q->head + q->count) % q->slots;
+  q->addr[i] = addr;
+  if (page) memcpy(q->pages + (size_t)i*STAMPDB_PAGE_BYTES, page, STAMPDB_PAGE_BYTES);
+  if (++q->count > q->hwm) q->hwm = q->count;
+  return 0;
+}
+
+void wb_drain(stampdb_state_t *s){ while (s->wb.count) wb_issue_one(s); }
+
+int wb_sync(stampdb_state_t *s){
+  wb_drain(s);
+  int rc = s->wb.error; s->wb.error = 0;
+  return rc;
+}
+
+/** @brief True when [addr, addr+len) touches a queued program page or erase sector. */
+bool wb_overlaps(const stampdb_state_t *s, uint32_t addr, size_t len){
+  const wb_queue_t *q = &s->wb;
+  for (uint32_t k=0; k<q->count; k++){
+    uint32_t a = q->addr[(q->head + k) % q->slots];
+    uint32_t lo = a & ~WB_ERASE, span = (a & WB_ERASE) ? STAMPDB_SEG_BYTES : STAMPDB_PAGE_BYTES;
+    if (addr < lo + span && lo < addr + len) return true;
+  }
+  return false;
+}
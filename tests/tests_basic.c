@@ -3,6 +3,7 @@
  * @brief Sanity test: write a few rows, query range, check latest.
  */
 #include "stampdb.h"
+#include "sim/sim_flash.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,7 +14,7 @@ static int approx_eq(float a, float b, float eps){ return fabsf(a-b) <= eps; }
 /** @brief Entry point for basic integration test. */
 int main(void){
   // fresh DB
-  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin");
+  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload();
   size_t ws_bytes = 1<<20; void *ws = malloc(ws_bytes);
   stampdb_t *db=NULL; stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=(uint32_t)ws_bytes,.read_batch_rows=512,.commit_interval_ms=0};
   if (stampdb_open(&db,&cfg)!=STAMPDB_OK){ fprintf(stderr,"open failed\n"); return 1; }
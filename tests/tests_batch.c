@@ -0,0 +1,61 @@
+/**
+ * @file tests_batch.c
+ * @brief Batched SoA writes store the same rows and blocks as per-row writes.
+ */
+#include "stampdb.h"
+#include "sim/sim_flash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N 1000
+
+/** @brief Remove sim artifacts to start from a blank device. */
+static void reset_sim(void){
+  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload();
+}
+
+static uint32_t ts_col[N]; static float val_col[N]; static uint16_t ser_col[N];
+
+/** @brief Open a fresh DB, ingest via `mode` (0=per-row, 1=batch, 2=multi), dump series 6 and 9. */
+static int ingest_and_dump(int mode, uint32_t *ts_out, float *v_out, int *n_out, uint32_t *blocks){
+  reset_sim();
+  size_t ws_bytes = 1<<20; void *ws = malloc(ws_bytes);
+  stampdb_t *db=NULL; stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=(uint32_t)ws_bytes,.read_batch_rows=512,.commit_interval_ms=0};
+  if (stampdb_open(&db,&cfg)!=STAMPDB_OK){ free(ws); return 1; }
+  if (mode==0){ for (int i=0;i<N;i++) if (stampdb_write(db, ser_col[i], ts_col[i], val_col[i])!=STAMPDB_OK){ free(ws); return 2; } }
+  else if (mode==1){
+    // split per series, as a caller holding columns per sensor would
+    for (int sid=0;sid<2;sid++){
+      static uint32_t t[N]; static float v[N]; int k=0; uint16_t want=(uint16_t)(sid?9:6);
+      for (int i=0;i<N;i++) if (ser_col[i]==want){ t[k]=ts_col[i]; v[k]=val_col[i]; k++; }
+      if (stampdb_write_batch(db, want, t, v, (size_t)k)!=STAMPDB_OK){ free(ws); return 3; }
+    }
+  } else if (stampdb_write_batch_multi(db, ser_col, ts_col, val_col, N)!=STAMPDB_OK){ free(ws); return 4; }
+  stampdb_flush(db);
+  stampdb_stats_t st; stampdb_info(db,&st); *blocks=st.blocks_written;
+  int n=0;
+  for (int sid=0;sid<2;sid++){
+    stampdb_it_t it; stampdb_query_begin(db,(uint16_t)(sid?9:6),0,0xFFFFFFFFu,&it);
+    uint32_t ts; float v; while (n<N && stampdb_next(&it,&ts,&v)){ ts_out[n]=ts; v_out[n]=v; n++; }
+    stampdb_query_end(&it);
+  }
+  *n_out=n;
+  stampdb_close(db); free(ws);
+  return 0;
+}
+
+/** @brief Compare per-row, single-series batch and multi-series batch ingest. */
+int main(void){
+  // two series in runs of 10 rows with a few >255 ms gaps to exercise lane switches
+  for (int i=0;i<N;i++){ ser_col[i]=(uint16_t)(((i/10)%2)?9:6); ts_col[i]=(uint32_t)(i*20 + ((i%97)==0 ? 400 : 0) + (i/97)*400); val_col[i]=(float)(i%50)*0.5f; }
+  static uint32_t ts_a[N], ts_b[N]; static float v_a[N], v_b[N]; int na=0, nb=0; uint32_t blk_a=0, blk_b=0;
+  if (ingest_and_dump(0, ts_a, v_a, &na, &blk_a)) return 1;
+  if (na!=N){ fprintf(stderr,"per-row rows=%d\n", na); return 2; }
+  for (int mode=1; mode<=2; mode++){
+    if (ingest_and_dump(mode, ts_b, v_b, &nb, &blk_b)) return 10*mode;
+    if (nb!=na || blk_b!=blk_a){ fprintf(stderr,"mode %d rows=%d/%d blocks=%u/%u\n", mode, nb, na, blk_b, blk_a); return 10*mode+1; }
+    for (int i=0;i<na;i++) if (ts_a[i]!=ts_b[i] || v_a[i]!=v_b[i]){ fprintf(stderr,"mode %d mismatch at %d\n", mode, i); return 10*mode+2; }
+  }
+  return 0;
+}
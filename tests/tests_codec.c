@@ -15,14 +15,16 @@ int main(void){
   int16_t q[60]; float vals[60]; float bias=1.2f, scale=0.005f;
   for (int i=0;i<60;i++){ q[i]=(int16_t)(i-30); vals[i]=bias+scale*(float)q[i]; }
   uint8_t buf[224];
-  codec_encode_payload(buf, 8, deltas, q, 60);
-  uint32_t del2[60]; int16_t q2[60]; codec_decode_payload(buf,8,del2,q2,60);
+  block_header_t h={.series=3,.count=60,.t0_ms=1234,.dt_bits=8,.val_lane=STAMPDB_VAL_Q16,.bias=bias,.scale=scale,.payload_crc=0xdeadbeef,.agg_exact=true,.qsum=-12345};
+  codec_encode_payload(buf, &h, deltas, q, vals);
+  uint32_t del2[60]; float v2[60]; codec_decode_payload(buf,&h,del2,v2);
   for (int i=0;i<60;i++) if (del2[i]!=deltas[i]){ fprintf(stderr,"delta mismatch\n"); return 1; }
-  for (int i=0;i<60;i++) if (q2[i]!=q[i]){ fprintf(stderr,"q mismatch\n"); return 2; }
+  for (int i=0;i<60;i++) if (v2[i]!=vals[i]){ fprintf(stderr,"value mismatch\n"); return 2; }
   // pack/unpack header
-  block_header_t h={.series=3,.count=60,.t0_ms=1234,.dt_bits=8,.bias=bias,.scale=scale,.payload_crc=0xdeadbeef};
   uint8_t hdr[32]; codec_pack_header(hdr,&h);
   block_header_t h2; if (!codec_unpack_header(&h2,hdr)){ fprintf(stderr,"header unpack failed\n"); return 3; }
   if (h2.series!=h.series || h2.count!=h.count || h2.t0_ms!=h.t0_ms || h2.dt_bits!=h.dt_bits){ fprintf(stderr,"header field mismatch\n"); return 4; }
+  if (h2.version!=2 || !h2.agg_exact || h2.qsum!=h.qsum){ fprintf(stderr,"header v2 aggregate fields mismatch\n"); return 5; }
+  float mn, mx, sum; if (!codec_block_aggregate(&h2,&mn,&mx,&sum) || mn!=codec_dequant(bias,scale,-32767) || mx!=codec_dequant(bias,scale,32767)) return 6;
   return 0;
 }
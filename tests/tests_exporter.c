@@ -1,31 +1,73 @@
 /**
  * @file tests_exporter.c
- * @brief Populate deterministic data and validate CLI exporter produces rows.
+ * @brief Populate deterministic data and validate CLI exporter produces rows; the
+ * parallel whole-image export (--all --bin) matches per-series iterators for 1 and 4
+ * threads, with identical files.
  */
 #include "stampdb.h"
+#include "sim/sim_flash.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 /** @brief Remove sim artifacts to start from a blank device. */
 static void reset_sim(void){
-  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin");
+  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload();
 }
 
 /** @brief Export a limited range and ensure output file has data lines. */
 int main(void){
+  setenv("STAMPDB_SIM_FLASH_BYTES", "163840", 1); // 32 segments + meta; inherited by stampctl
   reset_sim();
   size_t ws_bytes = 1<<20; void *ws = malloc(ws_bytes);
   stampdb_t *db=NULL; stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=(uint32_t)ws_bytes,.read_batch_rows=512,.commit_interval_ms=0};
   if (stampdb_open(&db,&cfg)!=STAMPDB_OK){ fprintf(stderr,"open fail\n"); return 1; }
   // write deterministic data for series 5 in [0..9990]
   for (int i=0;i<1000;i++){ stampdb_write(db, 5, (uint32_t)(i*10), (float)(i%100)); }
-  stampdb_flush(db); stampdb_close(db); free(ws);
+  stampdb_flush(db); stampdb_close(db);
   // run exporter
   int rc = system("./stampctl export --series 5 --t0 0 --t1 5000 --csv > out.csv");
   (void)rc;
   FILE *f=fopen("out.csv","rb"); if(!f){ fprintf(stderr,"no export\n"); return 2; }
   char line[256]; int lines=0; while (fgets(line,sizeof(line),f)) lines++; fclose(f);
   if (lines < 2){ fprintf(stderr,"no rows exported\n"); return 3; }
+
+  // more series (one above the exact-bitmap range), wrapping the ring
+  if (stampdb_open(&db,&cfg)!=STAMPDB_OK) return 4;
+  const uint16_t ids[3] = { 5, 6, 300 };
+  for (int i=0;i<60000;i++) stampdb_write(db, ids[i % 3], 10000u + (uint32_t)(i/3)*5u, (float)(i % 77));
+  stampdb_flush(db); stampdb_close(db);
+  if (system("./stampctl export --all --threads 1 --bin --out out1.stx") != 0) return 5;
+  if (system("./stampctl export --all --threads 4 --bin --out out4.stx") != 0) return 6;
+  static uint8_t b1[1u<<20], b4[1u<<20];
+  f = fopen("out1.stx","rb"); size_t n1 = f ? fread(b1, 1, sizeof(b1), f) : 0; if (f) fclose(f);
+  f = fopen("out4.stx","rb"); size_t n4 = f ? fread(b4, 1, sizeof(b4), f) : 0; if (f) fclose(f);
+  if (n1 < 8 || n1 != n4 || memcmp(b1, b4, n1)!=0){ fprintf(stderr,"thread counts disagree (%zu/%zu B)\n", n1, n4); return 7; }
+  uint32_t magic, nser; memcpy(&magic, b1, 4); memcpy(&nser, b1+4, 4);
+  if (magic != 0x31585453u || nser != 3u) return 8;
+
+  // each series' columns equal the iterator's rows
+  if (stampdb_open(&db,&cfg)!=STAMPDB_OK) return 9;
+  size_t off = 8;
+  for (uint32_t k=0;k<nser;k++){
+    uint16_t series; uint32_t rows;
+    memcpy(&series, b1+off, 2); memcpy(&rows, b1+off+4, 4); off += 8;
+    if (series != ids[k] || off + (size_t)rows*8u > n1) return 10;
+    const uint8_t *ts_col = b1 + off, *v_col = b1 + off + (size_t)rows*4u;
+    stampdb_it_t it; uint32_t ts, r = 0, ts_b; float v, v_b;
+    stampdb_query_begin(db, series, 0, 0xFFFFFFFFu, &it);
+    while (stampdb_next(&it, &ts, &v)){
+      if (r >= rows) return 11;
+      memcpy(&ts_b, ts_col + 4u*r, 4); memcpy(&v_b, v_col + 4u*r, 4);
+      if (ts_b != ts || v_b != v){ fprintf(stderr,"series %u row %u: %u %f vs %u %f\n", series, r, ts_b, v_b, ts, v); return 12; }
+      r++;
+    }
+    stampdb_query_end(&it);
+    if (r != rows || rows == 0) return 13;
+    off += (size_t)rows*8u;
+  }
+  if (off != n1) return 14;
+  stampdb_close(db); free(ws);
+  remove("out1.stx"); remove("out4.stx");
   return 0;
 }
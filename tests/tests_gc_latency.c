@@ -1,15 +1,17 @@
 /**
  * @file tests_gc_latency.c
- * @brief Induce GC and assert P99 write latency stays under a quota-bound cap.
+ * @brief Induce GC and assert P99 write latency stays bounded (the writer never waits on the quota).
  */
 #include "stampdb.h"
+#include "sim/sim_flash.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 static uint64_t now_ms(void){ struct timespec ts; clock_gettime(CLOCK_MONOTONIC,&ts); return (uint64_t)ts.tv_sec*1000ull + (uint64_t)(ts.tv_nsec/1000000ull); }
-static void reset_sim(void){ remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); }
+static int cmp_u64(const void *a, const void *b){ uint64_t x=*(const uint64_t*)a, y=*(const uint64_t*)b; return (x>y)-(x<y); }
+static void reset_sim(void){ remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload(); }
 
 /** @brief Write a stream of samples and compute P99 latency bound. */
 int main(void){
@@ -32,13 +34,12 @@ int main(void){
   }
   stampdb_flush(db);
   stampdb_close(db); free(ws);
-  // compute P99
-  // simple nth element: sort copy
+  // compute P99 over a sorted copy
   uint64_t *cp=(uint64_t*)malloc(sizeof(uint64_t)*N); memcpy(cp,lat,sizeof(uint64_t)*N);
-  for (int i=0;i<N-1;i++) for (int j=i+1;j<N;j++) if (cp[j]<cp[i]){ uint64_t tmp=cp[i]; cp[i]=cp[j]; cp[j]=tmp; }
+  qsort(cp, N, sizeof(uint64_t), cmp_u64);
   uint64_t p99 = cp[(N*99)/100];
-  // bound P99 under 1500ms (quota delays can block up to ~1s)
-  if (p99 > 1500){ fprintf(stderr,"P99 too high: %llums\n", (unsigned long long)p99); return 2; }
+  // bound P99 under 100ms: an exhausted quota defers reclaim instead of waiting
+  if (p99 > 100){ fprintf(stderr,"P99 too high: %llums\n", (unsigned long long)p99); return 2; }
   free(cp); free(lat);
   return 0;
 }
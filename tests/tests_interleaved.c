@@ -0,0 +1,51 @@
+/**
+ * @file tests_interleaved.c
+ * @brief Round-robin multi-series ingest fills per-series blocks instead of 1-row pages.
+ */
+#include "stampdb.h"
+#include "sim/sim_flash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief Remove sim artifacts to start from a blank device. */
+static void reset_sim(void){
+  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload();
+}
+
+/** @brief Write `ticks` rows to each of `nseries` series round-robin; return blocks written. */
+static int run(uint32_t open_builders, int nseries, int ticks, uint32_t *blocks_out){
+  reset_sim();
+  size_t ws_bytes = 1<<20; void *ws = malloc(ws_bytes);
+  stampdb_t *db=NULL; stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=(uint32_t)ws_bytes,.read_batch_rows=512,.commit_interval_ms=0,.open_builders=open_builders};
+  if (stampdb_open(&db,&cfg)!=STAMPDB_OK){ fprintf(stderr,"open fail\n"); free(ws); return 1; }
+  for (int t=0;t<ticks;t++) for (int sid=0;sid<nseries;sid++){
+    if (stampdb_write(db, (uint16_t)(10+sid), (uint32_t)(t*100), (float)(sid*1000+t))!=STAMPDB_OK){ fprintf(stderr,"write fail\n"); free(ws); return 2; }
+  }
+  stampdb_flush(db);
+  stampdb_stats_t st; stampdb_info(db,&st); *blocks_out = st.blocks_written;
+  // every series must read back all rows in order
+  for (int sid=0;sid<nseries;sid++){
+    stampdb_it_t it; stampdb_query_begin(db,(uint16_t)(10+sid),0,(uint32_t)(ticks*100),&it);
+    int n=0; uint32_t ts, prev=0; float v;
+    while (stampdb_next(&it,&ts,&v)){
+      if (n>0 && ts<=prev){ fprintf(stderr,"series %d out of order\n", sid); free(ws); return 3; }
+      prev=ts; n++;
+    }
+    stampdb_query_end(&it);
+    if (n!=ticks){ fprintf(stderr,"series %d rows=%d want %d\n", sid, n, ticks); free(ws); return 4; }
+  }
+  stampdb_close(db); free(ws);
+  return 0;
+}
+
+/** @brief 12 sensors with a builder each pack full blocks; with 4 builders LRU eviction stays correct. */
+int main(void){
+  uint32_t blocks=0;
+  int rc = run(12, 12, 200, &blocks); if (rc) return rc;
+  // 200 rows/series at a constant 100 ms cadence (delta-of-delta lane): 109 + 91 rows -> 2 blocks per series
+  if (blocks > 12u*2u){ fprintf(stderr,"too many blocks with 12 builders: %u\n", blocks); return 10; }
+  rc = run(4, 12, 20, &blocks); if (rc) return 20+rc;
+  if (blocks == 0){ fprintf(stderr,"no blocks written\n"); return 30; }
+  return 0;
+}
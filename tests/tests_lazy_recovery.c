@@ -0,0 +1,168 @@
+/**
+ * @file tests_lazy_recovery.c
+ * @brief Lazy open: only the head is located (a few footers), writes are accepted at
+ * once; queries answer exactly as after a full open, a latest lookup settles only the
+ * newest segments; recover_step finishes one footer at a time into the same tail, sort
+ * flag and latest cache; rotations over pending slots, snapshot_save, gc_step, the page
+ * index and concurrent readers all work before recovery completes; a blank device falls
+ * back to the full build.
+ */
+#include "stampdb.h"
+#include "sim/sim_flash.h"
+#include "src/stampdb_internal.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEGS 64u
+
+/** @brief Remove sim artifacts to start from a blank device. */
+static void reset_sim(void){
+  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload();
+}
+
+static stampdb_t *open_db(void *ws, uint32_t lazy, uint32_t page_index, uint32_t concurrent){
+  stampdb_t *db=NULL;
+  stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=1u<<20,.read_batch_rows=512,.page_index=page_index,
+                     .concurrent_readers=concurrent,.lazy_recovery=lazy};
+  return stampdb_open(&db,&cfg)==STAMPDB_OK ? db : NULL;
+}
+
+/** @brief Rows of series 0 and 1 in [from, from+n), interleaved. */
+static int ingest(stampdb_t *db, uint32_t from, uint32_t n){
+  for (uint32_t i=from;i<from+n;i++)
+    for (uint16_t series=0; series<2; series++)
+      if (stampdb_write(db, series, 1000u + i*10u, (float)((i + series) & 63u))!=STAMPDB_OK) return -1;
+  return stampdb_flush(db)==STAMPDB_OK ? 0 : -1;
+}
+
+/** @brief Rows of a series in [t0..t1]: (count, first ts, last ts, sum of values). */
+typedef struct { uint32_t n, first, last; double sum; } scan_t;
+static scan_t scan(stampdb_t *db, uint16_t series, uint32_t t0, uint32_t t1){
+  scan_t r; memset(&r, 0, sizeof(r));
+  stampdb_it_t it; uint32_t ts; float v;
+  if (stampdb_query_begin(db, series, t0, t1, &it)!=STAMPDB_OK) return r;
+  while (stampdb_next(&it, &ts, &v)){ if (!r.n) r.first = ts; r.last = ts; r.n++; r.sum += v; }
+  stampdb_query_end(&it);
+  return r;
+}
+static bool same(scan_t a, scan_t b){ return a.n==b.n && a.first==b.first && a.last==b.last && a.sum==b.sum && a.n; }
+
+static stampdb_stats_t info(stampdb_t *db){ stampdb_stats_t st; stampdb_info(db, &st); return st; }
+
+typedef struct { stampdb_t *db; scan_t r; } job_t;
+static void *reader_main(void *arg){ job_t *j = arg; j->r = scan(j->db, 1, 0, 0xFFFFFFFFu); return NULL; }
+
+int main(void){
+  char bytes[32]; snprintf(bytes, sizeof(bytes), "%u", SEGS*4096u + 32768u);
+  setenv("STAMPDB_SIM_FLASH_BYTES", bytes, 1);
+  reset_sim();
+  void *ws = malloc(1u<<20);
+
+  // blank device: nothing to locate, the full (empty) build runs
+  stampdb_t *db = open_db(ws, 1, 0, 0);
+  if (!db) return 1;
+  stampdb_stats_t st = info(db);
+  if (!st.recovery_ready || st.recovery_pending_segs || stampdb_recover_step(db, 0)!=STAMPDB_OK || stampdb_recover_step(NULL, 0)!=STAMPDB_EINVAL) return 2;
+
+  // the ring wraps, closed without a snapshot
+  if (ingest(db, 0, 150000)!=0) return 3;
+  stampdb_close(db);
+  db = open_db(ws, 0, 0, 0);
+  if (!db) return 4;
+  stampdb_stats_t eager = info(db);
+  if (eager.seg_seq_head <= SEGS || eager.recovery_footer_reads < SEGS || !eager.recovery_ready) return 5;
+  scan_t ref0 = scan(db, 0, 0, 0xFFFFFFFFu), ref1 = scan(db, 1, 0, 0xFFFFFFFFu);
+  uint32_t used = db->s.used_seg_count, lts; float lv;
+  if (!db->s.zm_sorted || stampdb_query_latest(db, 1, &lts, &lv)!=STAMPDB_OK || lts != ref1.last) return 6;
+  stampdb_close(db);
+
+  // lazy: head from the hint, everything else pending; writes go in at once
+  db = open_db(ws, 1, 0, 0);
+  if (!db) return 7;
+  st = info(db);
+  if (st.recovery_ready || st.recovery_footer_reads > 4u || st.recovery_pending_segs < SEGS - 4u || st.seg_seq_head != eager.seg_seq_head) return 8;
+  if (stampdb_write(db, 2, 5000000u, 1.0f)!=STAMPDB_OK || stampdb_flush(db)!=STAMPDB_OK) return 9;
+  uint32_t pending = info(db).recovery_pending_segs;
+  if (stampdb_query_latest(db, 1, &lts, &lv)!=STAMPDB_OK || lts != ref1.last) return 10; // newest segment first
+  st = info(db);
+  if (st.recovery_ready || st.recovery_pending_segs + 2u < pending) return 11;
+  if (!same(scan(db, 0, 0, 0xFFFFFFFFu), ref0)) return 12; // walks (and settles) every segment
+  st = info(db);
+  if (!st.recovery_ready || st.recovery_pending_segs || st.seg_seq_tail != eager.seg_seq_tail || !db->s.zm_sorted) return 13;
+  if (!same(scan(db, 1, 0, 0xFFFFFFFFu), ref1) || scan(db, 2, 0, 0xFFFFFFFFu).n != 1u) return 14;
+  stampdb_close(db);
+
+  // recover_step: one footer per call at budget 0, then the same state as a full open
+  db = open_db(ws, 1, 0, 0);
+  if (!db) return 15;
+  pending = info(db).recovery_pending_segs;
+  uint32_t calls = 1;
+  while (stampdb_recover_step(db, 0)==STAMPDB_EBUSY) calls++;
+  st = info(db);
+  if (calls != pending || !st.recovery_ready || st.seg_seq_tail != eager.seg_seq_tail || !db->s.zm_sorted) return 16;
+  if (!latest_find(&db->s, 0) || !latest_find(&db->s, 1) || st.recovery_footer_reads < SEGS) return 17; // seeded at the end
+  if (!same(scan(db, 0, 0, 0xFFFFFFFFu), ref0)) return 18;
+  used = db->s.used_seg_count;
+  stampdb_close(db);
+  db = open_db(ws, 0, 0, 0);
+  if (!db || db->s.used_seg_count != used) return 19;
+  stampdb_close(db);
+
+  // rotations over pending slots: the oldest laps go unread, the rest settle in the background
+  db = open_db(ws, 1, 0, 0);
+  if (!db) return 20;
+  if (ingest(db, 150000, 30000)!=0) return 21;
+  st = info(db);
+  if (st.recovery_ready || st.seg_seq_head <= eager.seg_seq_head + SEGS/4u) return 22;
+  while (stampdb_gc_step(db, 1000)==STAMPDB_EBUSY) {}
+  st = info(db);
+  if (!st.recovery_ready || st.recovery_pending_segs) return 23;
+  scan_t w0 = scan(db, 0, 0, 0xFFFFFFFFu), w1 = scan(db, 1, 0, 0xFFFFFFFFu);
+  if (w0.last != 1000u + 179999u*10u || w0.first <= ref0.first || w1.n != w0.n) return 24;
+  uint32_t tail = st.seg_seq_tail;
+  stampdb_close(db);
+  db = open_db(ws, 0, 0, 0);
+  if (!db) return 25;
+  if (!same(scan(db, 0, 0, 0xFFFFFFFFu), w0) || !same(scan(db, 1, 0, 0xFFFFFFFFu), w1) || info(db).seg_seq_tail != tail) return 26;
+  stampdb_close(db);
+
+  // snapshot_save completes recovery, so its checkpoint covers every segment
+  db = open_db(ws, 1, 0, 0);
+  if (!db || info(db).recovery_ready) return 27;
+  if (stampdb_snapshot_save(db)!=STAMPDB_OK || !info(db).recovery_ready) return 28;
+  stampdb_close(db);
+  db = open_db(ws, 0, 0, 0);
+  if (!db || info(db).recovery_footer_reads >= SEGS || !same(scan(db, 0, 0, 0xFFFFFFFFu), w0)) return 29;
+  stampdb_close(db);
+
+  // page index: pending segments are indexed as they settle (the checkpoint is not used lazily)
+  db = open_db(ws, 1, 1, 0);
+  if (!db) return 30;
+  uint32_t mid = w0.first + (w0.last - w0.first)/20u*10u;
+  scan_t part = scan(db, 1, mid, mid + 20000u);
+  if (!info(db).recovery_ready) return 31;
+  uint32_t skipped = info(db).index_skipped_pages;
+  scan_t again = scan(db, 1, mid, mid + 20000u);
+  if (!same(part, again) || part.n != 2001u || info(db).index_skipped_pages <= skipped) return 32;
+  stampdb_close(db);
+
+  // concurrent readers read pending footers themselves and store nothing; the writer settles
+  db = open_db(ws, 1, 0, 1);
+  if (!db) return 33;
+  pending = info(db).recovery_pending_segs;
+  if (!pending || !same(scan(db, 0, 0, 0xFFFFFFFFu), w0) || info(db).recovery_pending_segs != pending) return 34;
+  job_t j = { db, {0} };
+  pthread_t th;
+  pthread_create(&th, NULL, reader_main, &j);
+  while (stampdb_recover_step(db, 50)==STAMPDB_EBUSY) {}
+  pthread_join(th, NULL);
+  if (!same(j.r, w1) || !info(db).recovery_ready || !same(scan(db, 1, 0, 0xFFFFFFFFu), w1)) return 35;
+  if (info(db).crc_errors) return 36;
+  stampdb_close(db);
+
+  free(ws);
+  printf("lazy_recovery ok (%u footers read by a full open, %u pending after a lazy one)\n", eager.recovery_footer_reads, pending);
+  return 0;
+}
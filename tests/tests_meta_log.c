@@ -0,0 +1,77 @@
+/**
+ * @file tests_meta_log.c
+ * @brief Append-only meta logs: newest valid record wins, torn records are skipped,
+ * the cursor survives reopen, and a log sector is erased only when it is entered.
+ */
+#include "stampdb.h"
+#include "sim/sim_flash.h"
+#include "src/stampdb_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief Remove sim artifacts to start from a blank device. */
+static void reset_sim(void){
+  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload();
+}
+
+/** @brief Erases since the last call (UINT32_MAX when perf is compiled out). */
+static uint32_t erases(stampdb_t *db){
+  stampdb_perf_t p;
+  if (stampdb_perf_info(db, &p, 1)!=STAMPDB_OK) return UINT32_MAX;
+  return p.ops[STAMPDB_PERF_FLASH_ERASE].count;
+}
+
+static uint32_t meta_page(uint32_t sector, uint32_t page){ return sim_flash_size_bytes() - STAMPDB_META_RESERVED + sector*4096u + page*256u; }
+
+int main(void){
+  reset_sim();
+  size_t ws_bytes = 1<<20; void *ws = malloc(ws_bytes);
+  stampdb_t *db=NULL; stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=(uint32_t)ws_bytes,.read_batch_rows=512,.perf=1};
+  if (stampdb_open(&db,&cfg)!=STAMPDB_OK) return 1;
+  stampdb_state_t *s = &db->s;
+  uint32_t a, q; stampdb_snapshot_t snap;
+  if (meta_load_head_hint(s, &a, &q)==0 || meta_load_snapshot(s, &snap)==0) return 2; // blank device
+  bool perf = erases(db) != UINT32_MAX;
+
+  // 40 hints in a 16-record sector: erased when entered at records 0, 16, 32
+  for (uint32_t i=0;i<40;i++) if (meta_save_head_hint(s, i*256u, 100u+i)!=0) return 3;
+  if (perf && erases(db)!=3u){ fprintf(stderr,"hint log erased %u times\n", erases(db)); return 4; }
+  if (meta_load_head_hint(s, &a, &q)!=0 || a!=39u*256u || q!=139u){ fprintf(stderr,"hint %u %u\n",a,q); return 5; }
+
+  // 40 snapshots over two sectors: erases at records 0, 16, 32; newest by append order, not seg_seq_head
+  for (uint32_t i=0;i<40;i++){
+    stampdb_snapshot_t r={.version=1,.epoch_id=i,.seg_seq_head=1000u-i,.seg_seq_tail=1,.head_addr=i*4096u};
+    if (meta_save_snapshot(s, &r)!=0) return 6;
+  }
+  if (perf && erases(db)!=3u) return 7;
+  if (meta_load_snapshot(s, &snap)!=0 || snap.epoch_id!=39u || snap.seg_seq_head!=961u) return 8;
+
+  // tear the newest snapshot record (record 39 -> sector 0, page 7): previous one wins
+  uint8_t zero[256]; memset(zero, 0, sizeof(zero));
+  sim_flash_program_256(meta_page(0, 7), zero);
+  if (meta_load_snapshot(s, &snap)!=0 || snap.epoch_id!=38u) return 9;
+  stampdb_close(db);
+
+  // reopen: cursors rebuilt from the logs; appends skip the torn page, no erase mid-sector
+  if (stampdb_open(&db,&cfg)!=STAMPDB_OK) return 10;
+  s = &db->s; erases(db);
+  stampdb_snapshot_t r={.version=1,.epoch_id=77,.seg_seq_head=5,.seg_seq_tail=1,.head_addr=0};
+  if (meta_save_snapshot(s, &r)!=0 || meta_save_head_hint(s, 4096u, 200u)!=0) return 11;
+  if (perf && erases(db)!=0u){ fprintf(stderr,"append after reopen erased\n"); return 12; }
+  if (meta_load_snapshot(s, &snap)!=0 || snap.epoch_id!=77u) return 13;
+  if (meta_load_head_hint(s, &a, &q)!=0 || a!=4096u || q!=200u) return 14;
+  uint8_t page[256]; sim_flash_read(meta_page(0, 8), page, sizeof(page));
+  uint32_t magic; memcpy(&magic, page, 4);
+  if (magic != 0x314C4D53u) return 15; // landed right after the torn record
+
+  // rotations append hints: ~1 meta erase per 16 rolls instead of one per roll
+  erases(db);
+  uint32_t segs0 = 0; stampdb_stats_t st; stampdb_info(db,&st); segs0 = st.seg_seq_head;
+  for (uint32_t i=0;i<32u*15u*109u;i++) stampdb_write(db, 1, i*10u, (float)(i%1000));
+  stampdb_flush(db); stampdb_info(db,&st);
+  uint32_t rolls = st.seg_seq_head - segs0, e = erases(db);
+  if (perf && (rolls < 32u || e > rolls + rolls/16u + 2u)){ fprintf(stderr,"%u rolls, %u erases\n", rolls, e); return 16; }
+  stampdb_close(db); free(ws);
+  return 0;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file tests_next_batch.c
+ * @brief stampdb_next_batch(): zero-copy block slices and coalesced buffers match stampdb_next();
+ * stampdb_query_export() fills whole caller arrays across blocks and resumes where it stopped.
+ */
+#include "stampdb.h"
+#include "sim/sim_flash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAXR 4000
+
+/** @brief Remove sim artifacts to start from a blank device. */
+static void reset_sim(void){
+  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload();
+}
+
+/** @brief Reference rows via stampdb_next(). */
+static size_t rows_next(stampdb_t *db, uint16_t series, uint32_t t0, uint32_t t1, uint32_t *ts, float *v){
+  stampdb_it_t it; stampdb_query_begin(db, series, t0, t1, &it); size_t n=0;
+  while (n<MAXR && stampdb_next(&it, &ts[n], &v[n])) n++;
+  stampdb_query_end(&it); return n;
+}
+
+/** @brief Rows via stampdb_next_batch(); cap 0 = zero-copy. Returns rows, or (size_t)-1 on a bad batch. */
+static size_t rows_batch(stampdb_t *db, uint16_t series, uint32_t t0, uint32_t t1, size_t cap, size_t max_batch, uint32_t *ts, float *v){
+  stampdb_it_t it; stampdb_query_begin(db, series, t0, t1, &it);
+  uint32_t bts[600]; float bv[600];
+  if (cap) stampdb_query_set_buffer(&it, bts, bv, cap);
+  const uint32_t *pt; const float *pv; size_t n, total=0;
+  while (stampdb_next_batch(&it, &pt, &pv, &n)){
+    if (n==0 || n>max_batch || total+n>MAXR) return (size_t)-1;
+    if (cap && (pt!=bts || pv!=bv)) return (size_t)-1;
+    if (!cap && (pt<it.times || pt>=it.times+STAMPDB_BLOCK_MAX_ROWS)) return (size_t)-1;
+    memcpy(ts+total, pt, n*sizeof(uint32_t)); memcpy(v+total, pv, n*sizeof(float)); total+=n;
+  }
+  stampdb_query_end(&it); return total;
+}
+
+/** @brief Rows via stampdb_query_export() in calls of `chunk` rows; every call but the last is full. */
+static size_t rows_export(stampdb_t *db, uint16_t series, uint32_t t0, uint32_t t1, size_t chunk, uint32_t *ts, float *v){
+  stampdb_it_t it; stampdb_query_begin(db, series, t0, t1, &it); size_t n, total=0, last=chunk;
+  while (total<MAXR && (n = stampdb_query_export(&it, ts+total, v+total, chunk < MAXR-total ? chunk : MAXR-total))){
+    if (last!=chunk) return (size_t)-1;
+    last = n; total += n;
+  }
+  stampdb_query_end(&it); return total;
+}
+
+int main(void){
+  reset_sim();
+  size_t ws_bytes = 1<<20; void *ws = malloc(ws_bytes);
+  stampdb_t *db=NULL; stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=(uint32_t)ws_bytes,.read_batch_rows=100};
+  if (stampdb_open(&db,&cfg)!=STAMPDB_OK) return 1;
+  for (int i=0;i<3000;i++){ stampdb_write(db, 1, (uint32_t)(i*10), (float)i); if (i%3==0) stampdb_write(db, 2, (uint32_t)(i*10), -(float)i); }
+  stampdb_flush(db);
+
+  static uint32_t ts_a[MAXR], ts_b[MAXR]; static float v_a[MAXR], v_b[MAXR];
+  const struct { uint16_t series; uint32_t t0, t1; } q[] = {
+    {1, 0, 0xFFFFFFFFu}, {1, 1234, 17777}, {1, 5, 5}, {1, 29990, 40000}, {2, 3, 29001},
+    {1, 500, 400},  // inverted window: empty
+  };
+  for (size_t k=0;k<sizeof(q)/sizeof(q[0]);k++){
+    size_t na = rows_next(db, q[k].series, q[k].t0, q[k].t1, ts_a, v_a);
+    for (size_t i=0;i<na;i++) if (ts_a[i]<q[k].t0 || ts_a[i]>q[k].t1){ fprintf(stderr,"q%zu: row out of window\n",k); return 2; }
+    const size_t caps[3] = {0, 64, 500};
+    for (int c=0;c<3;c++){
+      size_t max_batch = caps[c] ? (caps[c] < cfg.read_batch_rows ? caps[c] : cfg.read_batch_rows) : STAMPDB_BLOCK_MAX_ROWS;
+      size_t nb = rows_batch(db, q[k].series, q[k].t0, q[k].t1, caps[c], max_batch, ts_b, v_b);
+      if (nb!=na || memcmp(ts_a,ts_b,na*4)!=0 || memcmp(v_a,v_b,na*4)!=0){ fprintf(stderr,"q%zu cap %zu: %zu vs %zu rows\n",k,caps[c],nb,na); return 3; }
+    }
+  }
+  if (rows_next(db, 1, 1234, 17777, ts_a, v_a) != (17770-1240)/10+1 || ts_a[0]!=1240) return 4;
+  if (stampdb_it_size()!=sizeof(stampdb_it_t)) return 5;
+
+  // bulk export ignores read_batch_rows: one call returns the whole window
+  const size_t chunks[3] = {1, 37, MAXR};
+  for (size_t k=0;k<sizeof(q)/sizeof(q[0]);k++){
+    size_t na = rows_next(db, q[k].series, q[k].t0, q[k].t1, ts_a, v_a);
+    for (int c=0;c<3;c++){
+      size_t nb = rows_export(db, q[k].series, q[k].t0, q[k].t1, chunks[c], ts_b, v_b);
+      if (nb!=na || memcmp(ts_a,ts_b,na*4)!=0 || memcmp(v_a,v_b,na*4)!=0){ fprintf(stderr,"export q%zu chunk %zu: %zu vs %zu rows\n",k,chunks[c],nb,na); return 5; }
+    }
+  }
+
+  // full coalesced batches except the last; interleaving with stampdb_next keeps order
+  stampdb_it_t it; stampdb_query_begin(db, 1, 0, 0xFFFFFFFFu, &it);
+  uint32_t bts[100]; float bv[100]; stampdb_query_set_buffer(&it, bts, bv, 100);
+  const uint32_t *pt; const float *pv; size_t n; uint32_t expect = 0; int batches = 0;
+  while (1){
+    uint32_t one; float ov;
+    if (batches%2 && stampdb_next(&it, &one, &ov)){ if (one!=expect) return 6; expect += 10; }
+    if (!stampdb_next_batch(&it, &pt, &pv, &n)) break;
+    for (size_t i=0;i<n;i++){ if (pt[i]!=expect) return 7; expect += 10; }
+    if (n!=100 && expect!=30000u) return 8;
+    batches++;
+  }
+  if (expect!=30000u) return 9;
+  stampdb_query_end(&it);
+  stampdb_close(db);
+
+  // a block crossing the u32 wrap is not numerically ordered: clipped by compaction
+  reset_sim();
+  if (stampdb_open(&db,&cfg)!=STAMPDB_OK) return 10;
+  for (int i=0;i<100;i++) stampdb_write(db, 3, 0xFFFFFE00u + (uint32_t)i*16u, (float)i);
+  stampdb_flush(db);
+  const struct { uint32_t t0, t1; size_t rows; } w[] = { {0, 300, 19}, {0xFFFFFF00u, 0xFFFFFFFFu, 16}, {0, 0xFFFFFFFFu, 100} };
+  for (int k=0;k<3;k++){
+    size_t na = rows_next(db, 3, w[k].t0, w[k].t1, ts_a, v_a);
+    size_t nb = rows_batch(db, 3, w[k].t0, w[k].t1, 0, STAMPDB_BLOCK_MAX_ROWS, ts_b, v_b);
+    if (na!=w[k].rows || nb!=na || memcmp(ts_a,ts_b,na*4)!=0){ fprintf(stderr,"wrap window %d: %zu/%zu rows\n",k,na,nb); return 11; }
+  }
+  stampdb_close(db); free(ws);
+  printf("next_batch OK\n");
+  return 0;
+}
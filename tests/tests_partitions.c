@@ -0,0 +1,137 @@
+/**
+ * @file tests_partitions.c
+ * @brief Flash partitions: two instances on one device keep independent data, GC and
+ * recovery; a wrapping ring never touches its neighbour or the gap between them; both
+ * can ingest from separate threads at once; bad partitions are rejected.
+ */
+#include "stampdb.h"
+#include "sim/sim_flash.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define META 32768u
+#define FAST_SEGS 8u   // high-rate ring: wraps many times
+#define SLOW_SEGS 24u  // low-rate housekeeping ring
+#define SLOW_BASE 0u
+#define SLOW_BYTES (SLOW_SEGS*4096u + META)
+#define GAP_BASE SLOW_BYTES
+#define FAST_BASE (GAP_BASE + 4096u) // one unowned sector between the partitions
+#define FAST_BYTES (FAST_SEGS*4096u + META)
+#define DEV_BYTES (FAST_BASE + FAST_BYTES)
+
+/** @brief Remove sim artifacts to start from a blank device. */
+static void reset_sim(void){
+  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload();
+}
+
+static stampdb_t *open_part(void *ws, uint32_t base, uint32_t bytes){
+  stampdb_t *db=NULL;
+  stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=1u<<20,.read_batch_rows=512,.flash_base=base,.flash_bytes=bytes};
+  if (stampdb_open(&db,&cfg)!=STAMPDB_OK) return NULL;
+  return db;
+}
+
+static int open_rc(void *ws, uint32_t base, uint32_t bytes){
+  stampdb_t *db=NULL;
+  stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=1u<<20,.flash_base=base,.flash_bytes=bytes};
+  return stampdb_open(&db,&cfg);
+}
+
+/** @brief Rows of series 0: (count, first ts, last ts, sum of values). */
+typedef struct { uint32_t n, first, last; double sum; } scan_t;
+static scan_t scan(stampdb_t *db){
+  scan_t r; memset(&r, 0, sizeof(r));
+  stampdb_it_t it; uint32_t ts; float v;
+  if (stampdb_query_begin(db, 0, 0, 0xFFFFFFFFu, &it)!=STAMPDB_OK) return r;
+  while (stampdb_next(&it, &ts, &v)){ if (!r.n) r.first = ts; r.last = ts; r.n++; r.sum += v; }
+  stampdb_query_end(&it);
+  return r;
+}
+
+static uint32_t fnv(uint32_t addr, uint32_t len){
+  uint32_t h = 2166136261u; uint8_t buf[4096];
+  for (uint32_t off=0; off<len; off+=sizeof(buf)){
+    sim_flash_read(addr+off, buf, sizeof(buf));
+    for (size_t i=0;i<sizeof(buf);i++){ h ^= buf[i]; h *= 16777619u; }
+  }
+  return h;
+}
+
+static bool blank(uint32_t addr, uint32_t len){
+  uint8_t buf[4096];
+  for (uint32_t off=0; off<len; off+=sizeof(buf)){
+    sim_flash_read(addr+off, buf, sizeof(buf));
+    for (size_t i=0;i<sizeof(buf);i++) if (buf[i]!=0xFF) return false;
+  }
+  return true;
+}
+
+static int ingest(stampdb_t *db, uint32_t from, uint32_t n, uint32_t step){
+  for (uint32_t i=from;i<from+n;i++){
+    if (stampdb_write(db, 0, 1000u + i*step, (float)(i & 255u))!=STAMPDB_OK) return -1;
+    if (i % 256u == 0) stampdb_gc_step(db, 200);
+  }
+  return stampdb_flush(db)==STAMPDB_OK ? 0 : -1;
+}
+
+typedef struct { stampdb_t *db; uint32_t from, n, step; int rc; } job_t;
+static void *job_main(void *arg){ job_t *j = arg; j->rc = ingest(j->db, j->from, j->n, j->step); return NULL; }
+
+int main(void){
+  char bytes[32]; snprintf(bytes, sizeof(bytes), "%u", DEV_BYTES);
+  setenv("STAMPDB_SIM_FLASH_BYTES", bytes, 1);
+  reset_sim();
+  void *ws_slow = malloc(1u<<20), *ws_fast = malloc(1u<<20);
+
+  // bad partitions: unaligned, past the device, too small for meta + 2 segments
+  if (open_rc(ws_slow, 100u, SLOW_BYTES)!=STAMPDB_EINVAL) return 1;
+  if (open_rc(ws_slow, 0u, SLOW_BYTES + 100u)!=STAMPDB_EINVAL) return 2;
+  if (open_rc(ws_slow, FAST_BASE, FAST_BYTES + 4096u)!=STAMPDB_EINVAL) return 3;
+  if (open_rc(ws_slow, DEV_BYTES + 4096u, 0u)!=STAMPDB_EINVAL) return 4;
+  if (open_rc(ws_slow, 0u, META + 4096u)!=STAMPDB_EINVAL) return 5;
+
+  // housekeeping first, then the fast ring wraps ~10x next to it
+  stampdb_t *slow = open_part(ws_slow, SLOW_BASE, SLOW_BYTES);
+  stampdb_t *fast = open_part(ws_fast, FAST_BASE, 0u); // 0 = to the end of the device
+  if (!slow || !fast) return 6;
+  if (ingest(slow, 0, 2000, 60)!=0) return 7;
+  scan_t s0 = scan(slow);
+  uint32_t slow_hash = fnv(SLOW_BASE, SLOW_BYTES);
+  if (s0.n!=2000u) return 8;
+  if (ingest(fast, 0, 200000, 1)!=0) return 9;
+  stampdb_stats_t st; stampdb_info(fast, &st);
+  if (st.seg_seq_head < 10u*FAST_SEGS){ fprintf(stderr, "fast ring only at seq %u\n", st.seg_seq_head); return 10; }
+  if (fnv(SLOW_BASE, SLOW_BYTES)!=slow_hash || !blank(GAP_BASE, 4096u)) return 11;
+  scan_t f0 = scan(fast), s1 = scan(slow);
+  if (f0.last!=1000u + 199999u || f0.n==0 || f0.n>=200000u) return 12;
+  if (s1.n!=s0.n || s1.sum!=s0.sum) return 13;
+  stampdb_snapshot_save(fast);
+  stampdb_close(fast); stampdb_close(slow);
+
+  // reopen (fast from its snapshot, slow from a scan): each recovers only its own ring
+  slow = open_part(ws_slow, SLOW_BASE, SLOW_BYTES);
+  fast = open_part(ws_fast, FAST_BASE, FAST_BYTES);
+  if (!slow || !fast) return 14;
+  scan_t f1 = scan(fast), s2 = scan(slow);
+  if (f1.n!=f0.n || f1.first!=f0.first || f1.last!=f0.last || f1.sum!=f0.sum) return 15;
+  if (s2.n!=s0.n || s2.last!=s0.last || s2.sum!=s0.sum) return 16;
+
+  // both writers at once from separate threads
+  job_t js = { slow, 2000, 3000, 60, -1 }, jf = { fast, 200000, 100000, 1, -1 };
+  pthread_t ts_, tf_;
+  pthread_create(&ts_, NULL, job_main, &js); pthread_create(&tf_, NULL, job_main, &jf);
+  pthread_join(ts_, NULL); pthread_join(tf_, NULL);
+  if (js.rc!=0 || jf.rc!=0) return 17;
+  scan_t s3 = scan(slow), f2 = scan(fast);
+  if (s3.n!=5000u || s3.last!=1000u + 4999u*60u || f2.last!=1000u + 299999u) return 18;
+  if (!blank(GAP_BASE, 4096u)) return 19;
+  stampdb_info(slow, &st);
+  if (st.crc_errors) return 20;
+  stampdb_close(fast); stampdb_close(slow);
+
+  free(ws_slow); free(ws_fast);
+  printf("partitions ok (fast %u rows retained, slow %u)\n", f2.n, s3.n);
+  return 0;
+}
@@ -0,0 +1,76 @@
+/**
+ * @file tests_perf.c
+ * @brief Perf instrumentation: flash/API/phase counters are consistent and histograms add up.
+ */
+#include "stampdb.h"
+#include "sim/sim_flash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief Remove sim artifacts to start from a blank device. */
+static void reset_sim(void){
+  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload();
+}
+
+static uint32_t hist_sum(const stampdb_perf_hist_t *h){ uint32_t n=0; for (uint32_t b=0;b<STAMPDB_PERF_BUCKETS;b++) n+=h->hist[b]; return n; }
+
+int main(void){
+  reset_sim();
+  size_t ws_bytes = 1<<20; void *ws = malloc(ws_bytes);
+  stampdb_t *db=NULL; stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=(uint32_t)ws_bytes,.read_batch_rows=512,.perf=1};
+  if (stampdb_open(&db,&cfg)!=STAMPDB_OK) return 1;
+  stampdb_perf_t p;
+  if (stampdb_perf_info(db,&p,1)==STAMPDB_EINVAL){ printf("perf compiled out; skipping\n"); stampdb_close(db); free(ws); return 0; }
+  if (!p.enabled || p.ops[STAMPDB_PERF_FLASH_READ].count==0) return 2; // open scanned footers
+
+  // ~5 segments of one series, then flush/query/latest/snapshot
+  const int N=5*15*(int)STAMPDB_BLOCK_MAX_ROWS;
+  for (int i=0;i<N;i++) if (stampdb_write(db,3,(uint32_t)(i*10),(float)(i%100))!=STAMPDB_OK) return 3;
+  stampdb_flush(db);
+  stampdb_it_t it; stampdb_query_begin(db,3,0,(uint32_t)N*10u,&it);
+  uint32_t ts; float v; int rows=0; while (stampdb_next(&it,&ts,&v)) rows++;
+  stampdb_query_end(&it);
+  if (rows!=N) return 4;
+  if (stampdb_query_latest(db,3,&ts,&v)!=STAMPDB_OK) return 5;
+  if (stampdb_query_latest(db,9,&ts,&v)!=STAMPDB_EINVAL) return 5; // miss: walks flash, finds nothing, still timed
+  if (stampdb_perf_info(db,&p,0)!=STAMPDB_OK) return 6;
+  uint32_t pre_snap = p.ops[STAMPDB_PERF_FLASH_PROGRAM].count;
+  stampdb_snapshot_save(db);
+
+  stampdb_stats_t st; stampdb_info(db,&st);
+  if (stampdb_perf_info(db,&p,0)!=STAMPDB_OK) return 6;
+  const stampdb_perf_hist_t *o = p.ops;
+  for (uint32_t op=0; op<STAMPDB_PERF_OP_COUNT; op++){
+    if (hist_sum(&o[op])!=o[op].count){ fprintf(stderr,"%s: hist %u != count %u\n",stampdb_perf_op_name(op),hist_sum(&o[op]),o[op].count); return 7; }
+    if (o[op].count && o[op].max_us > o[op].total_us) return 8;
+  }
+  if (o[STAMPDB_PERF_WRITE].count!=(uint32_t)N || o[STAMPDB_PERF_FLUSH].count!=1 || o[STAMPDB_PERF_LATEST].count!=2) return 9;
+  if (o[STAMPDB_PERF_QUERY_BEGIN].count!=1 || o[STAMPDB_PERF_QUERY_BLOCK].count < st.blocks_written) return 10;
+  if (o[STAMPDB_PERF_ROTATE].count < 5 || o[STAMPDB_PERF_HEAD_HINT].count != o[STAMPDB_PERF_ROTATE].count) return 11;
+  // snapshot: its record, the zone-map checkpoint header and at least one stream page, all in the meta region
+  uint32_t snap_pages = o[STAMPDB_PERF_FLASH_PROGRAM].count - pre_snap;
+  if (snap_pages < 3u || snap_pages > 32768u/256u){ fprintf(stderr,"snapshot programmed %u pages\n",snap_pages); return 12; }
+  // two programs per block (payload, header) + footer per rotation, and 1 meta page per hint
+  uint32_t programs = 2u*st.blocks_written + o[STAMPDB_PERF_ROTATE].count + o[STAMPDB_PERF_HEAD_HINT].count + snap_pages;
+  if (o[STAMPDB_PERF_FLASH_PROGRAM].count != programs){ fprintf(stderr,"programs %u vs %u\n",o[STAMPDB_PERF_FLASH_PROGRAM].count,programs); return 12; }
+  if (o[STAMPDB_PERF_FLASH_PROGRAM].bytes != 256ull*programs) return 13;
+  if (o[STAMPDB_PERF_FLASH_ERASE].bytes != 4096ull*o[STAMPDB_PERF_FLASH_ERASE].count || o[STAMPDB_PERF_FLASH_ERASE].count==0) return 14;
+  if (o[STAMPDB_PERF_SNAPSHOT].count!=1) return 15;
+  if (strcmp(stampdb_perf_op_name(STAMPDB_PERF_HEAD_HINT),"head_hint")!=0 || strcmp(stampdb_perf_op_name(STAMPDB_PERF_OP_COUNT),"?")!=0) return 16;
+
+  // reset zeroes but stays enabled
+  stampdb_perf_info(db,&p,1); stampdb_perf_info(db,&p,0);
+  if (!p.enabled || p.ops[STAMPDB_PERF_WRITE].count!=0) return 17;
+  stampdb_close(db);
+
+  // opened without cfg.perf: nothing recorded
+  cfg.perf = 0;
+  if (stampdb_open(&db,&cfg)!=STAMPDB_OK) return 18;
+  stampdb_write(db,3,(uint32_t)N*10u,1.0f);
+  if (stampdb_perf_info(db,&p,0)!=STAMPDB_OK || p.enabled || p.ops[STAMPDB_PERF_WRITE].count) return 19;
+  stampdb_close(db);
+  free(ws);
+  printf("perf OK\n");
+  return 0;
+}
@@ -3,13 +3,14 @@
  * @brief Matrix of power-cut scenarios: torn header, payload, footer.
  */
 #include "stampdb.h"
+#include "sim/sim_flash.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 /** @brief Remove sim artifacts to start from a blank device. */
 static void reset_sim(void){
-  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin");
+  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload();
 }
 
 /** @brief Write 300 rows to series 3 to span several blocks. */
@@ -25,20 +26,20 @@ static int populate(void){
 /** @brief Overwrite the last 32 bytes of page (header) with 0xFF. */
 static int corrupt_header_only(void){
   FILE *f=fopen("flash.bin","r+b"); if(!f) return -1; fseek(f,0,SEEK_END); long sz=ftell(f); if (sz<256) { fclose(f); return -1; }
-  fseek(f, (long)(sz - 256 + 224), SEEK_SET); unsigned char ff[32]; memset(ff,0xFF,32); fwrite(ff,1,32,f); fclose(f); return 0;
+  fseek(f, (long)(sz - 256 + 224), SEEK_SET); unsigned char ff[32]; memset(ff,0xFF,32); fwrite(ff,1,32,f); fclose(f); sim_flash_reload(); return 0;
 }
 
 /** @brief Flip a payload byte to force CRC mismatch. */
 static int corrupt_payload_only(void){
   FILE *f=fopen("flash.bin","r+b"); if(!f) return -1; fseek(f,0,SEEK_END); long sz=ftell(f); if (sz<256) { fclose(f); return -1; }
-  fseek(f, (long)(sz - 256 + 0), SEEK_SET); unsigned char z=0; fwrite(&z,1,1,f); fclose(f); return 0;
+  fseek(f, (long)(sz - 256 + 0), SEEK_SET); unsigned char z=0; fwrite(&z,1,1,f); fclose(f); sim_flash_reload(); return 0;
 }
 
 /** @brief Wipe the last 256 B footer page of the last segment. */
 static int corrupt_footer(void){
   // wipe last 256B (footer)
   FILE *f=fopen("flash.bin","r+b"); if(!f) return -1; fseek(f,0,SEEK_END); long sz=ftell(f); if (sz<4096) { fclose(f); return -1; }
-  fseek(f, (long)( (sz/4096)*4096 - 256 ), SEEK_SET); unsigned char ff[256]; memset(ff,0xFF,256); fwrite(ff,1,256,f); fclose(f); return 0;
+  fseek(f, (long)( (sz/4096)*4096 - 256 ), SEEK_SET); unsigned char ff[256]; memset(ff,0xFF,256); fwrite(ff,1,256,f); fclose(f); sim_flash_reload(); return 0;
 }
 
 /** @brief Reopen DB and count rows in [0..5000] for series 3. */
@@ -3,6 +3,7 @@
  * @brief Power-cut simulation (torn header) and recovery correctness.
  */
 #include "stampdb.h"
+#include "sim/sim_flash.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,7 +11,7 @@
 /** @brief Populate data and tear the last header to simulate power cut. */
 static int write_powercut_pattern(void){
   // open fresh DB and write some rows, then simulate torn page by writing payload only
-  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin");
+  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload();
   size_t ws_bytes = 1<<20; void *ws = malloc(ws_bytes);
   stampdb_t *db=NULL; stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=(uint32_t)ws_bytes,.read_batch_rows=512,.commit_interval_ms=0};
   if (stampdb_open(&db,&cfg)!=STAMPDB_OK) return 1;
@@ -22,6 +23,7 @@ static int write_powercut_pattern(void){
   // zero last 32 bytes of last programmed page
   fseek(f, (long)(sz - 256 + 224), SEEK_SET);
   unsigned char ff[32]; memset(ff,0xFF,32); fwrite(ff,1,32,f); fclose(f);
+  sim_flash_reload(); // pick up the external edit in `file` sim mode
   return 0;
 }
 
@@ -3,13 +3,14 @@
  * @brief Bound recovery time proportional to segments since last snapshot.
  */
 #include "stampdb.h"
+#include "sim/sim_flash.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 static uint64_t now_ms(void){ struct timespec ts; clock_gettime(CLOCK_MONOTONIC,&ts); return (uint64_t)ts.tv_sec*1000ull + (uint64_t)(ts.tv_nsec/1000000ull); }
-static void reset_sim(void){ remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); }
+static void reset_sim(void){ remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload(); }
 
 /** @brief Fill segs, snapshot, add K more segs; measure reopen time bound. */
 int main(void){
@@ -18,7 +19,7 @@ int main(void){
   stampdb_t *db=NULL; stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=(uint32_t)ws_bytes,.read_batch_rows=512,.commit_interval_ms=0};
   if (stampdb_open(&db,&cfg)!=STAMPDB_OK) return 1;
   // write enough to fill N segments, then snapshot
-  int rows_per_block=74; int blocks_per_seg=(4096/256)-1; int rows_per_seg = rows_per_block*blocks_per_seg;
+  int rows_per_block=(int)STAMPDB_BLOCK_MAX_ROWS; int blocks_per_seg=(4096/256)-1; int rows_per_seg = rows_per_block*blocks_per_seg;
   int segs0=8; for (int i=0;i<segs0*rows_per_seg;i++){ stampdb_write(db, 7, (uint32_t)(i*10), (float)i); }
   stampdb_flush(db);
   if (stampdb_snapshot_save(db)!=STAMPDB_OK) return 2;
@@ -0,0 +1,176 @@
+/**
+ * @file tests_rollup.c
+ * @brief Rollup tier: aggregates keep answering from the tier after the raw ring wrapped
+ * many times; planner results (tier middle + raw edges) match row-by-row sums of the raw
+ * rows; reopen keeps the old buckets and re-validates the new ones; late rows are neither
+ * lost nor double counted; bad tier configs are rejected.
+ */
+#include "stampdb.h"
+#include "sim/sim_flash.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define META 32768u
+#define RAW_SEGS 16u
+#define RAW_BYTES (RAW_SEGS*4096u + META)
+#define TIER_BASE RAW_BYTES
+#define TIER_SEGS 48u
+#define TIER_BYTES (TIER_SEGS*4096u + META)
+#define DEV_BYTES (TIER_BASE + TIER_BYTES)
+#define TB 1000u     // tier bucket: 100 rows of each series
+#define T0 1000000u
+#define ROWS 200000u // per series; the raw ring keeps <10% of them
+
+/** @brief Remove sim artifacts to start from a blank device. */
+static void reset_sim(void){
+  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload();
+}
+
+static uint32_t row_ts(uint32_t i){ return T0 + i*10u; }
+static float row_val(uint16_t series, uint32_t i){ return (float)(i % 100u) + (float)series; }
+
+static int open_rc(void *ws, uint32_t bucket, uint32_t base, uint32_t bytes, stampdb_t **db){
+  stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=1u<<20,.read_batch_rows=512,.flash_bytes=RAW_BYTES,
+                     .rollup_bucket_ms=bucket,.rollup_flash_base=base,.rollup_flash_bytes=bytes};
+  return stampdb_open(db,&cfg);
+}
+
+static stampdb_t *open_db(void *ws){
+  stampdb_t *db=NULL;
+  return open_rc(ws, TB, TIER_BASE, TIER_BYTES, &db)==STAMPDB_OK ? db : NULL;
+}
+
+/** @brief Rows [from, from+n) of series 0 and 1, interleaved in runs of 50; flush + GC every 10000. */
+static int ingest(stampdb_t *db, uint32_t from, uint32_t n){
+  for (uint32_t i=from;i<from+n;i+=50u){
+    for (uint16_t series=0; series<2; series++){
+      uint32_t ts[50]; float v[50];
+      for (uint32_t j=0;j<50u;j++){ ts[j] = row_ts(i+j); v[j] = row_val(series, i+j); }
+      if (stampdb_write_batch(db, series, ts, v, 50)!=STAMPDB_OK) return -1;
+    }
+    if ((i+50u) % 10000u == 0){ if (stampdb_flush(db)!=STAMPDB_OK) return -1; stampdb_gc_step(db, 1000); }
+  }
+  return stampdb_flush(db)==STAMPDB_OK ? 0 : -1;
+}
+
+/** @brief Reference: the raw rows of [t0..t1] bucketed one by one through the iterator. */
+static uint32_t raw_buckets(stampdb_t *db, uint16_t series, uint32_t t0, uint32_t t1, uint32_t bucket_ms, stampdb_agg_t *out, uint32_t cap){
+  uint32_t nb = bucket_ms ? (t1 - t0)/bucket_ms + 1u : 1u;
+  if (nb > cap) return 0;
+  memset(out, 0, sizeof(*out)*nb);
+  stampdb_it_t it; uint32_t ts; float v;
+  stampdb_query_begin(db, series, t0, t1, &it);
+  while (stampdb_next(&it, &ts, &v)){
+    stampdb_agg_t *b = &out[bucket_ms ? (ts - t0)/bucket_ms : 0u];
+    if (!b->count || v < b->min) b->min = v; if (!b->count || v > b->max) b->max = v;
+    b->sum += v; b->count++;
+  }
+  stampdb_query_end(&it);
+  return nb;
+}
+
+/** @brief Aggregate vs the raw reference: exact counts, values within the Fixed16 error. */
+static int check_vs_raw(stampdb_t *db, uint16_t series, uint32_t t0, uint32_t t1, uint32_t bucket_ms){
+  static stampdb_agg_t got[256], want[256];
+  uint32_t n, nw = raw_buckets(db, series, t0, t1, bucket_ms, want, 256);
+  if (!nw || stampdb_query_aggregate(db, series, t0, t1, bucket_ms, got, 256, &n)!=STAMPDB_OK || n!=nw) return -1;
+  for (uint32_t i=0;i<n;i++){
+    const stampdb_agg_t *g = &got[i], *w = &want[i];
+    if (g->count != w->count){ fprintf(stderr, "[%u..%u]/%u bucket %u: count %u vs %u\n", t0, t1, bucket_ms, i, g->count, w->count); return -1; }
+    if (!g->count) continue;
+    if (fabsf(g->min - w->min) > 0.01f || fabsf(g->max - w->max) > 0.01f || fabsf(g->sum - w->sum) > 0.002f*fabsf(w->sum) + 1.0f){
+      fprintf(stderr, "[%u..%u]/%u bucket %u: %f/%f/%f vs %f/%f/%f\n", t0, t1, bucket_ms, i, g->min, g->max, g->sum, w->min, w->max, w->sum);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/** @brief Whole history of a series in one bucket: rows, min, max, sum per 100-row bucket. */
+static int check_total(stampdb_t *db, uint16_t series, uint32_t rows){
+  stampdb_agg_t a; uint32_t n;
+  if (stampdb_query_aggregate(db, series, T0, row_ts(rows) - 1u, 0, &a, 1, &n)!=STAMPDB_OK) return -1;
+  float sum = (float)(rows/100u) * (4950.0f + 100.0f*(float)series);
+  if (a.count != rows || a.min != (float)series || a.max != 99.0f + (float)series || fabsf(a.sum - sum) > 1e-4f*sum){
+    fprintf(stderr, "series %u total: %u rows %f/%f/%f\n", series, a.count, a.min, a.max, a.sum); return -1;
+  }
+  return 0;
+}
+
+int main(void){
+  char bytes[32]; snprintf(bytes, sizeof(bytes), "%u", DEV_BYTES);
+  setenv("STAMPDB_SIM_FLASH_BYTES", bytes, 1);
+  reset_sim();
+  void *ws = malloc(1u<<20);
+  stampdb_t *db = NULL;
+
+  // bad tiers: bucket too narrow for its 4 fields, overlapping the main partition, no partition, past the device
+  if (open_rc(ws, 3u, TIER_BASE, TIER_BYTES, &db)!=STAMPDB_EINVAL) return 1;
+  if (open_rc(ws, TB, TIER_BASE - 4096u, TIER_BYTES, &db)!=STAMPDB_EINVAL) return 2;
+  if (open_rc(ws, TB, TIER_BASE, 0u, &db)!=STAMPDB_EINVAL) return 3;
+  if (open_rc(ws, TB, TIER_BASE, TIER_BYTES + 4096u, &db)!=STAMPDB_EINVAL) return 4;
+
+  // long history: the raw ring wraps ~10x, the tier keeps every bucket
+  db = open_db(ws);
+  if (!db) return 5;
+  if (ingest(db, 0, ROWS)!=0) return 6;
+  stampdb_stats_t st; stampdb_info(db, &st);
+  if (st.seg_seq_head < 8u*RAW_SEGS || st.rollup_points < 2u*ROWS/100u){ fprintf(stderr, "seq %u points %u\n", st.seg_seq_head, st.rollup_points); return 7; }
+  stampdb_it_t it; uint32_t ts; float v;
+  stampdb_query_begin(db, 0, 0, 0xFFFFFFFFu, &it);
+  if (!stampdb_next(&it, &ts, &v) || ts < row_ts(ROWS/2u)) return 8; // raw rows of the first half are gone
+  uint32_t raw_first = ts;
+  if (check_total(db, 0, ROWS)!=0 || check_total(db, 1, ROWS)!=0) return 9;
+  stampdb_info(db, &st);
+  if (st.agg_rollup_points < 2u*ROWS/100u - 8u) return 10; // answered from the tier
+  static stampdb_agg_t out[256]; uint32_t n;
+  if (stampdb_query_aggregate(db, 1, T0, T0 + 199u*10000u + 9999u, 10000u, out, 256, &n)!=STAMPDB_OK || n != 200u) return 11;
+  for (uint32_t i=0;i<n;i++) if (out[i].count != 1000u || out[i].min != 1.0f || out[i].max != 100.0f) return 12;
+
+  // planner vs raw rows inside raw retention: unaligned edges, aligned and one-bucket windows
+  uint32_t last = row_ts(ROWS - 1u), agg0 = st.agg_rollup_points;
+  uint32_t a = raw_first + (TB - raw_first % TB) % TB; // first whole bucket with raw rows
+  if (check_vs_raw(db, 0, a, last, 0)!=0) return 13;
+  if (check_vs_raw(db, 1, a, last - 4321u, 5000u)!=0) return 14;
+  if (check_vs_raw(db, 0, a + 2u*TB, a + 37u*TB + 555u, TB)!=0) return 15;
+  if (check_vs_raw(db, 1, raw_first + 17u, last, 0)!=0) return 16; // unaligned t0, one bucket
+  if (check_vs_raw(db, 0, a + 10u, last, 2000u)!=0) return 17;     // unaligned t0: raw only
+  stampdb_info(db, &st);
+  if (st.agg_rollup_points == agg0) return 18;
+  stampdb_snapshot_save(db);
+  stampdb_close(db);
+
+  // reopen: old buckets still from the tier; buckets after reopen become tier-servable at flush
+  db = open_db(ws);
+  if (!db) return 19;
+  if (check_total(db, 0, ROWS)!=0 || check_vs_raw(db, 1, a, last, 0)!=0) return 20;
+  if (ingest(db, ROWS, 50000u)!=0) return 21;
+  if (check_total(db, 1, ROWS + 50000u)!=0) return 22;
+  uint32_t last2 = row_ts(ROWS + 49999u);
+  stampdb_query_begin(db, 0, 0, 0xFFFFFFFFu, &it);
+  if (!stampdb_next(&it, &ts, &v) || ts <= row_ts(ROWS)) return 23; // raw wrapped past the reopen point
+  uint32_t a2 = ts + (TB - ts % TB) % TB;
+  agg0 = (stampdb_info(db, &st), st.agg_rollup_points);
+  if (check_vs_raw(db, 0, a2, last2, 0)!=0 || check_vs_raw(db, 1, a2 + 3u*TB, last2, 3000u)!=0) return 24;
+  stampdb_info(db, &st);
+  if (st.agg_rollup_points == agg0) return 25;
+
+  // a late row inside the complete window: not counted until flushed, then exactly once
+  uint32_t late = row_ts(ROWS + 45000u) + 5u;
+  if (stampdb_write(db, 0, late, 50.0f)!=STAMPDB_OK) return 26;
+  stampdb_agg_t t;
+  if (stampdb_query_aggregate(db, 0, a2, last2, 0, &t, 1, &n)!=STAMPDB_OK) return 27;
+  uint32_t before = t.count;
+  if (stampdb_flush(db)!=STAMPDB_OK) return 28;
+  if (stampdb_query_aggregate(db, 0, a2, last2, 0, &t, 1, &n)!=STAMPDB_OK || t.count != before + 1u) return 29;
+  if (check_vs_raw(db, 0, a2, last2, 0)!=0 || check_vs_raw(db, 0, a2, last2, TB)!=0) return 30;
+  stampdb_info(db, &st);
+  if (st.crc_errors) return 31;
+  stampdb_close(db);
+
+  free(ws);
+  printf("rollup ok (%u points emitted, %u read by aggregates)\n", st.rollup_points, st.agg_rollup_points);
+  return 0;
+}
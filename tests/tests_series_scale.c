@@ -0,0 +1,154 @@
+/**
+ * @file tests_series_scale.c
+ * @brief u16 series ids: segments with only ids < 256 keep exact bitmaps ('SFG1'), mixed
+ * ones switch to a Bloom filter ('SFG2') with a bounded false-positive rate; every series
+ * reads back through queries and a latest cache smaller than the series count; filters
+ * survive the zone-map checkpoint; the tolerance table for high ids is bounded.
+ */
+#include "stampdb.h"
+#include "sim/sim_flash.h"
+#include "src/stampdb_internal.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEGS 96u
+#define NSERIES 600u
+#define ROWS 20u
+
+/** @brief Remove sim artifacts to start from a blank device. */
+static void reset_sim(void){
+  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload();
+}
+
+static uint16_t sid(uint32_t k){ return (uint16_t)(k*109u + 1000u); } // spread over 1000..66391 mod 2^16, never 0xFFFF
+static uint32_t row_ts(uint32_t round, uint32_t k, uint32_t i){ return 100000u*round + k*100u + i*5u; }
+static float row_val(uint32_t k, uint32_t i){ return (float)((k + i) & 63u); }
+
+static stampdb_t *open_db(void *ws){
+  stampdb_t *db=NULL;
+  stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=1u<<20,.read_batch_rows=512,.latest_slots=128};
+  return stampdb_open(&db,&cfg)==STAMPDB_OK ? db : NULL;
+}
+
+static uint32_t footer_magic(uint32_t seg){
+  uint32_t m; sim_flash_read(seg*4096u + 15u*256u, &m, sizeof(m)); return m;
+}
+
+/** @brief Every series: ROWS*rounds time-ordered rows with the expected values, latest = its last row. */
+static int check_all(stampdb_t *db, uint32_t rounds){
+  for (uint32_t k=0;k<NSERIES;k++){
+    stampdb_it_t it; uint32_t ts, n=0; float v;
+    if (stampdb_query_begin(db, sid(k), 0, 0xFFFFFFFFu, &it)!=STAMPDB_OK) return -1;
+    while (stampdb_next(&it, &ts, &v)){
+      uint32_t r = n / ROWS, i = n % ROWS;
+      if (ts != row_ts(r, k, i) || fabsf(v - row_val(k, i)) > 0.01f){ fprintf(stderr, "series %u row %u: %u %f\n", sid(k), n, ts, v); return -1; }
+      n++;
+    }
+    stampdb_query_end(&it);
+    if (n != rounds*ROWS){ fprintf(stderr, "series %u: %u rows\n", sid(k), n); return -1; }
+    if (stampdb_query_latest(db, sid(k), &ts, &v)!=STAMPDB_OK || ts != row_ts(rounds-1u, k, ROWS-1u) || fabsf(v - row_val(k, ROWS-1u)) > 0.01f){
+      fprintf(stderr, "latest %u: %u\n", sid(k), ts); return -1;
+    }
+  }
+  return 0;
+}
+
+int main(void){
+  char bytes[32]; snprintf(bytes, sizeof(bytes), "%u", (SEGS*4096u) + 32768u);
+  setenv("STAMPDB_SIM_FLASH_BYTES", bytes, 1);
+  reset_sim();
+  void *ws = malloc(1u<<20);
+
+  // filter unit checks: exact below 256, conversion keeps members, Bloom FPR with 15 ids
+  uint8_t f[STAMPDB_SERIES_FILTER_BYTES]; bool bloom = false;
+  memset(f, 0, sizeof(f));
+  series_set_add(f, &bloom, 3); series_set_add(f, &bloom, 200);
+  if (bloom || !series_set_has(f, bloom, 3) || series_set_has(f, bloom, 4) || series_set_has(f, bloom, 259)) return 1;
+  series_set_add(f, &bloom, 40000);
+  if (!bloom || !series_set_has(f, bloom, 3) || !series_set_has(f, bloom, 200) || !series_set_has(f, bloom, 40000)) return 2;
+  uint32_t fp = 0, probes = 0;
+  for (uint32_t t=0;t<200;t++){
+    memset(f, 0, sizeof(f)); bloom = true;
+    for (uint32_t j=0;j<15;j++) series_set_add(f, &bloom, (uint16_t)(t*977u + j*4099u));
+    for (uint32_t j=0;j<15;j++) if (!series_set_has(f, bloom, (uint16_t)(t*977u + j*4099u))) return 3; // no false negatives
+    for (uint32_t q=0;q<1000;q++){ uint16_t id = (uint16_t)(50000u + t*7u + q*13u); probes++; fp += series_set_has(f, bloom, id); }
+  }
+  if (fp*100u > probes){ fprintf(stderr, "bloom fpr %u/%u\n", fp, probes); return 4; } // expected ~0.2%
+
+  // bad ids
+  stampdb_t *db = open_db(ws);
+  if (!db) return 5;
+  if (stampdb_write(db, 0xFFFFu, 1, 1.0f)!=STAMPDB_EINVAL) return 6;
+
+  // low ids only: exact bitmap footers
+  for (uint32_t i=0;i<8000;i++) stampdb_write(db, (uint16_t)(i & 1u), 10u + i, 1.0f);
+  stampdb_flush(db);
+  if (footer_magic(0) != STAMPDB_FOOTER_MAGIC || db->s.segs[0].series_bloom) return 7;
+  stampdb_close(db);
+
+  // many high ids: one block per series and round, 15 series per segment
+  reset_sim();
+  db = open_db(ws);
+  if (!db) return 8;
+  const uint32_t rounds = 2;
+  for (uint32_t r=0;r<rounds;r++)
+    for (uint32_t k=0;k<NSERIES;k++)
+      for (uint32_t i=0;i<ROWS;i++) if (stampdb_write(db, sid(k), row_ts(r, k, i), row_val(k, i))!=STAMPDB_OK) return 9;
+  stampdb_flush(db);
+  if (footer_magic(0) != STAMPDB_FOOTER_MAGIC_BLOOM) return 10;
+  if (check_all(db, rounds)!=0) return 11;
+  stampdb_stats_t st; stampdb_info(db, &st);
+  if (st.latest_evictions == 0 || st.latest_misses == 0){ fprintf(stderr, "evictions %u misses %u\n", st.latest_evictions, st.latest_misses); return 12; }
+
+  // measured per-segment false positives against the real series sets
+  fp = probes = 0;
+  for (uint32_t seg=0; seg<db->s.seg_count; seg++){
+    const seg_summary_t *sm = &db->s.segs[seg];
+    if (!sm->valid || sm->block_count==0) continue;
+    uint16_t ids[STAMPDB_DATA_PAGES_PER_SEG]; uint32_t nid = 0;
+    for (uint32_t p=0;p<sm->block_count;p++){
+      uint8_t hdr[STAMPDB_HEADER_BYTES]; block_header_t h;
+      sim_flash_read(sm->addr_first + p*256u + STAMPDB_PAYLOAD_BYTES, hdr, sizeof(hdr));
+      if (codec_unpack_header(&h, hdr)) ids[nid++] = h.series;
+    }
+    for (uint32_t k=0;k<NSERIES;k++){
+      bool member = false;
+      for (uint32_t j=0;j<nid;j++) member |= ids[j] == sid(k);
+      if (member){ if (!series_set_has(sm->series_filter, sm->series_bloom, sid(k))) return 13; continue; }
+      probes++; fp += series_set_has(sm->series_filter, sm->series_bloom, sid(k));
+    }
+  }
+  if (probes == 0 || fp*100u > probes){ fprintf(stderr, "zone map fpr %u/%u\n", fp, probes); return 14; }
+
+  // tolerance overrides for high ids are bounded; clearing one frees its slot
+  for (uint32_t k=0;k<STAMPDB_TOLERANCE_EXT_SLOTS;k++) if (stampdb_set_tolerance(db, sid(k), 0.5f)!=STAMPDB_OK) return 15;
+  if (stampdb_set_tolerance(db, sid(NSERIES-1u), 0.5f)!=STAMPDB_ENOSPACE) return 16;
+  if (stampdb_set_tolerance(db, sid(0), 0.25f)!=STAMPDB_OK) return 17; // update in place
+  if (stampdb_set_tolerance(db, sid(1), STAMPDB_TOLERANCE_DEFAULT)!=STAMPDB_OK) return 18;
+  if (stampdb_set_tolerance(db, sid(NSERIES-1u), 0.5f)!=STAMPDB_OK) return 19;
+  if (stampdb_set_tolerance(db, 7, 0.5f)!=STAMPDB_OK) return 20; // low ids never run out
+
+  // checkpointed zone map round-trips the Bloom filters; reopen answers every series
+  seg_summary_t *before = malloc(sizeof(seg_summary_t)*SEGS);
+  memcpy(before, db->s.segs, sizeof(seg_summary_t)*db->s.seg_count);
+  uint32_t head_idx = db->s.head.addr / STAMPDB_SEG_BYTES;
+  stampdb_snapshot_save(db);
+  stampdb_close(db);
+  db = open_db(ws);
+  if (!db) return 21;
+  stampdb_info(db, &st);
+  if (st.recovery_footer_reads >= db->s.seg_count) return 22; // checkpoint used
+  for (uint32_t seg=0; seg<db->s.seg_count; seg++){
+    const seg_summary_t *a = &before[seg], *b = &db->s.segs[seg];
+    if (seg == head_idx || !a->valid || a->block_count==0) continue;
+    if (a->series_bloom != b->series_bloom || memcmp(a->series_filter, b->series_filter, STAMPDB_SERIES_FILTER_BYTES)!=0) return 23;
+  }
+  if (check_all(db, rounds)!=0) return 24;
+  stampdb_close(db);
+
+  free(before); free(ws);
+  printf("series_scale ok (fpr %u/%u, evictions %u, misses %u)\n", fp, probes, st.latest_evictions, st.latest_misses);
+  return 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file tests_sim_timing.c
+ * @brief Simulator timing model: ops charge their latency to the virtual clock behind
+ * platform_micros(), per-op counters add up, jitter is bounded and repeatable per seed,
+ * the env presets parse; under the RP2350 model synchronous writes pay the rotation
+ * erase, write-behind writes never touch flash, and gc_step budgets count modeled erases.
+ */
+#include "stampdb.h"
+#include "sim/sim_flash.h"
+#include "src/stampdb_internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief Remove sim artifacts to start from a blank device. */
+static void reset_sim(void){
+  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload();
+}
+
+/** @brief Modeled latencies of `n` erases of sector 0. */
+static void erase_lat(uint64_t *out, uint32_t n){
+  for (uint32_t i=0;i<n;i++){ uint64_t t = sim_clock_us(); sim_flash_erase_4k(0); out[i] = sim_clock_us() - t; }
+}
+
+/** @brief Max modeled latency of `rows` single-series writes, one every 10 ms; idle work if `wb`. */
+static uint64_t ingest_max_us(stampdb_t *db, uint32_t rows, uint32_t wb){
+  uint64_t worst = 0;
+  for (uint32_t i=0;i<rows;i++){
+    uint64_t t = sim_clock_us();
+    if (stampdb_write(db, 0, i*10u, (float)(i & 63u))!=STAMPDB_OK) return UINT64_MAX;
+    uint64_t d = sim_clock_us() - t; if (d > worst) worst = d;
+    if (wb) while (stampdb_flash_step(db, 1000)==STAMPDB_EBUSY) {}
+    sim_clock_advance_us(10000);
+  }
+  return worst;
+}
+
+static stampdb_t *open_db(void *ws, uint32_t wb){
+  stampdb_t *db=NULL;
+  stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=1u<<20,.read_batch_rows=512,.write_behind_pages=wb};
+  return stampdb_open(&db,&cfg)==STAMPDB_OK ? db : NULL;
+}
+
+int main(void){
+  setenv("STAMPDB_SIM_FLASH_BYTES", "262144", 1);
+  unsetenv("STAMPDB_SIM_TIMING"); unsetenv("STAMPDB_SIM_JITTER");
+  reset_sim();
+  sim_flash_stats_t st;
+
+  // off by default: ops are counted but cost no modeled time
+  if (sim_flash_get_timing(NULL)) return 1;
+  sim_flash_stats(&st, true);
+  uint64_t c0 = sim_clock_us(); uint8_t page[256]; memset(page, 0xA5, sizeof(page));
+  sim_flash_erase_4k(4096); sim_flash_program_256(4096, page);
+  sim_flash_stats(&st, true);
+  if (sim_clock_us() != c0 || st.op[SIM_OP_ERASE].ops != 1 || st.op[SIM_OP_PROGRAM].ops != 1 || st.op[SIM_OP_ERASE].busy_us) return 2;
+
+  // env presets: rp2350 and a custom triple
+  setenv("STAMPDB_SIM_TIMING", "rp2350", 1); sim_flash_reload();
+  sim_flash_timing_t t;
+  if (!sim_flash_get_timing(&t) || t.erase_us != sim_flash_timing_rp2350().erase_us || t.program_us != 500u) return 3;
+  setenv("STAMPDB_SIM_TIMING", "30000,400,20", 1); setenv("STAMPDB_SIM_JITTER", "10,7", 1); sim_flash_reload();
+  if (!sim_flash_get_timing(&t) || t.erase_us != 30000u || t.program_us != 400u || t.read_ns_per_byte != 20u || t.jitter_pct != 10u || t.seed != 7u) return 4;
+  setenv("STAMPDB_SIM_TIMING", "off", 1); unsetenv("STAMPDB_SIM_JITTER"); sim_flash_reload();
+  if (sim_flash_get_timing(NULL)) return 5;
+
+  // exact latencies: the clock and platform_micros() move by the modeled cost only
+  sim_flash_timing_t rp = sim_flash_timing_rp2350();
+  sim_flash_set_timing(&rp);
+  sim_flash_stats(&st, true);
+  c0 = sim_clock_us(); uint64_t p0 = platform_micros();
+  if (p0 != c0) return 6;
+  sim_flash_erase_4k(8192);
+  if (sim_clock_us() - c0 != rp.erase_us) return 7;
+  for (uint32_t i=0;i<4;i++) sim_flash_program_256(8192u + i*256u, page);
+  uint8_t buf[4096]; sim_flash_read(8192, buf, sizeof(buf)); // 4096 B * 30 ns = 122.88 us
+  if (platform_micros() - p0 != rp.erase_us + 4u*rp.program_us + 122u) return 8;
+  sim_clock_advance_us(5000);
+  if (platform_millis() != (p0 + rp.erase_us + 4u*rp.program_us + 122u + 5000u)/1000u) return 9;
+  sim_flash_stats(&st, false);
+  if (st.op[SIM_OP_PROGRAM].ops != 4 || st.op[SIM_OP_PROGRAM].busy_us != 4u*rp.program_us || st.op[SIM_OP_PROGRAM].max_us != rp.program_us) return 10;
+  if (st.op[SIM_OP_READ].bytes != 4096u || st.op[SIM_OP_READ].busy_us != 122u || st.op[SIM_OP_ERASE].max_us != rp.erase_us) return 11;
+
+  // jitter: within ±pct, not constant, the same sequence again for the same seed, another for a new one
+  enum { NJ = 64 };
+  uint64_t a[NJ], b[NJ], c[NJ];
+  sim_flash_timing_t j = rp; j.jitter_pct = 20; j.seed = 42;
+  sim_flash_set_timing(&j); erase_lat(a, NJ);
+  sim_flash_set_timing(&j); erase_lat(b, NJ);
+  j.seed = 43; sim_flash_set_timing(&j); erase_lat(c, NJ);
+  uint64_t lo = UINT64_MAX, hi = 0;
+  for (uint32_t i=0;i<NJ;i++){ if (a[i] < lo) lo = a[i]; if (a[i] > hi) hi = a[i]; }
+  if (lo < rp.erase_us*80u/100u || hi > rp.erase_us*120u/100u || lo == hi) return 12;
+  if (memcmp(a, b, sizeof(a))!=0 || memcmp(a, c, sizeof(a))==0) return 13;
+
+  // RP2350 model end to end: a synchronous write that rotates waits for the erase...
+  sim_flash_set_timing(&rp);
+  reset_sim();
+  void *ws = malloc(1u<<20);
+  stampdb_t *db = open_db(ws, 0);
+  if (!db) return 14;
+  uint64_t sync_max = ingest_max_us(db, 4000, 0);
+  if (sync_max < rp.erase_us || sync_max == UINT64_MAX) return 15;
+  stampdb_close(db);
+
+  // ...a write-behind one never does: the idle loop issues the queue
+  reset_sim();
+  db = open_db(ws, 8);
+  if (!db) return 16;
+  uint64_t wb_max = ingest_max_us(db, 4000, 1);
+  if (wb_max >= rp.program_us) return 17;
+  stampdb_stats_t ds; stampdb_info(db, &ds);
+  if (ds.wb_full_stalls) return 18;
+  stampdb_close(db);
+
+  // gc_step budgets count modeled time: a 30 ms budget starts one 45 ms erase, then stops
+  reset_sim();
+  db = open_db(ws, 0);
+  if (!db) return 19;
+  sim_flash_stats(&st, true);
+  if (stampdb_gc_step(db, 30000)!=STAMPDB_EBUSY) return 20;
+  sim_flash_stats(&st, true);
+  if (st.op[SIM_OP_ERASE].ops != 1) return 21; // checked before each erase, so one may overrun
+  if (stampdb_gc_step(db, 1000000)!=STAMPDB_OK) return 22;
+  stampdb_close(db);
+
+  sim_flash_set_timing(NULL);
+  if (sim_flash_get_timing(NULL)) return 23;
+  free(ws);
+  printf("sim_timing ok (sync write max %llu us, write-behind max %llu us)\n", (unsigned long long)sync_max, (unsigned long long)wb_max);
+  return 0;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file tests_spsc_ring.c
+ * @brief Pico Core0→Core1 sample ring: FIFO order, no loss or duplication under a
+ * concurrent producer/consumer, full-ring refusal, and depth high-water mark.
+ */
+#include "platform/pico/spsc_ring.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+#define N 500000u
+
+static spsc_ring_t ring;
+
+/** @brief Producer thread: push 0..N-1, spinning (and counting stalls) while full. */
+static void *producer(void *arg){
+  (void)arg;
+  for (uint32_t i=0;i<N;i++){
+    spsc_sample_t s = { i, (float)(i & 0xFFFFu), (uint16_t)(i % 7u), 0 };
+    if (!spsc_push(&ring, &s)){ ring.stalls++; while (!spsc_push(&ring, &s)) sched_yield(); }
+  }
+  return NULL;
+}
+
+int main(void){
+  // single-threaded: full ring refuses, batch pop returns oldest first
+  spsc_sample_t s = {0};
+  for (uint32_t i=0;i<SPSC_RING_SLOTS;i++){ s.ts = i; if (!spsc_push(&ring, &s)) return 1; }
+  if (spsc_push(&ring, &s) || spsc_depth(&ring)!=SPSC_RING_SLOTS || ring.hwm!=SPSC_RING_SLOTS) return 2;
+  uint16_t se[100]; uint32_t ts[100]; float v[100];
+  if (spsc_pop(&ring, se, ts, v, 100)!=100 || ts[0]!=0 || ts[99]!=99) return 3;
+  s.ts = 5000; if (!spsc_push(&ring, &s)) return 4;
+  uint32_t expect = 100; size_t n;
+  while ((n = spsc_pop(&ring, se, ts, v, 100)) > 0) for (size_t k=0;k<n;k++){ if (ts[k] != (expect < SPSC_RING_SLOTS ? expect : 5000u)) return 5; expect++; }
+  if (expect != SPSC_RING_SLOTS + 1u || spsc_depth(&ring)!=0) return 6;
+
+  // concurrent: every sample arrives once, in order, with its fields intact
+  memset(&ring, 0, sizeof(ring));
+  pthread_t th; if (pthread_create(&th, NULL, producer, NULL)!=0) return 7;
+  uint32_t next = 0;
+  while (next < N){
+    if (!(n = spsc_pop(&ring, se, ts, v, 100))) sched_yield();
+    for (size_t k=0;k<n;k++,next++){
+      if (ts[k]!=next || se[k]!=(uint16_t)(next % 7u) || v[k]!=(float)(next & 0xFFFFu)){ fprintf(stderr,"sample %u: got ts=%u series=%u\n", next, ts[k], se[k]); return 8; }
+    }
+  }
+  pthread_join(th, NULL);
+  if (spsc_depth(&ring)!=0 || ring.hwm > SPSC_RING_SLOTS) return 9;
+  printf("spsc ring OK (stalls=%u hwm=%u)\n", ring.stalls, ring.hwm);
+  return 0;
+}
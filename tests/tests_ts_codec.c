@@ -0,0 +1,82 @@
+/**
+ * @file tests_ts_codec.c
+ * @brief Delta-of-delta timestamp lane: codec round-trips and denser blocks end to end.
+ */
+#include "stampdb.h"
+#include "src/stampdb_internal.h"
+#include "sim/sim_flash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+/** @brief Remove sim artifacts to start from a blank device. */
+static void reset_sim(void){
+  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload();
+}
+
+/** @brief Encode/decode `n` deltas through the DOD lane; checks last_ts/last_value helpers too. */
+static int roundtrip(const uint32_t *d, uint16_t n){
+  int16_t q[STAMPDB_BLOCK_MAX_ROWS]; for (uint16_t i=0;i<n;i++) q[i]=(int16_t)(i*37-2000);
+  uint8_t buf[STAMPDB_PAYLOAD_BYTES];
+  block_header_t h={.count=n,.t0_ms=5000,.dt_bits=STAMPDB_DT_DOD,.val_lane=STAMPDB_VAL_Q16,.bias=0.0f,.scale=1.0f};
+  if (!codec_encode_payload(buf, &h, d, q, NULL)) return 1;
+  uint32_t d2[STAMPDB_BLOCK_MAX_ROWS]; float v2[STAMPDB_BLOCK_MAX_ROWS];
+  if (!codec_decode_payload(buf, &h, d2, v2)) return 2;
+  uint32_t t = 5000; for (uint16_t i=0;i<n;i++){ if (d2[i]!=d[i] || v2[i]!=(float)q[i]) return 3; t += d[i]; }
+  if (codec_block_last_ts(&h, buf)!=t || codec_block_last_value(&h, buf)!=(float)q[n-1]) return 4;
+  return 0;
+}
+
+/* Fixed16 values (2 B each) behind a 5 B constant-cadence lane. */
+#define Q16_MAX_ROWS 109u
+
+int main(void){
+  uint32_t d[STAMPDB_BLOCK_MAX_ROWS]; int rc;
+  // constant cadence: the whole lane is 5 bytes, so the block holds the Fixed16 row cap
+  for (uint32_t i=0;i<Q16_MAX_ROWS;i++) d[i] = i ? 1000u : 0u;
+  if (codec_dod_lane_bytes(Q16_MAX_ROWS, 0) + 2u*Q16_MAX_ROWS > STAMPDB_PAYLOAD_BYTES) return 10;
+  if ((rc = roundtrip(d, Q16_MAX_ROWS))){ fprintf(stderr,"constant rc=%d\n",rc); return 10+rc; }
+  // jitter, negative dods, and deltas beyond the u16 lane
+  for (uint32_t i=1;i<80;i++) d[i] = 100u + (i*7u)%9u;
+  if ((rc = roundtrip(d, 80))){ fprintf(stderr,"jitter rc=%d\n",rc); return 20+rc; }
+  for (uint32_t i=1;i<60;i++) d[i] = 300000u + (i%2 ? 0u : 250u);
+  if ((rc = roundtrip(d, 60))){ fprintf(stderr,"slow rc=%d\n",rc); return 30+rc; }
+  d[1] = 0x7FFFFFFFu; d[2] = 0; d[3] = 0x7FFFFFFFu; // full 32-bit zigzag width
+  if ((rc = roundtrip(d, 4))){ fprintf(stderr,"wide rc=%d\n",rc); return 40+rc; }
+  if ((rc = roundtrip(d, 1)) || (rc = roundtrip(d, 2))){ fprintf(stderr,"short rc=%d\n",rc); return 50+rc; }
+  // oversize is refused rather than truncated
+  int16_t q[STAMPDB_BLOCK_MAX_ROWS] = {0}; uint8_t buf[STAMPDB_PAYLOAD_BYTES];
+  block_header_t h8={.count=75,.dt_bits=8,.val_lane=STAMPDB_VAL_Q16}, hd={.count=Q16_MAX_ROWS+1u,.dt_bits=STAMPDB_DT_DOD,.val_lane=STAMPDB_VAL_Q16};
+  if (codec_encode_payload(buf, &h8, d, q, NULL)!=0 || codec_encode_payload(buf, &hd, d, q, NULL)!=0) return 60;
+
+  // end to end: fixed cadence fills 109-row Fixed16 blocks; slow and jittery sensors stay exact
+  reset_sim();
+  size_t ws_bytes = 1<<20; void *ws = malloc(ws_bytes);
+  stampdb_t *db=NULL; stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=(uint32_t)ws_bytes,.read_batch_rows=512};
+  if (stampdb_open(&db,&cfg)!=STAMPDB_OK) return 70;
+  const int N = 10*(int)Q16_MAX_ROWS;
+  for (int i=0;i<N;i++) if (stampdb_write(db,1,(uint32_t)(i*1000),(float)(i%50))!=STAMPDB_OK) return 71;
+  stampdb_flush(db);
+  stampdb_stats_t st; stampdb_info(db,&st);
+  if (st.blocks_written!=10u){ fprintf(stderr,"constant cadence took %u blocks\n",st.blocks_written); return 72; }
+  uint32_t ts_j[500], ts_s[300]; uint32_t t=0;
+  for (int i=0;i<500;i++){ t += 95u + (uint32_t)((i*13)%11); ts_j[i]=t; }
+  for (int i=0;i<300;i++) ts_s[i] = (uint32_t)i*300000u + (uint32_t)(i%3);
+  for (int i=0;i<500;i++) if (stampdb_write(db,2,ts_j[i],(float)i)!=STAMPDB_OK) return 73;
+  for (int i=0;i<300;i++) if (stampdb_write(db,3,ts_s[i],(float)i)!=STAMPDB_OK) return 74;
+  stampdb_flush(db);
+  for (int k=0;k<2;k++){
+    uint16_t series = (uint16_t)(2+k); const uint32_t *want = k ? ts_s : ts_j; int n = k ? 300 : 500;
+    stampdb_it_t it; stampdb_query_begin(db, series, 0, 0xFFFFFFFFu, &it);
+    uint32_t ts; float v; int i=0;
+    while (stampdb_next(&it,&ts,&v)){ if (i>=n || ts!=want[i] || fabsf(v-(float)i)>0.05f){ fprintf(stderr,"s%u row %d ts %u\n",series,i,ts); return 75; } i++; }
+    stampdb_query_end(&it);
+    if (i!=n){ fprintf(stderr,"s%u rows %d\n",series,i); return 76; }
+  }
+  stampdb_info(db,&st);
+  // jitter needs 5-bit dods (~83 rows/block), the slow sensor 3-bit (~92): 7 + 4 blocks
+  if (st.blocks_written > 10u + 7u + 4u){ fprintf(stderr,"blocks %u\n",st.blocks_written); return 77; }
+  stampdb_close(db); free(ws);
+  printf("ts_codec OK\n");
+  return 0;
+}
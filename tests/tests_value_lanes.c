@@ -0,0 +1,146 @@
+/**
+ * @file tests_value_lanes.c
+ * @brief Adaptive value lanes: 8/12-bit Fixed-point within a series tolerance, lossless XOR floats.
+ */
+#include "stampdb.h"
+#include "src/stampdb_internal.h"
+#include "sim/sim_flash.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** @brief Remove sim artifacts to start from a blank device. */
+static void reset_sim(void){
+  remove("flash.bin"); remove("meta_snap_a.bin"); remove("meta_snap_b.bin"); remove("meta_head_hint.bin"); sim_flash_reload();
+}
+
+static stampdb_t *open_db(void *ws, size_t ws_bytes){
+  stampdb_t *db=NULL; stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=(uint32_t)ws_bytes,.read_batch_rows=512};
+  return stampdb_open(&db,&cfg)==STAMPDB_OK ? db : NULL;
+}
+
+/** @brief Codec-level round trip of one lane; XOR must be bit-exact. */
+static int lane_roundtrip(uint8_t lane, const float *vals, uint16_t n){
+  uint32_t d[STAMPDB_BLOCK_MAX_ROWS] = {0}; int16_t q[STAMPDB_BLOCK_MAX_ROWS];
+  block_header_t h={.count=n,.dt_bits=STAMPDB_DT_DOD,.val_lane=lane,.bias=0.0f,.scale=1.0f};
+  for (uint16_t i=0;i<n;i++) q[i] = (int16_t)vals[i];
+  uint8_t buf[STAMPDB_PAYLOAD_BYTES];
+  if (!codec_encode_payload(buf, &h, d, q, vals)) return 1;
+  uint32_t d2[STAMPDB_BLOCK_MAX_ROWS]; float v2[STAMPDB_BLOCK_MAX_ROWS];
+  if (!codec_decode_payload(buf, &h, d2, v2)) return 2;
+  if (memcmp(v2, vals, sizeof(float)*n)!=0) return 3;
+  float last = codec_block_last_value(&h, buf);
+  if (memcmp(&last, &vals[n-1], 4)!=0) return 4;
+  return 0;
+}
+
+int main(void){
+  float v[STAMPDB_BLOCK_MAX_ROWS]; int rc;
+  // quantized lanes keep their sign at every bit offset (q12 packs two values per 3 bytes)
+  for (int i=0;i<200;i++) v[i] = (float)((i*37)%255 - 127);
+  if ((rc = lane_roundtrip(STAMPDB_VAL_Q8, v, 200))){ fprintf(stderr,"q8 rc=%d\n",rc); return 10+rc; }
+  for (int i=0;i<141;i++) v[i] = (float)((i*997)%4095 - 2047);
+  if ((rc = lane_roundtrip(STAMPDB_VAL_Q12, v, 141))){ fprintf(stderr,"q12 rc=%d\n",rc); return 20+rc; }
+  if ((rc = lane_roundtrip(STAMPDB_VAL_Q12, v, 140))){ fprintf(stderr,"q12 even rc=%d\n",rc); return 20+rc; }
+  // XOR: repeats, sub-window changes, full-width changes, signed zero, inf/nan bits
+  for (int i=0;i<60;i++) v[i] = (i%7==0) ? v[i>0?i-1:0] : (float)(1000.0 + 0.125*i);
+  v[0] = 1000.0f; v[10] = -0.0f; v[11] = 0.0f; v[20] = INFINITY; v[21] = -3.4e38f; v[22] = 1e-40f;
+  uint32_t nanbits = 0x7FC01234u; memcpy(&v[30], &nanbits, 4);
+  if ((rc = lane_roundtrip(STAMPDB_VAL_XOR, v, 60))){ fprintf(stderr,"xor rc=%d\n",rc); return 30+rc; }
+  for (uint32_t i=0;i<STAMPDB_BLOCK_MAX_ROWS;i++) v[i] = 42.0f; // constant: 32 bits + 1 bit per row
+  if ((rc = lane_roundtrip(STAMPDB_VAL_XOR, v, STAMPDB_BLOCK_MAX_ROWS))){ fprintf(stderr,"xor const rc=%d\n",rc); return 40+rc; }
+  // a new window exactly 10 bits shorter than the previous one costs the same as reusing it
+  const uint32_t shrink[4] = { 0x00000000u, 0x000FFFFFu, 0x3FFFFFFFu, 0x3FFFFFFEu };
+  memcpy(v, shrink, sizeof(shrink));
+  if ((rc = lane_roundtrip(STAMPDB_VAL_XOR, v, 4))){ fprintf(stderr,"xor shrink rc=%d\n",rc); return 80+rc; }
+  // a lane that would run past the payload is refused
+  for (int i=0;i<60;i++){ uint32_t u = 0x9E3779B9u * (uint32_t)(i+1); memcpy(&v[i], &u, 4); }
+  block_header_t hx={.count=60,.dt_bits=STAMPDB_DT_DOD,.val_lane=STAMPDB_VAL_XOR}; uint8_t buf[STAMPDB_PAYLOAD_BYTES]; uint32_t d[60]={0};
+  if (codec_encode_payload(buf, &hx, d, NULL, v)!=0) return 50;
+
+  // end to end
+  reset_sim();
+  size_t ws_bytes = 1<<20; void *ws = malloc(ws_bytes);
+  stampdb_t *db = open_db(ws, ws_bytes); if (!db) return 60;
+  if (stampdb_set_tolerance(db, 0xFFFF, 0.1f)!=STAMPDB_EINVAL || stampdb_set_tolerance(db, 1, NAN)!=STAMPDB_EINVAL) return 61;
+  if (stampdb_set_tolerance(db, 1, 0.01f)!=STAMPDB_OK) return 62;              // slow signal in [-1, 1]: q8
+  if (stampdb_set_tolerance(db, 2, 0.001f)!=STAMPDB_OK) return 63;             // [-4, 4]: q12
+  if (stampdb_set_tolerance(db, 3, STAMPDB_TOLERANCE_LOSSLESS)!=STAMPDB_OK) return 64; // counter
+  const int N = 2000;
+  for (int i=0;i<N;i++){
+    uint32_t ts = (uint32_t)i*1000u;
+    if (stampdb_write(db, 1, ts, sinf((float)i*0.01f))!=STAMPDB_OK) return 65;
+    if (stampdb_write(db, 2, ts, 4.0f*cosf((float)i*0.003f))!=STAMPDB_OK) return 66;
+    if (stampdb_write(db, 3, ts, 16777216.0f + (float)(i*2) + 0.5f*(float)(i%2))!=STAMPDB_OK) return 67;
+    if (stampdb_write(db, 4, ts, sinf((float)i*0.01f))!=STAMPDB_OK) return 68; // default: Fixed16
+  }
+  stampdb_flush(db); stampdb_close(db);
+  db = open_db(ws, ws_bytes); if (!db) return 69;
+  const float tol[5] = {0, 0.01f, 0.001f, 0.0f, 1e-4f};
+  for (uint16_t s=1;s<=4;s++){
+    stampdb_it_t it; stampdb_query_begin(db, s, 0, 0xFFFFFFFFu, &it);
+    uint32_t ts; float got; int i=0; float worst=0;
+    while (stampdb_next(&it,&ts,&got)){
+      float want = s==1||s==4 ? sinf((float)i*0.01f) : s==2 ? 4.0f*cosf((float)i*0.003f) : 16777216.0f + (float)(i*2) + 0.5f*(float)(i%2);
+      if (ts != (uint32_t)i*1000u){ fprintf(stderr,"s%u row %d ts %u\n",s,i,ts); return 70; }
+      float e = fabsf(got-want); if (e > worst) worst = e;
+      if (s==3 && memcmp(&got,&want,4)!=0){ fprintf(stderr,"lossless row %d: %.9g vs %.9g\n",i,got,want); return 71; }
+      i++;
+    }
+    stampdb_query_end(&it);
+    if (i!=N){ fprintf(stderr,"s%u rows %d\n",s,i); return 72; }
+    if (worst > tol[s]*1.01f + 1e-6f){ fprintf(stderr,"s%u worst error %g > %g\n",s,worst,tol[s]); return 73; }
+  }
+  // exact latest for the lossless series, rebuilt by recovery from the XOR lane
+  uint32_t lts; float lv, want = 16777216.0f + (float)((N-1)*2) + 0.5f;
+  if (stampdb_query_latest(db, 3, &lts, &lv)!=STAMPDB_OK || lts!=(uint32_t)(N-1)*1000u || memcmp(&lv,&want,4)!=0) return 74;
+  // header aggregates stay exact on the narrow lanes; XOR blocks are decoded instead
+  for (uint16_t s=1;s<=3;s++){
+    stampdb_agg_t a; uint32_t nb=0;
+    if (stampdb_query_aggregate(db, s, 0, 0xFFFFFFFFu, 0, &a, 1, &nb)!=STAMPDB_OK || nb!=1 || a.count!=(uint32_t)N) return 75;
+    float lo = s==1 ? -1.0f : s==2 ? -4.0f : 16777216.0f, hi = s==1 ? 1.0f : s==2 ? 4.0f : want;
+    if (a.min < lo - 2*tol[s] - 1e-3f || a.max > hi + 2*tol[s] + 1e-3f){ fprintf(stderr,"s%u agg [%f,%f]\n",s,a.min,a.max); return 76; }
+    if (s==3 && a.max!=want) return 77;
+  }
+  // capacity: q8 values pack ~2x the rows of the Fixed16 series with the same signal
+  stampdb_stats_t st; stampdb_info(db, &st);
+  uint32_t b1=0, b4=0;
+  for (uint16_t s=1;s<=4;s+=3){
+    stampdb_it_t it; stampdb_query_begin(db, s, 0, 0xFFFFFFFFu, &it);
+    uint32_t ts; float got; uint32_t blocks=0; uint32_t last_blk_t0 = 0xFFFFFFFFu;
+    while (stampdb_next(&it,&ts,&got)){ if (it.t0_block != last_blk_t0){ blocks++; last_blk_t0 = it.t0_block; } }
+    stampdb_query_end(&it);
+    if (s==1) b1 = blocks; else b4 = blocks;
+  }
+  if (!(b1*2u <= b4 + 1u)){ fprintf(stderr,"q8 blocks %u vs q16 %u\n",b1,b4); return 78; }
+
+  // lossless round trip of random mantissa windows (any lead/len, so windows grow and shrink)
+  enum { NW = 3000 };
+  static uint32_t wbits[NW];
+  uint32_t rng = 12345u, u = 0x3F800000u;
+  if (stampdb_set_tolerance(db, 5, STAMPDB_TOLERANCE_LOSSLESS)!=STAMPDB_OK) return 85;
+  for (uint32_t i=0;i<NW;i++){
+    rng = rng*1664525u + 1013904223u; uint32_t lead = 9u + (rng >> 8) % 23u;
+    rng = rng*1664525u + 1013904223u; uint32_t len = 1u + (rng >> 8) % (32u - lead);
+    rng = rng*1664525u + 1013904223u; uint32_t mask = (len == 32u ? ~0u : ((1u << len) - 1u)) << (32u - lead - len);
+    if (i % 5u) u ^= (rng | 1u << (31u - lead)) & mask; // exponent untouched: always finite
+    wbits[i] = u; float f; memcpy(&f, &u, 4);
+    if (stampdb_write(db, 5, 5000000u + i*10u, f)!=STAMPDB_OK) return 86;
+  }
+  stampdb_flush(db);
+  stampdb_info(db, &st);
+  uint32_t crc0 = st.crc_errors, nw = 0;
+  { stampdb_it_t it; stampdb_query_begin(db, 5, 0, 0xFFFFFFFFu, &it);
+    uint32_t ts; float got;
+    while (stampdb_next(&it,&ts,&got)){
+      if (nw >= NW || ts != 5000000u + nw*10u || memcmp(&got, &wbits[nw], 4)!=0){ fprintf(stderr,"xor window row %u\n",nw); return 87; }
+      nw++;
+    }
+    stampdb_query_end(&it); }
+  stampdb_info(db, &st);
+  if (nw != NW || st.crc_errors != crc0){ fprintf(stderr,"xor window rows %u\n",nw); return 88; }
+  stampdb_close(db); free(ws);
+  printf("value_lanes OK (q8 %u blocks, q16 %u blocks)\n", b1, b4);
+  return 0;
+}
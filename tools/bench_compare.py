@@ -0,0 +1,64 @@
+#!/usr/bin/env python3
+"""
+bench_compare.py — diff two stampdb_bench JSON results.
+
+Usage:
+  python3 tools/bench_compare.py BASE.json NEW.json [--threshold PCT] [--only BENCH]
+
+Prints every metric present in both runs with its relative change (positive = better,
+using each result's "better" direction). Exits 1 when any metric regressed by more
+than --threshold percent (default 10), so it can gate CI between releases. Runs from
+different platforms (e.g. sim vs a Pico harness) compare fine; only keys that match
+(bench, case, metric) are diffed.
+"""
+import argparse
+import json
+import sys
+from typing import Dict, Tuple
+
+Key = Tuple[str, str, str]
+
+
+def load(path: str) -> Tuple[dict, Dict[Key, dict]]:
+    with open(path) as f:
+        doc = json.load(f)
+    if doc.get("schema") != "stampdb-bench/1":
+        raise SystemExit(f"{path}: unknown schema {doc.get('schema')!r}")
+    return doc, {(r["bench"], r["case"], r["metric"]): r for r in doc["results"]}
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("base")
+    ap.add_argument("new")
+    ap.add_argument("--threshold", type=float, default=10.0, help="regression limit in percent")
+    ap.add_argument("--only", help="restrict to one bench (ingest/query/latest/open)")
+    args = ap.parse_args()
+
+    bdoc, base = load(args.base)
+    ndoc, new = load(args.new)
+    print(f"base: {bdoc.get('label') or args.base} ({bdoc.get('platform')})   new: {ndoc.get('label') or args.new} ({ndoc.get('platform')})")
+    regressions = 0
+    for key in sorted(base.keys() & new.keys()):
+        if args.only and key[0] != args.only:
+            continue
+        b, n = base[key]["value"], new[key]["value"]
+        if b == 0:
+            change = 0.0 if n == 0 else float("inf")
+        else:
+            change = (n - b) / abs(b) * 100.0
+        if base[key]["better"] == "lower" and change:
+            change = -change
+        flag = ""
+        if change < -args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print(f"{key[0]:7} {key[1]:34} {key[2]:15} {b:>14.6g} -> {n:<14.6g} {change:+7.1f}%{flag}")
+    missing = sorted(base.keys() - new.keys())
+    for key in missing:
+        print(f"{key[0]:7} {key[1]:34} {key[2]:15} missing in new run")
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,43 @@
+#!/usr/bin/env python3
+"""
+gen_crc32c_table.py — regenerate src/crc32c_table.h (slicing-by-8 CRC-32C tables).
+
+Usage:
+  python3 tools/gen_crc32c_table.py > src/crc32c_table.h
+
+Tables are reflected CRC-32C (Castagnoli, poly 0x82F63B78 == reversed 0x1EDC6F41),
+matching the SSE4.2 `crc32` and ARMv8 `crc32c*` instructions.
+"""
+POLY = 0x82F63B78
+
+def main() -> None:
+    t = [[0] * 256 for _ in range(8)]
+    for i in range(256):
+        c = i
+        for _ in range(8):
+            c = (c >> 1) ^ POLY if c & 1 else c >> 1
+        t[0][i] = c
+    for k in range(1, 8):
+        for i in range(256):
+            c = t[k - 1][i]
+            t[k][i] = (c >> 8) ^ t[0][c & 0xFF]
+    print("/**")
+    print(" * @file crc32c_table.h")
+    print(" * @brief Generated slicing-by-8 tables for reflected CRC-32C (poly 0x82F63B78).")
+    print(" *")
+    print(" * Do not edit: regenerate with `python3 tools/gen_crc32c_table.py > src/crc32c_table.h`.")
+    print(" * Table k maps a byte to its CRC contribution k bytes ahead of the stream end.")
+    print(" */")
+    print("#pragma once")
+    print("#include <stdint.h>")
+    print()
+    print("static const uint32_t crc32c_table[8][256] = {")
+    for k in range(8):
+        print("  {")
+        for r in range(0, 256, 8):
+            print("    " + ", ".join("0x%08Xu" % v for v in t[k][r:r + 8]) + ",")
+        print("  },")
+    print("};")
+
+if __name__ == "__main__":
+    main()
@@ -3,21 +3,27 @@
  * @brief Command-line tools: export, retention, info, and ingest helpers.
  *
  * Subcommands:
- *  - export    → CSV/NDJSON by time range
+ *  - export    → CSV/NDJSON by time range; --all: every series, the ring split across
+ *                --threads workers (CRC + decode in parallel), optionally to a binary
+ *                columnar file (--bin, layout at write_bin)
  *  - retention → rough capacity estimator
- *  - info      → print DB stats (head/tail, blocks, CRCs, GC, recovery)
+ *  - info      → print DB stats (head/tail, blocks, CRCs, GC, recovery); --perf adds
+ *                latency histograms for the open/recovery it just performed
  *  - ingest    → write N rows for demos/tests
  */
 #include "stampdb.h"
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 /** @brief Print brief usage. */
 static void usage(void){
   fprintf(stderr, "Usage: stampctl export --series S --t0 ms --t1 ms [--csv|--ndjson]\n");
+  fprintf(stderr, "       stampctl export --all [--threads N] [--t0 ms] [--t1 ms] [--csv|--ndjson|--bin] [--out FILE]\n");
   fprintf(stderr, "       stampctl retention --days D\n");
-  fprintf(stderr, "       stampctl info\n");
+  fprintf(stderr, "       stampctl info [--perf]\n");
   fprintf(stderr, "       stampctl ingest --series S --rows N [--period-ms P] [--start 0]\n");
   fprintf(stderr, "\nOne-word helpers:\n");
   fprintf(stderr, "  stampctl reset   # delete sim files (flash.bin, meta_*)\n");
@@ -26,28 +32,174 @@ static void usage(void){
   fprintf(stderr, "  stampctl dump    # export all rows for series 1 as CSV\n");
 }
 
+/* ---- export --all: parallel whole-ring scan ------------------------------ */
+
+/** @brief Growable columns of one series' rows from one worker's ring range. */
+typedef struct { uint16_t series; size_t n, cap; uint32_t *ts; float *v; } col_t;
+
+/** @brief One worker: ring positions [pos0, pos1) into per-series columns. */
+typedef struct {
+  stampdb_t *db; const stampdb_scan_t *sc;
+  uint32_t pos0, pos1, t0, t1;
+  int32_t *slot;           // series -> index in cols, -1 = not seen
+  col_t *cols; size_t ncols, capcols;
+  int oom;
+} worker_t;
+
+/** @brief Scan callback: append the block's rows within [t0..t1] to its series' columns. */
+static void worker_block(void *user, uint16_t series, const uint32_t *ts, const float *vals, size_t n){
+  worker_t *w = user;
+  if (w->oom) return;
+  if (w->slot[series] < 0){
+    if (w->ncols == w->capcols){
+      size_t cap = w->capcols ? 2u*w->capcols : 16u; col_t *c = realloc(w->cols, cap*sizeof(col_t));
+      if (!c){ w->oom = 1; return; }
+      w->cols = c; w->capcols = cap;
+    }
+    memset(&w->cols[w->ncols], 0, sizeof(col_t)); w->cols[w->ncols].series = series;
+    w->slot[series] = (int32_t)w->ncols++;
+  }
+  col_t *c = &w->cols[w->slot[series]];
+  if (c->n + n > c->cap){
+    size_t cap = c->cap ? 2u*c->cap : 1024u;
+    while (cap < c->n + n) cap *= 2u;
+    uint32_t *t = realloc(c->ts, cap*sizeof(uint32_t)); if (t) c->ts = t;
+    float *v = realloc(c->v, cap*sizeof(float)); if (v) c->v = v;
+    if (!t || !v){ w->oom = 1; return; }
+    c->cap = cap;
+  }
+  for (size_t i=0;i<n;i++) if (ts[i] >= w->t0 && ts[i] <= w->t1){ c->ts[c->n] = ts[i]; c->v[c->n] = vals[i]; c->n++; }
+}
+
+static void *worker_main(void *arg){
+  worker_t *w = arg;
+  stampdb_scan_range(w->db, w->sc, w->pos0, w->pos1, worker_block, w);
+  return NULL;
+}
+
 /**
- * @brief Export rows for a series in [t0..t1] to CSV or NDJSON on stdout.
+ * @brief Binary columnar export (little-endian): "STX1", u32 series count, then per
+ * series ascending: u16 series, u16 0, u32 rows, u32 ts_ms[rows], f32 value[rows].
+ * One series' columns are the concatenation of the workers' parts in ring order.
+ */
+static void write_bin(FILE *f, worker_t *w, uint32_t nw, const uint16_t *ids, size_t nids){
+  uint32_t hdr[2] = { 0x31585453u, (uint32_t)nids }; // "STX1"
+  fwrite(hdr, sizeof(hdr), 1, f);
+  for (size_t k=0;k<nids;k++){
+    uint32_t rows = 0;
+    for (uint32_t i=0;i<nw;i++) if (w[i].slot[ids[k]] >= 0) rows += (uint32_t)w[i].cols[w[i].slot[ids[k]]].n;
+    uint16_t sh[2] = { ids[k], 0 };
+    fwrite(sh, sizeof(sh), 1, f); fwrite(&rows, sizeof(rows), 1, f);
+    for (uint32_t i=0;i<nw;i++) if (w[i].slot[ids[k]] >= 0){ const col_t *c = &w[i].cols[w[i].slot[ids[k]]]; fwrite(c->ts, sizeof(uint32_t), c->n, f); }
+    for (uint32_t i=0;i<nw;i++) if (w[i].slot[ids[k]] >= 0){ const col_t *c = &w[i].cols[w[i].slot[ids[k]]]; fwrite(c->v, sizeof(float), c->n, f); }
+  }
+}
+
+/** @brief Text export of every series (ascending), rows in ring order: CSV series,ts_ms,value or NDJSON. */
+static void write_text(FILE *f, int fmt, worker_t *w, uint32_t nw, const uint16_t *ids, size_t nids){
+  if (fmt==0) fputs("series,ts_ms,value\n", f);
+  for (size_t k=0;k<nids;k++)
+    for (uint32_t i=0;i<nw;i++){
+      if (w[i].slot[ids[k]] < 0) continue;
+      const col_t *c = &w[i].cols[w[i].slot[ids[k]]];
+      for (size_t r=0;r<c->n;r++){
+        if (fmt==0) fprintf(f, "%u,%u,%.9g\n", ids[k], c->ts[r], c->v[r]);
+        else fprintf(f, "{\"series\":%u,\"ts_ms\":%u,\"value\":%.9g}\n", ids[k], c->ts[r], c->v[r]);
+      }
+    }
+}
+
+/**
+ * @brief Export every series: the ring's positions are split into `threads` contiguous
+ * ranges scanned concurrently (CRC check + decode per block), then merged per series in
+ * seqno order and written through one large stdio buffer.
+ */
+static int export_all(uint32_t threads, uint32_t t0, uint32_t t1, int fmt, const char *out_path){
+  size_t ws_bytes = 1<<20; void *ws = malloc(ws_bytes);
+  if (!ws) { fprintf(stderr, "oom\n"); return 1; }
+  stampdb_t *db=NULL; stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=(uint32_t)ws_bytes,.read_batch_rows=512,.concurrent_readers=1};
+  if (stampdb_open(&db, &cfg)!=STAMPDB_OK){ fprintf(stderr, "open failed\n"); free(ws); return 2; }
+  stampdb_scan_t sc; stampdb_scan_begin(db, &sc);
+  if (threads > sc.segs) threads = sc.segs;
+  worker_t *w = calloc(threads, sizeof(worker_t));
+  pthread_t *tid = calloc(threads, sizeof(pthread_t));
+  int rc = (w && tid) ? 0 : 3;
+  for (uint32_t i=0;i<threads && !rc;i++){
+    w[i].db = db; w[i].sc = &sc; w[i].t0 = t0; w[i].t1 = t1;
+    w[i].pos0 = (uint32_t)((uint64_t)sc.segs*i/threads); w[i].pos1 = (uint32_t)((uint64_t)sc.segs*(i+1u)/threads);
+    w[i].slot = malloc(sizeof(int32_t)*0x10000u);
+    if (!w[i].slot){ rc = 3; break; }
+    memset(w[i].slot, 0xFF, sizeof(int32_t)*0x10000u);
+  }
+  uint32_t started = 0;
+  for (; started<threads && !rc; started++) if (pthread_create(&tid[started], NULL, worker_main, &w[started])!=0){ rc = 3; break; }
+  for (uint32_t i=0;i<started;i++) pthread_join(tid[i], NULL);
+  for (uint32_t i=0;i<threads && !rc;i++) if (w[i].oom) rc = 3;
+  if (rc) fprintf(stderr, "export: out of memory\n");
+
+  // series present in any range, ascending
+  uint16_t *ids = NULL; size_t nids = 0;
+  if (!rc){
+    static uint8_t seen[0x10000];
+    for (uint32_t i=0;i<threads;i++) for (size_t k=0;k<w[i].ncols;k++) seen[w[i].cols[k].series] = 1;
+    ids = malloc(sizeof(uint16_t)*0x10000u);
+    if (!ids) rc = 3;
+    else for (uint32_t id=0;id<0x10000u;id++) if (seen[id]) ids[nids++] = (uint16_t)id;
+  }
+  FILE *f = stdout;
+  if (!rc && out_path && !(f = fopen(out_path, fmt==2 ? "wb" : "w"))){ fprintf(stderr, "cannot open %s\n", out_path); rc = 4; }
+  if (!rc){
+    static char obuf[1u<<20];
+    setvbuf(f, obuf, _IOFBF, sizeof(obuf));
+    if (fmt==2) write_bin(f, w, threads, ids, nids); else write_text(f, fmt, w, threads, ids, nids);
+    if (fflush(f)!=0 || ferror(f)){ fprintf(stderr, "export: write failed\n"); rc = 4; }
+    if (f != stdout) fclose(f); else setvbuf(stdout, NULL, _IOLBF, 0);
+  }
+  stampdb_stats_t st; stampdb_info(db, &st);
+  if (st.crc_errors) fprintf(stderr, "export: %u pages failed CRC (their segments ended early)\n", st.crc_errors);
+  for (uint32_t i=0;w && i<threads;i++){
+    for (size_t k=0;k<w[i].ncols;k++){ free(w[i].cols[k].ts); free(w[i].cols[k].v); }
+    free(w[i].cols); free(w[i].slot);
+  }
+  free(ids); free(w); free(tid);
+  stampdb_close(db); free(ws);
+  return rc;
+}
+
+/**
+ * @brief Export rows for a series in [t0..t1] to CSV or NDJSON on stdout (--all: every series, see export_all).
  */
 static int cmd_export(int argc, char **argv){
-  uint16_t series=0; uint32_t t0=0,t1=0; int fmt=0; // 0=csv,1=ndjson
+  uint16_t series=0; uint32_t t0=0,t1=0; int fmt=0; // 0=csv,1=ndjson,2=bin (--all only)
+  int all=0, have_t1=0; uint32_t threads=0; const char *out_path=NULL;
   for (int i=2;i<argc;i++){
     if (strcmp(argv[i],"--series")==0 && i+1<argc){ series=(uint16_t)atoi(argv[++i]); }
     else if (strcmp(argv[i],"--t0")==0 && i+1<argc){ t0=(uint32_t)strtoul(argv[++i],NULL,10); }
-    else if (strcmp(argv[i],"--t1")==0 && i+1<argc){ t1=(uint32_t)strtoul(argv[++i],NULL,10); }
+    else if (strcmp(argv[i],"--t1")==0 && i+1<argc){ t1=(uint32_t)strtoul(argv[++i],NULL,10); have_t1=1; }
     else if (strcmp(argv[i],"--csv")==0){ fmt=0; }
     else if (strcmp(argv[i],"--ndjson")==0){ fmt=1; }
+    else if (strcmp(argv[i],"--bin")==0){ fmt=2; }
+    else if (strcmp(argv[i],"--all")==0){ all=1; }
+    else if (strcmp(argv[i],"--threads")==0 && i+1<argc){ threads=(uint32_t)strtoul(argv[++i],NULL,10); }
+    else if (strcmp(argv[i],"--out")==0 && i+1<argc){ out_path=argv[++i]; }
   }
+  if (all){
+    if (!threads){ long n = sysconf(_SC_NPROCESSORS_ONLN); threads = n > 0 ? (uint32_t)n : 1u; }
+    return export_all(threads, t0, have_t1 ? t1 : 0xFFFFFFFFu, fmt, out_path);
+  }
+  if (fmt==2){ fprintf(stderr, "export: --bin needs --all\n"); return 1; }
   if (t1<t0) t1=t0;
   size_t ws_bytes = 1<<20; void *ws = malloc(ws_bytes); // 1 MiB workspace (host only)
   stampdb_t *db=NULL; stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=(uint32_t)ws_bytes,.read_batch_rows=512,.commit_interval_ms=0};
   if (stampdb_open(&db, &cfg)!=STAMPDB_OK){ fprintf(stderr, "open failed\n"); return 1; }
   stampdb_it_t it; if (stampdb_query_begin(db, series, t0, t1, &it)!=STAMPDB_OK){ fprintf(stderr, "query begin failed\n"); return 2; }
   if (fmt==0) printf("ts_ms,value\n");
-  uint32_t ts; float v;
-  while (stampdb_next(&it,&ts,&v)){
-    if (fmt==0) printf("%u,%.9g\n", ts, v);
-    else printf("{\"ts_ms\":%u,\"value\":%.9g}\n", ts, v);
+  const uint32_t *ts; const float *v; size_t n;
+  while (stampdb_next_batch(&it,&ts,&v,&n)){
+    for (size_t i=0;i<n;i++){
+      if (fmt==0) printf("%u,%.9g\n", ts[i], v[i]);
+      else printf("{\"ts_ms\":%u,\"value\":%.9g}\n", ts[i], v[i]);
+    }
   }
   stampdb_query_end(&it);
   stampdb_close(db); free(ws);
@@ -72,15 +224,38 @@ static int cmd_retention(int argc, char **argv){
   return 0;
 }
 
-static int cmd_info(void){
+/** @brief Print one line per perf op that ran: totals plus non-empty log2 buckets as `<2^i us:count`. */
+static void print_perf(const stampdb_perf_t *p){
+  for (uint32_t op=0; op<STAMPDB_PERF_OP_COUNT; op++){
+    const stampdb_perf_hist_t *h = &p->ops[op];
+    if (!h->count) continue;
+    printf("perf %-13s count=%u total_us=%llu max_us=%u bytes=%llu hist=", stampdb_perf_op_name(op), h->count,
+           (unsigned long long)h->total_us, h->max_us, (unsigned long long)h->bytes);
+    const char *sep = "";
+    for (uint32_t b=0; b<STAMPDB_PERF_BUCKETS; b++) if (h->hist[b]){
+      if (b+1u < STAMPDB_PERF_BUCKETS) printf("%s<%u:%u", sep, 1u<<b, h->hist[b]); else printf("%s>=%u:%u", sep, 1u<<(b-1u), h->hist[b]);
+      sep = ",";
+    }
+    printf("\n");
+  }
+}
+
+static int cmd_info(int argc, char **argv){
+  int perf = 0;
+  for (int i=2;i<argc;i++) if (strcmp(argv[i],"--perf")==0) perf = 1;
   size_t ws_bytes = 1<<20; void *ws = malloc(ws_bytes);
   if (!ws) { fprintf(stderr, "oom\n"); return 1; }
-  stampdb_t *db=NULL; stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=(uint32_t)ws_bytes,.read_batch_rows=512,.commit_interval_ms=0};
+  stampdb_t *db=NULL; stampdb_cfg_t cfg={.workspace=ws,.workspace_bytes=(uint32_t)ws_bytes,.read_batch_rows=512,.commit_interval_ms=0,.perf=(uint32_t)perf};
   if (stampdb_open(&db, &cfg)!=STAMPDB_OK){ fprintf(stderr, "open failed\n"); free(ws); return 2; }
   stampdb_stats_t st; stampdb_info(db,&st);
   printf("seg_seq_head=%u seg_seq_tail=%u blocks_written=%u crc_errors=%u gc_warn_events=%u gc_busy_events=%u recovery_truncations=%u\n",
          st.seg_seq_head, st.seg_seq_tail, st.blocks_written, st.crc_errors,
          st.gc_warn_events, st.gc_busy_events, st.recovery_truncations);
+  if (perf){
+    stampdb_perf_t p;
+    if (stampdb_perf_info(db, &p, 0)!=STAMPDB_OK) printf("perf: not compiled in (build with -DSTAMPDB_ENABLE_PERF=ON)\n");
+    else print_perf(&p);
+  }
   stampdb_close(db); free(ws); return 0;
 }
 
@@ -147,7 +322,8 @@ static int cmd_dump(void){
   if (stampdb_open(&db, &cfg)!=STAMPDB_OK){ fprintf(stderr, "open failed\n"); free(ws); return 2; }
   printf("ts_ms,value\n");
   stampdb_it_t it; if (stampdb_query_begin(db,1,0,0xFFFFFFFFu,&it)!=STAMPDB_OK){ fprintf(stderr,"query begin failed\n"); stampdb_close(db); free(ws); return 3; }
-  uint32_t ts; float v; while (stampdb_next(&it,&ts,&v)) printf("%u,%.9g\n", ts, v);
+  const uint32_t *ts; const float *v; size_t n;
+  while (stampdb_next_batch(&it,&ts,&v,&n)) for (size_t i=0;i<n;i++) printf("%u,%.9g\n", ts[i], v[i]);
   stampdb_query_end(&it);
   stampdb_close(db); free(ws); return 0;
 }
@@ -172,7 +348,7 @@ int main(int argc, char **argv){
   if (argc<2){ usage(); return 1; }
   if (strcmp(argv[1],"export")==0) return cmd_export(argc,argv);
   if (strcmp(argv[1],"retention")==0) return cmd_retention(argc,argv);
-  if (strcmp(argv[1],"info")==0) return cmd_info();
+  if (strcmp(argv[1],"info")==0) return cmd_info(argc,argv);
   if (strcmp(argv[1],"ingest")==0) return cmd_ingest(argc,argv);
   if (strcmp(argv[1],"reset")==0) return cmd_reset();
   if (strcmp(argv[1],"peek")==0) return cmd_peek();